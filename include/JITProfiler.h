@@ -0,0 +1,119 @@
+/*
+    Copyright © 2025 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#ifndef _JITPROFILER_H
+#define _JITPROFILER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "config.h"
+
+/*
+    Sampling profiler of the m68k CPU. The virtual timer of CPU0 interrupts execution at the
+    rate given by the profile boot option. The interrupted ARM PC is classified, and if it is in
+    translated code it is mapped back to the m68k instruction through the local state of the
+    unit. Page faults cannot be interrupted, a timer which expired during the fault handler is
+    taken when the handler finishes and the sample is accounted to it.
+*/
+
+enum ProfCategory {
+    PROF_JIT,               /* Translated code, resolved to m68k instruction */
+    PROF_JIT_UNRESOLVED,    /* Translated code, unit not found or translator busy */
+    PROF_DISPATCH,          /* Main loop, lookups and helpers called from JIT code */
+    PROF_TRANSLATE,         /* Translator running on CPU0 */
+    PROF_FAULT,             /* Page fault handlers emulating bus access */
+    PROF_COUNT
+};
+
+#define PROF_MAGIC      0x50524f46  /* 'PROF' */
+#define PROF_VERSION    1
+
+/* Layout of the buffer written through JITPROF control register, all fields are big endian */
+struct ProfHeader {
+    uint32_t    ph_Capacity;        /* Size of the buffer, set by the caller */
+    uint32_t    ph_Magic;
+    uint32_t    ph_Version;
+    uint32_t    ph_Rate;            /* Samples per second */
+    uint32_t    ph_Category[PROF_COUNT];
+    uint32_t    ph_Dropped;         /* Samples which did not fit into the histogram */
+    uint32_t    ph_EntryCount;
+};
+
+struct ProfEntry {
+    uint32_t    pe_Address;         /* Address of m68k instruction */
+    uint32_t    pe_Count;           /* Number of samples taken in it */
+};
+
+#if EMU68_PROFILER
+
+extern uint32_t prof_rate;
+extern volatile uint8_t prof_activity;
+
+void Profiler_Start();
+void Profiler_Sample(uint64_t elr);
+void Profiler_FaultSample(uint64_t elr);
+void Profiler_Print();
+void Profiler_Export();
+
+/* Mark what CPU0 is doing outside of translated code. Other CPUs leave the marker alone */
+static inline uint8_t Profiler_Enter(uint8_t activity)
+{
+    uint64_t mpidr;
+    uint8_t old = prof_activity;
+
+    __asm__ volatile("mrs %0, MPIDR_EL1":"=r"(mpidr));
+    if ((mpidr & 3) == 0)
+        prof_activity = activity;
+
+    return old;
+}
+
+static inline void Profiler_Leave(uint8_t old)
+{
+    uint64_t mpidr;
+
+    __asm__ volatile("mrs %0, MPIDR_EL1":"=r"(mpidr));
+    if ((mpidr & 3) == 0)
+        prof_activity = old;
+}
+
+/* Called at the end of page fault handler, takes the sample if the timer expired meanwhile */
+static inline void Profiler_PollFault(uint64_t elr)
+{
+    uint64_t ctl;
+
+    if (prof_rate == 0)
+        return;
+
+    __asm__ volatile("mrs %0, CNTV_CTL_EL0":"=r"(ctl));
+
+    /* Enabled, not masked and expired */
+    if (ctl == 5)
+        Profiler_FaultSample(elr);
+}
+
+#else
+
+static inline void Profiler_Start() {}
+static inline void Profiler_Print() {}
+static inline void Profiler_Export() {}
+static inline uint8_t Profiler_Enter(uint8_t activity) { (void)activity; return 0; }
+static inline void Profiler_Leave(uint8_t old) { (void)old; }
+static inline void Profiler_PollFault(uint64_t elr) { (void)elr; }
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _JITPROFILER_H */
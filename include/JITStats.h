@@ -0,0 +1,95 @@
+/*
+    Copyright © 2025 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#ifndef _JITSTATS_H
+#define _JITSTATS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "config.h"
+
+/*
+    Instrumentation of the JIT. Every timed event has a pair of counters, number of events
+    followed by the number of CPU cycles (PMCCNTR_EL0) spent in them. The counters are selected
+    from m68k side by writing their number to JITSTATSEL, which latches the value into
+    JITSTATLO and JITSTATHI. Writing JITSTATSEL with bit 31 set clears all counters.
+
+    Counters are updated without locking. A fault taken on another CPU may race with the main
+    loop, so the values are approximate, which is good enough for tuning.
+*/
+
+enum JITStat {
+    JS_TRANSLATE,           /* M68K_Translate, both tiers and the async worker */
+    JS_TRANSLATE_CYCLES,
+    JS_VERIFY,              /* M68K_VerifyUnit and M68K_VerifyUnitCRC32 */
+    JS_VERIFY_CYCLES,
+    JS_DISPATCH,            /* MainLoop slow path, unit not found by LRU or lookup table */
+    JS_DISPATCH_CYCLES,
+    JS_FAULT,               /* Page fault handlers emulating bus access */
+    JS_FAULT_CYCLES,
+    JS_EVICT,               /* Units thrown away by M68K_EvictUnits */
+    JS_EVICT_CYCLES,
+    JS_LRU_HIT,             /* Both in MainLoop and in M68K_Dispatch */
+    JS_LRU_MISS,
+    JS_HASH_LOOKUPS,        /* Taken from ICache lookup table when latched */
+    JS_HASH_PROBES,
+    JS_BUSCALL,             /* Bus accesses called directly from translated code */
+    JS_BUSCALL_CYCLES,
+    JS_FAULT_CACHE_HIT,     /* Page faults emulated with already decoded access */
+    JS_FAULT_CACHE_MISS,
+    JS_COUNT
+};
+
+#define JITSTATF_CLEAR  0x80000000
+
+#if EMU68_JIT_STATS
+
+extern uint64_t jit_stats[JS_COUNT];
+
+static inline uint64_t JITStat_Clock()
+{
+    uint64_t t;
+    __asm__ volatile("mrs %0, PMCCNTR_EL0":"=r"(t));
+    return t;
+}
+
+static inline void JITStat_Inc(enum JITStat s)
+{
+    jit_stats[s]++;
+}
+
+/* Count the event s and the cycles spent since t0 */
+static inline void JITStat_Time(enum JITStat s, uint64_t t0)
+{
+    jit_stats[s]++;
+    jit_stats[s + 1] += JITStat_Clock() - t0;
+}
+
+#else
+
+static inline uint64_t JITStat_Clock() { return 0; }
+static inline void JITStat_Inc(enum JITStat s) { (void)s; }
+static inline void JITStat_Time(enum JITStat s, uint64_t t0) { (void)s; (void)t0; }
+
+#endif
+
+uint64_t JITStat_Get(enum JITStat s);
+void JITStat_Clear();
+void JITStat_Latch();
+void JITStat_Print();
+void JITStat_Periodic();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _JITSTATS_H */
@@ -16,6 +16,8 @@
 #include "nodes.h"
 #include "md5.h"
 #include "lists.h"
+#include "UnitTable.h"
+#include "UnitIndex.h"
 
 struct M68KLocalState
 {
@@ -28,22 +30,21 @@ struct M68KLocalState
 struct M68KTranslationUnit
 {
     /* Hot part of the structure shall preferably reside in one or at most two cache lines */
-    struct Node         mt_HashNode;        /* 00: 2 x 8 bytes - prev and next pointer in the has table bucket */
     union {
         struct {
-            uint32_t    mt_Epoch;           /* 16: 2 x 4 bytes - first 32-bit epoch incremented after every cache flush */
+            uint32_t    mt_Epoch;           /* 00: 2 x 4 bytes - first 32-bit epoch incremented after every cache flush */
             uint32_t    mt_M68kAddress;     /*                   followed by 32-bit m68k entry address */
         };
         uint64_t        mt_Key;             /*     1 x 8 bytes - match key, the two above combined */
     };
-    void *              mt_ARMEntryPoint;   /* 24: 1 x 8 bytes - entry point for AArch64 code */
+    void *              mt_ARMEntryPoint;   /* 08: 1 x 8 bytes - entry point for AArch64 code */
+    struct Node         mt_LRUNode;         /* 16: 2 x 8 bytes - LRU node */
 
     /* Less hot part - in case cache line is 32 bytes long, only */
-    struct Node         mt_LRUNode;         /* 32: 2 x 8 bytes - LRU node */
-    uint32_t            mt_CRC32;           /* 48: 1 x 4 bytes - CRC32 of the whole block*/
-    uint32_t            mt_Fingerprint;     /* 52: 1 x 4 bytes - *mt_M68kAddress ^ *(mt_M68kAddress + 4) */
-    uint32_t            mt_M68kLow;         /* 56: 1 x 4 bytes - lowest m68k address in this block */
-    uint32_t            mt_M68kHigh;        /* 60: 1 x 4 bytes - highest m68k address in this block */
+    uint32_t            mt_CRC32;           /* 32: 1 x 4 bytes - CRC32 of the whole block*/
+    uint32_t            mt_Fingerprint;     /* 36: 1 x 4 bytes - *mt_M68kAddress ^ *(mt_M68kAddress + 4) */
+    uint32_t            mt_M68kLow;         /* 40: 1 x 4 bytes - lowest m68k address in this block */
+    uint32_t            mt_M68kHigh;        /* 44: 1 x 4 bytes - highest m68k address in this block */
 
     /* Cold part of the structure */
     uint32_t        mt_JIT_CONTROL;
@@ -53,9 +54,14 @@ struct M68KTranslationUnit
     uint32_t        mt_Conditionals;
     uint32_t        mt_M68kInsnCnt;
     uint32_t        mt_ARMInsnCnt;
+    uint32_t        mt_Tier;            /* 1 - fast translation with entry counter, 2 - hot unit retranslated */
     uint64_t        mt_UseCount;
     uint64_t        mt_FetchCount;
     struct M68KLocalState *  mt_LocalState;
+    struct List     mt_ChainIn;         /* Links from exits of other units patched to jump into this one */
+    struct List     mt_ChainOut;        /* Links from exits of this unit patched to jump into other units */
+    struct UnitIndexNode mt_IndexNode;  /* Node of the index by m68k address range */
+    struct UnitIndexNode mt_ARMIndexNode; /* Node of the index by AArch64 code range */
     
     uint32_t        mt_ARMCode[] __attribute__((aligned(64)));
 };
@@ -82,6 +88,60 @@ struct DoubleExitBlock
     uint32_t    eb_ARMCode[];
 };
 
+/*
+    Link between a patchable exit slot of one translation unit and the entry point of another
+    one. Every link is present on the mt_ChainOut list of the source unit and on the mt_ChainIn
+    list of the target unit, so that either side can undo it when it is thrown away.
+*/
+struct M68KChainLink
+{
+    struct Node cl_OutNode;
+    struct Node cl_InNode;
+    uint32_t *  cl_Slot;
+    uint32_t    cl_Type;
+};
+
+#define CHAIN_BRANCH        0   /* cl_Slot is a nop patched to direct branch */
+#define CHAIN_INLINE_CACHE  1   /* cl_Slot is one way of M68KInlineCache */
+
+/*
+    Per-site target cache of an indirect exit (JMP, JSR, RTS), stored as data directly behind
+    the exit code. Two most recently seen m68k targets are compared with the PC in the code.
+*/
+#define IC_WAYS             2
+#define IC_INVALID_PC       1   /* odd address, never matches m68k PC */
+
+struct M68KInlineCache
+{
+    struct {
+        uint32_t    ic_M68kPC;
+        uint32_t    ic_Pad;
+        void *      ic_ARMEntry;
+    }                           ic_Way[IC_WAYS];
+    struct M68KTranslationUnit *ic_Unit;
+    uint32_t                    ic_Victim;
+    uint32_t                    ic_Pad;
+};
+
+/*
+    Entry of runtime return address stack. Calls leaving the unit push the m68k return address
+    together with inline cache of the call site, which remembers translation of the code at the
+    return address. RTS compares its PC with the top entry and uses that cache on a match.
+*/
+struct M68KShadowEntry
+{
+    uint32_t                    se_M68kPC;
+    uint32_t                    se_Pad;
+    struct M68KInlineCache *    se_Site;
+};
+
+/* Taken/not taken counters of a conditional branch, updated by tier 1 code */
+struct M68KBranchProfile
+{
+    uint32_t                    bp_Taken;
+    uint32_t                    bp_NotTaken;
+};
+
 #define FIXUP_BCC           0x00000bcc
 #define FIXUP_TBZ           0x00000036
 
@@ -89,6 +149,10 @@ struct DoubleExitBlock
 #define MARKER_DOUBLE_EXIT  0xffffaa56
 #define MARKER_STOP         0xffffffff
 #define MARKER_BREAK        0xfffffff1
+#define MARKER_STOP_LINKABLE 0xfffffff2
+#define MARKER_STOP_INDIRECT 0xfffffff3
+#define MARKER_CALL         0xfffffff4
+#define MARKER_STOP_RETURN  0xfffffff5
 
 struct TranslatorContext {
     uint32_t *      tc_CodeStart;
@@ -102,6 +166,9 @@ struct TranslatorContext {
         uint16_t *  tc_M68kCodePtr;
         uint32_t *  tc_PPCCodePtr;
     };
+    uint16_t        tc_KnownMask;       /* D0-D7/A0-A7 holding a value known at translation time */
+    uint16_t        tc_KnownWrites;     /* Registers the instruction being translated may change */
+    uint32_t        tc_KnownValue[16];
 };
 
 struct M68KState
@@ -168,6 +235,7 @@ struct M68KState
             uint8_t IPL;
             uint8_t RESET;
             uint8_t PPC;
+            uint8_t JIT;
         } INTF;
         uint64_t INT64;
     } __attribute__((aligned(8)));
@@ -182,6 +250,15 @@ struct M68KState
     uint32_t JIT_CONTROL2;
 
     volatile uint8_t * PPC_EE_FLAG;
+
+    uint32_t JIT_TIER2_PC;
+    uint32_t JIT_SNAPSHOT;
+    uint32_t JIT_SNAPSHOT_SIZE;
+    uint32_t JIT_STAT_SELECT;
+    uint32_t JIT_STAT_LO;
+    uint32_t JIT_STAT_HI;
+    uint32_t JIT_PROFILE;
+    uint32_t JIT_PROFILE_SIZE;
 };
 
 #define JCCB_SOFT               0
@@ -204,6 +281,16 @@ struct M68KState
 #define JC2_CHIP_SLOWDOWN_RATIO_MASK    0x07
 #define JC2B_BLITWAIT                   11
 #define JC2F_BLITWAIT                   (1 << JC2B_BLITWAIT)
+#define JC2B_TIER2_THRESHOLD            12
+#define JC2_TIER2_THRESHOLD_MASK        0x1f
+#define JC2B_PEEPHOLE                   17
+#define JC2F_PEEPHOLE                   (1 << JC2B_PEEPHOLE)
+#define JC2B_IR                         18
+#define JC2F_IR                         (1 << JC2B_IR)
+#define JC2B_DIRECT_BUS                 19
+#define JC2F_DIRECT_BUS                 (1 << JC2B_DIRECT_BUS)
+#define JC2B_POSTED_WRITES              20
+#define JC2F_POSTED_WRITES              (1 << JC2B_POSTED_WRITES)
 #define JC2B_INT_FROM_ARM               29
 #define JC2F_INT_FROM_ARM               (1 << JC2B_INT_FROM_ARM)
 #define JC2B_INT_FROM_PPC               30
@@ -544,6 +631,26 @@ struct M68KState
 #define CTX_LAST_PC_POS 3
 #define CTX_LAST_PC_ASM "v19.s[3]"
 
+#define CTX_EXIT_SLOT_VN 22
+#define CTX_EXIT_SLOT_SIZE TS_D
+#define CTX_EXIT_SLOT_POS 0
+#define CTX_EXIT_SLOT_ASM "v22.d[0]"
+
+#define CTX_IC_SITE_VN 22
+#define CTX_IC_SITE_SIZE TS_D
+#define CTX_IC_SITE_POS 1
+#define CTX_IC_SITE_ASM "v22.d[1]"
+
+#define CTX_SHADOW_SP_VN 23
+#define CTX_SHADOW_SP_SIZE TS_D
+#define CTX_SHADOW_SP_POS 0
+#define CTX_SHADOW_SP_ASM "v23.d[0]"
+
+#define CTX_BRANCH_PROFILE_VN 23
+#define CTX_BRANCH_PROFILE_SIZE TS_D
+#define CTX_BRANCH_PROFILE_POS 1
+#define CTX_BRANCH_PROFILE_ASM "v23.d[1]"
+
 #define REG_CACR        REG_CACR_VN,REG_CACR_SIZE,REG_CACR_POS
 #define REG_USP         REG_USP_VN,REG_USP_SIZE,REG_USP_POS
 #define REG_ISP         REG_ISP_VN,REG_ISP_SIZE,REG_ISP_POS
@@ -553,6 +660,10 @@ struct M68KState
 #define CTX_POINTER     CTX_POINTER_VN,CTX_POINTER_SIZE,CTX_POINTER_POS
 #define CTX_INSN_COUNT  CTX_INSN_COUNT_VN,CTX_INSN_COUNT_SIZE,CTX_INSN_COUNT_POS
 #define CTX_LAST_PC     CTX_LAST_PC_VN,CTX_LAST_PC_SIZE,CTX_LAST_PC_POS
+#define CTX_EXIT_SLOT   CTX_EXIT_SLOT_VN,CTX_EXIT_SLOT_SIZE,CTX_EXIT_SLOT_POS
+#define CTX_IC_SITE     CTX_IC_SITE_VN,CTX_IC_SITE_SIZE,CTX_IC_SITE_POS
+#define CTX_SHADOW_SP   CTX_SHADOW_SP_VN,CTX_SHADOW_SP_SIZE,CTX_SHADOW_SP_POS
+#define CTX_BRANCH_PROFILE CTX_BRANCH_PROFILE_VN,CTX_BRANCH_PROFILE_SIZE,CTX_BRANCH_PROFILE_POS
 
 void EMIT_GetOffsetPC(struct TranslatorContext *ctx, int8_t *offset);
 void EMIT_AdvancePC(struct TranslatorContext *ctx, uint8_t offset);
@@ -562,6 +673,7 @@ void EMIT_LoadFromEffectiveAddress(struct TranslatorContext *ctx, uint8_t size,
 void EMIT_StoreToEffectiveAddress(struct TranslatorContext *ctx, uint8_t size, uint8_t *arm_reg, uint8_t ea, uint8_t *ext_words, int sign_extend);
 void EMIT_Exception(struct TranslatorContext *ctx, uint16_t exception, uint8_t format, ...);
 void EMIT_LocalExit(struct TranslatorContext *ctx, uint32_t insn_count_fixup);
+void EMIT_ChainableExit(struct TranslatorContext *ctx, uint32_t insn_count_fixup);
 void EMIT_JumpOnCondition(struct TranslatorContext *ctx, uint8_t m68k_condition, uint32_t distance, uint32_t *type);
 void EMIT_JumpOnFPUCondition(struct TranslatorContext *ctx, uint8_t fpu_condition, uint32_t distance, uint32_t *jump_type);
 
@@ -659,6 +771,44 @@ void *M68K_TranslateNoCache(uint16_t *m68kcodeptr);
 struct M68KTranslationUnit *M68K_VerifyUnit(struct M68KTranslationUnit *unit);
 struct M68KTranslationUnit *M68K_VerifyUnitCRC32(struct M68KTranslationUnit *unit);
 void M68K_DumpStats();
+void M68K_LinkExit(uint32_t *slot, void *entry);
+void M68K_UpdateInlineCache(struct M68KInlineCache *site, uint32_t pc, void *entry);
+void M68K_UnlinkUnit(struct M68KTranslationUnit *unit);
+void M68K_UnlinkAll();
+void M68K_PromoteUnit(uint32_t address);
+void M68K_ResetShadowStack();
+void M68K_ResetBranchProfile();
+int M68K_PredictBranch(uint16_t *insn_ptr, int take_branch);
+void EMIT_BranchProfile(struct TranslatorContext *ctx, uint16_t *insn_ptr, int taken);
+void M68K_AddSuccessor(uint16_t *m68k_ptr);
+void M68K_LockTranslator();
+int M68K_TryLockTranslator();
+void M68K_UnlockTranslator();
+void M68K_TranslationWorker();
+int M68K_TranslationWorkerFault();
+void M68K_AdoptPrefetchedUnits();
+void M68K_SaveROMCache();
+int M68K_LoadROMCache(const void *buffer, uint32_t size);
+int M68K_IsROMCache(const void *buffer, uint32_t size);
+int M68K_WriteProtectFault(uint64_t far, uint64_t elr);
+void SYSFaultCacheFlush();
+void M68K_ReleaseDiscardedUnits();
+void M68K_InvalidateRange(uint32_t low, uint32_t high);
+void M68K_IndexUnit(struct M68KTranslationUnit *unit);
+void M68K_UnindexUnit(struct M68KTranslationUnit *unit);
+struct M68KTranslationUnit *M68K_FindUnitByARMAddress(const void *arm_pc);
+uint32_t M68K_RelocateUnit(struct M68KTranslationUnit *unit, uintptr_t old_address);
+void M68K_InitCodeCache();
+void *M68K_AllocUnit(uint32_t size);
+void *M68K_TrimUnit(void *unit, uint32_t size);
+void M68K_FreeUnit(void *unit);
+uint32_t M68K_CodeCacheFree();
+int M68K_RecycleCodeCache(int debug);
+void M68K_DumpCodeCacheStats();
+uint32_t M68K_Peephole(uint32_t *code, uint32_t length, uint8_t ctx_reg, uint32_t *map);
+void M68K_PrepareKnownValues(struct TranslatorContext *ctx, uint16_t *insn);
+void M68K_UpdateKnownValues(struct TranslatorContext *ctx, uint16_t *insn, uint32_t count);
+int M68K_KnownAddress(struct TranslatorContext *ctx, uint8_t ea, uint16_t *m68k_ptr, uint8_t *ext_words, uint32_t *address);
 uint8_t M68K_GetCC(uint32_t **ptr);
 uint8_t M68K_ModifyCC(uint32_t **ptr);
 void M68K_FlushCC(uint32_t **ptr);
@@ -672,4 +822,97 @@ void LRU_MarkForVerify(uint32_t *addr);
 
 extern uint8_t host_flags;
 
+/*
+    Opcode stream of the translator. Instruction words below 16MB are fetched from ICACHE in blocks of
+    M68K_CODE_BLOCK_SIZE bytes (whole cache lines, never crossing a page) and kept in a small direct
+    mapped buffer, so that the decoders do not pay for a full cache lookup on every extension word.
+    The buffer is valid only while M68K_Translate is running, outside of it the reads go to ICACHE.
+*/
+#define M68K_CODE_BLOCK_SIZE    64
+#define M68K_CODE_BLOCK_COUNT   4
+
+struct M68KCodeStream {
+    uint8_t     cs_Data[M68K_CODE_BLOCK_COUNT][M68K_CODE_BLOCK_SIZE] __attribute__((aligned(16)));
+    uint32_t    cs_Tag[M68K_CODE_BLOCK_COUNT];
+    uint32_t    cs_Active;
+};
+
+extern struct M68KCodeStream M68K_CodeStream;
+
+void M68K_OpenCodeStream();
+void M68K_CloseCodeStream();
+const uint8_t *M68K_FetchCodeBlock(uint32_t address);
+uint16_t M68K_ReadCodeSlow16(uint32_t address);
+uint32_t M68K_ReadCodeSlow32(uint32_t address);
+
+static inline const uint8_t *M68K_CodeBlock(uint32_t address)
+{
+    uint32_t slot = (address / M68K_CODE_BLOCK_SIZE) & (M68K_CODE_BLOCK_COUNT - 1);
+
+    if (M68K_CodeStream.cs_Tag[slot] == (address & ~(M68K_CODE_BLOCK_SIZE - 1)))
+        return M68K_CodeStream.cs_Data[slot];
+    else
+        return M68K_FetchCodeBlock(address);
+}
+
+static inline uint16_t M68K_ReadCode16(uint32_t address)
+{
+    if (address >= 0x01000000)
+        return *(uint16_t *)(uintptr_t)address;
+
+    if (!M68K_CodeStream.cs_Active || (address & (M68K_CODE_BLOCK_SIZE - 1)) > M68K_CODE_BLOCK_SIZE - 2)
+        return M68K_ReadCodeSlow16(address);
+
+    return *(const uint16_t *)(const void *)&M68K_CodeBlock(address)[address & (M68K_CODE_BLOCK_SIZE - 1)];
+}
+
+static inline uint32_t M68K_ReadCode32(uint32_t address)
+{
+    if (address >= 0x01000000)
+        return *(uint32_t *)(uintptr_t)address;
+
+    if (!M68K_CodeStream.cs_Active || (address & (M68K_CODE_BLOCK_SIZE - 1)) > M68K_CODE_BLOCK_SIZE - 4)
+        return M68K_ReadCodeSlow32(address);
+
+    return *(const uint32_t *)(const void *)&M68K_CodeBlock(address)[address & (M68K_CODE_BLOCK_SIZE - 1)];
+}
+
+/*
+    Values of m68k registers known at translation time, collected along the unit being translated.
+    The body of a unit has no merge points, conditional branches leave it through exit blocks and
+    loops return to its very beginning, where nothing is known. Entries are dropped as soon as an
+    instruction may write the register, see M68K_UpdateKnownValues.
+
+    M68K_GetKnownValue returns the value at the beginning of the instruction being translated.
+    Code computing addresses has to use M68K_GetStableValue instead, the instruction may already
+    have changed the register (e.g. by (An)+ mode) at the point where the address is needed.
+*/
+static inline int M68K_GetKnownValue(struct TranslatorContext *ctx, uint8_t reg, uint32_t *value)
+{
+    if (!(ctx->tc_KnownMask & (1 << reg)))
+        return 0;
+
+    *value = ctx->tc_KnownValue[reg];
+    return 1;
+}
+
+static inline int M68K_GetStableValue(struct TranslatorContext *ctx, uint8_t reg, uint32_t *value)
+{
+    if (ctx->tc_KnownWrites & (1 << reg))
+        return 0;
+
+    return M68K_GetKnownValue(ctx, reg, value);
+}
+
+static inline void M68K_SetKnownValue(struct TranslatorContext *ctx, uint8_t reg, uint32_t value)
+{
+    ctx->tc_KnownMask |= 1 << reg;
+    ctx->tc_KnownValue[reg] = value;
+}
+
+static inline void M68K_ForgetKnownValues(struct TranslatorContext *ctx, uint16_t mask)
+{
+    ctx->tc_KnownMask &= ~mask;
+}
+
 #endif /* _M68K_H */
@@ -0,0 +1,89 @@
+/*
+    Copyright © 2025 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#ifndef _M68KIR_H
+#define _M68KIR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+    Lightweight SSA form of a run of m68k instructions. Every node is a value defined exactly
+    once, m68k registers are tracked as the node holding their current value. Runs consist of
+    instructions which do not access memory: LEA, MOVEA, ADDA/SUBA, ADDQ/SUBQ to An, EXG, MOVEQ,
+    MOVE.L to Dn, ADD.L/SUB.L and ADDQ.L/SUBQ.L to Dn, CMP, CMPA, CMPI and TST of registers. The
+    whole run reduces to the set of registers it changes, the expressions computing their new
+    values and the last operation producing flags.
+
+    CCR is modelled as that operation together with its operands, which are nodes like any other
+    value. It is computed once, before the registers are written, so the condition flags of the
+    CPU still hold it when the run ends. A Bcc, DBcc or Scc following the run is translated by the
+    direct emitters and tests these flags without reloading CCR. A run stops in front of a flag
+    producer if flags of the previous one which it does not overwrite (X after ADD or SUB) are
+    still needed. MOVEM and memory operands are not part of the IR.
+
+    Nodes are simplified and numbered while being created (constant folding, reassociation of
+    constants, value numbering). Only values reaching the final register state are lowered,
+    the rest is dead and never emitted.
+*/
+
+#define IR_MAX_NODES    128
+#define IR_MAX_INSNS    16
+#define IR_NONE         0xffff
+
+enum IROp {
+    IR_CONST,       /* in_Value */
+    IR_REG,         /* Value of m68k register in_Value at start of the run */
+    IR_ADD,
+    IR_SUB,
+    IR_SEXT16,
+    IR_LSL          /* in_Args[0] shifted left by in_Value */
+};
+
+/* Operation which produced current CCR */
+enum IRFlags {
+    IRF_NONE,       /* Run did not change flags */
+    IRF_LOGIC,      /* N and Z of the first operand, V and C cleared */
+    IRF_ADD,        /* First operand plus second, X set as C */
+    IRF_SUB,        /* First operand minus second, X set as C */
+    IRF_CMP         /* Same as IRF_SUB, X unchanged */
+};
+
+struct IRNode {
+    uint8_t         in_Op;
+    uint8_t         in_Pad;
+    uint16_t        in_Reads;       /* m68k registers whose value at start of the run is used */
+    uint16_t        in_Args[2];
+    uint32_t        in_Value;
+};
+
+struct IRBlock {
+    struct IRNode   ib_Nodes[IR_MAX_NODES];
+    uint16_t        ib_NodeCount;
+    uint16_t        ib_InsnCount;
+    uint16_t        ib_Regs[16];    /* Node holding current value of D0-D7/A0-A7 */
+    uint8_t         ib_InsnSize[IR_MAX_INSNS];
+    uint8_t         ib_FlagOp;
+    uint8_t         ib_FlagSize;    /* Operand size in bytes */
+    uint8_t         ib_FlagMask;    /* Flags needed by the code following the producer */
+    uint16_t        ib_FlagArgs[2];
+};
+
+struct TranslatorContext;
+
+uint32_t M68K_TranslateIR(struct TranslatorContext *ctx, uint32_t max_insns, uint16_t *stop_at);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _M68KIR_H */
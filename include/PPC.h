@@ -15,6 +15,7 @@
 #include <emu68/Node>
 
 #include "A64.h"
+#include "UnitTable.h"
 
 #include <emu68/TranslatorContext>
 #include <emu68/ppc/PPCTranslatorContext.hpp>
@@ -311,24 +312,23 @@ struct TranslationUnitLRU : public Emu68::Node {
     TranslationUnitLRU(PPCTranslationUnit *node = nullptr) : unit(node) {}
 };
 
-struct PPCTranslationUnit : public Emu68::Node
+struct PPCTranslationUnit
 {
     /* Hot part of the structure shall preferably reside in one or at most two cache lines */
-    //struct Node         ptu_HashNode;       /* 00: 2 x 8 bytes - prev and next pointer in the has table bucket */
     union {
         struct {
-            uint32_t    ptu_Epoch;          /* 16: 2 x 4 bytes - first 32-bit epoch incremented after every cache flush */
+            uint32_t    ptu_Epoch;          /* 00: 2 x 4 bytes - first 32-bit epoch incremented after every cache flush */
             uint32_t    ptu_PPCAddress;     /*                   followed by 32-bit PPC entry address */
         };
         uint64_t        ptu_Key;            /*     1 x 8 bytes - match key, the two above combined */
     };
-    void *              ptu_ARMEntryPoint;  /* 24: 1 x 8 bytes - entry point for AArch64 code */
+    void *              ptu_ARMEntryPoint;  /* 08: 1 x 8 bytes - entry point for AArch64 code */
 
     /* Less hot part - in case cache line is 32 bytes long, only */
-    uint32_t            ptu_CRC32;          /* 32: 1 x 4 bytes - CRC32 of the whole block*/
-    uint32_t            ptu_Fingerprint;    /* 36: 1 x 4 bytes - *mt_M68kAddress ^ *(mt_M68kAddress + 4) */
-    uint32_t            ptu_PPCLow;        /* 40: 1 x 4 bytes - lowest m68k address in this block */
-    uint32_t            ptu_PPCHigh;       /* 44: 1 x 4 bytes - highest m68k address in this block */
+    uint32_t            ptu_CRC32;          /* 16: 1 x 4 bytes - CRC32 of the whole block*/
+    uint32_t            ptu_Fingerprint;    /* 20: 1 x 4 bytes - *mt_M68kAddress ^ *(mt_M68kAddress + 4) */
+    uint32_t            ptu_PPCLow;        /* 24: 1 x 4 bytes - lowest m68k address in this block */
+    uint32_t            ptu_PPCHigh;       /* 28: 1 x 4 bytes - highest m68k address in this block */
     TranslationUnitLRU  ptu_LRU;
 
     /* Cold part of the structure */
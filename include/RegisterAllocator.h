@@ -36,6 +36,7 @@ uint8_t RA_MapM68kRegisterForWrite(struct TranslatorContext *ctx, uint8_t m68k_r
 void RA_UnmapM68kRegister(struct TranslatorContext *ctx, uint8_t m68k_reg);
 uint8_t RA_CopyFromM68kRegister(struct TranslatorContext *ctx, uint8_t m68k_reg);
 uint16_t RA_GetTempAllocMask();
+void RA_Reset();
 
 void RA_ResetFPUAllocator();
 uint8_t RA_AllocFPURegister(struct TranslatorContext *ctx);
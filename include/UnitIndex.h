@@ -0,0 +1,67 @@
+/*
+    Copyright © 2019-2025 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#ifndef _UNITINDEX_H
+#define _UNITINDEX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+    Index of translation units by the range of guest addresses [low, high) they were translated
+    from. Units are put into hashed buckets by the 4K page of their lowest address. Overlap query
+    visits buckets of all pages the range touches, widened by the longest range ever inserted,
+    so that units starting before the queried range are found too.
+
+    The node is embedded in the unit, removal is O(1). Removing a node which is not in the
+    index does nothing. A unit may be put into several indexes, e.g. by guest address range and
+    by the range of its host code, with separate nodes.
+*/
+
+#define UNITINDEX_PAGE_SHIFT    12
+
+struct UnitIndexNode
+{
+    struct UnitIndexNode *  un_Next;        /* Next node in the same bucket */
+    struct UnitIndexNode ** un_Prev;        /* Pointer to this node in previous node or bucket head */
+    uint32_t                un_Low;
+    uint32_t                un_High;
+};
+
+struct UnitIndex
+{
+    struct UnitIndexNode ** ui_Buckets;
+    uint32_t                ui_Mask;
+    uint32_t                ui_Shift;
+    uint32_t                ui_Count;
+    uint32_t                ui_MaxSpan;     /* Longest range inserted so far, in pages */
+};
+
+typedef void (*UnitIndexFunc)(struct UnitIndexNode *node, void *data);
+
+void UnitIndex_Init(struct UnitIndex *idx, uint32_t size);
+void UnitIndex_Insert(struct UnitIndex *idx, struct UnitIndexNode *node, uint32_t low, uint32_t high);
+void UnitIndex_Remove(struct UnitIndex *idx, struct UnitIndexNode *node);
+void UnitIndex_Clear(struct UnitIndex *idx);
+uint32_t UnitIndex_ForEachOverlap(struct UnitIndex *idx, uint32_t low, uint32_t high, UnitIndexFunc func, void *data);
+struct UnitIndexNode *UnitIndex_FindFirst(struct UnitIndex *idx, uint32_t low, uint32_t high);
+
+static inline uint32_t UnitIndex_Hash(const struct UnitIndex *idx, uint32_t page)
+{
+    return (page * 0x9e3779b1) >> idx->ui_Shift;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UNITINDEX_H */
@@ -0,0 +1,134 @@
+/*
+    Copyright © 2019-2025 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#ifndef _UNITTABLE_H
+#define _UNITTABLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+    Lookup table of translation units used by both M68k and PPC JIT. The table uses open
+    addressing with linear probing, four slots share one cache line. A slot keeps the
+    {epoch, guest address} match key and pointer to the translation unit, so that a lookup
+    touches only the table and not the units which do not match.
+
+    Every guest address is present in the table at most once. Empty slots have NULL unit
+    pointer. Removal shifts following entries back, there are no tombstones.
+
+    Lookup functions are inline since they are called from the main loops which do not
+    follow C ABI.
+*/
+
+struct UnitTableSlot
+{
+    union {
+        struct {
+            uint32_t    us_Epoch;           /* Same layout as mt_Key/ptu_Key of the units */
+            uint32_t    us_Address;
+        };
+        uint64_t        us_Key;
+    };
+    void *              us_Unit;
+};
+
+struct UnitTable
+{
+    struct UnitTableSlot *  ut_Slots;
+    uint32_t                ut_Mask;
+    uint32_t                ut_Shift;
+    uint32_t                ut_Count;
+    uint32_t                ut_Limit;
+    uint64_t                ut_Lookups;     /* Number of lookups performed */
+    uint64_t                ut_Probes;      /* Total number of slots visited by lookups */
+    uint32_t                ut_MaxProbe;    /* Longest probe sequence seen */
+};
+
+void UnitTable_Init(struct UnitTable *t, uint32_t size);
+int UnitTable_Insert(struct UnitTable *t, uint32_t epoch, uint32_t address, void *unit);
+void UnitTable_Remove(struct UnitTable *t, uint32_t address);
+void UnitTable_SetEpoch(struct UnitTable *t, uint32_t address, uint32_t epoch);
+void UnitTable_ResetStats(struct UnitTable *t);
+
+static inline uint32_t UnitTable_Hash(const struct UnitTable *t, uint32_t address)
+{
+    return (address * 0x9e3779b1) >> t->ut_Shift;
+}
+
+static inline int UnitTable_IsFull(const struct UnitTable *t)
+{
+    return t->ut_Count >= t->ut_Limit;
+}
+
+static inline void UnitTable_CountProbe(struct UnitTable *t, uint32_t probes)
+{
+    t->ut_Lookups++;
+    t->ut_Probes += probes;
+    if (probes > t->ut_MaxProbe)
+        t->ut_MaxProbe = probes;
+}
+
+/* Find unit for given address, translated in given epoch */
+static inline void *UnitTable_Find(struct UnitTable *t, uint32_t epoch, uint32_t address)
+{
+    struct UnitTableSlot key;
+    uint32_t idx = UnitTable_Hash(t, address);
+    uint32_t probes = 1;
+
+    key.us_Epoch = epoch;
+    key.us_Address = address;
+
+    while (1)
+    {
+        struct UnitTableSlot *s = &t->ut_Slots[idx];
+
+        if (s->us_Unit == (void *)0)
+        {
+            UnitTable_CountProbe(t, probes);
+            return (void *)0;
+        }
+
+        if (s->us_Key == key.us_Key)
+        {
+            UnitTable_CountProbe(t, probes);
+            return s->us_Unit;
+        }
+
+        idx = (idx + 1) & t->ut_Mask;
+        probes++;
+    }
+}
+
+/* Find unit for given address regardless of its epoch */
+static inline void *UnitTable_FindAddress(struct UnitTable *t, uint32_t address)
+{
+    uint32_t idx = UnitTable_Hash(t, address);
+
+    while (1)
+    {
+        struct UnitTableSlot *s = &t->ut_Slots[idx];
+
+        if (s->us_Unit == (void *)0)
+            return (void *)0;
+
+        if (s->us_Address == address)
+            return s->us_Unit;
+
+        idx = (idx + 1) & t->ut_Mask;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UNITTABLE_H */
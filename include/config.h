@@ -53,6 +53,54 @@
 #define EMU68_PC_REG_HISTORY    0
 #define EMU68_CCR_SCAN_DEPTH    20
 #define EMU68_CCR_BREAK_AT_UNIT_END 1
+#define EMU68_CHAIN_UNITS       1
+#define EMU68_INLINE_CACHE      1
+#define EMU68_SHADOW_STACK      1
+#define EMU68_SHADOW_STACK_DEPTH 64
+#define EMU68_ASM_DISPATCH      1
+#define EMU68_TIERED_JIT        1
+#define EMU68_TIER2_THRESHOLD   12
+#define EMU68_TIER2_INSN_DEPTH  256
+#define EMU68_TIER2_CCR_SCAN_DEPTH 31
+#define EMU68_TIER2_LOOP_COUNT  16
+#define EMU68_BRANCH_PROFILE    1
+#define EMU68_BRANCH_PROFILE_SIZE 2048
+#define EMU68_BRANCH_PROFILE_MIN 32
+#define EMU68_ASYNC_JIT         1
+#define EMU68_ASYNC_JIT_CPU     1
+#define EMU68_ASYNC_JIT_QUEUE   64
+#define EMU68_ASYNC_JIT_DEPTH   2
+#define EMU68_ASYNC_JIT_SUCC    4
+#define EMU68_WP_SMC            1
+
+/* Segmented FIFO code cache, enabled with jit_fifo boot option */
+#define EMU68_JIT_SEGMENTED     1
+#define EMU68_JIT_SEGMENT_SIZE  (256*1024)
+#define EMU68_JIT_MAX_SEGMENTS  256
+#define EMU68_JIT_PROMOTE_FETCHES 64
+
+/* Cycle counters of translator and dispatcher, readable through JITSTATSEL/JITSTATLO/JITSTATHI */
+#define EMU68_JIT_STATS         1
+
+/* Sampling profiler of m68k code, started with profile=n boot option */
+#define EMU68_PROFILER          1
+#define EMU68_PROFILER_SLOTS    4096
+#define EMU68_PROFILER_TOP      32
+
+/* Peephole pass over translated code, controlled by JC2_PEEPHOLE, disabled with no_peephole boot option */
+#define EMU68_PEEPHOLE          1
+
+/* Translation of flag-less register instructions through SSA IR, controlled by JC2_IR, enabled with jit_ir boot option */
+#define EMU68_IR                1
+
+/* Tracking of register values known at translation time, used to simplify address computations */
+#define EMU68_KNOWN_VALUES      1
+
+/* Direct calls to bus access stubs for CHIP and chipset addresses known at translation time, controlled by JC2_DIRECT_BUS */
+#define EMU68_DIRECT_BUS        1
+
+/* Number of entries (power of two) in the cache of decoded loads and stores faulting on bus access, 0 disables it */
+#define EMU68_FAULT_CACHE       256
 
 #define EMU68_HASHSIZE          65536
 #define EMU68_HASHMASK          (EMU68_HASHSIZE - 1)
@@ -63,6 +111,12 @@
 /* Speed for bitbang RS232... */
 #define PISTORM_BITBANG_SPEED   921600
 
+/* Number of entries (power of two) in the PiStorm32 queue of posted CHIP RAM writes, controlled by JC2_POSTED_WRITES, 0 disables it */
+#define PISTORM_WRITE_QUEUE     256
+
+/* Runs of stores or loads to CHIP memory faulting together (MOVEM) are handled with one block transfer */
+#define PISTORM_BLOCK_FAULTS    1
+
 #endif
 
 #ifndef VERSION_STRING_DATE
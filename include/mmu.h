@@ -19,6 +19,7 @@ extern "C" {
 void mmu_init();
 uintptr_t mmu_virt2phys(uintptr_t addr);
 void mmu_map(uintptr_t phys, uintptr_t virt, uintptr_t length, uint32_t attr_low, uint32_t attr_high);
+int mmu_write_protect(uintptr_t virt, int protect);
 
 #ifdef __cplusplus
 }
@@ -10,6 +10,7 @@
 #include <M68k.h>
 #include <support.h>
 #include <config.h>
+#include <JITStats.h>
 #ifdef PISTORM_CLASSIC
 #define PS_PROTOCOL_IMPL
 #include "pistorm/ps_protocol.h"
@@ -50,7 +51,31 @@ static inline void setSR(uint32_t sr)
     __asm__ volatile("mov "REG_SR_ASM", %w0": :"r"(sr));
 }
 
-extern struct List ICache[EMU68_HASHSIZE];
+static inline uint32_t *getExitSlot()
+{
+    uint32_t *slot;
+    __asm__ volatile("mov %0, "CTX_EXIT_SLOT_ASM:"=r"(slot));
+    return slot;
+}
+
+static inline void clearExitSlot()
+{
+    __asm__ volatile("mov "CTX_EXIT_SLOT_ASM", xzr");
+}
+
+static inline struct M68KInlineCache *getICSite()
+{
+    struct M68KInlineCache *site;
+    __asm__ volatile("mov %0, "CTX_IC_SITE_ASM:"=r"(site));
+    return site;
+}
+
+static inline void clearICSite()
+{
+    __asm__ volatile("mov "CTX_IC_SITE_ASM", xzr");
+}
+
+extern struct UnitTable ICache;
 void M68K_LoadContext(struct M68KState *ctx);
 void M68K_SaveContext(struct M68KState *ctx);
 
@@ -89,36 +114,62 @@ uint32_t *LRU_FindBlock(uint32_t address)
     return NULL;
 }
 
-void LRU_MarkForVerify(uint32_t *addr)
+/*
+    Find slot of the LRU cache holding given ARM entry point. The unit owning the code is looked
+    up first, so that only the set of its m68k address is searched. Full scan is a fallback.
+*/
+static int LRU_FindByARMAddress(uint32_t *addr)
 {
-    for (int i = 0; i < EMU68_LRU_SET_COUNT * EMU68_LRU_WAY_COUNT; i++)
+    struct M68KTranslationUnit *unit = M68K_FindUnitByARMAddress(addr);
+
+    if (unit)
     {
-        if (LRU_cache[i].arm == addr)
+        const uint32_t set = ADDR_2_SET(unit->mt_M68kAddress);
+
+        for (uint32_t i = set * EMU68_LRU_WAY_COUNT; i < (set + 1) * EMU68_LRU_WAY_COUNT; i++)
         {
-            uintptr_t e = (uintptr_t)addr;
-            e &= 0x00ffffffffffffffULL;
-            e |= 0xaa00000000000000ULL;
-            LRU_cache[i].arm = (uint32_t *)e;
-            break;
+            if (LRU_cache[i].arm == addr)
+                return i;
         }
+
+        return -1;
+    }
+
+    for (int i = 0; i < EMU68_LRU_SET_COUNT * EMU68_LRU_WAY_COUNT; i++)
+    {
+        if (LRU_cache[i].arm == addr)
+            return i;
+    }
+
+    return -1;
+}
+
+void LRU_MarkForVerify(uint32_t *addr)
+{
+    int i = LRU_FindByARMAddress(addr);
+
+    if (i >= 0)
+    {
+        uintptr_t e = (uintptr_t)addr;
+        e &= 0x00ffffffffffffffULL;
+        e |= 0xaa00000000000000ULL;
+        LRU_cache[i].arm = (uint32_t *)e;
     }
 }
 
 void LRU_InvalidateByARMAddress(uint32_t *addr)
 {
-    for (int i = 0; i < EMU68_LRU_SET_COUNT * EMU68_LRU_WAY_COUNT; i++)
+    int i = LRU_FindByARMAddress(addr);
+
+    if (i >= 0)
     {
-        if (LRU_cache[i].arm == addr)
-        {
-            const uint32_t set = i / EMU68_LRU_WAY_COUNT;
-            const uint32_t way = i % EMU68_LRU_WAY_COUNT;
+        const uint32_t set = i / EMU68_LRU_WAY_COUNT;
+        const uint32_t way = i % EMU68_LRU_WAY_COUNT;
 
-            LRU_cache[i].arm = (void*)0;
-            LRU_cache[i].m68k = 0xffffffff;
-            
-            LRU_alloc[set] |= (0x80000000 >> way);
-            break;
-        }
+        LRU_cache[i].arm = (void*)0;
+        LRU_cache[i].m68k = 0xffffffff;
+        
+        LRU_alloc[set] |= (0x80000000 >> way);
     }
 }
 
@@ -170,51 +221,37 @@ void LRU_InsertBlock(struct M68KTranslationUnit *unit)
     LRU_alloc[set] = current;
 }
 
+/*
+    With the assembly dispatcher most LRU hits never get here, they are counted by M68K_Dispatch.
+    A PC which missed there misses here again and is counted as a miss once.
+*/
 static inline uint32_t * FindUnitQuick()
 {
 #if EMU68_USE_LRU
     uint32_t *code = LRU_FindBlock(PC);
 
     if (likely(code != NULL))
+    {
+        JITStat_Inc(JS_LRU_HIT);
         return code;
-#endif
-
-    union {
-        struct Node * node;
-        struct M68KTranslationUnit * unit;
-    } un;
-
-    union {
-        struct {
-            uint32_t    mt_Epoch;           /* 16: 2 x 4 bytes - first 32-bit epoch incremented after every cache flush */
-            uint32_t    mt_M68kAddress;     /*                   followed by 32-bit m68k entry address */
-        };
-        uint64_t        mt_Key;             /*     1 x 8 bytes - match key, the two above combined */
-    } u;
-
-    u.mt_Epoch = EPOCH;
-    u.mt_M68kAddress = PC;
+    }
 
-    uint64_t key = u.mt_Key;
+    JITStat_Inc(JS_LRU_MISS);
+#endif
 
-    /* Perform search */
-    uint32_t hash = (PC >> EMU68_HASHSHIFT) & EMU68_HASHMASK;
-    struct List *bucket = &ICache[hash];
+    struct M68KTranslationUnit *unit = UnitTable_Find(&ICache, EPOCH, PC);
 
-    /* Go through the list of translated units */
-    ForeachNode(bucket, un.node)
+    if (likely(unit != NULL))
     {
-        /* Check if unit is found */
-        if (un.unit->mt_Key == key)
-        {
-            /* Tell CPU we are going to execute the code soon, give it time to prefetch eventually */
-            asm volatile ("prfm plil1keep, [%0]"::"r"(un.unit->mt_ARMEntryPoint));
+        /* Tell CPU we are going to execute the code soon, give it time to prefetch eventually */
+        asm volatile ("prfm plil1keep, [%0]"::"r"(unit->mt_ARMEntryPoint));
+
+        unit->mt_FetchCount++;
 
 #if EMU68_USE_LRU
-            LRU_InsertBlock(un.unit);
+        LRU_InsertBlock(unit);
 #endif
-            return un.unit->mt_ARMEntryPoint;
-        }
+        return unit->mt_ARMEntryPoint;
     }
 
     return NULL;
@@ -222,54 +259,220 @@ static inline uint32_t * FindUnitQuick()
 
 static inline struct M68KTranslationUnit *FindUnit()
 {
-    union {
-        struct Node * node;
-        struct M68KTranslationUnit * unit;
-    } un;
+    struct M68KTranslationUnit *unit = UnitTable_FindAddress(&ICache, PC);
 
-    /* Perform search */
-    uint32_t hash = (PC >> EMU68_HASHSHIFT) & EMU68_HASHMASK;
-    struct List *bucket = &ICache[hash];
-
-    /* Go through the list of translated units */
-    ForeachNode(bucket, un.node)
-    {
-        /* Check if unit is found */
-        if (un.unit->mt_M68kAddress == PC)
-        {
 #if EMU68_USE_LRU
-            LRU_InsertBlock(un.unit);
+    if (unit != NULL)
+        LRU_InsertBlock(unit);
 #endif
-            return un.unit;
-        }
-    }
 
-    return NULL;
+    return unit;
 }
 
 static inline struct M68KTranslationUnit *FindUnitNoLRU()
 {
-    union {
-        struct Node * node;
-        struct M68KTranslationUnit * unit;
-    } un;
+    return UnitTable_FindAddress(&ICache, PC);
+}
 
-    /* Perform search */
-    uint32_t hash = (PC >> EMU68_HASHSHIFT) & EMU68_HASHMASK;
-    struct List *bucket = &ICache[hash];
+#if EMU68_CHAIN_UNITS || EMU68_INLINE_CACHE
+/*
+    If previous unit has left through a chainable exit, patch the exit to jump directly into the
+    code which is going to be executed now. If it has left through an indirect exit which missed
+    its inline cache, put the target there. Context has to be saved since C code is called.
+*/
+static inline void ChainExit(struct M68KState *ctx, void *entry)
+{
+    uint32_t *slot = getExitSlot();
+    struct M68KInlineCache *site = getICSite();
 
-    /* Go through the list of translated units */
-    ForeachNode(bucket, un.node)
+    if (unlikely(slot != NULL || site != NULL))
     {
-        /* Check if unit is found */
-        if (un.unit->mt_M68kAddress == PC)
-        {
-            return un.unit;
-        }
+        uint32_t pc = PC;
+
+        clearExitSlot();
+        clearICSite();
+        M68K_SaveContext(ctx);
+        if (slot)
+            M68K_LinkExit(slot, entry);
+        if (site)
+            M68K_UpdateInlineCache(site, pc, entry);
+        M68K_LoadContext(ctx);
     }
+}
+#else
+static inline void ChainExit(struct M68KState *ctx, void *entry) { (void)ctx; (void)entry; }
+#endif
 
-    return NULL;
+#if EMU68_ASM_DISPATCH
+/*
+    Dispatcher fast path, called by MainLoop instead of ARMCode(). It runs the unit at x12 and keeps
+    on dispatching as long as the next unit is either the same as the last one, or is found in the LRU
+    cache. All of it is done in registers, there is no context save and no C code involved. MainLoop
+    takes over on pending interrupt, uncached mode, LRU miss, or when the exit of last unit waits to be
+    linked by ChainExit.
+*/
+void M68K_Dispatch();
+
+void __attribute__((used)) stub_Dispatch()
+{
+    __asm__ volatile(
+"       .align  6                               \n"
+"       .globl  M68K_Dispatch                   \n"
+"M68K_Dispatch:                                 \n"
+"       str     x30, [sp, #-16]!                \n"
+"1:     blr     x12                             \n"
+#ifndef PISTORM_ANY_MODEL
+"       cbz     w%[reg_pc], 9f                  \n"
+#endif
+"       mov     x0, " CTX_POINTER_ASM "         \n"
+"       ldr     x1, [x0, #%[int64]]             \n"
+"       cbnz    x1, 9f                          \n" // Interrupt pending
+"       mov     w1, " REG_CACR_ASM "            \n"
+"       tbz     w1, #%[cacr_ie], 9f             \n" // JIT cache disabled
+"       mov     x0, " CTX_EXIT_SLOT_ASM "       \n"
+"       mov     x1, " CTX_IC_SITE_ASM "         \n"
+"       orr     x0, x0, x1                      \n"
+"       cbnz    x0, 9f                          \n" // Exit to be linked
+"       mov     w1, " CTX_LAST_PC_ASM "         \n"
+"       cmp     w1, w%[reg_pc]                  \n"
+"       b.eq    1b                              \n"
+#if EMU68_USE_LRU
+"       adrp    x0, LRU_cache                   \n"
+"       add     x0, x0, :lo12:LRU_cache         \n"
+"       ubfx    w1, w%[reg_pc], #4, #%[set_bits]\n" // x1 = set number, x0 = first entry of the set
+"       add     x0, x0, x1, lsl #%[set_shift]   \n"
+"       mov     w2, #0x80000000                 \n" // w2 = mask of the way in LRU_alloc
+"2:     ldp     x3, x4, [x0], #16               \n"
+"       cmp     x3, w%[reg_pc], uxtw            \n"
+"       b.eq    3f                              \n"
+"       lsr     w2, w2, #1                      \n"
+"       tbz     w2, #%[last_way], 2b            \n"
+"       b       9f                              \n" // LRU miss
+"3:     prfm    plil1keep, [x4]                 \n"
+"       adrp    x0, LRU_alloc                   \n" // Touch the way, same as LRU_FindBlock does
+"       add     x0, x0, :lo12:LRU_alloc         \n"
+"       ldr     w3, [x0, x1, lsl #2]            \n"
+"       bic     w3, w3, w2                      \n"
+"       lsr     w5, w3, #%[way_shift]           \n"
+"       cbnz    w5, 4f                          \n"
+"       mvn     w3, w2                          \n"
+"4:     str     w3, [x0, x1, lsl #2]            \n"
+#if EMU68_JIT_STATS
+"       adrp    x0, jit_stats                   \n" // Hits only, a miss is counted by FindUnitQuick
+"       add     x0, x0, :lo12:jit_stats         \n"
+"       ldr     x3, [x0, #%[lru_hit]]           \n"
+"       add     x3, x3, #1                      \n"
+"       str     x3, [x0, #%[lru_hit]]           \n"
+#endif
+"       mov     " CTX_LAST_PC_ASM ", w%[reg_pc] \n"
+"       mov     x12, x4                         \n"
+"       b       1b                              \n"
+#endif
+"9:     ldr     x30, [sp], #16                  \n"
+"       ret                                     \n"
+    ::[reg_pc]"i"(REG_PC),
+      [int64]"i"(__builtin_offsetof(struct M68KState, INT64)),
+      [cacr_ie]"i"(CACRB_IE),
+      [set_bits]"i"(__builtin_ctz(EMU68_LRU_SET_COUNT)),
+      [set_shift]"i"(4 + __builtin_ctz(EMU68_LRU_WAY_COUNT)),
+      [last_way]"i"(31 - EMU68_LRU_WAY_COUNT),
+      [way_shift]"i"(32 - EMU68_LRU_WAY_COUNT),
+      [lru_hit]"i"(8 * JS_LRU_HIT));
+}
+
+/*
+    Dispatcher microbenchmark. The dummy unit below decrements x13 and either keeps PC (pc_xor == 0)
+    or swaps it between two addresses found in LRU. Once the counter reaches zero, PC is set to an
+    address which misses in LRU and the dispatcher returns. Returns the cycles spent in M68K_Dispatch.
+*/
+#define BENCH_PC_A  0x00f80000
+#define BENCH_PC_B  0x00f80100
+#define BENCH_PC_END 0x00000002
+
+uint64_t M68K_DispatchBenchCore(struct M68KState *ctx, uint64_t count, uint32_t pc_xor);
+
+void __attribute__((used)) stub_DispatchBench()
+{
+    __asm__ volatile(
+"       .align  4                               \n"
+"DispatchBench_Unit:                            \n"
+"       subs    x13, x13, #1                    \n"
+"       b.eq    1f                              \n"
+"       eor     w%[reg_pc], w%[reg_pc], w14     \n"
+"       ret                                     \n"
+"1:     mov     w%[reg_pc], #%[pc_end]          \n"
+"       ret                                     \n"
+"       .globl  M68K_DispatchBenchCore          \n"
+"M68K_DispatchBenchCore:                        \n"
+"       stp     x29, x30, [sp, #-128]!          \n"
+"       stp     x12, x13, [sp, #16]             \n"
+"       stp     x14, x18, [sp, #32]             \n"
+"       stp     q19, q20, [sp, #48]             \n"
+"       stp     q21, q22, [sp, #80]             \n"
+"       str     q23, [sp, #112]                 \n"
+"       mov     " CTX_POINTER_ASM ", x0         \n"
+"       mov     w3, #%[cacr]                    \n"
+"       mov     " REG_CACR_ASM ", w3            \n"
+"       movi    v22.2d, #0                      \n"
+"       mov     x13, x1                         \n"
+"       mov     w14, w2                         \n"
+"       mov     w%[reg_pc], #%[pc_a]            \n"
+"       mov     " CTX_LAST_PC_ASM ", w%[reg_pc] \n"
+"       adr     x12, DispatchBench_Unit         \n"
+"       isb                                     \n"
+"       mrs     x29, PMCCNTR_EL0                \n"
+"       bl      M68K_Dispatch                   \n"
+"       isb                                     \n"
+"       mrs     x0, PMCCNTR_EL0                 \n"
+"       sub     x0, x0, x29                     \n"
+"       ldr     q23, [sp, #112]                 \n"
+"       ldp     q21, q22, [sp, #80]             \n"
+"       ldp     q19, q20, [sp, #48]             \n"
+"       ldp     x14, x18, [sp, #32]             \n"
+"       ldp     x12, x13, [sp, #16]             \n"
+"       ldp     x29, x30, [sp], #128            \n"
+"       ret                                     \n"
+    ::[reg_pc]"i"(REG_PC),
+      [cacr]"i"(CACR_IE),
+      [pc_a]"i"(BENCH_PC_A),
+      [pc_end]"i"(BENCH_PC_END));
+}
+
+void M68K_DispatchBenchmark()
+{
+    extern void DispatchBench_Unit();
+    static struct M68KState state;
+    struct M68KTranslationUnit unit;
+    const uint64_t iter_count = 1000000;
+    uint64_t cycles;
+
+    LRU_InvalidateAll();
+
+    unit.mt_ARMEntryPoint = (void *)DispatchBench_Unit;
+    unit.mt_M68kAddress = BENCH_PC_A;
+    LRU_InsertBlock(&unit);
+    unit.mt_M68kAddress = BENCH_PC_B;
+    LRU_InsertBlock(&unit);
+
+    cycles = M68K_DispatchBenchCore(&state, iter_count, 0);
+    kprintf("[JIT] Dispatch to last unit: %lld cycles, %f cycles per dispatch\n", cycles, (double)cycles / (double)iter_count);
+
+    cycles = M68K_DispatchBenchCore(&state, iter_count, BENCH_PC_A ^ BENCH_PC_B);
+    kprintf("[JIT] Dispatch through LRU: %lld cycles, %f cycles per dispatch\n", cycles, (double)cycles / (double)iter_count);
+
+    LRU_InvalidateAll();
+}
+
+static inline void RunUnit()
+{
+    M68K_Dispatch();
+}
+#else
+static inline void RunUnit()
+{
+    ARMCode();
 }
+#endif
 
 #ifdef PISTORM_CLASSIC
 
@@ -302,10 +505,14 @@ void MainLoop()
     struct M68KState *ctx = getCTX();
 
     LRU_InvalidateAll();
+    M68K_ResetShadowStack();
+    M68K_ResetBranchProfile();
 
     M68K_LoadContext(ctx);
 
     __asm__ volatile("mov v28.d[0], xzr");
+    clearExitSlot();
+    clearICSite();
 
     /* The JIT loop is running forever */
     while(1)
@@ -329,6 +536,21 @@ void MainLoop()
             uint32_t vector;
             uint32_t vbr;
 
+#if EMU68_TIERED_JIT
+            /* A unit has crossed the hotness threshold, retranslate it */
+            if (ctx->INTF.JIT)
+            {
+                ctx->INTF.JIT = 0;
+
+                M68K_SaveContext(ctx);
+                M68K_PromoteUnit(ctx->JIT_TIER2_PC);
+                M68K_LoadContext(ctx);
+
+                /* The unit in x12 might be gone now */
+                setLastPC(~0);
+            }
+#endif
+
             /* Find out requested IPL level based on ARM state and real IPL line */
             if (ctx->INTF.ARM_err)
             {
@@ -433,6 +655,10 @@ void MainLoop()
 
                 /* Load PC */
                 __asm__ volatile("ldr %w0, [%1, %2]":"=r"(PC):"r"(vbr),"r"(vector)); 
+
+                /* PC does not follow the exit of last unit anymore, do not link it */
+                clearExitSlot();
+                clearICSite();
             }
 
             /* All interrupts masked or new PC loaded and stack swapped, continue with code execution */
@@ -447,8 +673,10 @@ void MainLoop()
             /* The last PC is the same as currently set PC? */
             if (LastPC == PC)
             {
+                ChainExit(ctx, (void *)ARMCode);
+
                 /* Jump to the code now */
-                ARMCode();
+                RunUnit();
                 continue;
             }
             else
@@ -462,10 +690,12 @@ void MainLoop()
                     /* Store m68k PC of corresponding ARM code in CTX_LAST_PC */
                     __asm__ volatile("mov "CTX_LAST_PC_ASM", %w0": :"r"(PC));
 
+                    ChainExit(ctx, code);
+
                     /* This is the case, load entry point into x12 */
                     ARMCode = (void*)code;
                     
-                    ARMCode();
+                    RunUnit();
 
                     /* Go back to beginning of the loop */
                     continue;
@@ -474,34 +704,33 @@ void MainLoop()
                 /* If we are that far there was no JIT unit found */
                 M68K_SaveContext(ctx);
 
+                uint64_t t0 = JITStat_Clock();
+
                 uint32_t copyPC = getCTX()->PC;
 
+#if EMU68_ASYNC_JIT
+                /* Take units translated by the worker in the meantime, the one needed now may be among them */
+                M68K_AdoptPrefetchedUnits();
+#endif
+#if EMU68_WP_SMC
+                /* No unit is running now, units thrown away by write faults can be released */
+                M68K_ReleaseDiscardedUnits();
+#endif
+
                 /* Perform search without testing Epoch */
-                struct M68KTranslationUnit __attribute__((may_alias)) *node = NULL;
-                struct Node *n;
-                uint32_t hash = (copyPC >> EMU68_HASHSHIFT) & EMU68_HASHMASK;
-                struct List *bucket = &ICache[hash];
+                struct M68KTranslationUnit *node = UnitTable_FindAddress(&ICache, copyPC);
 
-                /* Go through the list of translated units */
-                ForeachNode(bucket, n)
+                if (node != NULL)
                 {
-                    union {
-                        struct Node *n;
-                        struct M68KTranslationUnit *u;
-                    } conv;
-
-                    conv.n = n;
-                    struct M68KTranslationUnit *u = conv.u;
-
-                    /* Check if unit is found */
-                    if (u->mt_M68kAddress == copyPC)
-                    {
-                        /* Node found, most likely Epoch broken */
-                        node = M68K_VerifyUnit(u);
-                        break;
-                    }
+                    /* Node found, most likely Epoch broken */
+                    uint64_t t1 = JITStat_Clock();
+                    node = M68K_VerifyUnit(node);
+                    JITStat_Time(JS_VERIFY, t1);
                 }
 
+                if (node != NULL)
+                    node->mt_FetchCount++;
+
                 if (node == NULL) {
                     /* Get the code. This never fails */
                     node = M68K_GetTranslationUnit((void*)(uintptr_t)copyPC);
@@ -510,12 +739,29 @@ void MainLoop()
 #if EMU68_USE_LRU
                 LRU_InsertBlock(node);
 #endif
+#if EMU68_CHAIN_UNITS || EMU68_INLINE_CACHE
+                /* Link exit of previous unit, if there was any left after verification above */
+                uint32_t *slot = getExitSlot();
+                struct M68KInlineCache *site = getICSite();
+                if (slot != NULL)
+                {
+                    clearExitSlot();
+                    M68K_LinkExit(slot, node->mt_ARMEntryPoint);
+                }
+                if (site != NULL)
+                {
+                    clearICSite();
+                    M68K_UpdateInlineCache(site, copyPC, node->mt_ARMEntryPoint);
+                }
+#endif
+                JITStat_Time(JS_DISPATCH, t0);
+
                 /* Load CPU context */
                 M68K_LoadContext(getCTX());
                 __asm__ volatile("mov "CTX_LAST_PC_ASM", %w0": :"r"(PC));
                 /* Prepare ARM pointer in x12 and call it */
                 ARMCode = node->mt_ARMEntryPoint;
-                ARMCode();
+                RunUnit();
             }
         }
         else
@@ -524,17 +770,25 @@ void MainLoop()
 
             /* Uncached mode - reset LastPC */
             setLastPC(~0);
+            clearExitSlot();
+            clearICSite();
 
             /* Save context since C code will be called */
             M68K_SaveContext(ctx);
 
+#if EMU68_WP_SMC
+            M68K_ReleaseDiscardedUnits();
+#endif
+
             /* Find the unit */
             node = FindUnitNoLRU();
 
             /* If node is found verify it */
             if (likely(node != NULL))
             {
+                uint64_t t1 = JITStat_Clock();
                 node = M68K_VerifyUnitCRC32(node);
+                JITStat_Time(JS_VERIFY, t1);
             }
             /* If node was not found or invalidated, translate code */
             if (unlikely(node == NULL))
@@ -0,0 +1,271 @@
+/*
+    Copyright © 2025 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "support.h"
+#include "config.h"
+#include "M68k.h"
+#include "mmu.h"
+#include "intc.h"
+#include "JITProfiler.h"
+
+#if EMU68_PROFILER
+
+#define JIT_EXEC_ALIAS  0x0000001000000000ULL
+#define PROF_MAX_PROBE  16
+
+extern struct M68KState *__m68k_state;
+
+/* Samples per second, zero if profiler is disabled */
+uint32_t prof_rate = 0;
+volatile uint8_t prof_activity = PROF_DISPATCH;
+
+static uint64_t prof_interval;
+static uint64_t prof_category[PROF_COUNT];
+static uint64_t prof_dropped;
+static struct ProfEntry prof_hist[EMU68_PROFILER_SLOTS];
+
+static const char * const prof_names[PROF_COUNT] = {
+    "Translated code",
+    "Translated code, unresolved",
+    "Dispatcher and helpers",
+    "Translator",
+    "Page faults"
+};
+
+static inline void Rearm()
+{
+    __asm__ volatile("msr CNTV_TVAL_EL0, %0; isb"::"r"(prof_interval));
+}
+
+/* Map ARM address in translated code to m68k instruction. Returns 0 if it cannot be done now */
+static uint32_t ResolvePC(uint64_t elr)
+{
+    struct M68KTranslationUnit *unit;
+    uint32_t address = 0;
+
+    /* Units can be changed only with translator lock held, skip the sample if another CPU has it */
+    if (!M68K_TryLockTranslator())
+        return 0;
+
+    unit = M68K_FindUnitByARMAddress((void *)(uintptr_t)elr);
+
+    if (unit != NULL)
+    {
+        struct M68KLocalState *ls = unit->mt_LocalState;
+        uint32_t offset = (elr - (uintptr_t)unit->mt_ARMEntryPoint) / 4;
+
+        address = unit->mt_M68kAddress;
+
+        /* Last instruction which code starts at or before the sampled one */
+        if (ls != NULL)
+        {
+            for (uint32_t i=0; i < unit->mt_M68kInsnCnt && ls[i].mls_ARMOffset <= offset; i++)
+                address = (uint32_t)(uintptr_t)ls[i].mls_M68kPtr;
+        }
+    }
+
+    M68K_UnlockTranslator();
+
+    return address;
+}
+
+static void Record(uint32_t address)
+{
+    uint32_t slot = (address * 0x9e3779b1) >> (32 - __builtin_ctz(EMU68_PROFILER_SLOTS));
+
+    for (int i=0; i < PROF_MAX_PROBE; i++)
+    {
+        struct ProfEntry *e = &prof_hist[(slot + i) & (EMU68_PROFILER_SLOTS - 1)];
+
+        if (e->pe_Address == address || e->pe_Count == 0)
+        {
+            e->pe_Address = address;
+            e->pe_Count++;
+            return;
+        }
+    }
+
+    prof_dropped++;
+}
+
+static void Account(uint64_t elr, enum ProfCategory fallback)
+{
+    /* Is the address in the executable alias of JIT memory? */
+    extern void *m68k_jit_virt_base;
+    uint64_t offset = (elr & ~JIT_EXEC_ALIAS) - (uintptr_t)m68k_jit_virt_base;
+
+    if ((elr & JIT_EXEC_ALIAS) && offset < __m68k_state->JIT_CACHE_TOTAL)
+    {
+        uint32_t address = ResolvePC(elr);
+
+        if (address != 0)
+        {
+            Record(address);
+            if (fallback != PROF_FAULT)
+                fallback = PROF_JIT;
+        }
+        else if (fallback != PROF_FAULT)
+        {
+            fallback = PROF_JIT_UNRESOLVED;
+        }
+    }
+
+    prof_category[fallback]++;
+}
+
+/* Called from IRQ vector of CPU0 when the virtual timer has expired */
+void Profiler_Sample(uint64_t elr)
+{
+    uint32_t id = 0;
+
+    if (gic_available())
+        id = gic_read_iar();
+
+    Account(elr, prof_activity);
+    Rearm();
+
+    if (gic_available())
+        gic_write_eoir(id);
+}
+
+/* Timer expired while page fault was handled, count the sample for the instruction doing the access */
+void Profiler_FaultSample(uint64_t elr)
+{
+    Account(elr, PROF_FAULT);
+    Rearm();
+}
+
+/* Start the timer on CPU0. Has to be called on CPU0 */
+void Profiler_Start()
+{
+    uint64_t freq;
+
+    if (prof_rate == 0)
+        return;
+
+    __asm__ volatile("mrs %0, CNTFRQ_EL0":"=r"(freq));
+    prof_interval = (freq & 0xffffffff) / prof_rate;
+    if (prof_interval == 0)
+        prof_interval = 1;
+
+    kprintf("[JIT] Starting profiler, %d samples per second\n", prof_rate);
+
+    if (gic_available())
+        gic_irq_eanble(GIC_PPI_VTIMER);
+
+    Rearm();
+    __asm__ volatile("msr CNTV_CTL_EL0, %0; isb"::"r"(1ULL));
+    __asm__ volatile("msr DAIFClr, #2");
+}
+
+void Profiler_Print()
+{
+    uint64_t total = 0;
+
+    if (prof_rate == 0)
+        return;
+
+    for (int i=0; i < PROF_COUNT; i++)
+        total += prof_category[i];
+
+    if (total == 0)
+        return;
+
+    kprintf("[JIT] Profiler: %lld samples, %lld not in histogram\n", total, prof_dropped);
+    for (int i=0; i < PROF_COUNT; i++)
+    {
+        uint32_t share = (10000 * prof_category[i]) / total;
+        kprintf("[JIT]   %s: %lld (%d.%02d%%)\n", prof_names[i], prof_category[i], share / 100, share % 100);
+    }
+
+    /* Show hottest instructions, selected without sorting the histogram */
+    uint32_t last_count = 0xffffffff;
+    uint32_t last_address = 0;
+
+    kprintf("[JIT] Hottest m68k instructions:\n");
+    for (int n=0; n < EMU68_PROFILER_TOP; n++)
+    {
+        struct ProfEntry *best = NULL;
+
+        for (int i=0; i < EMU68_PROFILER_SLOTS; i++)
+        {
+            struct ProfEntry *e = &prof_hist[i];
+
+            if (e->pe_Count == 0)
+                continue;
+
+            /* Strictly behind previous pick in (count descending, address ascending) order */
+            if (e->pe_Count > last_count || (e->pe_Count == last_count && e->pe_Address <= last_address))
+                continue;
+
+            if (best == NULL || e->pe_Count > best->pe_Count || (e->pe_Count == best->pe_Count && e->pe_Address < best->pe_Address))
+                best = e;
+        }
+
+        if (best == NULL)
+            break;
+
+        uint32_t share = (10000ULL * best->pe_Count) / total;
+        kprintf("[JIT]   %08x: %d (%d.%02d%%)\n", best->pe_Address, best->pe_Count, share / 100, share % 100);
+
+        last_count = best->pe_Count;
+        last_address = best->pe_Address;
+    }
+}
+
+/*
+    Write the histogram to the buffer given in JIT_PROFILE. First longword of the buffer holds its
+    capacity. Required size is left in JIT_PROFILE_SIZE, if the buffer is too small nothing is
+    written. Called from JIT code through MOVEC.
+*/
+void Profiler_Export()
+{
+    uint32_t address = __m68k_state->JIT_PROFILE;
+    uint32_t count = 0;
+
+    for (int i=0; i < EMU68_PROFILER_SLOTS; i++)
+    {
+        if (prof_hist[i].pe_Count)
+            count++;
+    }
+
+    uint32_t size = sizeof(struct ProfHeader) + count * sizeof(struct ProfEntry);
+
+    __m68k_state->JIT_PROFILE_SIZE = size;
+
+    /* Buffer has to be in ARM memory, the bus is not going to handle that */
+    if (address == 0 || mmu_virt2phys(address) == (uintptr_t)-1 || mmu_virt2phys(address + size - 1) == (uintptr_t)-1)
+        return;
+
+    if (BE32(*(uint32_t *)(uintptr_t)address) < size)
+        return;
+
+    struct ProfHeader *hdr = (struct ProfHeader *)(uintptr_t)address;
+    struct ProfEntry *out = (struct ProfEntry *)&hdr[1];
+
+    hdr->ph_Magic = BE32(PROF_MAGIC);
+    hdr->ph_Version = BE32(PROF_VERSION);
+    hdr->ph_Rate = BE32(prof_rate);
+    for (int i=0; i < PROF_COUNT; i++)
+        hdr->ph_Category[i] = BE32((uint32_t)prof_category[i]);
+    hdr->ph_Dropped = BE32((uint32_t)prof_dropped);
+    hdr->ph_EntryCount = BE32(count);
+
+    for (int i=0; i < EMU68_PROFILER_SLOTS; i++)
+    {
+        if (prof_hist[i].pe_Count)
+        {
+            out->pe_Address = BE32(prof_hist[i].pe_Address);
+            out->pe_Count = BE32(prof_hist[i].pe_Count);
+            out++;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,161 @@
+/*
+    Copyright © 2025 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "support.h"
+#include "config.h"
+#include "M68k.h"
+#include "UnitTable.h"
+#include "JITStats.h"
+#include "JITProfiler.h"
+
+extern struct UnitTable ICache;
+extern struct M68KState *__m68k_state;
+
+/* Interval of the summary printed by housekeeper, in seconds. Zero disables it */
+uint32_t jit_stats_period = 0;
+
+#if EMU68_JIT_STATS
+
+uint64_t jit_stats[JS_COUNT];
+
+/* Lookup table counts since boot, remembered on clear */
+static uint64_t hash_lookups_base;
+static uint64_t hash_probes_base;
+
+uint64_t JITStat_Get(enum JITStat s)
+{
+    switch (s)
+    {
+        case JS_HASH_LOOKUPS:
+            return ICache.ut_Lookups - hash_lookups_base;
+        case JS_HASH_PROBES:
+            return ICache.ut_Probes - hash_probes_base;
+        default:
+            if (s < JS_COUNT)
+                return jit_stats[s];
+            return 0;
+    }
+}
+
+void JITStat_Clear()
+{
+    for (int i=0; i < JS_COUNT; i++)
+        jit_stats[i] = 0;
+
+    hash_lookups_base = ICache.ut_Lookups;
+    hash_probes_base = ICache.ut_Probes;
+}
+
+/* Called from JIT code on write to JITSTATSEL */
+void JITStat_Latch()
+{
+    uint32_t sel = __m68k_state->JIT_STAT_SELECT;
+
+    if (sel & JITSTATF_CLEAR)
+    {
+        JITStat_Clear();
+        sel &= ~JITSTATF_CLEAR;
+        __m68k_state->JIT_STAT_SELECT = sel;
+    }
+
+    uint64_t value = JITStat_Get(sel);
+
+    __m68k_state->JIT_STAT_LO = (uint32_t)value;
+    __m68k_state->JIT_STAT_HI = (uint32_t)(value >> 32);
+}
+
+static void PrintTimed(const char *name, enum JITStat s)
+{
+    uint64_t count = jit_stats[s];
+    uint64_t cycles = jit_stats[s + 1];
+
+    kprintf("[JIT]   %s: %lld, %lld cycles", name, count, cycles);
+    if (count)
+        kprintf(" (%lld per call)", cycles / count);
+    kprintf("\n");
+}
+
+void JITStat_Print()
+{
+    uint64_t hits = jit_stats[JS_LRU_HIT];
+    uint64_t total = hits + jit_stats[JS_LRU_MISS];
+    uint64_t lookups = JITStat_Get(JS_HASH_LOOKUPS);
+    uint64_t probes = JITStat_Get(JS_HASH_PROBES);
+    uint64_t fc_hits = jit_stats[JS_FAULT_CACHE_HIT];
+    uint64_t fc_total = fc_hits + jit_stats[JS_FAULT_CACHE_MISS];
+
+    kprintf("[JIT] Instrumentation counters:\n");
+    PrintTimed("Translations", JS_TRANSLATE);
+    PrintTimed("Verifications", JS_VERIFY);
+    PrintTimed("Slow dispatches", JS_DISPATCH);
+    PrintTimed("Bus page faults", JS_FAULT);
+    PrintTimed("Direct bus calls", JS_BUSCALL);
+    PrintTimed("Eviction passes", JS_EVICT);
+
+    if (total)
+    {
+        uint32_t rate = (10000 * hits) / total;
+        kprintf("[JIT]   LRU: %lld hits, %lld misses, hit rate %d.%02d%%\n",
+            hits, jit_stats[JS_LRU_MISS], rate / 100, rate % 100);
+    }
+
+    if (fc_total)
+    {
+        uint32_t rate = (10000 * fc_hits) / fc_total;
+        kprintf("[JIT]   Fault decode cache: %lld hits, %lld misses, hit rate %d.%02d%%\n",
+            fc_hits, jit_stats[JS_FAULT_CACHE_MISS], rate / 100, rate % 100);
+    }
+
+    if (lookups)
+    {
+        uint32_t mean = (100 * probes) / lookups;
+        kprintf("[JIT]   Lookup table: %lld lookups, mean chain walk %d.%02d\n", lookups, mean / 100, mean % 100);
+    }
+
+    kprintf("[JIT]   Units: %d, JIT cache free: %d kB\n",
+        __m68k_state->JIT_UNIT_COUNT, __m68k_state->JIT_CACHE_FREE / 1024);
+}
+
+/* Called by the housekeeper loop, prints the summary every jit_stats_period seconds */
+void JITStat_Periodic()
+{
+    static uint64_t last_shown = 0;
+    uint64_t now, freq;
+
+    if (jit_stats_period == 0)
+        return;
+
+    __asm__ volatile("mrs %0, CNTPCT_EL0":"=r"(now));
+    __asm__ volatile("mrs %0, CNTFRQ_EL0":"=r"(freq));
+
+    if (last_shown == 0)
+    {
+        last_shown = now;
+    }
+    else if (now - last_shown >= freq * jit_stats_period)
+    {
+        last_shown = now;
+        JITStat_Print();
+        Profiler_Print();
+    }
+}
+
+#else
+
+uint64_t JITStat_Get(enum JITStat) { return 0; }
+void JITStat_Clear() {}
+void JITStat_Latch()
+{
+    __m68k_state->JIT_STAT_LO = 0;
+    __m68k_state->JIT_STAT_HI = 0;
+}
+void JITStat_Print() {}
+void JITStat_Periodic() {}
+
+#endif
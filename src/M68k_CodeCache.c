@@ -0,0 +1,431 @@
+/*
+    Copyright © 2025 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "support.h"
+#include "config.h"
+#include "M68k.h"
+#include "lists.h"
+#include "tlsf.h"
+#include "cache.h"
+#include "UnitTable.h"
+
+/*
+    Memory for translated code. By default units are allocated from the JIT TLSF pool with the
+    worst case size and trimmed after translation. When the pool is full, least recently used
+    units are thrown away one by one, which fragments the pool over time.
+
+    With the jit_fifo boot option the pool is split into segments of equal size. Units are
+    allocated from the current segment by bumping a pointer, freed units leave holes which are
+    reclaimed only when the whole segment is recycled. Segments are recycled in FIFO order.
+    Hot units (retranslated in tier 2 or fetched often) found in a recycled segment are moved to
+    survivor segments instead of being thrown away. Survivor segments are recycled in FIFO order
+    as well, without further promotion.
+*/
+
+#define JIT_EXEC_ALIAS  0x0000001000000000ULL
+
+extern struct List LRU;
+extern struct UnitTable ICache;
+extern struct M68KState *__m68k_state;
+
+int jit_segmented = 0;
+
+static inline uint32_t UnitLength(struct M68KTranslationUnit *unit)
+{
+    uint32_t length = (4 * (unit->mt_ARMInsnCnt + 1) + 63 + sizeof(struct M68KTranslationUnit)) & ~63;
+
+    /* Local state kept for the profiler follows the code */
+    if (unit->mt_LocalState)
+        length += unit->mt_M68kInsnCnt * sizeof(struct M68KLocalState);
+
+    return length;
+}
+
+#if EMU68_JIT_SEGMENTED
+struct CodeSegment {
+    uintptr_t   cs_Base;
+    uintptr_t   cs_Top;             /* Next free byte */
+    uintptr_t   cs_Last;            /* Last allocation, the only one which can be trimmed */
+    uint32_t    cs_LiveUnits;       /* Units allocated and not freed yet */
+};
+
+static struct CodeSegment Segments[EMU68_JIT_MAX_SEGMENTS];
+static uintptr_t seg_base = 0;
+static uint32_t seg_count = 0;
+static uint32_t nursery_count = 0;
+static uint32_t nursery_current = 0;
+static uint32_t survivor_current = 0;
+
+static uint32_t seg_recycled = 0;
+static uint32_t seg_evicted = 0;
+static uint32_t seg_promoted = 0;
+static uint32_t seg_pinned = 0;
+
+static inline struct CodeSegment *SegmentOf(void *ptr)
+{
+    return &Segments[((uintptr_t)ptr - seg_base) / EMU68_JIT_SEGMENT_SIZE];
+}
+
+static inline int IsCurrent(uint32_t idx)
+{
+    return idx == nursery_current || idx == survivor_current;
+}
+
+/*
+    Bump allocate from segment idx if it has space left. An empty segment other than the current
+    one is reset first.
+*/
+static void *SegmentAlloc(uint32_t idx, uint32_t size)
+{
+    struct CodeSegment *s = &Segments[idx];
+
+    if (!IsCurrent(idx))
+    {
+        if (__atomic_load_n(&s->cs_LiveUnits, __ATOMIC_ACQUIRE) != 0)
+            return NULL;
+
+        s->cs_Top = s->cs_Base;
+        s->cs_Last = 0;
+    }
+
+    if (s->cs_Top + size > s->cs_Base + EMU68_JIT_SEGMENT_SIZE)
+        return NULL;
+
+    s->cs_Last = s->cs_Top;
+    s->cs_Top += size;
+    __atomic_add_fetch(&s->cs_LiveUnits, 1, __ATOMIC_RELEASE);
+
+    return (void *)s->cs_Last;
+}
+
+/* Allocate from current segment of the ring [first, first + count), move to next empty one if needed */
+static void *RingAlloc(uint32_t *current, uint32_t first, uint32_t count, uint32_t size)
+{
+    void *ptr = SegmentAlloc(*current, size);
+
+    for (uint32_t i=1; ptr == NULL && i < count; i++)
+    {
+        uint32_t idx = first + (*current - first + i) % count;
+
+        if (__atomic_load_n(&Segments[idx].cs_LiveUnits, __ATOMIC_ACQUIRE) == 0)
+        {
+            *current = idx;
+            ptr = SegmentAlloc(idx, size);
+        }
+    }
+
+    return ptr;
+}
+
+/*
+    Move hot unit to a survivor segment. The unit is already removed from LRU, lookup table and
+    indexes. Returns the new copy or NULL if there is no space in survivor segments.
+*/
+static struct M68KTranslationUnit *PromoteUnit(struct M68KTranslationUnit *unit)
+{
+    uint32_t length = UnitLength(unit);
+    struct M68KTranslationUnit *copy;
+
+    copy = RingAlloc(&survivor_current, nursery_count, seg_count - nursery_count, length);
+    if (copy == NULL)
+        return NULL;
+
+    memcpy(copy, unit, length);
+    M68K_RelocateUnit(copy, (uintptr_t)unit);
+
+    if (copy->mt_LocalState)
+        copy->mt_LocalState = (void *)((uintptr_t)copy + ((uintptr_t)unit->mt_LocalState - (uintptr_t)unit));
+
+    copy->mt_ARMEntryPoint = (void *)((uintptr_t)&copy->mt_ARMCode[0] | JIT_EXEC_ALIAS);
+    NEWLIST(&copy->mt_ChainIn);
+    NEWLIST(&copy->mt_ChainOut);
+    copy->mt_IndexNode.un_Prev = NULL;
+    copy->mt_ARMIndexNode.un_Prev = NULL;
+
+    arm_flush_dcache_for_jit((uintptr_t)&copy->mt_ARMCode[0], 4 * (copy->mt_ARMInsnCnt + 1));
+    arm_flush_icache_for_jit((uintptr_t)copy->mt_ARMEntryPoint, 4 * (copy->mt_ARMInsnCnt + 1));
+
+    ADDHEAD(&LRU, &copy->mt_LRUNode);
+    UnitTable_Insert(&ICache, copy->mt_Epoch, copy->mt_M68kAddress, copy);
+    M68K_IndexUnit(copy);
+
+    return copy;
+}
+
+static inline int IsHot(struct M68KTranslationUnit *unit)
+{
+    if (((uintptr_t)unit->mt_ARMEntryPoint >> 56) == 0xaa)
+        return 0;
+
+    return unit->mt_Tier == 2 || unit->mt_FetchCount >= EMU68_JIT_PROMOTE_FETCHES;
+}
+
+/*
+    Throw away all units of the segment, moving hot ones to survivor segments if promote is set.
+    Units which are not in LRU (waiting for adoption or for release) keep the segment busy.
+*/
+static void RecycleSegment(uint32_t idx, int promote, int debug)
+{
+    struct CodeSegment *s = &Segments[idx];
+    struct List victims;
+    struct Node *n, *next;
+
+    NEWLIST(&victims);
+
+    /* Take the units out of LRU first, promotion may recycle survivor segment in the meantime */
+    ForeachNodeSafe(&LRU, n, next)
+    {
+        struct M68KTranslationUnit *u = (void *)((char *)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+
+        if ((uintptr_t)u >= s->cs_Base && (uintptr_t)u < s->cs_Base + EMU68_JIT_SEGMENT_SIZE)
+        {
+            REMOVE(n);
+            ADDTAIL(&victims, n);
+        }
+    }
+
+    while ((n = REMHEAD(&victims)))
+    {
+        struct M68KTranslationUnit *u = (void *)((char *)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+        struct M68KTranslationUnit *copy = NULL;
+
+        UnitTable_Remove(&ICache, u->mt_M68kAddress);
+        M68K_UnindexUnit(u);
+        LRU_InvalidateByM68kAddress(u->mt_M68kAddress);
+        M68K_UnlinkUnit(u);
+
+        if (promote && IsHot(u))
+        {
+            copy = PromoteUnit(u);
+
+            /* Make room in the oldest survivor segment and try once again */
+            if (copy == NULL)
+            {
+                RecycleSegment(nursery_count + (survivor_current - nursery_count + 1) % (seg_count - nursery_count), 0, debug);
+                copy = PromoteUnit(u);
+            }
+        }
+
+        if (copy != NULL)
+        {
+            seg_promoted++;
+        }
+        else
+        {
+            seg_evicted++;
+            __m68k_state->JIT_UNIT_COUNT--;
+        }
+
+        M68K_FreeUnit(u);
+    }
+
+    if (s->cs_LiveUnits != 0)
+    {
+        seg_pinned++;
+    }
+    else
+    {
+        s->cs_Top = s->cs_Base;
+        s->cs_Last = 0;
+    }
+
+    seg_recycled++;
+
+    if (debug > 0)
+        kprintf("[ICache] Recycled JIT segment %d at %p, %d units still busy\n", idx, (void *)s->cs_Base, s->cs_LiveUnits);
+}
+#endif
+
+/*
+    Split JIT pool into segments if jit_fifo was given. Falls back to TLSF allocation if the
+    pool is too small.
+*/
+void M68K_InitCodeCache()
+{
+#if EMU68_JIT_SEGMENTED
+    if (jit_segmented)
+    {
+        uint32_t count = tlsf_get_free_size(jit_tlsf) / EMU68_JIT_SEGMENT_SIZE;
+
+        /* Leave some space for TLSF headers */
+        if (count > 0)
+            count--;
+        if (count > EMU68_JIT_MAX_SEGMENTS)
+            count = EMU68_JIT_MAX_SEGMENTS;
+
+        if (count >= 4)
+            seg_base = (uintptr_t)tlsf_malloc_aligned(jit_tlsf, count * EMU68_JIT_SEGMENT_SIZE, 64);
+
+        if (seg_base == 0)
+        {
+            kprintf("[ICache] JIT pool too small for segmented cache, using TLSF\n");
+            jit_segmented = 0;
+            return;
+        }
+
+        seg_count = count;
+        nursery_count = count - count / 4;
+
+        for (uint32_t i=0; i < count; i++)
+        {
+            Segments[i].cs_Base = seg_base + i * EMU68_JIT_SEGMENT_SIZE;
+            Segments[i].cs_Top = Segments[i].cs_Base;
+            Segments[i].cs_Last = 0;
+            Segments[i].cs_LiveUnits = 0;
+        }
+
+        nursery_current = 0;
+        survivor_current = nursery_count;
+
+        kprintf("[ICache] Segmented JIT cache: %d nursery and %d survivor segments of %d kB\n",
+            nursery_count, seg_count - nursery_count, EMU68_JIT_SEGMENT_SIZE / 1024);
+    }
+#endif
+}
+
+/* Allocate memory for a unit, 64 byte aligned. Returns NULL if no space is left */
+void *M68K_AllocUnit(uint32_t size)
+{
+#if EMU68_JIT_SEGMENTED
+    if (jit_segmented)
+    {
+        size = (size + 63) & ~63;
+
+        if (size > EMU68_JIT_SEGMENT_SIZE)
+            return NULL;
+
+        return RingAlloc(&nursery_current, 0, nursery_count, size);
+    }
+#endif
+
+    return tlsf_malloc_aligned(jit_tlsf, size, 64);
+}
+
+/* Shrink the unit after translation to its real length */
+void *M68K_TrimUnit(void *unit, uint32_t size)
+{
+#if EMU68_JIT_SEGMENTED
+    if (jit_segmented)
+    {
+        struct CodeSegment *s = SegmentOf(unit);
+
+        if (s->cs_Last == (uintptr_t)unit)
+            s->cs_Top = (uintptr_t)unit + ((size + 63) & ~63);
+
+        return unit;
+    }
+#endif
+
+    return tlsf_realloc(jit_tlsf, unit, size);
+}
+
+/* Release memory of a unit. In segmented cache the space is reused when the segment is recycled */
+void M68K_FreeUnit(void *unit)
+{
+    /* Decoded faulting accesses may point into the unit */
+    SYSFaultCacheFlush();
+
+#if EMU68_JIT_SEGMENTED
+    if (jit_segmented)
+    {
+        __atomic_sub_fetch(&SegmentOf(unit)->cs_LiveUnits, 1, __ATOMIC_RELEASE);
+        return;
+    }
+#endif
+
+    tlsf_free(jit_tlsf, unit);
+}
+
+/* Free space for new units, value of JIT_CACHE_FREE */
+uint32_t M68K_CodeCacheFree()
+{
+#if EMU68_JIT_SEGMENTED
+    if (jit_segmented)
+    {
+        uint32_t free = 0;
+
+        for (uint32_t i=0; i < seg_count; i++)
+        {
+            if (IsCurrent(i))
+                free += Segments[i].cs_Base + EMU68_JIT_SEGMENT_SIZE - Segments[i].cs_Top;
+            else if (Segments[i].cs_LiveUnits == 0)
+                free += EMU68_JIT_SEGMENT_SIZE;
+        }
+
+        return free;
+    }
+#endif
+
+    return tlsf_get_free_size(jit_tlsf);
+}
+
+/*
+    Make space for new unit by recycling the oldest nursery segment. Returns 0 if cache is not
+    segmented and units have to be evicted from LRU instead. Called on CPU0 with translator lock
+    held.
+*/
+int M68K_RecycleCodeCache(int debug)
+{
+#if EMU68_JIT_SEGMENTED
+    if (jit_segmented)
+    {
+        uint32_t victim = (nursery_current + 1) % nursery_count;
+
+        /* Skip segments busy with units outside LRU, they become empty once released */
+        for (uint32_t i=0; i < nursery_count - 1; i++)
+        {
+            RecycleSegment(victim, 1, debug);
+
+            if (Segments[victim].cs_LiveUnits == 0)
+                break;
+
+            victim = (victim + 1) % nursery_count;
+        }
+
+        __m68k_state->JIT_CACHE_FREE = M68K_CodeCacheFree();
+
+        return 1;
+    }
+#else
+    (void)debug;
+#endif
+
+    return 0;
+}
+
+void M68K_DumpCodeCacheStats()
+{
+#if EMU68_JIT_SEGMENTED
+    if (jit_segmented)
+    {
+        struct Node *n;
+        uintptr_t used = 0;
+        uintptr_t live = 0;
+
+        for (uint32_t i=0; i < seg_count; i++)
+        {
+            if (IsCurrent(i) || Segments[i].cs_LiveUnits != 0)
+                used += Segments[i].cs_Top - Segments[i].cs_Base;
+        }
+
+        ForeachNode(&LRU, n)
+        {
+            live += UnitLength((struct M68KTranslationUnit *)((char *)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode)));
+        }
+
+        uint32_t frag = used ? (uint32_t)(1000 * (used - (live < used ? live : used)) / used) : 0;
+        uint32_t rate = seg_recycled ? (100 * seg_evicted) / seg_recycled : 0;
+
+        kprintf("[ICache] Segmented cache: %d kB used, %d kB live, fragmentation %d.%d%%\n",
+            used / 1024, live / 1024, frag / 10, frag % 10);
+        kprintf("[ICache] Segments recycled: %d (%d busy), units evicted: %d (%d.%02d per segment), promoted: %d\n",
+            seg_recycled, seg_pinned, seg_evicted, rate / 100, rate % 100, seg_promoted);
+    }
+#endif
+}
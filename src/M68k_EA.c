@@ -8,6 +8,7 @@
     with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
 */
 
+#include "config.h"
 #include "support.h"
 #include "M68k.h"
 #include "RegisterAllocator.h"
@@ -400,6 +401,170 @@ static inline __attribute__((always_inline)) void store_reg_to_addr(struct Trans
         RA_FreeARMRegister(ctx, base);
 }
 
+/*
+    Find m68k register known to hold a value close enough to address, so that the access of given
+    size (or the address computation if size is 0) is a single instruction with immediate offset.
+    Returns the ARM register and the offset, 0xff if there is no such register.
+*/
+static uint8_t known_base(struct TranslatorContext *ctx, uint8_t size, uint32_t address, int32_t *offset)
+{
+    for (uint8_t reg=0; reg < 16; reg++)
+    {
+        uint32_t value;
+        int64_t off;
+        int fits;
+
+        if (!M68K_GetStableValue(ctx, reg, &value))
+            continue;
+
+        off = (int64_t)address - (int64_t)value;
+
+        if (size == 0)
+            fits = off > -4096 && off < 4096;
+        else if (off > -256 && off < 256)
+            fits = 1;
+        else
+            fits = off >= 0 && off < 4096 * size && (off & (size - 1)) == 0;
+
+        if (fits)
+        {
+            *offset = off;
+            return RA_MapM68kRegister(ctx, reg);
+        }
+    }
+
+    return 0xff;
+}
+
+/* ARM register of m68k register known to hold value, preferably the one equal to prefer. 0xff if none */
+static uint8_t known_register(struct TranslatorContext *ctx, uint32_t value, uint8_t prefer)
+{
+    uint8_t found = 0xff;
+
+    for (uint8_t reg=0; reg < 16; reg++)
+    {
+        uint32_t v;
+
+        if (M68K_GetStableValue(ctx, reg, &v) && v == value)
+        {
+            found = RA_MapM68kRegister(ctx, reg);
+            if (found == prefer)
+                break;
+        }
+    }
+
+    return found;
+}
+
+#if EMU68_DIRECT_BUS && defined(PISTORM_ANY_MODEL)
+
+void SYSBusRead8();
+void SYSBusRead16();
+void SYSBusRead32();
+void SYSBusWrite8();
+void SYSBusWrite16();
+void SYSBusWrite32();
+
+/*
+    Check if access of given size to the address known at translation time shall call the bus
+    directly. Only ranges which are never mapped are used: CHIP memory without page zero (it may
+    be mapped to ROM), CIA and custom chip registers. Everything else goes through page faults.
+*/
+static int direct_bus(uint8_t size, uint32_t address)
+{
+    extern struct M68KState *__m68k_state;
+    uint64_t last = (uint64_t)address + size - 1;
+
+    if (!(__m68k_state->JIT_CONTROL2 & JC2F_DIRECT_BUS))
+        return 0;
+
+    if (size != 1 && size != 2 && size != 4)
+        return 0;
+
+    return (address >= 0x1000 && last < 0x200000) ||
+           (address >= 0xbf0000 && last <= 0xbfffff) ||
+           (address >= 0xdff000 && last <= 0xdfffff);
+}
+
+/*
+    Call bus access stub with the address in w0 and value to store in w1. The stubs preserve all
+    registers but x0 and x1, these are saved here together with the link register.
+*/
+static void emit_bus_call(struct TranslatorContext *ctx, void (*stub)(), uint32_t address, uint8_t value)
+{
+    union {
+        uint64_t u64;
+        uint16_t u16[4];
+    } u;
+
+    u.u64 = (uintptr_t)stub;
+
+    EMIT(ctx,
+        stp64_preindex(31, 0, 1, -32),
+        str64_offset(31, 30, 16)
+    );
+
+    if (value != 0xff)
+        EMIT(ctx, mov_reg(1, value));
+
+    EMIT_LoadImmediate(ctx, 0, address);
+
+    EMIT(ctx,
+        mov64_immed_u16(30, u.u16[3], 0),
+        movk64_immed_u16(30, u.u16[2], 1),
+        movk64_immed_u16(30, u.u16[1], 2),
+        movk64_immed_u16(30, u.u16[0], 3),
+        blr(30)
+    );
+}
+
+static void emit_bus_read(struct TranslatorContext *ctx, uint8_t size, uint8_t reg, uint32_t address, int sign_ext)
+{
+    switch (size)
+    {
+        case 4:
+            emit_bus_call(ctx, SYSBusRead32, address, 0xff);
+            EMIT(ctx, mov_reg(reg, 0));
+            break;
+        case 2:
+            emit_bus_call(ctx, SYSBusRead16, address, 0xff);
+            EMIT(ctx, sign_ext ? sxth(reg, 0) : uxth(reg, 0));
+            break;
+        case 1:
+            emit_bus_call(ctx, SYSBusRead8, address, 0xff);
+            EMIT(ctx, sign_ext ? sxtb(reg, 0) : uxtb(reg, 0));
+            break;
+    }
+
+    EMIT(ctx,
+        ldr64_offset(31, 30, 16),
+        ldp64_postindex(31, 0, 1, 32)
+    );
+}
+
+static void emit_bus_write(struct TranslatorContext *ctx, uint8_t size, uint8_t reg, uint32_t address)
+{
+    switch (size)
+    {
+        case 4:
+            emit_bus_call(ctx, SYSBusWrite32, address, reg);
+            break;
+        case 2:
+            emit_bus_call(ctx, SYSBusWrite16, address, reg);
+            break;
+        case 1:
+            emit_bus_call(ctx, SYSBusWrite8, address, reg);
+            break;
+    }
+
+    EMIT(ctx,
+        ldr64_offset(31, 30, 16),
+        ldp64_postindex(31, 0, 1, 32)
+    );
+}
+
+#endif
+
 #define M68K_EA_DA 0x8000
 #define M68K_EA_REG 0x7000
 #define M68K_EA_WL 0x0800
@@ -486,7 +651,7 @@ void EMIT_LoadFromEffectiveAddress(struct TranslatorContext *ctx, uint8_t size,
                 }
                 break;
             case 0:
-                kprintf("Load form EA: Dn with wrong operand size! Opcode %04x at %08x\n", cache_read_16(ICACHE, (uint32_t)(uintptr_t)&m68k_ptr[-*ext_words]), m68k_ptr - *ext_words);
+                kprintf("Load form EA: Dn with wrong operand size! Opcode %04x at %08x\n", M68K_ReadCode16((uint32_t)(uintptr_t)&m68k_ptr[-*ext_words]), m68k_ptr - *ext_words);
                 break;
             default:
                 kprintf("Wrong size\n");
@@ -517,7 +682,7 @@ void EMIT_LoadFromEffectiveAddress(struct TranslatorContext *ctx, uint8_t size,
                 }
                 break;
             case 0:
-                kprintf("Load form EA: An with wrong operand size! Opcode %04x at %08x\n", cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[-*ext_words]), m68k_ptr - *ext_words);
+                kprintf("Load form EA: An with wrong operand size! Opcode %04x at %08x\n", M68K_ReadCode16((uintptr_t)&m68k_ptr[-*ext_words]), m68k_ptr - *ext_words);
                 {
                     uint16_t *ptr = &m68k_ptr[-*ext_words] - 8;
                     for (int i=0; i < 16; i++)
@@ -532,10 +697,44 @@ void EMIT_LoadFromEffectiveAddress(struct TranslatorContext *ctx, uint8_t size,
     }
     else
     {
+        uint8_t known_ext = *ext_words;
+        uint8_t known = 0xff;
+        uint32_t address;
+        int32_t offset;
+#if EMU68_DIRECT_BUS && defined(PISTORM_ANY_MODEL)
+        uint8_t bus = 0;
+#endif
+
         if (*arm_reg == 0xff)
             *arm_reg = RA_AllocARMRegister(ctx);
 
-        if (mode == 2) /* Mode 002: (An) */
+        if (M68K_KnownAddress(ctx, ea, m68k_ptr, &known_ext, &address))
+        {
+#if EMU68_DIRECT_BUS && defined(PISTORM_ANY_MODEL)
+            /* Chipset or CHIP memory, call the bus instead of taking a page fault */
+            if (direct_bus(size, address))
+                bus = 1;
+            else
+#endif
+            /* Indexed and absolute addresses known at translation time are reached from a register holding a nearby value */
+            if (mode == 6 || (mode == 7 && (src_reg == 0 || src_reg == 1 || src_reg == 3)))
+                known = known_base(ctx, size, address, &offset);
+        }
+
+#if EMU68_DIRECT_BUS && defined(PISTORM_ANY_MODEL)
+        if (bus)
+        {
+            *ext_words = known_ext;
+            emit_bus_read(ctx, size, *arm_reg, address, sign_ext);
+        }
+        else
+#endif
+        if (known != 0xff)
+        {
+            *ext_words = known_ext;
+            load_reg_from_addr_offset(ctx, size, known, *arm_reg, offset, 0, sign_ext);
+        }
+        else if (mode == 2) /* Mode 002: (An) */
         {
             if (size == 0) {
                 if (read_only) {
@@ -673,19 +872,19 @@ void EMIT_LoadFromEffectiveAddress(struct TranslatorContext *ctx, uint8_t size,
             {
                 RA_FreeARMRegister(ctx, *arm_reg);
                 *arm_reg = RA_MapM68kRegister(ctx, src_reg + 8);
-                *imm_offset = (int16_t)cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                *imm_offset = (int16_t)M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
             }
             else
             {
                 uint8_t reg_An = RA_MapM68kRegister(ctx, src_reg + 8);
-                int16_t off16 = (int16_t)cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                int16_t off16 = (int16_t)M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
 
                 load_reg_from_addr_offset(ctx, size, reg_An, *arm_reg, off16, 0, sign_ext);
             }
         }
         else if (mode == 6) /* Mode 006: (d8, An, Xn.SIZE*SCALE) */
         {
-            uint16_t brief = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+            uint16_t brief = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
             uint8_t extra_reg = (brief >> 12) & 7;
 
             if ((brief & 0x0100) == 0)
@@ -783,13 +982,13 @@ void EMIT_LoadFromEffectiveAddress(struct TranslatorContext *ctx, uint8_t size,
                 {
                     case 2: /* Word displacement */
                         bd_reg = RA_AllocARMRegister(ctx);
-                        lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        lo16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                         load_s16_ext32(ctx, bd_reg, lo16);
                         break;
                     case 3: /* Long displacement */
                         bd_reg = RA_AllocARMRegister(ctx);
-                        hi16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
-                        lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        hi16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        lo16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                         EMIT_LoadImmediate(ctx, bd_reg, (hi16 << 16) | lo16);
                         break;
                 }
@@ -799,13 +998,13 @@ void EMIT_LoadFromEffectiveAddress(struct TranslatorContext *ctx, uint8_t size,
                 {
                     case 2: /* Word outer displacement */
                         outer_reg = RA_AllocARMRegister(ctx);
-                        lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        lo16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                         load_s16_ext32(ctx, outer_reg, lo16);
                         break;
                     case 3: /* Long outer displacement */
                         outer_reg = RA_AllocARMRegister(ctx);
-                        hi16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
-                        lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        hi16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        lo16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                         EMIT_LoadImmediate(ctx, outer_reg, (hi16 << 16) | lo16);
                         break;
                 }
@@ -899,20 +1098,20 @@ void EMIT_LoadFromEffectiveAddress(struct TranslatorContext *ctx, uint8_t size,
                     EMIT_GetOffsetPC(ctx, &off8);
                     RA_FreeARMRegister(ctx, *arm_reg);
                     *arm_reg = REG_PC;
-                    *imm_offset = off8 + (int16_t)cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                    *imm_offset = off8 + (int16_t)M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                 }
                 else
                 {
                     int8_t off8 = 2 + 2*(*ext_words);
                     EMIT_GetOffsetPC(ctx, &off8);
-                    int32_t off = off8 + (int16_t)(cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]));
+                    int32_t off = off8 + (int16_t)(M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]));
 
                     load_reg_from_addr_offset(ctx, size, REG_PC, *arm_reg, off, 1, sign_ext);
                 }
             }
             else if (src_reg == 3)
             {
-                uint16_t brief = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                uint16_t brief = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                 uint8_t extra_reg = (brief >> 12) & 7;
 
                 if ((brief & 0x0100) == 0)
@@ -1149,7 +1348,7 @@ void EMIT_LoadFromEffectiveAddress(struct TranslatorContext *ctx, uint8_t size,
             else if (src_reg == 0)
             {
                 uint16_t lo16;
-                lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                lo16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
 
                 if (size == 0) {
                     load_s16_ext32(ctx, *arm_reg, lo16);
@@ -1165,8 +1364,8 @@ void EMIT_LoadFromEffectiveAddress(struct TranslatorContext *ctx, uint8_t size,
             else if (src_reg == 1)
             {
                 uint16_t hi16, lo16;
-                hi16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
-                lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                hi16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+                lo16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
 
                 if (size == 0) {
                     EMIT_LoadImmediate(ctx, *arm_reg, (hi16 << 16) | lo16);
@@ -1205,12 +1404,17 @@ void EMIT_LoadFromEffectiveAddress(struct TranslatorContext *ctx, uint8_t size,
                 switch (size)
                 {
                     case 4:
-                        hi16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
-                        lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
-                        EMIT_LoadImmediate(ctx, *arm_reg, (hi16 << 16) | lo16);
+                        hi16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        lo16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        /* Skip the load if target holds the value already, copy it if another register does */
+                        known = known_register(ctx, (hi16 << 16) | lo16, *arm_reg);
+                        if (known == 0xff)
+                            EMIT_LoadImmediate(ctx, *arm_reg, (hi16 << 16) | lo16);
+                        else if (known != *arm_reg)
+                            EMIT(ctx, mov_reg(*arm_reg, known));
                         break;
                     case 2:
-                        off = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        off = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
 
                         if (sign_ext && (off & 0x8000))
                             EMIT(ctx, movn_immed_u16(*arm_reg, ~off, 0));
@@ -1218,7 +1422,7 @@ void EMIT_LoadFromEffectiveAddress(struct TranslatorContext *ctx, uint8_t size,
                             EMIT(ctx, mov_immed_u16(*arm_reg, off, 0));
                         break;
                     case 1:
-                        off = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]) & 0xff;
+                        off = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]) & 0xff;
                         if (sign_ext && (off & 0x80))
                             EMIT(ctx, movn_immed_u16(*arm_reg, ~(off | 0xff00), 0));
                         else
@@ -1339,7 +1543,41 @@ void EMIT_StoreToEffectiveAddress(struct TranslatorContext *ctx, uint8_t size, u
     }
     else
     {
-        if (mode == 2) /* Mode 002: (An) */
+        uint8_t known_ext = *ext_words;
+        uint8_t known = 0xff;
+        uint32_t address;
+        int32_t offset;
+#if EMU68_DIRECT_BUS && defined(PISTORM_ANY_MODEL)
+        uint8_t bus = 0;
+#endif
+
+        if (M68K_KnownAddress(ctx, ea, m68k_ptr, &known_ext, &address))
+        {
+#if EMU68_DIRECT_BUS && defined(PISTORM_ANY_MODEL)
+            /* Chipset or CHIP memory, call the bus instead of taking a page fault */
+            if (direct_bus(size, address))
+                bus = 1;
+            else
+#endif
+            /* Indexed and absolute addresses known at translation time are reached from a register holding a nearby value */
+            if (mode == 6 || (mode == 7 && (src_reg == 0 || src_reg == 1 || src_reg == 3)))
+                known = known_base(ctx, size, address, &offset);
+        }
+
+#if EMU68_DIRECT_BUS && defined(PISTORM_ANY_MODEL)
+        if (bus)
+        {
+            *ext_words = known_ext;
+            emit_bus_write(ctx, size, *arm_reg, address);
+        }
+        else
+#endif
+        if (known != 0xff)
+        {
+            *ext_words = known_ext;
+            store_reg_to_addr_offset(ctx, size, known, *arm_reg, offset, 0);
+        }
+        else if (mode == 2) /* Mode 002: (An) */
         {
             if (size == 0) {
                 uint8_t tmp = RA_MapM68kRegister(ctx, src_reg + 8);
@@ -1418,13 +1656,13 @@ void EMIT_StoreToEffectiveAddress(struct TranslatorContext *ctx, uint8_t size, u
         else if (mode == 5) /* Mode 005: (d16, An) */
         {
             uint8_t reg_An = RA_MapM68kRegister(ctx, src_reg + 8);
-            int16_t off16 = (int16_t)cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+            int16_t off16 = (int16_t)M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
 
             store_reg_to_addr_offset(ctx, size, reg_An, *arm_reg, off16, 0);
         }
         else if (mode == 6) /* Mode 006: (d8, An, Xn.SIZE*SCALE) */
         {
-            uint16_t brief = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+            uint16_t brief = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
             uint8_t extra_reg = (brief >> 12) & 7;
 
             if ((brief & 0x0100) == 0)
@@ -1518,13 +1756,13 @@ void EMIT_StoreToEffectiveAddress(struct TranslatorContext *ctx, uint8_t size, u
                 {
                     case 2: /* Word displacement */
                         bd_reg = RA_AllocARMRegister(ctx);
-                        lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        lo16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                         load_s16_ext32(ctx, bd_reg, lo16);
                         break;
                     case 3: /* Long displacement */
                         bd_reg = RA_AllocARMRegister(ctx);
-                        hi16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
-                        lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        hi16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        lo16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                         EMIT_LoadImmediate(ctx, bd_reg, (hi16 << 16) | lo16);
                         break;
                 }
@@ -1534,13 +1772,13 @@ void EMIT_StoreToEffectiveAddress(struct TranslatorContext *ctx, uint8_t size, u
                 {
                     case 2: /* Word outer displacement */
                         outer_reg = RA_AllocARMRegister(ctx);
-                        lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        lo16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                         load_s16_ext32(ctx, outer_reg, lo16);
                         break;
                     case 3: /* Long outer displacement */
                         outer_reg = RA_AllocARMRegister(ctx);
-                        hi16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
-                        lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        hi16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+                        lo16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                         EMIT_LoadImmediate(ctx, outer_reg, (hi16 << 16) | lo16);
                         break;
                 }
@@ -1642,7 +1880,7 @@ void EMIT_StoreToEffectiveAddress(struct TranslatorContext *ctx, uint8_t size, u
             if (src_reg == 2) /* (d16, PC) mode */
             {
                 int8_t off = 2;
-                int32_t off32 = (int16_t)cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                int32_t off32 = (int16_t)M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                 EMIT_GetOffsetPC(ctx, &off);
                 off32 += off;
 
@@ -1650,7 +1888,7 @@ void EMIT_StoreToEffectiveAddress(struct TranslatorContext *ctx, uint8_t size, u
             }
             else if (src_reg == 3)
             {
-                uint16_t brief = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                uint16_t brief = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                 uint8_t extra_reg = (brief >> 12) & 7;
 
                 if ((brief & 0x0100) == 0)
@@ -1757,13 +1995,13 @@ void EMIT_StoreToEffectiveAddress(struct TranslatorContext *ctx, uint8_t size, u
                     {
                         case 2: /* Word displacement */
                             bd_reg = RA_AllocARMRegister(ctx);
-                            lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                            lo16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                             load_s16_ext32(ctx, bd_reg, lo16);
                             break;
                         case 3: /* Long displacement */
                             bd_reg = RA_AllocARMRegister(ctx);
-                            hi16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
-                            lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                            hi16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+                            lo16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                             EMIT_LoadImmediate(ctx, bd_reg, (hi16 << 16) | lo16);
                             break;
                     }
@@ -1773,13 +2011,13 @@ void EMIT_StoreToEffectiveAddress(struct TranslatorContext *ctx, uint8_t size, u
                     {
                         case 2: /* Word outer displacement */
                             outer_reg = RA_AllocARMRegister(ctx);
-                            lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                            lo16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                             load_s16_ext32(ctx, outer_reg, lo16);
                             break;
                         case 3: /* Long outer displacement */
                             outer_reg = RA_AllocARMRegister(ctx);
-                            hi16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
-                            lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                            hi16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+                            lo16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
                             EMIT_LoadImmediate(ctx, outer_reg, (hi16 << 16) | lo16);
                             break;
                     }
@@ -1864,7 +2102,7 @@ void EMIT_StoreToEffectiveAddress(struct TranslatorContext *ctx, uint8_t size, u
             else if (src_reg == 0)
             {
                 uint16_t lo16;
-                lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                lo16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
 
                 if (size == 0) {
                     load_s16_ext32(ctx, *arm_reg, lo16);
@@ -1880,8 +2118,8 @@ void EMIT_StoreToEffectiveAddress(struct TranslatorContext *ctx, uint8_t size, u
             else if (src_reg == 1)
             {
                 uint16_t lo16, hi16;
-                hi16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
-                lo16 = cache_read_16(ICACHE, (uintptr_t)&m68k_ptr[(*ext_words)++]);
+                hi16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
+                lo16 = M68K_ReadCode16((uintptr_t)&m68k_ptr[(*ext_words)++]);
 
                 if (size == 0) {
                     EMIT_LoadImmediate(ctx, *arm_reg, (hi16 << 16) | lo16);
@@ -0,0 +1,835 @@
+/*
+    Copyright © 2025 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "config.h"
+#include "support.h"
+#include "M68k.h"
+#include "M68kIR.h"
+#include "RegisterAllocator.h"
+
+static struct IRBlock ir;
+
+static void IR_Reset(struct IRBlock *b)
+{
+    b->ib_NodeCount = 0;
+    b->ib_InsnCount = 0;
+    b->ib_FlagOp = IRF_NONE;
+    b->ib_FlagMask = 0;
+    for (int i=0; i < 16; i++)
+        b->ib_Regs[i] = IR_NONE;
+}
+
+/* Create a node or return an existing one with the same definition (value numbering) */
+static uint16_t IR_Node(struct IRBlock *b, uint8_t op, uint16_t a0, uint16_t a1, uint32_t value)
+{
+    for (uint16_t i=0; i < b->ib_NodeCount; i++)
+    {
+        struct IRNode *n = &b->ib_Nodes[i];
+        if (n->in_Op == op && n->in_Args[0] == a0 && n->in_Args[1] == a1 && n->in_Value == value)
+            return i;
+    }
+
+    if (b->ib_NodeCount == IR_MAX_NODES)
+        return IR_NONE;
+
+    struct IRNode *n = &b->ib_Nodes[b->ib_NodeCount];
+
+    n->in_Op = op;
+    n->in_Args[0] = a0;
+    n->in_Args[1] = a1;
+    n->in_Value = value;
+    n->in_Reads = op == IR_REG ? 1 << value : 0;
+    if (a0 != IR_NONE)
+        n->in_Reads |= b->ib_Nodes[a0].in_Reads;
+    if (a1 != IR_NONE)
+        n->in_Reads |= b->ib_Nodes[a1].in_Reads;
+
+    return b->ib_NodeCount++;
+}
+
+static inline struct IRNode *N(struct IRBlock *b, uint16_t n)
+{
+    return &b->ib_Nodes[n];
+}
+
+static uint16_t IR_Const(struct IRBlock *b, uint32_t value)
+{
+    return IR_Node(b, IR_CONST, IR_NONE, IR_NONE, value);
+}
+
+static uint16_t IR_Reg(struct IRBlock *b, uint8_t reg)
+{
+    if (b->ib_Regs[reg] == IR_NONE)
+        b->ib_Regs[reg] = IR_Node(b, IR_REG, IR_NONE, IR_NONE, reg);
+
+    return b->ib_Regs[reg];
+}
+
+/* Constants are always the second operand and are moved outwards, x + c1 + c2 becomes x + (c1 + c2) */
+static uint16_t IR_Add(struct IRBlock *b, uint16_t x, uint16_t y)
+{
+    if (x == IR_NONE || y == IR_NONE)
+        return IR_NONE;
+
+    if (N(b, x)->in_Op == IR_CONST)
+    {
+        uint16_t t = x; x = y; y = t;
+    }
+
+    if (N(b, y)->in_Op == IR_CONST)
+    {
+        uint32_t c = N(b, y)->in_Value;
+
+        if (N(b, x)->in_Op == IR_CONST)
+            return IR_Const(b, N(b, x)->in_Value + c);
+        if (c == 0)
+            return x;
+        if (N(b, x)->in_Op == IR_ADD && N(b, N(b, x)->in_Args[1])->in_Op == IR_CONST)
+            return IR_Add(b, N(b, x)->in_Args[0], IR_Const(b, N(b, N(b, x)->in_Args[1])->in_Value + c));
+
+        return IR_Node(b, IR_ADD, x, y, 0);
+    }
+
+    if (N(b, y)->in_Op == IR_ADD && N(b, N(b, y)->in_Args[1])->in_Op == IR_CONST)
+        return IR_Add(b, IR_Add(b, x, N(b, y)->in_Args[0]), N(b, y)->in_Args[1]);
+    if (N(b, x)->in_Op == IR_ADD && N(b, N(b, x)->in_Args[1])->in_Op == IR_CONST)
+        return IR_Add(b, IR_Add(b, N(b, x)->in_Args[0], y), N(b, x)->in_Args[1]);
+
+    return IR_Node(b, IR_ADD, x, y, 0);
+}
+
+static uint16_t IR_Sub(struct IRBlock *b, uint16_t x, uint16_t y)
+{
+    if (x == IR_NONE || y == IR_NONE)
+        return IR_NONE;
+
+    if (x == y)
+        return IR_Const(b, 0);
+    if (N(b, y)->in_Op == IR_CONST)
+        return IR_Add(b, x, IR_Const(b, -N(b, y)->in_Value));
+    if (N(b, y)->in_Op == IR_ADD && N(b, N(b, y)->in_Args[1])->in_Op == IR_CONST)
+        return IR_Add(b, IR_Sub(b, x, N(b, y)->in_Args[0]), IR_Const(b, -N(b, N(b, y)->in_Args[1])->in_Value));
+    if (N(b, x)->in_Op == IR_ADD && N(b, N(b, x)->in_Args[1])->in_Op == IR_CONST)
+        return IR_Add(b, IR_Sub(b, N(b, x)->in_Args[0], y), N(b, x)->in_Args[1]);
+
+    return IR_Node(b, IR_SUB, x, y, 0);
+}
+
+static uint16_t IR_Sext16(struct IRBlock *b, uint16_t x)
+{
+    if (x == IR_NONE)
+        return IR_NONE;
+
+    if (N(b, x)->in_Op == IR_CONST)
+        return IR_Const(b, (int16_t)N(b, x)->in_Value);
+    if (N(b, x)->in_Op == IR_SEXT16)
+        return x;
+
+    return IR_Node(b, IR_SEXT16, x, IR_NONE, 0);
+}
+
+static uint16_t IR_Lsl(struct IRBlock *b, uint16_t x, uint8_t shift)
+{
+    if (x == IR_NONE)
+        return IR_NONE;
+
+    if (shift == 0)
+        return x;
+    if (N(b, x)->in_Op == IR_CONST)
+        return IR_Const(b, N(b, x)->in_Value << shift);
+
+    return IR_Node(b, IR_LSL, x, IR_NONE, shift);
+}
+
+/* Brief extension word format only, full format is left to the direct emitters */
+static uint16_t IR_Indexed(struct IRBlock *b, uint16_t base, uint16_t brief)
+{
+    if (brief & 0x100)
+        return IR_NONE;
+
+    uint16_t index = IR_Reg(b, (brief >> 12) & 15);
+
+    if ((brief & 0x800) == 0)
+        index = IR_Sext16(b, index);
+
+    index = IR_Lsl(b, index, (brief >> 9) & 3);
+
+    return IR_Add(b, IR_Add(b, base, index), IR_Const(b, (int8_t)brief));
+}
+
+/* Address computed by the control addressing mode, as used by LEA */
+static uint16_t IR_Address(struct IRBlock *b, uint16_t *ptr, uint8_t ea, uint8_t *ext_words)
+{
+    uint8_t mode = (ea >> 3) & 7;
+    uint8_t reg = ea & 7;
+    uint16_t *ext = ptr + 1 + *ext_words;
+
+    switch (mode)
+    {
+        case 2:
+            return IR_Reg(b, 8 + reg);
+
+        case 5:
+            *ext_words += 1;
+            return IR_Add(b, IR_Reg(b, 8 + reg), IR_Const(b, (int16_t)M68K_ReadCode16((uint32_t)(uintptr_t)ext)));
+
+        case 6:
+            *ext_words += 1;
+            return IR_Indexed(b, IR_Reg(b, 8 + reg), M68K_ReadCode16((uint32_t)(uintptr_t)ext));
+
+        case 7:
+            switch (reg)
+            {
+                case 0:
+                    *ext_words += 1;
+                    return IR_Const(b, (int16_t)M68K_ReadCode16((uint32_t)(uintptr_t)ext));
+                case 1:
+                    *ext_words += 2;
+                    return IR_Const(b, M68K_ReadCode32((uint32_t)(uintptr_t)ext));
+                case 2:
+                    /* The code is translated at its run time address, PC relative addresses are constants */
+                    *ext_words += 1;
+                    return IR_Const(b, (uint32_t)(uintptr_t)ext + (int16_t)M68K_ReadCode16((uint32_t)(uintptr_t)ext));
+                case 3:
+                    *ext_words += 1;
+                    return IR_Indexed(b, IR_Const(b, (uint32_t)(uintptr_t)ext), M68K_ReadCode16((uint32_t)(uintptr_t)ext));
+            }
+            break;
+    }
+
+    return IR_NONE;
+}
+
+/* Register or immediate source operand of given size (2 or 4), sign extended to 32 bits */
+static uint16_t IR_Source(struct IRBlock *b, uint16_t *ptr, uint8_t ea, uint8_t size, uint8_t *ext_words)
+{
+    uint8_t mode = (ea >> 3) & 7;
+    uint8_t reg = ea & 7;
+    uint16_t *ext = ptr + 1 + *ext_words;
+    uint16_t val;
+
+    if (mode == 0 || mode == 1)
+        val = IR_Reg(b, (mode << 3) + reg);
+    else if (ea == 0x3c && size == 4)
+    {
+        *ext_words += 2;
+        return IR_Const(b, M68K_ReadCode32((uint32_t)(uintptr_t)ext));
+    }
+    else if (ea == 0x3c && size == 2)
+    {
+        *ext_words += 1;
+        val = IR_Const(b, M68K_ReadCode16((uint32_t)(uintptr_t)ext));
+    }
+    else
+        return IR_NONE;
+
+    return size == 2 ? IR_Sext16(b, val) : val;
+}
+
+/* Register or immediate operand of CMP, CMPI and TST. Only the lowest size bytes of the value are valid */
+static uint16_t IR_SourceRaw(struct IRBlock *b, uint16_t *ptr, uint8_t ea, uint8_t size, uint8_t *ext_words)
+{
+    uint8_t mode = (ea >> 3) & 7;
+    uint8_t reg = ea & 7;
+    uint16_t *ext = ptr + 1 + *ext_words;
+
+    if (mode == 0 || (mode == 1 && size != 1))
+        return IR_Reg(b, (mode << 3) + reg);
+
+    if (ea != 0x3c)
+        return IR_NONE;
+
+    if (size == 4)
+    {
+        *ext_words += 2;
+        return IR_Const(b, M68K_ReadCode32((uint32_t)(uintptr_t)ext));
+    }
+
+    *ext_words += 1;
+    return IR_Const(b, M68K_ReadCode16((uint32_t)(uintptr_t)ext));
+}
+
+/*
+    Add one instruction to the block. Returns its length in words, 0 if the instruction cannot
+    be expressed in the IR. Register state of the block changes only if the instruction was
+    accepted.
+*/
+static uint8_t IR_Decode(struct IRBlock *b, uint16_t *ptr)
+{
+    uint16_t opcode = M68K_ReadCode16((uint32_t)(uintptr_t)ptr);
+    uint8_t ext_words = 0;
+    uint16_t val = IR_NONE;
+    uint8_t dst = 0xff;
+    uint8_t flag_op = IRF_NONE;
+    uint8_t flag_size = 4;
+    uint16_t flag_args[2] = { IR_NONE, IR_NONE };
+
+    if ((opcode & 0xf1c0) == 0x41c0)                                /* LEA <ea>, An */
+    {
+        dst = 8 + ((opcode >> 9) & 7);
+        val = IR_Address(b, ptr, opcode & 0x3f, &ext_words);
+    }
+    else if ((opcode & 0xe1c0) == 0x2040)                           /* MOVEA.W/L <ea>, An */
+    {
+        dst = 8 + ((opcode >> 9) & 7);
+        val = IR_Source(b, ptr, opcode & 0x3f, (opcode & 0x1000) ? 2 : 4, &ext_words);
+    }
+    else if ((opcode & 0xf1c0) == 0x2000)                           /* MOVE.L <ea>, Dn */
+    {
+        dst = (opcode >> 9) & 7;
+        val = IR_Source(b, ptr, opcode & 0x3f, 4, &ext_words);
+        flag_op = IRF_LOGIC;
+        flag_args[0] = val;
+    }
+    else if ((opcode & 0xf100) == 0x7000)                           /* MOVEQ #imm, Dn */
+    {
+        dst = (opcode >> 9) & 7;
+        val = IR_Const(b, (int8_t)opcode);
+        flag_op = IRF_LOGIC;
+        flag_args[0] = val;
+    }
+    else if ((opcode & 0xb1c0) == 0x9080)                           /* ADD.L/SUB.L <ea>, Dn */
+    {
+        dst = (opcode >> 9) & 7;
+        flag_op = (opcode & 0x4000) ? IRF_ADD : IRF_SUB;
+        flag_args[0] = IR_Reg(b, dst);
+        flag_args[1] = IR_Source(b, ptr, opcode & 0x3f, 4, &ext_words);
+        if (opcode & 0x4000)
+            val = IR_Add(b, flag_args[0], flag_args[1]);
+        else
+            val = IR_Sub(b, flag_args[0], flag_args[1]);
+    }
+    else if ((opcode & 0xf0f8) == 0x5080)                           /* ADDQ.L/SUBQ.L #imm, Dn */
+    {
+        uint8_t q = (opcode >> 9) & 7;
+
+        dst = opcode & 7;
+        flag_op = (opcode & 0x100) ? IRF_SUB : IRF_ADD;
+        flag_args[0] = IR_Reg(b, dst);
+        flag_args[1] = IR_Const(b, q ? q : 8);
+        if (opcode & 0x100)
+            val = IR_Sub(b, flag_args[0], flag_args[1]);
+        else
+            val = IR_Add(b, flag_args[0], flag_args[1]);
+    }
+    else if ((opcode & 0xf0c0) == 0xb0c0)                           /* CMPA.W/L <ea>, An */
+    {
+        flag_op = IRF_CMP;
+        flag_args[0] = IR_Reg(b, 8 + ((opcode >> 9) & 7));
+        flag_args[1] = IR_Source(b, ptr, opcode & 0x3f, (opcode & 0x100) ? 4 : 2, &ext_words);
+    }
+    else if ((opcode & 0xf100) == 0xb000)                           /* CMP <ea>, Dn */
+    {
+        flag_op = IRF_CMP;
+        flag_size = 1 << ((opcode >> 6) & 3);
+        flag_args[0] = IR_Reg(b, (opcode >> 9) & 7);
+        flag_args[1] = IR_SourceRaw(b, ptr, opcode & 0x3f, flag_size, &ext_words);
+    }
+    else if ((opcode & 0xff38) == 0x0c00 && (opcode & 0xc0) != 0xc0) /* CMPI #imm, Dn */
+    {
+        flag_op = IRF_CMP;
+        flag_size = 1 << ((opcode >> 6) & 3);
+        flag_args[0] = IR_Reg(b, opcode & 7);
+        flag_args[1] = IR_SourceRaw(b, ptr, 0x3c, flag_size, &ext_words);
+    }
+    else if ((opcode & 0xff38) == 0x4a00 && (opcode & 0xc0) != 0xc0) /* TST Dn */
+    {
+        flag_op = IRF_LOGIC;
+        flag_size = 1 << ((opcode >> 6) & 3);
+        flag_args[0] = IR_Reg(b, opcode & 7);
+    }
+    else if ((opcode & 0xf038) == 0x5008 && (opcode & 0xc0) != 0xc0 && (opcode & 0xc0) != 0) /* ADDQ/SUBQ #imm, An */
+    {
+        uint8_t q = (opcode >> 9) & 7;
+
+        dst = 8 + (opcode & 7);
+        if (opcode & 0x100)
+            val = IR_Sub(b, IR_Reg(b, dst), IR_Const(b, q ? q : 8));
+        else
+            val = IR_Add(b, IR_Reg(b, dst), IR_Const(b, q ? q : 8));
+    }
+    else if ((opcode & 0xb0c0) == 0x90c0)                           /* ADDA/SUBA.W/L <ea>, An */
+    {
+        dst = 8 + ((opcode >> 9) & 7);
+        val = IR_Source(b, ptr, opcode & 0x3f, (opcode & 0x100) ? 4 : 2, &ext_words);
+        if (opcode & 0x4000)
+            val = IR_Add(b, IR_Reg(b, dst), val);
+        else
+            val = IR_Sub(b, IR_Reg(b, dst), val);
+    }
+    else if ((opcode & 0xf130) == 0xc100 && ((opcode & 0xf8) == 0x40 || (opcode & 0xf8) == 0x48 || (opcode & 0xf8) == 0x88))
+    {                                                               /* EXG */
+        uint8_t rx = (opcode >> 9) & 7;
+        uint8_t ry = opcode & 7;
+
+        if ((opcode & 0xf8) == 0x48)
+            rx += 8;
+        if ((opcode & 0xf8) != 0x40)
+            ry += 8;
+
+        uint16_t vx = IR_Reg(b, rx);
+        uint16_t vy = IR_Reg(b, ry);
+        if (vx == IR_NONE || vy == IR_NONE)
+            return 0;
+
+        b->ib_Regs[rx] = vy;
+        b->ib_Regs[ry] = vx;
+
+        return 1;
+    }
+    else
+        return 0;
+
+    if (flag_op != IRF_NONE)
+    {
+        /* X is not touched by CMP and logic operations, if it is still needed the run ends here */
+        uint8_t kept = (flag_op == IRF_ADD || flag_op == IRF_SUB) ? 0 : SR_X;
+
+        if (flag_args[0] == IR_NONE || (flag_op != IRF_LOGIC && flag_args[1] == IR_NONE))
+            return 0;
+        if (b->ib_FlagOp != IRF_NONE && (b->ib_FlagMask & kept))
+            return 0;
+    }
+
+    if (dst != 0xff)
+    {
+        if (val == IR_NONE)
+            return 0;
+
+        /* Make sure the initial value of destination is known before it gets overwritten */
+        if (IR_Reg(b, dst) == IR_NONE)
+            return 0;
+
+        b->ib_Regs[dst] = val;
+    }
+
+    if (flag_op != IRF_NONE)
+    {
+        b->ib_FlagOp = flag_op;
+        b->ib_FlagSize = flag_size;
+        b->ib_FlagMask = M68K_GetSRMask(ptr);
+        b->ib_FlagArgs[0] = flag_args[0];
+        b->ib_FlagArgs[1] = flag_args[1];
+
+        if (flag_op != IRF_ADD && flag_op != IRF_SUB)
+            b->ib_FlagMask &= ~SR_X;
+    }
+
+    return 1 + ext_words;
+}
+
+static inline int IR_IsDirty(struct IRBlock *b, uint8_t reg)
+{
+    uint16_t v = b->ib_Regs[reg];
+    return v != IR_NONE && !(N(b, v)->in_Op == IR_REG && N(b, v)->in_Value == reg);
+}
+
+/*
+    Find order in which the changed registers can be written. Register r can be written once no
+    other pending register needs its initial value. Cyclic dependencies (e.g. EXG) are broken by
+    computing one of the values into a temporary register first. At most one such temporary is
+    allowed, otherwise the run is not worth it. Returns number of entries in order, negative if
+    the registers cannot be scheduled. Entries with bit 7 set denote computation into temporary.
+*/
+static int IR_Schedule(struct IRBlock *b, uint8_t *order)
+{
+    uint16_t pending = 0;
+    uint16_t held = 0;
+    int count = 0;
+
+    for (int r=0; r < 16; r++)
+        if (IR_IsDirty(b, r))
+            pending |= 1 << r;
+
+    while (pending)
+    {
+        int pick = -1;
+
+        for (int r=0; r < 16 && pick < 0; r++)
+        {
+            if (!(pending & (1 << r)))
+                continue;
+
+            int blocked = 0;
+            for (int q=0; q < 16; q++)
+            {
+                if (q != r && (pending & (1 << q)) && !(held & (1 << q)) && (N(b, b->ib_Regs[q])->in_Reads & (1 << r)))
+                {
+                    blocked = 1;
+                    break;
+                }
+            }
+
+            if (!blocked)
+                pick = r;
+        }
+
+        if (pick < 0)
+        {
+            if (held)
+                return -1;
+
+            for (int r=0; r < 16; r++)
+            {
+                if (pending & (1 << r))
+                {
+                    held |= 1 << r;
+                    order[count++] = 0x80 | r;
+                    break;
+                }
+            }
+            continue;
+        }
+
+        order[count++] = pick;
+        pending &= ~(1 << pick);
+    }
+
+    return count;
+}
+
+static void IR_EmitInto(struct TranslatorContext *ctx, struct IRBlock *b, uint16_t v, uint8_t dst, uint16_t *temps);
+
+/* ARM register holding value v. Temporaries are marked in temps and released by the caller */
+static uint8_t IR_Operand(struct TranslatorContext *ctx, struct IRBlock *b, uint16_t v, uint16_t *temps)
+{
+    if (N(b, v)->in_Op == IR_REG)
+        return RA_MapM68kRegister(ctx, N(b, v)->in_Value);
+
+    uint8_t tmp = RA_AllocARMRegister(ctx);
+    *temps |= 1 << tmp;
+    IR_EmitInto(ctx, b, v, tmp, temps);
+
+    return tmp;
+}
+
+static void IR_EmitInto(struct TranslatorContext *ctx, struct IRBlock *b, uint16_t v, uint8_t dst, uint16_t *temps)
+{
+    struct IRNode *n = N(b, v);
+
+    switch (n->in_Op)
+    {
+        case IR_CONST:
+            EMIT_LoadImmediate(ctx, dst, n->in_Value);
+            break;
+
+        case IR_REG:
+        {
+            uint8_t src = RA_MapM68kRegister(ctx, n->in_Value);
+            if (src != dst)
+                EMIT(ctx, mov_reg(dst, src));
+            break;
+        }
+
+        case IR_ADD:
+        {
+            struct IRNode *y = N(b, n->in_Args[1]);
+            uint8_t rx = IR_Operand(ctx, b, n->in_Args[0], temps);
+
+            if (y->in_Op == IR_CONST)
+            {
+                uint32_t c = y->in_Value;
+
+                if (c < 4096)
+                    EMIT(ctx, add_immed(dst, rx, c));
+                else if (-c < 4096)
+                    EMIT(ctx, sub_immed(dst, rx, -c));
+                else
+                {
+                    uint8_t rc = IR_Operand(ctx, b, n->in_Args[1], temps);
+                    EMIT(ctx, add_reg(dst, rx, rc, LSL, 0));
+                }
+            }
+            else if (y->in_Op == IR_LSL)
+                EMIT(ctx, add_reg(dst, rx, IR_Operand(ctx, b, y->in_Args[0], temps), LSL, y->in_Value));
+            else
+                EMIT(ctx, add_reg(dst, rx, IR_Operand(ctx, b, n->in_Args[1], temps), LSL, 0));
+            break;
+        }
+
+        case IR_SUB:
+        {
+            uint8_t rx = IR_Operand(ctx, b, n->in_Args[0], temps);
+            EMIT(ctx, sub_reg(dst, rx, IR_Operand(ctx, b, n->in_Args[1], temps), LSL, 0));
+            break;
+        }
+
+        case IR_SEXT16:
+            EMIT(ctx, sxth(dst, IR_Operand(ctx, b, n->in_Args[0], temps)));
+            break;
+
+        case IR_LSL:
+            EMIT(ctx, lsl(dst, IR_Operand(ctx, b, n->in_Args[0], temps), n->in_Value));
+            break;
+    }
+}
+
+static void IR_FreeTemps(struct TranslatorContext *ctx, uint16_t temps)
+{
+    for (int r=0; r < 16; r++)
+        if (temps & (1 << r))
+            RA_FreeARMRegister(ctx, r);
+}
+
+/*
+    Compute flags of the last flag producing instruction of the run and store the needed ones in
+    CCR. Operands are still in their initial registers at this point. Lowering of register values
+    does not touch the condition flags, so host_flags stay valid for the instruction after the run.
+*/
+static void IR_EmitFlags(struct TranslatorContext *ctx, struct IRBlock *b)
+{
+    uint8_t update_mask = b->ib_FlagMask;
+    uint8_t shift = 32 - 8 * b->ib_FlagSize;
+    uint8_t op = b->ib_FlagOp;
+    uint16_t temps = 0;
+
+    if (op == IRF_NONE || update_mask == 0)
+        return;
+
+    uint8_t ra = IR_Operand(ctx, b, b->ib_FlagArgs[0], &temps);
+
+    if (op == IRF_LOGIC)
+    {
+        EMIT(ctx, cmn_reg(31, ra, LSL, shift));
+    }
+    else
+    {
+        struct IRNode *y = N(b, b->ib_FlagArgs[1]);
+
+        if (shift == 0 && y->in_Op == IR_CONST && y->in_Value < 4096)
+        {
+            if (op == IRF_ADD)
+                EMIT(ctx, cmn_immed(ra, y->in_Value));
+            else
+                EMIT(ctx, cmp_immed(ra, y->in_Value));
+        }
+        else
+        {
+            uint8_t rb = IR_Operand(ctx, b, b->ib_FlagArgs[1], &temps);
+
+            if (shift != 0)
+            {
+                uint8_t tmp = RA_AllocARMRegister(ctx);
+                temps |= 1 << tmp;
+                EMIT(ctx, lsl(tmp, ra, shift));
+                ra = tmp;
+            }
+
+            if (op == IRF_ADD)
+                EMIT(ctx, cmn_reg(ra, rb, LSL, shift));
+            else
+                EMIT(ctx, cmp_reg(ra, rb, LSL, shift));
+        }
+    }
+
+    IR_FreeTemps(ctx, temps);
+
+    uint8_t cc = RA_ModifyCC(ctx);
+
+    switch (op)
+    {
+        case IRF_LOGIC:
+            EMIT_GetNZ00(ctx, cc, &update_mask);
+
+            if (update_mask & SR_Z)
+                EMIT_SetFlagsConditional(ctx, cc, SR_Z, ARM_CC_EQ);
+            if (update_mask & SR_N)
+                EMIT_SetFlagsConditional(ctx, cc, SR_N, ARM_CC_MI);
+            break;
+
+        case IRF_ADD:
+            if (update_mask & SR_X)
+                EMIT_GetNZCVX(ctx, cc, &update_mask);
+            else
+                EMIT_GetNZCV(ctx, cc, &update_mask);
+
+            if (update_mask & SR_Z)
+                EMIT_SetFlagsConditional(ctx, cc, SR_Z, ARM_CC_EQ);
+            if (update_mask & SR_N)
+                EMIT_SetFlagsConditional(ctx, cc, SR_N, ARM_CC_MI);
+            if (update_mask & SR_V)
+                EMIT_SetFlagsConditional(ctx, cc, SR_Valt, ARM_CC_VS);
+            if (update_mask & (SR_X | SR_C)) {
+                if ((update_mask & (SR_X | SR_C)) == SR_X)
+                    EMIT_SetFlagsConditional(ctx, cc, SR_X, ARM_CC_CS);
+                else if ((update_mask & (SR_X | SR_C)) == SR_C)
+                    EMIT_SetFlagsConditional(ctx, cc, SR_Calt, ARM_CC_CS);
+                else
+                    EMIT_SetFlagsConditional(ctx, cc, SR_Calt | SR_X, ARM_CC_CS);
+            }
+            break;
+
+        default:
+            if (update_mask & SR_X)
+                EMIT_GetNZnCVX(ctx, cc, &update_mask);
+            else
+                EMIT_GetNZnCV(ctx, cc, &update_mask);
+
+            if (update_mask & SR_Z)
+                EMIT_SetFlagsConditional(ctx, cc, SR_Z, ARM_CC_EQ);
+            if (update_mask & SR_N)
+                EMIT_SetFlagsConditional(ctx, cc, SR_N, ARM_CC_MI);
+            if (update_mask & SR_V)
+                EMIT_SetFlagsConditional(ctx, cc, SR_Valt, ARM_CC_VS);
+            if (update_mask & (SR_X | SR_C)) {
+                if ((update_mask & (SR_X | SR_C)) == SR_X)
+                    EMIT_SetFlagsConditional(ctx, cc, SR_X, ARM_CC_CC);
+                else if ((update_mask & (SR_X | SR_C)) == SR_C)
+                    EMIT_SetFlagsConditional(ctx, cc, SR_Calt, ARM_CC_CC);
+                else
+                    EMIT_SetFlagsConditional(ctx, cc, SR_Calt | SR_X, ARM_CC_CC);
+            }
+            break;
+    }
+}
+
+static void IR_Lower(struct TranslatorContext *ctx, struct IRBlock *b, const uint8_t *order, int count)
+{
+    uint8_t held_reg = 0xff;
+
+    for (int i=0; i < count; i++)
+    {
+        uint8_t r = order[i] & 15;
+        uint16_t temps = 0;
+
+        if (order[i] & 0x80)
+        {
+            held_reg = RA_AllocARMRegister(ctx);
+            IR_EmitInto(ctx, b, b->ib_Regs[r], held_reg, &temps);
+            b->ib_Regs[r] = IR_NONE;
+        }
+        else if (b->ib_Regs[r] == IR_NONE)
+        {
+            EMIT(ctx, mov_reg(RA_MapM68kRegisterForWrite(ctx, r), held_reg));
+            RA_FreeARMRegister(ctx, held_reg);
+        }
+        else
+            IR_EmitInto(ctx, b, b->ib_Regs[r], RA_MapM68kRegisterForWrite(ctx, r), &temps);
+
+        IR_FreeTemps(ctx, temps);
+    }
+}
+
+#if EMU68_KNOWN_VALUES
+/* Value of node v if all registers it reads are known at the start of the run */
+static int IR_Evaluate(struct TranslatorContext *ctx, struct IRBlock *b, uint16_t v, uint32_t *value)
+{
+    struct IRNode *n = N(b, v);
+    uint32_t x, y;
+
+    switch (n->in_Op)
+    {
+        case IR_CONST:
+            *value = n->in_Value;
+            return 1;
+        case IR_REG:
+            return M68K_GetKnownValue(ctx, n->in_Value, value);
+        case IR_ADD:
+        case IR_SUB:
+            if (!IR_Evaluate(ctx, b, n->in_Args[0], &x) || !IR_Evaluate(ctx, b, n->in_Args[1], &y))
+                return 0;
+            *value = n->in_Op == IR_ADD ? x + y : x - y;
+            return 1;
+        case IR_SEXT16:
+            if (!IR_Evaluate(ctx, b, n->in_Args[0], &x))
+                return 0;
+            *value = (int16_t)x;
+            return 1;
+        case IR_LSL:
+            if (!IR_Evaluate(ctx, b, n->in_Args[0], &x))
+                return 0;
+            *value = x << n->in_Value;
+            return 1;
+    }
+
+    return 0;
+}
+#endif
+
+/*
+    Translate a run of consecutive m68k instructions through the IR. The run ends at the first
+    instruction the IR cannot express, after max_insns instructions or in front of stop_at, the
+    entry point of the unit, so that the translator still notices the loop. Runs of a single
+    instruction are left to the direct emitters. Returns number of m68k instructions consumed.
+*/
+uint32_t M68K_TranslateIR(struct TranslatorContext *ctx, uint32_t max_insns, uint16_t *stop_at)
+{
+    struct IRBlock *b = &ir;
+    uint16_t *ptr = ctx->tc_M68kCodePtr;
+    uint8_t order[IR_MAX_INSNS * 2 + 16];
+    int count;
+
+    if (max_insns > IR_MAX_INSNS)
+        max_insns = IR_MAX_INSNS;
+
+    IR_Reset(b);
+
+    while (b->ib_InsnCount < max_insns && b->ib_NodeCount < IR_MAX_NODES - 16)
+    {
+        if (b->ib_InsnCount && ptr == stop_at)
+            break;
+
+        uint8_t words = IR_Decode(b, ptr);
+        if (words == 0)
+            break;
+
+        b->ib_InsnSize[b->ib_InsnCount++] = words;
+        ptr += words;
+    }
+
+    if (b->ib_InsnCount < 2)
+        return 0;
+
+#if EMU68_KNOWN_VALUES
+    /* Registers ending up with the value they are known to hold already are left alone */
+    uint16_t known_mask = 0;
+    uint32_t known_value[16];
+
+    for (int r=0; r < 16; r++)
+    {
+        uint32_t old;
+
+        if (!IR_IsDirty(b, r))
+            continue;
+
+        if (IR_Evaluate(ctx, b, b->ib_Regs[r], &known_value[r]))
+        {
+            if (M68K_GetKnownValue(ctx, r, &old) && old == known_value[r])
+                b->ib_Regs[r] = IR_NONE;
+            else
+                known_mask |= 1 << r;
+        }
+    }
+#endif
+
+    count = IR_Schedule(b, order);
+    if (count < 0)
+        return 0;
+
+#if EMU68_KNOWN_VALUES
+    for (int r=0; r < 16; r++)
+    {
+        if (IR_IsDirty(b, r))
+            M68K_ForgetKnownValues(ctx, 1 << r);
+        if (known_mask & (1 << r))
+            M68K_SetKnownValue(ctx, r, known_value[r]);
+    }
+#endif
+
+    host_flags = 0;
+    IR_EmitFlags(ctx, b);
+    IR_Lower(ctx, b, order, count);
+
+    for (int i=0; i < b->ib_InsnCount; i++)
+        EMIT_AdvancePC(ctx, 2 * b->ib_InsnSize[i]);
+
+    ctx->tc_M68kCodePtr = ptr;
+
+    return b->ib_InsnCount;
+}
@@ -0,0 +1,360 @@
+/*
+    Copyright © 2025 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "support.h"
+#include "M68k.h"
+
+/*
+    Known register values of a translation unit. After every translated instruction the registers
+    it may write are forgotten, the instructions loading constants (MOVEQ, MOVE #imm, LEA with
+    constant address, ADDQ/SUBQ of known register, ...) record the new value afterwards. Anything
+    not understood here drops the whole knowledge. The decoding is deliberately conservative, a
+    register reported as written by mistake costs some code, a missed write produces wrong code.
+*/
+
+#define KV_ALL  0xffff
+
+/* Address register modified by (An)+ and -(An) modes */
+static inline uint16_t SideEffect(uint8_t ea)
+{
+    uint8_t mode = (ea >> 3) & 7;
+
+    if (mode == 3 || mode == 4)
+        return 0x100 << (ea & 7);
+
+    return 0;
+}
+
+/* Register addressed directly by Dn and An modes */
+static inline uint16_t Direct(uint8_t ea)
+{
+    uint8_t mode = (ea >> 3) & 7;
+
+    if (mode == 0)
+        return 1 << (ea & 7);
+    else if (mode == 1)
+        return 0x100 << (ea & 7);
+
+    return 0;
+}
+
+/* Mask of registers which may be changed by the instruction, KV_ALL if not known */
+static uint16_t WrittenRegs(uint16_t *ptr)
+{
+    uint16_t opcode = M68K_ReadCode16((uint32_t)(uintptr_t)ptr);
+    uint8_t ea = opcode & 0x3f;
+    uint8_t reg9 = (opcode >> 9) & 7;
+    uint8_t size = (opcode >> 6) & 3;
+
+    switch (opcode >> 12)
+    {
+        case 0x0:
+            /* Bit operations and MOVEP */
+            if ((opcode & 0x0100) || (opcode & 0x0f00) == 0x0800)
+                return ((opcode & 0x0100) ? 1 << reg9 : 0) | Direct(ea) | SideEffect(ea);
+            /* CAS, CAS2, CMP2, CHK2, MOVES and immediate operations on CCR/SR */
+            if (size == 3 || (opcode & 0x0f00) == 0x0e00 || ea == 0x3c)
+                return KV_ALL;
+            return Direct(ea) | SideEffect(ea);
+
+        case 0x1:
+        case 0x2:
+        case 0x3:
+        {
+            uint8_t dst = ((opcode >> 3) & 0x38) | reg9;
+            return SideEffect(ea) | Direct(dst) | SideEffect(dst);
+        }
+
+        case 0x4:
+            if (opcode == 0x4e71)                           /* NOP */
+                return 0;
+            if ((opcode & 0xf1c0) == 0x41c0)                /* LEA, EXTB.L */
+                return (ea & 0x38) ? 0x100 << reg9 : 1 << (ea & 7);
+            if ((opcode & 0xf140) == 0x4100)                /* CHK */
+                return SideEffect(ea);
+            if ((opcode & 0xf900) == 0x4000)                /* NEGX, CLR, MOVE from SR/CCR */
+                return Direct(ea) | SideEffect(ea);
+            if ((opcode & 0xff00) == 0x4400 || (opcode & 0xff00) == 0x4600)
+            {
+                if (size != 3)                              /* NEG, NOT */
+                    return Direct(ea) | SideEffect(ea);
+                if ((opcode & 0xffc0) == 0x44c0)            /* MOVE to CCR */
+                    return SideEffect(ea);
+                return KV_ALL;                              /* MOVE to SR may switch stacks */
+            }
+            if ((opcode & 0xfff8) == 0x4808)                /* LINK.L */
+                return (0x100 << (ea & 7)) | 0x8000;
+            if ((opcode & 0xffc0) == 0x4800)                /* NBCD */
+                return Direct(ea) | SideEffect(ea);
+            if ((opcode & 0xffc0) == 0x4840)
+            {
+                if ((ea & 0x38) == 0)                       /* SWAP */
+                    return 1 << (ea & 7);
+                if ((ea & 0x38) == 0x08)                    /* BKPT */
+                    return KV_ALL;
+                return 0x8000;                              /* PEA */
+            }
+            if ((opcode & 0xff80) == 0x4880)                /* EXT, MOVEM to memory */
+                return (ea & 0x38) ? SideEffect(ea) : 1 << (ea & 7);
+            if ((opcode & 0xff00) == 0x4a00)
+            {
+                if (opcode == 0x4afc)                       /* ILLEGAL */
+                    return KV_ALL;
+                if (size == 3)                              /* TAS */
+                    return Direct(ea) | SideEffect(ea);
+                return SideEffect(ea);                      /* TST */
+            }
+            if ((opcode & 0xff80) == 0x4c00)                /* MULx.L, DIVx.L */
+            {
+                uint16_t ext = M68K_ReadCode16((uint32_t)(uintptr_t)&ptr[1]);
+                return (1 << ((ext >> 12) & 7)) | (1 << (ext & 7)) | SideEffect(ea);
+            }
+            if ((opcode & 0xff80) == 0x4c80)                /* MOVEM to registers */
+                return M68K_ReadCode16((uint32_t)(uintptr_t)&ptr[1]) | SideEffect(ea);
+            if ((opcode & 0xfff0) == 0x4e50)                /* LINK, UNLK */
+                return (0x100 << (ea & 7)) | 0x8000;
+            if (opcode == 0x4e75 || (opcode & 0xffc0) == 0x4e80)    /* RTS, JSR */
+                return 0x8000;
+            if ((opcode & 0xffc0) == 0x4ec0)                /* JMP */
+                return 0;
+            return KV_ALL;
+
+        case 0x5:
+            if (size != 3)                                  /* ADDQ, SUBQ */
+                return Direct(ea) | SideEffect(ea);
+            if ((ea & 0x38) == 0x08)                        /* DBcc */
+                return 1 << (ea & 7);
+            if (ea >= 0x3a)                                 /* TRAPcc */
+                return KV_ALL;
+            return Direct(ea) | SideEffect(ea);             /* Scc */
+
+        case 0x6:
+            return (opcode & 0x0f00) == 0x0100 ? 0x8000 : 0;   /* BSR pushes return address */
+
+        case 0x7:
+            return (opcode & 0x0100) ? KV_ALL : 1 << reg9;
+
+        case 0x8:
+        case 0x9:
+        case 0xb:
+        case 0xc:
+        case 0xd:
+        {
+            /* Register named in bits 9-11 in either bank, register forms of ADDX/SUBX/ABCD/SBCD/CMPM/EXG/EOR/PACK/UNPK */
+            uint16_t written = (1 << reg9) | SideEffect(ea);
+
+            if (size == 3)
+                written |= 0x100 << reg9;
+            if ((opcode & 0x0100) && (ea & 0x30) == 0)
+                written |= (0x101 << reg9) | (0x101 << (ea & 7));
+
+            return written;
+        }
+
+        case 0xe:
+            if (size != 3)                                  /* Shifts and rotates of Dn */
+                return 1 << (opcode & 7);
+            if (opcode & 0x0800)                            /* Bit field operations */
+                return 0x00ff | Direct(ea) | SideEffect(ea);
+            return SideEffect(ea);                          /* Shifts of memory */
+    }
+
+    return KV_ALL;
+}
+
+/*
+    Address of the control addressing mode ea, if it is known at translation time. The extension
+    words are read from m68k_ptr[*ext_words], *ext_words is advanced only if the address is known.
+    The code is translated at its run time address, PC relative addresses are constants.
+*/
+int M68K_KnownAddress(struct TranslatorContext *ctx, uint8_t ea, uint16_t *m68k_ptr, uint8_t *ext_words, uint32_t *address)
+{
+    uint8_t mode = (ea >> 3) & 7;
+    uint8_t reg = ea & 7;
+    uint16_t *ext = &m68k_ptr[*ext_words];
+    uint32_t base;
+
+    if (ctx->tc_KnownMask == 0 && mode != 7)
+        return 0;
+
+    switch (mode)
+    {
+        case 2:
+            if (!M68K_GetStableValue(ctx, 8 + reg, address))
+                return 0;
+            return 1;
+
+        case 5:
+            if (!M68K_GetStableValue(ctx, 8 + reg, &base))
+                return 0;
+            *address = base + (int16_t)M68K_ReadCode16((uint32_t)(uintptr_t)ext);
+            *ext_words += 1;
+            return 1;
+
+        case 6:
+        case 7:
+        {
+            uint16_t brief;
+            uint32_t index;
+
+            if (mode == 6 && !M68K_GetStableValue(ctx, 8 + reg, &base))
+                return 0;
+
+            if (mode == 7)
+            {
+                switch (reg)
+                {
+                    case 0:
+                        *address = (int16_t)M68K_ReadCode16((uint32_t)(uintptr_t)ext);
+                        *ext_words += 1;
+                        return 1;
+                    case 1:
+                        *address = M68K_ReadCode32((uint32_t)(uintptr_t)ext);
+                        *ext_words += 2;
+                        return 1;
+                    case 2:
+                        *address = (uint32_t)(uintptr_t)ext + (int16_t)M68K_ReadCode16((uint32_t)(uintptr_t)ext);
+                        *ext_words += 1;
+                        return 1;
+                    case 3:
+                        base = (uint32_t)(uintptr_t)ext;
+                        break;
+                    default:
+                        return 0;
+                }
+            }
+
+            /* Brief extension word only */
+            brief = M68K_ReadCode16((uint32_t)(uintptr_t)ext);
+            if ((brief & 0x0100) || !M68K_GetStableValue(ctx, brief >> 12, &index))
+                return 0;
+
+            if (!(brief & 0x0800))
+                index = (int16_t)index;
+
+            *address = base + (int8_t)brief + (index << ((brief >> 9) & 3));
+            *ext_words += 1;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Returns m68k register receiving a known value from the instruction and the value, -1 if none */
+static int ComputeValue(struct TranslatorContext *ctx, uint16_t *ptr, uint32_t *value)
+{
+    uint16_t opcode = M68K_ReadCode16((uint32_t)(uintptr_t)ptr);
+    uint8_t reg9 = (opcode >> 9) & 7;
+    uint8_t ext_words = 0;
+    uint32_t v;
+
+    /* MOVEQ */
+    if ((opcode & 0xf100) == 0x7000)
+    {
+        *value = (int8_t)opcode;
+        return reg9;
+    }
+
+    /* MOVE.L #imm, Dn and MOVEA.L #imm, An */
+    if ((opcode & 0xf1bf) == 0x203c)
+    {
+        *value = M68K_ReadCode32((uint32_t)(uintptr_t)&ptr[1]);
+        return reg9 + ((opcode >> 3) & 8);
+    }
+
+    /* MOVEA.W #imm, An */
+    if ((opcode & 0xf1ff) == 0x307c)
+    {
+        *value = (int16_t)M68K_ReadCode16((uint32_t)(uintptr_t)&ptr[1]);
+        return 8 + reg9;
+    }
+
+    /* MOVE.L Rn, Dn and MOVEA.L Rn, An */
+    if ((opcode & 0xf1b0) == 0x2000)
+    {
+        if (!M68K_GetKnownValue(ctx, opcode & 15, value))
+            return -1;
+        return reg9 + ((opcode >> 3) & 8);
+    }
+
+    /* LEA */
+    if ((opcode & 0xf1c0) == 0x41c0 && (opcode & 0x38))
+    {
+        if (!M68K_KnownAddress(ctx, opcode & 0x3f, &ptr[1], &ext_words, value))
+            return -1;
+        return 8 + reg9;
+    }
+
+    /* CLR.L Dn */
+    if ((opcode & 0xfff8) == 0x4280)
+    {
+        *value = 0;
+        return opcode & 7;
+    }
+
+    /* ADDQ/SUBQ to An, ADDQ.L/SUBQ.L to Dn */
+    if ((opcode & 0xf038) == 0x5008 || (opcode & 0xf0f8) == 0x5080)
+    {
+        uint8_t reg = (opcode & 7) + (opcode & 8);
+        uint32_t q = reg9 ? reg9 : 8;
+
+        if ((opcode & 0xc0) == 0xc0 || !M68K_GetKnownValue(ctx, reg, &v))
+            return -1;
+
+        *value = (opcode & 0x0100) ? v - q : v + q;
+        return reg;
+    }
+
+    return -1;
+}
+
+/* Hide registers changed by the instruction at insn from the code translating it */
+void M68K_PrepareKnownValues(struct TranslatorContext *ctx, uint16_t *insn)
+{
+    ctx->tc_KnownWrites = ctx->tc_KnownMask ? WrittenRegs(insn) : 0;
+}
+
+/*
+    Update known register values after count m68k instructions starting at insn were translated.
+    Instructions merged by the decoders are walked one after another, if they were not consecutive
+    (e.g. a followed branch) all knowledge is dropped.
+*/
+void M68K_UpdateKnownValues(struct TranslatorContext *ctx, uint16_t *insn, uint32_t count)
+{
+    uint16_t *ptr = insn;
+
+    ctx->tc_KnownWrites = 0;
+
+    for (uint32_t i=0; i < count; i++)
+    {
+        uint32_t value = 0;
+        int reg = ComputeValue(ctx, ptr, &value);
+
+        M68K_ForgetKnownValues(ctx, WrittenRegs(ptr));
+
+        if (reg >= 0)
+            M68K_SetKnownValue(ctx, reg, value);
+
+        if (ctx->tc_KnownMask == 0 && count == 1)
+            return;
+
+        int length = M68K_GetINSNLength(ptr);
+        if (length <= 0)
+        {
+            M68K_ForgetKnownValues(ctx, KV_ALL);
+            return;
+        }
+
+        ptr += length;
+    }
+
+    if (count > 1 && ptr != ctx->tc_M68kCodePtr)
+        M68K_ForgetKnownValues(ctx, KV_ALL);
+}
@@ -39,16 +39,16 @@ uint32_t EMIT_CMPI(struct TranslatorContext *ctx, uint16_t opcode)
     switch (opcode & 0x00c0)
     {
         case 0x0000:    /* Byte operation */
-            u8 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) & 0xff;
+            u8 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) & 0xff;
             size = 1;
             break;
         case 0x0040:    /* Short operation */
-            u16 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
+            u16 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
             size = 2;
             break;
         case 0x0080:    /* Long operation */
-            u32 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) << 16;
-            u32 |= cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
+            u32 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) << 16;
+            u32 |= M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
             size = 4;
             break;
     }
@@ -193,22 +193,22 @@ uint32_t EMIT_SUBI(struct TranslatorContext *ctx, uint16_t opcode)
     switch (opcode & 0x00c0)
     {
         case 0x0000:    /* Byte operation */
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) & 0xff;
+            lo16 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) & 0xff;
             if (!(update_mask == 0)) {
                 EMIT(ctx, mov_immed_u16(immed, lo16 << 8, 1));
             }
             size = 1;
             break;
         case 0x0040:    /* Short operation */
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
+            lo16 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
             if (!(update_mask == 0)) {
                 EMIT(ctx, mov_immed_u16(immed, lo16, 1));
             }
             size = 2;
             break;
         case 0x0080:    /* Long operation */
-            u32 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) << 16;
-            u32 |= cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
+            u32 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) << 16;
+            u32 |= M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
             if ((u32 & 0xfffff000) == 0)
             {
                 immediate = 1;
@@ -502,22 +502,22 @@ uint32_t EMIT_ADDI(struct TranslatorContext *ctx, uint16_t opcode)
     switch (opcode & 0x00c0)
     {
         case 0x0000:    /* Byte operation */
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) & 0xff;
+            lo16 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) & 0xff;
             if (!(update_mask == 0)) {
                 EMIT(ctx, mov_immed_u16(immed, (lo16 & 0xff) << 8, 1));
             }
             size = 1;
             break;
         case 0x0040:    /* Short operation */
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
+            lo16 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
             if (!(update_mask == 0)) {
                 EMIT(ctx, mov_immed_u16(immed, lo16, 1));
             }
             size = 2;
             break;
         case 0x0080:    /* Long operation */
-            u32 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) << 16;
-            u32 |= cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
+            u32 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) << 16;
+            u32 |= M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
             if ((u32 & 0xfffff000) == 0)
             {
                 add_immediate = 1;
@@ -787,7 +787,7 @@ uint32_t EMIT_ORI_TO_CCR(struct TranslatorContext *ctx, uint16_t opcode)
 {
     (void)opcode;
     uint8_t immed = RA_AllocARMRegister(ctx);
-    uint16_t val8 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t val8 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
 
     /* 
         Before swapping flags - invalidate host flags: all flags modified by this instruction
@@ -822,7 +822,7 @@ uint32_t EMIT_ORI_TO_SR(struct TranslatorContext *ctx, uint16_t opcode)
     (void)opcode;
     uint8_t immed = RA_AllocARMRegister(ctx);
     uint8_t changed = RA_AllocARMRegister(ctx);
-    int16_t val = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    int16_t val = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t sp = RA_MapM68kRegister(ctx, 15);
     uint32_t *tmp;
     RA_SetDirtyM68kRegister(ctx, 15);
@@ -914,7 +914,7 @@ uint32_t EMIT_ORI(struct TranslatorContext *ctx, uint16_t opcode)
     switch (opcode & 0x00c0)
     {
         case 0x0000:    /* Byte operation */
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) & 0xff;
+            lo16 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) & 0xff;
             if (update_mask == 0 || update_mask == SR_Z) {
                 mask32 = number_to_mask(lo16);
                 if (mask32 == 0) {
@@ -927,7 +927,7 @@ uint32_t EMIT_ORI(struct TranslatorContext *ctx, uint16_t opcode)
             size = 1;
             break;
         case 0x0040:    /* Short operation */
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
+            lo16 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
             if (update_mask == 0 || update_mask == SR_Z) {
                 mask32 = number_to_mask(lo16 & 0xffff);
                 if (mask32 == 0) {
@@ -940,8 +940,8 @@ uint32_t EMIT_ORI(struct TranslatorContext *ctx, uint16_t opcode)
             size = 2;
             break;
         case 0x0080:    /* Long operation */
-            u32 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) << 16;
-            u32 |= cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
+            u32 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) << 16;
+            u32 |= M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
             mask32 = number_to_mask(u32);
             if (mask32 == 0)
             {
@@ -1227,7 +1227,7 @@ uint32_t EMIT_ANDI_TO_CCR(struct TranslatorContext *ctx, uint16_t opcode)
 {
     (void)opcode;
     uint8_t immed = RA_AllocARMRegister(ctx);
-    uint16_t val = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t val = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
    
     /* 
         Before swapping flags - invalidate host flags: all flags modified by this instruction
@@ -1259,7 +1259,7 @@ uint32_t EMIT_ANDI_TO_SR(struct TranslatorContext *ctx, uint16_t opcode)
 {
     (void)opcode;
     uint8_t immed = RA_AllocARMRegister(ctx);
-    int16_t val = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    int16_t val = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint32_t *tmp;
 
     uint8_t changed = RA_AllocARMRegister(ctx);
@@ -1353,7 +1353,7 @@ uint32_t EMIT_ANDI(struct TranslatorContext *ctx, uint16_t opcode)
     switch (opcode & 0x00c0)
     {
         case 0x0000:    /* Byte operation */
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) & 0xff;
+            lo16 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) & 0xff;
             if (update_mask == 0) {
                 if ((opcode & 0x0038) == 0) {
                     if (lo16 != 0xff) {
@@ -1377,7 +1377,7 @@ uint32_t EMIT_ANDI(struct TranslatorContext *ctx, uint16_t opcode)
             size = 1;
             break;
         case 0x0040:    /* Short operation */
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
+            lo16 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
             if (update_mask == 0) {
                 if ((opcode & 0x0038) == 0) {
                     if (lo16 != 0xffff) 
@@ -1401,8 +1401,8 @@ uint32_t EMIT_ANDI(struct TranslatorContext *ctx, uint16_t opcode)
             size = 2;
             break;
         case 0x0080:    /* Long operation */
-            u32 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) << 16;
-            u32 |= cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
+            u32 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) << 16;
+            u32 |= M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
             mask32 = number_to_mask(u32);
             if (mask32 == 0)
             {
@@ -1599,7 +1599,7 @@ uint32_t EMIT_EORI_TO_CCR(struct TranslatorContext *ctx, uint16_t opcode)
 {
     (void)opcode;
     uint8_t immed = RA_AllocARMRegister(ctx);
-    int16_t val = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    int16_t val = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
 
     /* 
         Before swapping flags - invalidate host flags: all flags modified by this instruction
@@ -1633,7 +1633,7 @@ uint32_t EMIT_EORI_TO_SR(struct TranslatorContext *ctx, uint16_t opcode)
 {
     (void)opcode;
     uint8_t immed = RA_AllocARMRegister(ctx);
-    int16_t val = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    int16_t val = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint32_t *tmp;
 
     uint8_t orig = RA_AllocARMRegister(ctx);
@@ -1723,7 +1723,7 @@ uint32_t EMIT_EORI(struct TranslatorContext *ctx, uint16_t opcode)
     switch (opcode & 0x00c0)
     {
         case 0x0000:    /* Byte operation */
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) & 0xff;
+            lo16 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) & 0xff;
             mask32 = number_to_mask(lo16);
             if (mask32 == 0)
             {
@@ -1732,7 +1732,7 @@ uint32_t EMIT_EORI(struct TranslatorContext *ctx, uint16_t opcode)
             size = 1;
             break;
         case 0x0040:    /* Short operation */
-            lo16 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
+            lo16 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
             mask32 = number_to_mask(lo16);
             if (mask32 == 0)
             {
@@ -1741,8 +1741,8 @@ uint32_t EMIT_EORI(struct TranslatorContext *ctx, uint16_t opcode)
             size = 2;
             break;
         case 0x0080:    /* Long operation */
-            u32 = cache_read_16(ICACHE, (uintptr_t)&ctx->   tc_M68kCodePtr[ext_count++]) << 16;
-            u32 |= cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
+            u32 = M68K_ReadCode16((uintptr_t)&ctx->   tc_M68kCodePtr[ext_count++]) << 16;
+            u32 |= M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]);
             mask32 = number_to_mask(u32);
             if (mask32 == 0)
             {
@@ -1936,7 +1936,7 @@ uint32_t EMIT_BTST(struct TranslatorContext *ctx, uint16_t opcode)
     if ((opcode & 0xffc0) == 0x0800)
     {
         immediate = 1;
-        imm_shift = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) & 31;
+        imm_shift = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) & 31;
     }
     else
     {
@@ -2022,7 +2022,7 @@ uint32_t EMIT_BCHG(struct TranslatorContext *ctx, uint16_t opcode)
     if ((opcode & 0xffc0) == 0x0840)
     {
         immediate = 1;
-        imm_shift = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) & 31;
+        imm_shift = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) & 31;
     }
     else
     {
@@ -2144,7 +2144,7 @@ uint32_t EMIT_BCLR(struct TranslatorContext *ctx, uint16_t opcode)
     if ((opcode & 0xffc0) == 0x0880)
     {
         immediate = 1;
-        imm_shift = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) & 31;
+        imm_shift = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) & 31;
     }
     else
     {
@@ -2258,7 +2258,7 @@ uint32_t EMIT_CMP2(struct TranslatorContext *ctx, uint16_t opcode)
     uint32_t opcode_address = (uint32_t)(uintptr_t)(ctx->tc_M68kCodePtr - 1);
     uint8_t update_mask = SR_Z | SR_C;
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t ea = -1;
     uint8_t lower = RA_AllocARMRegister(ctx);
     uint8_t higher = RA_AllocARMRegister(ctx);
@@ -2399,7 +2399,7 @@ uint32_t EMIT_BSET(struct TranslatorContext *ctx, uint16_t opcode)
     if ((opcode & 0xffc0) == 0x08c0)
     {
         immediate = 1;
-        imm_shift = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) & 31;
+        imm_shift = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[ext_count++]) & 31;
     }
     else
     {
@@ -2617,8 +2617,8 @@ uint32_t EMIT_CAS(struct TranslatorContext *ctx, uint16_t opcode)
     {
         uint8_t ext_words = 2;
         uint8_t size = (opcode >> 9) & 3;
-        uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[0]);
-        uint16_t opcode3 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[1]);
+        uint16_t opcode2 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[0]);
+        uint16_t opcode3 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[1]);
 
         uint8_t rn1 = RA_MapM68kRegister(ctx, (opcode2 >> 12) & 15);
         uint8_t rn2 = RA_MapM68kRegister(ctx, (opcode3 >> 12) & 15);
@@ -2709,7 +2709,7 @@ uint32_t EMIT_CAS(struct TranslatorContext *ctx, uint16_t opcode)
     else
     {
         uint8_t ext_words = 1;
-        uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+        uint16_t opcode2 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
         uint8_t ea = -1;
         uint8_t du = RA_MapM68kRegister(ctx, (opcode2 >> 6) & 7);
         uint8_t dc = RA_MapM68kRegister(ctx, opcode2 & 7);
@@ -2754,13 +2754,13 @@ uint32_t EMIT_CAS(struct TranslatorContext *ctx, uint16_t opcode)
             switch(size)
             {
                 case 2:
-                    if (cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[1]) & 1)
+                    if (M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[1]) & 1)
                         CAS_UNSAFE();
                     else
                         CAS_ATOMIC();
                     break;
                 case 3:
-                    if ((cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[1]) & 3) == 0)
+                    if ((M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[1]) & 3) == 0)
                         CAS_ATOMIC();
                     else
                         CAS_UNSAFE();
@@ -2772,13 +2772,13 @@ uint32_t EMIT_CAS(struct TranslatorContext *ctx, uint16_t opcode)
             switch(size)
             {
                 case 2:
-                    if (cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[2]) & 1)
+                    if (M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[2]) & 1)
                         CAS_UNSAFE();
                     else
                         CAS_ATOMIC();
                     break;
                 case 3:
-                    if ((cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[2]) & 3) == 0)
+                    if ((M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[2]) & 3) == 0)
                         CAS_ATOMIC();
                     else
                         CAS_UNSAFE();
@@ -2860,7 +2860,7 @@ uint32_t EMIT_CAS(struct TranslatorContext *ctx, uint16_t opcode)
 
 uint32_t EMIT_MOVEP(struct TranslatorContext *ctx, uint16_t opcode)
 {
-    int32_t offset = (int16_t)cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    int32_t offset = (int16_t)M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t an = RA_MapM68kRegister(ctx, 8 + (opcode & 7));
     uint8_t dn = RA_MapM68kRegister(ctx, (opcode >> 9) & 7);
     uint8_t tmp = RA_AllocARMRegister(ctx);
@@ -2977,7 +2977,7 @@ uint32_t EMIT_MOVES(struct TranslatorContext *ctx, uint16_t opcode)
 {
     uint8_t cc = RA_GetCC(ctx);
     uint8_t size = (opcode >> 6) & 3;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint32_t *tmp;
     uint32_t *tmp_priv;
     uint8_t ext_count = 1;
@@ -3316,7 +3316,7 @@ static struct OpcodeDef InsnTable[4096] = {
 
 uint32_t EMIT_line0(struct TranslatorContext *ctx)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint32_t insn_consumed = 1;
     ctx->tc_M68kCodePtr++;
 
@@ -3362,7 +3362,7 @@ uint32_t GetSR_Line0(uint16_t opcode)
 
 int M68K_GetLine0Length(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&(*insn_stream));
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)&(*insn_stream));
     
     int length = 0;
     int need_ea = 0;
@@ -12,6 +12,8 @@
 #include "RegisterAllocator.h"
 #include "cache.h"
 #include "tlsf.h"
+#include "JITStats.h"
+#include "JITProfiler.h"
 
 extern uint32_t insn_count;
 
@@ -1238,7 +1240,7 @@ static uint32_t EMIT_EXT(struct TranslatorContext *ctx, uint16_t opcode)
         then combine both to extb.l 
     */
 
-    if ((mode == 2) && (opcode ^ cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr)) == 0x40) {
+    if ((mode == 2) && (opcode ^ M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr)) == 0x40) {
         ctx->tc_M68kCodePtr++;
         mode = 7;
         insn_consumed++;
@@ -1290,7 +1292,7 @@ static uint32_t EMIT_LINK32(struct TranslatorContext *ctx, uint16_t opcode)
     uint8_t sp;
     uint8_t displ;
     uint8_t reg;
-    int32_t offset = (cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[0]) << 16) | cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[1]);
+    int32_t offset = (M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[0]) << 16) | M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[1]);
 
     displ = RA_AllocARMRegister(ctx);
 
@@ -1328,7 +1330,7 @@ static uint32_t EMIT_LINK16(struct TranslatorContext *ctx, uint16_t opcode)
     uint8_t sp;
     uint8_t displ;
     uint8_t reg;
-    int16_t offset = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    int16_t offset = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
 
     displ = RA_AllocARMRegister(ctx);
 
@@ -1543,7 +1545,7 @@ static uint32_t EMIT_STOP(struct TranslatorContext *ctx, uint16_t opcode)
     (void)opcode;
 
     uint32_t *tmpptr;
-    uint16_t new_sr = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr) & 0xf71f;
+    uint16_t new_sr = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr) & 0xf71f;
     uint8_t changed = RA_AllocARMRegister(ctx);
     uint8_t orig = RA_AllocARMRegister(ctx);
     uint8_t cc = RA_ModifyCC(ctx);
@@ -1766,7 +1768,7 @@ static uint32_t EMIT_RTD(struct TranslatorContext *ctx, uint16_t opcode)
     uint8_t tmp = RA_AllocARMRegister(ctx);
     uint8_t tmp2 = RA_AllocARMRegister(ctx);
     uint8_t sp = RA_MapM68kRegister(ctx, 15);
-    int16_t addend = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    int16_t addend = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
 
     /* Fetch return address from stack */
     EMIT(ctx, ldr_offset_postindex(sp, tmp2, 4));
@@ -1848,7 +1850,7 @@ static uint32_t EMIT_RTS(struct TranslatorContext *ctx, uint16_t opcode)
         );
     }
     else
-        EMIT(ctx, INSN_TO_LE(0xffffffff));
+        EMIT(ctx, INSN_TO_LE(MARKER_STOP_RETURN));
 
     return 1;
 }
@@ -1908,9 +1910,41 @@ static uint32_t EMIT_RTR(struct TranslatorContext *ctx, uint16_t opcode)
     return 1;
 }
 
+/* Call C function from JIT code, all general purpose registers are preserved */
+static void EMIT_CallHelper(struct TranslatorContext *ctx, void (*func)())
+{
+    union {
+        uint64_t u64;
+        uint16_t u16[4];
+    } u;
+
+    u.u64 = (uintptr_t)func;
+
+    EMIT(ctx, stp64_preindex(31, 0, 1, -256));
+    for (int i=2; i < 30; i += 2)
+        EMIT(ctx, stp64(31, i, i+1, i*8));
+    EMIT(ctx, str64_offset(31, 30, 240));
+
+    EMIT(ctx, 
+        mov64_immed_u16(1, u.u16[3], 0),
+        movk64_immed_u16(1, u.u16[2], 1),
+        movk64_immed_u16(1, u.u16[1], 2),
+        movk64_immed_u16(1, u.u16[0], 3),
+
+        blr(1)
+    );
+
+    for (int i=2; i < 30; i += 2)
+        EMIT(ctx, ldp64(31, i, i+1, i*8));
+    EMIT(ctx, 
+        ldr64_offset(31, 30, 240),
+        ldp64_postindex(31, 0, 1, 256)
+    );
+}
+
 static uint32_t EMIT_MOVEC(struct TranslatorContext *ctx, uint16_t opcode)
 {
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t dr = opcode & 1;
     uint8_t reg = RA_MapM68kRegister(ctx, opcode2 >> 12);
     uint8_t ctxreg = RA_GetCTX(ctx);
@@ -1974,33 +2008,7 @@ static uint32_t EMIT_MOVEC(struct TranslatorContext *ctx, uint16_t opcode)
 
                 void check_cacr();
 
-                union {
-                    uint64_t u64;
-                    uint16_t u16[4];
-                } u;
-
-                u.u64 = (uintptr_t)check_cacr;
-
-                EMIT(ctx, stp64_preindex(31, 0, 1, -256));
-                for (int i=2; i < 30; i += 2)
-                    EMIT(ctx, stp64(31, i, i+1, i*8));
-                EMIT(ctx, str64_offset(31, 30, 240));
-
-                EMIT(ctx, 
-                    mov64_immed_u16(1, u.u16[3], 0),
-                    movk64_immed_u16(1, u.u16[2], 1),
-                    movk64_immed_u16(1, u.u16[1], 2),
-                    movk64_immed_u16(1, u.u16[0], 3),
-
-                    blr(1)
-                );
-
-                for (int i=2; i < 30; i += 2)
-                    EMIT(ctx, ldp64(31, i, i+1, i*8));
-                EMIT(ctx, 
-                    ldr64_offset(31, 30, 240),
-                    ldp64_postindex(31, 0, 1, 256)
-                );
+                EMIT_CallHelper(ctx, check_cacr);
 
                 RA_FreeARMRegister(ctx, tmp);
                 break;
@@ -2108,6 +2116,18 @@ static uint32_t EMIT_MOVEC(struct TranslatorContext *ctx, uint16_t opcode)
                 RA_FreeARMRegister(ctx, tmp2);
                 RA_FreeARMRegister(ctx, tmp);
                 break;
+            case 0x1e1: /* JITSNAP - export translated ROM code to buffer at given address */
+                EMIT(ctx, str_offset(ctxreg, reg, __builtin_offsetof(struct M68KState, JIT_SNAPSHOT)));
+                EMIT_CallHelper(ctx, M68K_SaveROMCache);
+                break;
+            case 0x1e2: /* JITSTATSEL - select instrumentation counter and latch its value */
+                EMIT(ctx, str_offset(ctxreg, reg, __builtin_offsetof(struct M68KState, JIT_STAT_SELECT)));
+                EMIT_CallHelper(ctx, JITStat_Latch);
+                break;
+            case 0x1e5: /* JITPROF - export profiler histogram to buffer at given address */
+                EMIT(ctx, str_offset(ctxreg, reg, __builtin_offsetof(struct M68KState, JIT_PROFILE)));
+                EMIT_CallHelper(ctx, Profiler_Export);
+                break;
             case 0x003: // TCR - write bits 15, 14, read all zeros for now
                 tmp = RA_AllocARMRegister(ctx);
                 EMIT(ctx, 
@@ -2367,6 +2387,21 @@ static uint32_t EMIT_MOVEC(struct TranslatorContext *ctx, uint16_t opcode)
                 );
                 RA_FreeARMRegister(ctx, tmp);
                 break;
+            case 0x1e1: /* JITSNAP - size of last ROM code export */
+                EMIT(ctx, ldr_offset(ctxreg, reg, __builtin_offsetof(struct M68KState, JIT_SNAPSHOT_SIZE)));
+                break;
+            case 0x1e2: /* JITSTATSEL - number of selected instrumentation counter */
+                EMIT(ctx, ldr_offset(ctxreg, reg, __builtin_offsetof(struct M68KState, JIT_STAT_SELECT)));
+                break;
+            case 0x1e3: /* JITSTATLO - lower 32 bits of the counter latched by JITSTATSEL */
+                EMIT(ctx, ldr_offset(ctxreg, reg, __builtin_offsetof(struct M68KState, JIT_STAT_LO)));
+                break;
+            case 0x1e4: /* JITSTATHI - higher 32 bits of the counter latched by JITSTATSEL */
+                EMIT(ctx, ldr_offset(ctxreg, reg, __builtin_offsetof(struct M68KState, JIT_STAT_HI)));
+                break;
+            case 0x1e5: /* JITPROF - size of last profiler export */
+                EMIT(ctx, ldr_offset(ctxreg, reg, __builtin_offsetof(struct M68KState, JIT_PROFILE_SIZE)));
+                break;
             case 0x003: // TCR - write bits 15, 14, read all zeros for now
                 EMIT(ctx, ldrh_offset(ctxreg, reg, __builtin_offsetof(struct M68KState, TCR)));
                 break;
@@ -2443,6 +2478,22 @@ static uint32_t EMIT_MOVEUSP(struct TranslatorContext *ctx, uint16_t opcode)
     return 1;
 }
 
+/* Target of JMP/JSR with absolute or PC-relative address, ext points to the extension words */
+static uint16_t *GetStaticTarget(uint16_t *ext, uint16_t opcode)
+{
+    switch (opcode & 0x3f)
+    {
+        case 0x38:
+            return (uint16_t *)(uintptr_t)(int32_t)(int16_t)M68K_ReadCode16((uintptr_t)ext);
+        case 0x39:
+            return (uint16_t *)(uintptr_t)M68K_ReadCode32((uintptr_t)ext);
+        case 0x3a:
+            return (uint16_t *)((uintptr_t)ext + (int16_t)M68K_ReadCode16((uintptr_t)ext));
+        default:
+            return NULL;
+    }
+}
+
 static uint32_t EMIT_JSR(struct TranslatorContext *ctx, uint16_t opcode)
 {
     uint8_t ext_words = 0;
@@ -2457,9 +2508,21 @@ static uint32_t EMIT_JSR(struct TranslatorContext *ctx, uint16_t opcode)
     RA_SetDirtyM68kRegister(ctx, 15);
     EMIT_ResetOffsetPC(ctx);
     EMIT(ctx, mov_reg(REG_PC, ea));
+    uint16_t *target = GetStaticTarget(ctx->tc_M68kCodePtr, opcode);
     ctx->tc_M68kCodePtr += ext_words;
     RA_FreeARMRegister(ctx, ea);
-    EMIT(ctx, INSN_TO_LE(0xffffffff));
+
+    /* Subroutine call, the return address is put on shadow stack */
+    EMIT(ctx, INSN_TO_LE(MARKER_CALL));
+
+    /* Absolute and PC-relative targets are known at translation time, exit can be chained */
+    if (target != NULL)
+    {
+        M68K_AddSuccessor(target);
+        EMIT(ctx, INSN_TO_LE(MARKER_STOP_LINKABLE));
+    }
+    else
+        EMIT(ctx, INSN_TO_LE(MARKER_STOP_INDIRECT));
 
     return 1;
 }
@@ -2472,9 +2535,18 @@ static uint32_t EMIT_JMP(struct TranslatorContext *ctx, uint16_t opcode)
     /* JMP immediate cound be faster... */
     EMIT_LoadFromEffectiveAddress(ctx, 0, &ea, opcode & 0x3f, &ext_words, 0, NULL);
     EMIT_ResetOffsetPC(ctx);
+    uint16_t *target = GetStaticTarget(ctx->tc_M68kCodePtr, opcode);
     ctx->tc_M68kCodePtr += ext_words;
     RA_FreeARMRegister(ctx, ea);
-    EMIT(ctx, INSN_TO_LE(0xffffffff));
+
+    /* Absolute and PC-relative targets are known at translation time, exit can be chained */
+    if (target != NULL)
+    {
+        M68K_AddSuccessor(target);
+        EMIT(ctx, INSN_TO_LE(MARKER_STOP_LINKABLE));
+    }
+    else
+        EMIT(ctx, INSN_TO_LE(MARKER_STOP_INDIRECT));
 
     return 1;
 }
@@ -2659,7 +2731,7 @@ static uint32_t EMIT_MOVEM(struct TranslatorContext *ctx, uint16_t opcode)
 {
     uint8_t dir = (opcode >> 10) & 1;
     uint8_t size = (opcode >> 6) & 1;
-    uint16_t mask = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t mask = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t block_size = 0;
     uint8_t ext_words = 0;
     extern int debug;
@@ -3151,7 +3223,7 @@ static struct OpcodeDef InsnTable[4096] = {
 
 uint32_t EMIT_line4(struct TranslatorContext *ctx)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr++);
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr++);
 
     if (InsnTable[opcode & 0xfff].od_Emit) {
         return InsnTable[opcode & 0xfff].od_Emit(ctx, opcode);
@@ -3196,7 +3268,7 @@ uint32_t GetSR_Line4(uint16_t opcode)
 
 int M68K_GetLine4Length(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&(*insn_stream));
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)&(*insn_stream));
     
     int length = 0;
     int need_ea = 0;
@@ -3218,6 +3290,7 @@ int M68K_GetLine4Length(uint16_t *insn_stream)
 void check_cacr()
 {
     extern struct List LRU;
+    extern struct UnitTable ICache;
     extern struct M68KState *__m68k_state;
     static uint32_t old_cacr;
     uint32_t cacr;
@@ -3233,6 +3306,12 @@ void check_cacr()
     {
         struct Node *n;
         struct Node *keep = NULL;
+
+        /* Translation worker shares the unit table, LRU and JIT heap */
+        M68K_LockTranslator();
+
+        /* No unit may jump directly into another one while JIT cache is disabled */
+        M68K_UnlinkAll();
         
         while ((n = REMTAIL(&LRU)))
         {
@@ -3250,15 +3329,16 @@ void check_cacr()
             }
             else {
                 REMOVE(&u->mt_LRUNode);
-                REMOVE(&u->mt_HashNode);
+                UnitTable_Remove(&ICache, u->mt_M68kAddress);
+                M68K_UnindexUnit(u);
 
-                tlsf_free(jit_tlsf, u);
+                M68K_FreeUnit(u);
 
                 __m68k_state->JIT_UNIT_COUNT--;
             }
         }
 
-        __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+        __m68k_state->JIT_CACHE_FREE = M68K_CodeCacheFree();
             
         __asm__ volatile("mov "CTX_LAST_PC_ASM", %w0"::"r"(0xffffffff));
 
@@ -3268,6 +3348,8 @@ void check_cacr()
         {
             ADDTAIL(&LRU, keep);
         }
+
+        M68K_UnlockTranslator();
     }
 }
 
@@ -712,7 +712,7 @@ uint32_t EMIT_DBcc(struct TranslatorContext *ctx, uint16_t opcode)
     uint32_t *branch_2 = NULL;
     uint32_t branch_1_type = 0;
     uint32_t branch_2_type = 0;
-    int32_t branch_offset = 2 + (int16_t)cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr++);
+    int32_t branch_offset = 2 + (int16_t)M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr++);
     uint16_t *bra_rel_ptr = ctx->tc_M68kCodePtr - 2;
 
     /* Seldom case of DBT which does nothing */
@@ -823,7 +823,7 @@ uint32_t EMIT_DBcc(struct TranslatorContext *ctx, uint16_t opcode)
         EMIT(ctx, add_immed(REG_PC, REG_PC, true_pc_addend));
 
         /* Insert local exit */
-        EMIT_LocalExit(ctx, 1);
+        EMIT_ChainableExit(ctx, 1);
         uint32_t *exit_code_end = ctx->tc_CodePtr;
 
         /* Insert fixup location - if branch_1 is not NULL, insert double exit, otherwise single one */
@@ -906,7 +906,7 @@ static struct OpcodeDef InsnTable[512] = {
 
 uint32_t EMIT_line5(struct TranslatorContext *ctx)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr++);
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr++);
 
     if (InsnTable[opcode & 0777].od_Emit) {
         return InsnTable[opcode & 0777].od_Emit(ctx, opcode);
@@ -978,7 +978,7 @@ uint32_t GetSR_Line5(uint16_t opcode)
 
 int M68K_GetLine5Length(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&(*insn_stream));
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)&(*insn_stream));
     
     int length = 0;
     int need_ea = 0;
@@ -34,13 +34,13 @@ uint32_t EMIT_BRA(struct TranslatorContext *ctx, uint16_t opcode)
     if ((opcode & 0x00ff) == 0x00)
     {
         addend = 2;
-        bra_off = (int16_t)(cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr++));
+        bra_off = (int16_t)(M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr++));
     }
     /* use 32-bit offset */
     else if ((opcode & 0x00ff) == 0xff)
     {
         addend = 4;
-        bra_off = (int32_t)(cache_read_32(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr));
+        bra_off = (int32_t)(M68K_ReadCode32((uintptr_t)ctx->tc_M68kCodePtr));
         ctx->tc_M68kCodePtr += 2;
     }
     else
@@ -103,7 +103,15 @@ uint32_t EMIT_BRA(struct TranslatorContext *ctx, uint16_t opcode)
         ctx->tc_M68kCodePtr = (void *)((uintptr_t)bra_rel_ptr + bra_off);
     }
     else
-        EMIT(ctx, INSN_TO_LE(0xffffffff));
+    {
+        M68K_AddSuccessor((void *)((uintptr_t)bra_rel_ptr + bra_off));
+
+        /* Subroutine call, the return address is put on shadow stack */
+        if (bsr)
+            EMIT(ctx, INSN_TO_LE(MARKER_CALL));
+
+        EMIT(ctx, INSN_TO_LE(MARKER_STOP_LINKABLE));
+    }
 
     return 1;
 }
@@ -113,6 +121,7 @@ uint32_t EMIT_BSR(struct TranslatorContext *ctx, uint16_t opcode) __attribute__(
 uint32_t EMIT_Bcc(struct TranslatorContext *ctx, uint16_t opcode)
 {
     uint32_t *tmpptr;
+    uint16_t *insn_ptr = ctx->tc_M68kCodePtr - 1;
     uint8_t m68k_condition = (opcode >> 8) & 15;
     intptr_t branch_target = (intptr_t)ctx->tc_M68kCodePtr;
     intptr_t branch_offset = 0;
@@ -125,12 +134,12 @@ uint32_t EMIT_Bcc(struct TranslatorContext *ctx, uint16_t opcode)
     /* use 16-bit offset */
     if ((opcode & 0x00ff) == 0x00)
     {
-        branch_offset = (int16_t)cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr++);
+        branch_offset = (int16_t)M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr++);
     }
     /* use 32-bit offset */
     else if ((opcode & 0x00ff) == 0xff)
     {
-        branch_offset = (int32_t)cache_read_32(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+        branch_offset = (int32_t)M68K_ReadCode32((uintptr_t)ctx->tc_M68kCodePtr);
         ctx->tc_M68kCodePtr += 2;
     }
     else
@@ -139,6 +148,8 @@ uint32_t EMIT_Bcc(struct TranslatorContext *ctx, uint16_t opcode)
         branch_offset = (int8_t)(opcode & 0xff);
     }
 
+    uint16_t *next_insn = ctx->tc_M68kCodePtr;
+
     branch_offset += local_pc_off;
     branch_target += branch_offset - local_pc_off;
 
@@ -163,6 +174,9 @@ uint32_t EMIT_Bcc(struct TranslatorContext *ctx, uint16_t opcode)
 #endif
 #endif
 
+    /* Hot code follows the direction taken most often, if it is known already */
+    take_branch = M68K_PredictBranch(insn_ptr, take_branch);
+
     if (take_branch)
     {
         m68k_condition ^= 1;
@@ -177,6 +191,8 @@ uint32_t EMIT_Bcc(struct TranslatorContext *ctx, uint16_t opcode)
     EMIT_JumpOnCondition(ctx, m68k_condition, 0, &fixup_type);
     tmpptr = ctx->tc_CodePtr - 1;
 
+    EMIT_BranchProfile(ctx, insn_ptr, take_branch);
+
     /* Insert the branch non-taken case here */
     if (!take_branch)
     {
@@ -224,6 +240,8 @@ uint32_t EMIT_Bcc(struct TranslatorContext *ctx, uint16_t opcode)
     /* Now insert the branch taken case - this will be treated as exit code */
     uint32_t *exit_code_start = ctx->tc_CodePtr;
 
+    EMIT_BranchProfile(ctx, insn_ptr, !take_branch);
+
     /* Insert the first case here */
     if (take_branch)
     {
@@ -269,9 +287,11 @@ uint32_t EMIT_Bcc(struct TranslatorContext *ctx, uint16_t opcode)
     }
 
     /* Insert local exit */
-    EMIT_LocalExit(ctx, 1);
+    EMIT_ChainableExit(ctx, 1);
     uint32_t *exit_code_end = ctx->tc_CodePtr;
 
+    M68K_AddSuccessor(take_branch ? next_insn : (uint16_t *)branch_target);
+
     /* Insert fixup location */
     EMIT(ctx, 
         exit_code_end - tmpptr,
@@ -304,7 +324,7 @@ static struct OpcodeDef InsnTable[16] = {
 
 uint32_t EMIT_line6(struct TranslatorContext *ctx)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
 
     ctx->tc_M68kCodePtr++;
 
@@ -318,7 +338,7 @@ uint32_t GetSR_Line6(uint16_t opcode)
 
 int M68K_GetLine6Length(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)insn_stream);
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)insn_stream);
     int length = 1;
     
     if ((opcode & 0xff) == 0) {
@@ -23,7 +23,7 @@
 uint32_t EMIT_PACK_mem(struct TranslatorContext *ctx, uint16_t opcode) __attribute__((alias("EMIT_PACK_reg")));
 uint32_t EMIT_PACK_reg(struct TranslatorContext *ctx, uint16_t opcode)
 {
-    uint16_t addend = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t addend = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t tmp = -1;
 
     if (opcode & 8)
@@ -80,7 +80,7 @@ uint32_t EMIT_PACK_reg(struct TranslatorContext *ctx, uint16_t opcode)
 uint32_t EMIT_UNPK_mem(struct TranslatorContext *ctx, uint16_t opcode) __attribute__((alias("EMIT_UNPK_reg")));
 uint32_t EMIT_UNPK_reg(struct TranslatorContext *ctx, uint16_t opcode)
 {
-    uint16_t addend = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t addend = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t tmp = -1;
 
     if (opcode & 8)
@@ -590,7 +590,7 @@ static struct OpcodeDef InsnTable[512] = {
 
 uint32_t EMIT_line8(struct TranslatorContext *ctx)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr++);
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr++);
 
     if (InsnTable[opcode & 0x1ff].od_Emit) {
         return InsnTable[opcode & 0x1ff].od_Emit(ctx, opcode);
@@ -634,7 +634,7 @@ uint32_t GetSR_Line8(uint16_t opcode)
 
 int M68K_GetLine8Length(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)insn_stream);
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)insn_stream);
     
     int length = 0;
     int need_ea = 0;
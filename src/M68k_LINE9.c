@@ -340,7 +340,7 @@ uint32_t EMIT_SUBA_reg(struct TranslatorContext *ctx, uint16_t opcode)
     {
         if (immed)
         {
-            int16_t offset = (int16_t)cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+            int16_t offset = (int16_t)M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
 
             if (offset >= 0 && offset < 4096)
             {
@@ -363,7 +363,7 @@ uint32_t EMIT_SUBA_reg(struct TranslatorContext *ctx, uint16_t opcode)
         int32_t offset;
         if (immed)
         {
-            offset = ((int16_t)cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[0]) << 16) | (uint16_t)cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[1]);
+            offset = ((int16_t)M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[0]) << 16) | (uint16_t)M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[1]);
             
             if (offset >= 0 && offset < 4096)
             {
@@ -743,7 +743,7 @@ static struct OpcodeDef InsnTable[512] = {
 
 uint32_t EMIT_line9(struct TranslatorContext *ctx)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr++);
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr++);
 
     if (InsnTable[opcode & 0x1ff].od_Emit) {
         return InsnTable[opcode & 0x1ff].od_Emit(ctx, opcode);
@@ -787,7 +787,7 @@ uint32_t GetSR_Line9(uint16_t opcode)
 
 int M68K_GetLine9Length(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)insn_stream);
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)insn_stream);
     
     int length = 0;
     int need_ea = 0;
@@ -378,7 +378,7 @@ static struct OpcodeDef InsnTable[512] = {
 
 uint32_t EMIT_lineB(struct TranslatorContext *ctx)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr++);
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr++);
 
     /* 1011xxxx11xxxxxx - CMPA */
     if (InsnTable[opcode & 00777].od_Emit)
@@ -425,7 +425,7 @@ uint32_t GetSR_LineB(uint16_t opcode)
 
 int M68K_GetLineBLength(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)insn_stream);
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)insn_stream);
     
     int length = 0;
     int need_ea = 0;
@@ -310,7 +310,7 @@ static uint32_t EMIT_ADDA_ext(struct TranslatorContext *ctx, uint16_t opcode)
     {
         if (immed)
         {
-            int16_t offset = (int16_t)cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+            int16_t offset = (int16_t)M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
 
             if (offset >= 0 && offset < 4096)
             {
@@ -333,7 +333,7 @@ static uint32_t EMIT_ADDA_ext(struct TranslatorContext *ctx, uint16_t opcode)
         int32_t offset;
         if (immed)
         {
-            offset = ((int16_t)cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr) << 16) | (uint16_t)cache_read_16(ICACHE, (uintptr_t)(ctx->tc_M68kCodePtr + 1));
+            offset = ((int16_t)M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr) << 16) | (uint16_t)M68K_ReadCode16((uintptr_t)(ctx->tc_M68kCodePtr + 1));
             
             if (offset >= 0 && offset < 4096)
             {
@@ -695,7 +695,7 @@ static struct OpcodeDef InsnTable[4096] = {
 
 uint32_t EMIT_lineD(struct TranslatorContext *ctx)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr++);
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr++);
 
     if (InsnTable[opcode & 00777].od_Emit)
     {
@@ -740,7 +740,7 @@ uint32_t GetSR_LineD(uint16_t opcode)
 
 int M68K_GetLineDLength(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)insn_stream);
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)insn_stream);
     
     int length = 0;
     int need_ea = 0;
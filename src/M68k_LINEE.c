@@ -4083,7 +4083,7 @@ static uint32_t EMIT_BFTST_reg(struct TranslatorContext *ctx, uint16_t opcode)
 {
     uint8_t update_mask = M68K_GetSRMask(ctx->tc_M68kCodePtr - 1);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t src = RA_MapM68kRegister(ctx, opcode & 7);
 
     /* Direct offset and width */
@@ -4254,7 +4254,7 @@ static uint32_t EMIT_BFTST(struct TranslatorContext *ctx, uint16_t opcode)
 {
     uint8_t update_mask = M68K_GetSRMask(ctx->tc_M68kCodePtr - 1);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t base = 0xff;
 
     // Get EA address into a temporary register
@@ -4308,7 +4308,7 @@ static uint32_t EMIT_BFEXTU_reg(struct TranslatorContext *ctx, uint16_t opcode)
 {
     uint8_t update_mask = M68K_GetSRMask(ctx->tc_M68kCodePtr - 1);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
 
     /*
         IMPORTANT: Although it is not mentioned in 68000 PRM, the bitfield operations on
@@ -4507,7 +4507,7 @@ static uint32_t EMIT_BFEXTU(struct TranslatorContext *ctx, uint16_t opcode)
 {
     uint8_t update_mask = M68K_GetSRMask(ctx->tc_M68kCodePtr - 1);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t base = 0xff;
 
     // Get EA address into a temporary register
@@ -4565,7 +4565,7 @@ static uint32_t EMIT_BFEXTS_reg(struct TranslatorContext *ctx, uint16_t opcode)
 {
     uint8_t update_mask = M68K_GetSRMask(ctx->tc_M68kCodePtr - 1);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t src = RA_MapM68kRegister(ctx, opcode & 7);
 
     /* Direct offset and width */
@@ -4760,7 +4760,7 @@ static uint32_t EMIT_BFEXTS(struct TranslatorContext *ctx, uint16_t opcode)
 {
     uint8_t update_mask = M68K_GetSRMask(ctx->tc_M68kCodePtr - 1);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t base = 0xff;
 
     // Get EA address into a temporary register
@@ -4818,7 +4818,7 @@ static uint32_t EMIT_BFFFO_reg(struct TranslatorContext *ctx, uint16_t opcode)
 {
     uint8_t update_mask = M68K_GetSRMask(ctx->tc_M68kCodePtr - 1);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
 
     uint8_t src = RA_MapM68kRegister(ctx, opcode & 7);
 
@@ -5034,7 +5034,7 @@ static uint32_t EMIT_BFFFO(struct TranslatorContext *ctx, uint16_t opcode)
 {
     uint8_t update_mask = M68K_GetSRMask(ctx->tc_M68kCodePtr - 1);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t base = 0xff;
 
     // Get EA address into a temporary register
@@ -5092,7 +5092,7 @@ static uint32_t EMIT_BFCHG_reg(struct TranslatorContext *ctx, uint16_t opcode)
 {
     uint8_t update_mask = M68K_GetSRMask(ctx->tc_M68kCodePtr - 1);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t src = RA_MapM68kRegister(ctx, opcode & 7);
 
     RA_SetDirtyM68kRegister(ctx, opcode & 7);
@@ -5328,7 +5328,7 @@ static uint32_t EMIT_BFCHG(struct TranslatorContext *ctx, uint16_t opcode)
 {
     uint8_t update_mask = M68K_GetSRMask(ctx->tc_M68kCodePtr - 1);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t base = 0xff;
 
     // Get EA address into a temporary register
@@ -5379,7 +5379,7 @@ static uint32_t EMIT_BFSET_reg(struct TranslatorContext *ctx, uint16_t opcode)
 {
     uint8_t update_mask = M68K_GetSRMask(ctx->tc_M68kCodePtr - 1);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t src = RA_MapM68kRegister(ctx, opcode & 7);
 
     RA_SetDirtyM68kRegister(ctx, opcode & 7);
@@ -5615,7 +5615,7 @@ static uint32_t EMIT_BFSET(struct TranslatorContext *ctx, uint16_t opcode)
 {
     uint8_t update_mask = M68K_GetSRMask(ctx->tc_M68kCodePtr - 1);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t base = 0xff;
 
     // Get EA address into a temporary register
@@ -5669,7 +5669,7 @@ static uint32_t EMIT_BFCLR_reg(struct TranslatorContext *ctx, uint16_t opcode)
 {
     uint8_t update_mask = M68K_GetSRMask(ctx->tc_M68kCodePtr - 1);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t src = RA_MapM68kRegister(ctx, opcode & 7);
 
     RA_SetDirtyM68kRegister(ctx, opcode & 7);
@@ -5905,7 +5905,7 @@ static uint32_t EMIT_BFCLR(struct TranslatorContext *ctx, uint16_t opcode)
 {
     uint8_t update_mask = M68K_GetSRMask(ctx->tc_M68kCodePtr - 1);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t base = 0xff;
 
     // Get EA address into a temporary register
@@ -5959,7 +5959,7 @@ static uint32_t EMIT_BFINS_reg(struct TranslatorContext *ctx, uint16_t opcode)
 {
     uint8_t update_mask = M68K_GetSRMask(ctx->tc_M68kCodePtr - 1);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t dest = RA_MapM68kRegister(ctx, opcode & 7);
     uint8_t src = RA_MapM68kRegister(ctx, (opcode2 >> 12) & 7);
 
@@ -6225,7 +6225,7 @@ static uint32_t EMIT_BFINS(struct TranslatorContext *ctx, uint16_t opcode)
 {
     uint8_t update_mask = M68K_GetSRMask(ctx->tc_M68kCodePtr - 1);
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t base = 0xff;
 
     uint8_t src = RA_MapM68kRegister(ctx, (opcode2 >> 12) & 7);
@@ -6723,13 +6723,13 @@ static struct OpcodeDef InsnTable[4096] = {
 
 uint32_t EMIT_lineE(struct TranslatorContext *ctx)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr++);
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr++);
 
     /* Special case: the combination of RO(R/L).W #8, Dn; SWAP Dn; RO(R/L).W, Dn
         this is replaced by REV instruction */
     if (((opcode & 0xfef8) == 0xe058) &&
-        cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[0]) == (0x4840 | (opcode & 7)) &&
-        (cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[1]) & 0xfeff) == (opcode & 0xfeff))
+        M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[0]) == (0x4840 | (opcode & 7)) &&
+        (M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[1]) & 0xfeff) == (opcode & 0xfeff))
     {
         uint8_t update_mask = M68K_GetSRMask(ctx->tc_M68kCodePtr - 1);
         uint8_t reg = RA_MapM68kRegister(ctx, opcode & 7);
@@ -6819,7 +6819,7 @@ uint32_t GetSR_LineE(uint16_t opcode)
 
 int M68K_GetLineELength(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)insn_stream);
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)insn_stream);
     
     int length = 0;
     int need_ea = 0;
@@ -482,7 +482,7 @@ int FPSR_Update_Needed(uint16_t *ptr, int level)
         return 1;
     } 
 
-    while((cache_read_16(ICACHE, (uintptr_t)ptr) & 0xfe00) != 0xf200)
+    while((M68K_ReadCode16((uintptr_t)ptr) & 0xfe00) != 0xf200)
     {
         if (cnt++ > 200)
             return 1;
@@ -501,8 +501,8 @@ int FPSR_Update_Needed(uint16_t *ptr, int level)
         ptr += len;
     }
 
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&ptr[0]);
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&ptr[1]);
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)&ptr[0]);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)&ptr[1]);
 
     /* In case of FNOP check subsequent instruction */
     if (opcode == 0xf280 && opcode2 == 0x0000)
@@ -669,7 +669,7 @@ void FPU_FetchData(struct TranslatorContext *ctx, uint8_t *reg, uint16_t opcode,
                         uint32_t i;
                         float f;
                     } u;
-                    u.i = (uint32_t)cache_read_32(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[1]);
+                    u.i = (uint32_t)M68K_ReadCode32((uintptr_t)&ctx->tc_M68kCodePtr[1]);
                     /* Check if immediate constant is possible */
                     if ((u.i & 0x7ffff) == 0 && ((u.i & 0x7e000000) == 0x40000000 || (u.i & 0x7e000000) == 0x3e000000)) {
                         uint8_t imm = (u.i >> 19) & 0x7f;
@@ -687,7 +687,7 @@ void FPU_FetchData(struct TranslatorContext *ctx, uint8_t *reg, uint16_t opcode,
                     break;
 
                 case SIZE_L:
-                    int32_t imm32 = (uint32_t)cache_read_32(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[1]);
+                    int32_t imm32 = (uint32_t)M68K_ReadCode32((uintptr_t)&ctx->tc_M68kCodePtr[1]);
                     switch (imm32) {
                         case 0:
                             EMIT(ctx, fmov_0(*reg));
@@ -712,7 +712,7 @@ void FPU_FetchData(struct TranslatorContext *ctx, uint8_t *reg, uint16_t opcode,
                     break;
                 
                 case SIZE_W:
-                    int16_t imm = (int16_t)cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[1]);
+                    int16_t imm = (int16_t)M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[1]);
                     switch (imm) {
                         case 0:
                             EMIT(ctx, fmov_0(*reg));
@@ -737,7 +737,7 @@ void FPU_FetchData(struct TranslatorContext *ctx, uint8_t *reg, uint16_t opcode,
                     break;
 
                 case SIZE_B:
-                    int8_t imm8 = (int8_t)cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[1]);
+                    int8_t imm8 = (int8_t)M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[1]);
                     switch (imm8) {
                         case 0:
                             EMIT(ctx, fmov_0(*reg));
@@ -768,7 +768,7 @@ void FPU_FetchData(struct TranslatorContext *ctx, uint8_t *reg, uint16_t opcode,
                         uint64_t i;
                         double f;
                     } ud;
-                    ud.i = (uint64_t)cache_read_64(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[1]);
+                    ud.i = ((uint64_t)M68K_ReadCode32((uintptr_t)&ctx->tc_M68kCodePtr[1]) << 32) | M68K_ReadCode32((uintptr_t)&ctx->tc_M68kCodePtr[3]);
                     /* Check if immediate constant is possible */
                     if ((ud.i & 0xffffffffffULL) == 0 && 
                             ((ud.i & 0x7fc0000000000000ULL) == 0x4000000000000000ULL || 
@@ -1907,27 +1907,14 @@ uint32_t EPOCH;
 
 void *invalidate_instruction_cache(uintptr_t target_addr, uint16_t *pc, uint32_t *arm_pc)
 {
-    (void)target_addr;
-    (void)pc;
-    
+    extern struct M68KState *__m68k_state;
     int i;
-    //uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&pc[0]);
-    //struct M68KTranslationUnit *u;
-    //struct Node *n, *next;
-    //extern struct List LRU;
-    extern void *jit_tlsf;
-    //extern struct M68KState *__m68k_state;
-
-    (void)jit_tlsf;
+    uint16_t opcode = BE16(pc[0]);
 
     //kprintf("[LINEF] ICache flush... Opcode=%04x, Target=%08x, PC=%08x, ARM PC=%p\n", opcode, target_addr, pc, arm_pc);
     // kprintf("[LINEF] ARM insn: %08x\n", *arm_pc);
 
-    // Invalidate entire instruction cache
-    // FIXME: Could be more precise (but most of the time everything is probably flushed anyway)
-    // NOT: cache_invalidate_range does not handle length of >16 bytes
-    cache_invalidate_all(ICACHE);
-
+    /* The unit which called us may be thrown away below, the rest of it is executed from a copy */
     for (i=0; i < MAX_EPILOGUE_LENGTH; i++)
     {
         if (arm_pc[i] == 0xffffffff)
@@ -1939,139 +1926,40 @@ void *invalidate_instruction_cache(uintptr_t target_addr, uint16_t *pc, uint32_t
     //kprintf("[LINEF] Copied %d instructions of epilogue\n", i);
     __clear_cache(&icache_epilogue[0], &icache_epilogue[i]);
 
-    __asm__ volatile("mov "CTX_LAST_PC_ASM",%w0": :"r"(0xffffffff));
-
-    LRU_InvalidateAll();
-
-    EPOCH++;
-
-#if 0
     /* Get the scope */
-    switch (opcode & 0x18) {
-        case 0x08:  /* Line */
-            // kprintf("[LINEF] Invalidating line\n");
-            ForeachNodeSafe(&LRU, n, next)
-            {
-                u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+    if ((opcode & 0x18) == 0x08 || (opcode & 0x18) == 0x10)
+    {
+        uint32_t length = 16;
 
-                // If highest address of unit is lower than the begin flushed area, or lowest address of unit higher than the flushed area end
-                // then skip the unit
-                if ((uintptr_t)u->mt_M68kLow > ((target_addr + 16) & ~15) || (uintptr_t)u->mt_M68kHigh < (target_addr & ~15))
-                    continue;
+        /* Page size follows the P bit of TC register */
+        if ((opcode & 0x18) == 0x10)
+            length = (__m68k_state->TCR & 0x4000) ? 8192 : 4096;
 
-                if (__m68k_state->JIT_CONTROL & JCCF_SOFT)
-                {
-                    // Weak cflush. Generate invalid entry address instead of flushing. Fault handler will
-                    // verify block checksum and eventually discard it
-                    uintptr_t e = (uintptr_t)u->mt_ARMEntryPoint;
-                    e &= 0x00ffffffffffffffULL;
-                    e |= 0xaa00000000000000ULL;
-                    u->mt_ARMEntryPoint = (void*)e;
-                }
-                else
-                {
-                    // kprintf("[LINEF] Unit %p, %08x-%08x match! Removing.\n", u, u->mt_M68kLow, u->mt_M68kHigh);
-                    REMOVE(&u->mt_LRUNode);
-                    REMOVE(&u->mt_HashNode);
-                    tlsf_free(jit_tlsf, u);
+        uint32_t start = target_addr & ~(length - 1);
 
-                    __m68k_state->JIT_UNIT_COUNT--;
-                    __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
-                }
-            }
-            break;
-        case 0x10:  /* Page */
-            // kprintf("[LINEF] Invalidating page\n");
-            ForeachNodeSafe(&LRU, n, next)
-            {
-                u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+        M68K_LockTranslator();
+        cache_invalidate_range(ICACHE, start, length);
+        M68K_UnlockTranslator();
 
-                // If highest address of unit is lower than the begin flushed area, or lowest address of unit higher than the flushed area end
-                // then skip the unit
-                if ((uintptr_t)u->mt_M68kLow > ((target_addr + 4096) & ~4095) || (uintptr_t)u->mt_M68kHigh < (target_addr & ~4095))
-                    continue;
+        /* Only units translated from the flushed range are affected */
+        M68K_InvalidateRange(start, start + length);
+    }
+    else
+    {
+        // Invalidate entire instruction cache
+        M68K_LockTranslator();
+        cache_invalidate_all(ICACHE);
+        M68K_UnlockTranslator();
 
-                // kprintf("[LINEF] Unit %p, %08x-%08x match! Removing.\n", u, u->mt_M68kLow, u->mt_M68kHigh);
+        /* Units of previous epoch must not jump into each other directly */
+        M68K_UnlinkAll();
 
-                if (__m68k_state->JIT_CONTROL & JCCF_SOFT)
-                {
-                    // Weak cflush. Generate invalid entry address instead of flushing. Fault handler will
-                    // verify block checksum and eventually discard it
-                    uintptr_t e = (uintptr_t)u->mt_ARMEntryPoint;
-                    e &= 0x00ffffffffffffffULL;
-                    e |= 0xaa00000000000000ULL;
-                    u->mt_ARMEntryPoint = (void*)e;
-                }
-                else
-                {
-                    REMOVE(&u->mt_LRUNode);
-                    REMOVE(&u->mt_HashNode);
-                    tlsf_free(jit_tlsf, u);
+        __asm__ volatile("mov "CTX_LAST_PC_ASM",%w0": :"r"(0xffffffff));
 
-                    __m68k_state->JIT_UNIT_COUNT--;
-                    __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
-                }
-            }
-            break;
-        case 0x18:  /* All */
-            // kprintf("[LINEF] Invalidating all\n");            
-            if (__m68k_state->JIT_CONTROL & JCCF_SOFT)
-            {
-                if (__m68k_state->JIT_UNIT_COUNT < __m68k_state->JIT_SOFTFLUSH_THRESH)
-                {
-                    ForeachNode(&LRU, n)
-                    {
-                        uintptr_t uptr = ((uintptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
-                        uptr += __builtin_offsetof(struct M68KTranslationUnit, mt_ARMEntryPoint);
-
-                        // Weak cflush. Generate invalid entry address instead of flushing. Fault handler will
-                        // verify block checksum and eventually discard it
-                        *(uint8_t *)uptr = 0xaa;
-                    }
-                }
-                else
-                {
-                    while (
-#if EMU68_WEAK_CFLUSH_SLOW
-                            __m68k_state->JIT_UNIT_COUNT >= __m68k_state->JIT_SOFTFLUSH_THRESH &&
-#endif
-                            (n = REMHEAD(&LRU)))
-                    {
-                        u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
-             
-                        REMOVE(&u->mt_HashNode);
-                        tlsf_free(jit_tlsf, u);
-                        
-                        __m68k_state->JIT_UNIT_COUNT--;
-                    }
-                    __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
-#if EMU68_WEAK_CFLUSH_SLOW
-                    ForeachNode(&LRU, n)
-                    {
-                        uintptr_t uptr = ((uintptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
-                        uptr += __builtin_offsetof(struct M68KTranslationUnit, mt_ARMEntryPoint);
+        LRU_InvalidateAll();
 
-                        // Weak cflush. Generate invalid entry address instead of flushing. Fault handler will
-                        // verify block checksum and eventually discard it
-                        *(uint8_t *)uptr = 0xaa;
-                    }
-#endif
-                }
-            }
-            else
-            {
-                while ((n = REMHEAD(&LRU))) {
-                    u = (struct M68KTranslationUnit *)((intptr_t)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
-                    // kprintf("[LINEF] Removing unit %p\n", u);                
-                    REMOVE(&u->mt_HashNode);
-                    tlsf_free(jit_tlsf, u);
-                }
-                __m68k_state->JIT_UNIT_COUNT = 0;
-                __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
-            }
-            break;
+        EPOCH++;
     }
-#endif
 
     return &icache_epilogue[0];
 }
@@ -2084,8 +1972,8 @@ void __attribute__((used)) __trampoline_icache_invalidate(void)
 
 uint32_t EMIT_FPU(struct TranslatorContext *ctx)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[0]);
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[1]);
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[0]);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[1]);
     uint8_t ext_count = 1;
     uint32_t insn_consumed = 1;
     
@@ -2266,6 +2154,7 @@ uint32_t EMIT_FPU(struct TranslatorContext *ctx)
         uint8_t success_condition = 0;
         uint8_t tmp_cc = 0xff;
         uint32_t *tmpptr;
+        uint16_t *insn_ptr = ctx->tc_M68kCodePtr - 1;
 
         /* Test predicate with masked signalling bit, operations are the same */
         switch (predicate & 0x0f)
@@ -2459,14 +2348,14 @@ uint32_t EMIT_FPU(struct TranslatorContext *ctx)
         /* use 16-bit offset */
         if ((opcode & 0x0040) == 0x0000)
         {
-            branch_offset = (int16_t)cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr++);
+            branch_offset = (int16_t)M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr++);
         }
         /* use 32-bit offset */
         else
         {
             uint16_t lo16, hi16;
-            hi16 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr++);
-            lo16 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr++);
+            hi16 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr++);
+            lo16 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr++);
             branch_offset = lo16 | (hi16 << 16);
         }
 
@@ -2488,6 +2377,9 @@ uint32_t EMIT_FPU(struct TranslatorContext *ctx)
 #endif
 #endif
 
+        /* Hot code follows the direction taken most often, if it is known already */
+        take_branch = M68K_PredictBranch(insn_ptr, take_branch);
+
         if (take_branch)
         {
             success_condition ^= 1;
@@ -2498,6 +2390,8 @@ uint32_t EMIT_FPU(struct TranslatorContext *ctx)
         EMIT(ctx, b_cc(success_condition, 1));
         tmpptr = ctx->tc_CodePtr - 1;
 
+        EMIT_BranchProfile(ctx, insn_ptr, take_branch);
+
         branch_target += branch_offset - local_pc_off;
 
         /* Insert the branch non-taken case here */
@@ -2542,6 +2436,8 @@ uint32_t EMIT_FPU(struct TranslatorContext *ctx)
         /* Now insert the branch taken case - this will be treated as exit code */
         uint32_t *exit_code_start = ctx->tc_CodePtr;
 
+        EMIT_BranchProfile(ctx, insn_ptr, !take_branch);
+
         /* Insert the first case here */
         if (take_branch)
         {
@@ -2581,7 +2477,7 @@ uint32_t EMIT_FPU(struct TranslatorContext *ctx)
             }
         }
         /* Insert local exit */
-        EMIT_LocalExit(ctx, 1);
+        EMIT_ChainableExit(ctx, 1);
         uint32_t *exit_code_end = ctx->tc_CodePtr;
 
         /* Insert fixup location */
@@ -2705,7 +2601,7 @@ uint32_t EMIT_FPU(struct TranslatorContext *ctx)
             uint32_t branch_2_type = 0;
             int8_t off8 = 0;
             int32_t off = 6;
-            int32_t branch_offset = 4 + (int16_t)cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr++);
+            int32_t branch_offset = 4 + (int16_t)M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr++);
 
             EMIT_GetOffsetPC(ctx, &off8);
             off += off8;
@@ -2779,7 +2675,7 @@ uint32_t EMIT_FPU(struct TranslatorContext *ctx)
             EMIT(ctx, add_immed(REG_PC, REG_PC, true_pc_addend));
 
             /* Insert local exit */
-            EMIT_LocalExit(ctx, 1);
+            EMIT_ChainableExit(ctx, 1);
             uint32_t *exit_code_end = ctx->tc_CodePtr;
 
             /* Insert fixup location - if branch_1 is not NULL, insert double exit, otherwise single one */
@@ -5232,8 +5128,8 @@ int DisableFPU = 0;
 uint32_t EMIT_lineF(struct TranslatorContext *ctx)
 {
     uint32_t insn_consumed = 1;
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[0]);
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[1]);
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[0]);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[1]);
 
     /* Check destination coprocessor - if it is FPU go to separate function */
     if (DisableFPU == 0 && (opcode & 0x0e00) == 0x0200)
@@ -5292,7 +5188,7 @@ uint32_t EMIT_lineF(struct TranslatorContext *ctx)
         uint8_t buf1 = RA_AllocARMRegister(ctx);
         uint8_t buf2 = RA_AllocARMRegister(ctx);
         uint8_t reg = RA_MapM68kRegister(ctx, 8 + (opcode & 7));
-        uint32_t mem = (cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[1]) << 16) | cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[2]);
+        uint32_t mem = (M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[1]) << 16) | M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[2]);
 
         /* Align memory pointer */
         mem &= 0xfffffff0;
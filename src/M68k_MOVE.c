@@ -15,11 +15,12 @@
 uint32_t EMIT_moveq(struct TranslatorContext *ctx)
 {
     uint8_t update_mask = M68K_GetSRMask(ctx->tc_M68kCodePtr);
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     int8_t value = opcode & 0xff;
     uint8_t reg = (opcode >> 9) & 7;
     uint8_t tmp_reg = RA_MapM68kRegisterForWrite(ctx, reg);
     uint32_t insn_consumed = 1;
+    uint32_t known;
 
     if (opcode & 0x100) {
         EMIT_FlushPC(ctx);
@@ -40,8 +41,11 @@ uint32_t EMIT_moveq(struct TranslatorContext *ctx)
 
     ctx->tc_M68kCodePtr++;
 
+    /* Register known to hold the value already needs no load, flags are set from the constant anyway */
+    if (M68K_GetKnownValue(ctx, reg, &known) && known == (uint32_t)(int32_t)value)
+        ;
     /* Special case which can be 0-cycle on A76 and above - load zero to register */
-    if (value == 0)
+    else if (value == 0)
         EMIT(ctx, mov_reg(tmp_reg, 31));
     else
         EMIT(ctx, mov_immed_s8(tmp_reg, value));
@@ -79,7 +83,7 @@ uint32_t GetSR_Line7(uint16_t opcode)
 uint32_t EMIT_move(struct TranslatorContext *ctx)
 {
     uint8_t update_mask = M68K_GetSRMask(ctx->tc_M68kCodePtr);
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     int move_length = M68K_GetINSNLength(ctx->tc_M68kCodePtr);
     uint8_t ext_count = 0;
     uint8_t tmp_reg = 0xff;
@@ -157,7 +161,7 @@ uint32_t EMIT_move(struct TranslatorContext *ctx)
     if ((opcode & 0xf000) == 0x2000)
     {
         // Fetch 2nd opcode just now
-        uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[1]);
+        uint16_t opcode2 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[1]);
 
         // Is move.l Reg, -(An) ?: Dest mode 100, source mode 000 or 001
         if ((opcode & 0x01f0) == 0x0100)
@@ -358,7 +362,7 @@ uint32_t EMIT_move(struct TranslatorContext *ctx)
         /* Only if target is data register */
         if ((tmp & 0x38) == 0)
         {
-            uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[move_length - 1]);
+            uint16_t opcode2 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[move_length - 1]);
             
             /* Check if subsequent instruction is extb.l on the same target reg */
             if (size == 1 && (opcode2 & 0xfff8) == 0x49c0 && (opcode2 & 7) == (tmp & 7))
@@ -377,7 +381,7 @@ uint32_t EMIT_move(struct TranslatorContext *ctx)
             /* Check if subsequent instructions are ext.w + ext.l on the same target and size is byte */
             else if (size == 1 && (opcode2 & 0xfff8) == 0x4880 && (opcode2 & 7) == (tmp & 7))
             {
-                uint16_t opcode3 = cache_read_16(ICACHE, (uintptr_t)&ctx->tc_M68kCodePtr[move_length]);
+                uint16_t opcode3 = M68K_ReadCode16((uintptr_t)&ctx->tc_M68kCodePtr[move_length]);
                 if ((opcode3 & 0xfff8) == 0x48c0 && (opcode3 & 7) == (tmp & 7))
                 {
                     sign_ext = 1;
@@ -391,9 +395,20 @@ uint32_t EMIT_move(struct TranslatorContext *ctx)
         /* Copy 32bit from data reg to data reg */
         if (size == 4 || sign_ext)
         {
+            uint32_t known;
+
             /* If source was not a register (this is handled separately), but target is a register */
             if ((opcode & 0x38) != 0 && (opcode & 0x38) != 0x08) {
-                if ((tmp & 0x38) == 0) {
+                /* Long immediate which the target register is known to hold already */
+                if (!sign_ext && (opcode & 0x3f) == 0x3c && (tmp & 0x30) == 0 &&
+                    M68K_GetKnownValue(ctx, (tmp & 7) | (tmp & 8), &known) &&
+                    known == M68K_ReadCode32((uintptr_t)ctx->tc_M68kCodePtr))
+                {
+                    loaded_in_dest = 1;
+                    tmp_reg = RA_MapM68kRegisterForWrite(ctx, (tmp & 7) | (tmp & 8));
+                    ext_count = 2;
+                }
+                else if ((tmp & 0x38) == 0) {
                     loaded_in_dest = 1;
                     tmp_reg = RA_MapM68kRegisterForWrite(ctx, tmp & 7);
                     if (sign_ext)
@@ -432,7 +447,7 @@ uint32_t EMIT_move(struct TranslatorContext *ctx)
                 {
                     /* Special case - 16-bit immediate load into Dn register */
                     uint8_t dn = RA_MapM68kRegisterForWrite(ctx, tmp & 7);
-                    EMIT(ctx, movk_immed_u16(dn, cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr), 0));
+                    EMIT(ctx, movk_immed_u16(dn, M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr), 0));
                     ext_count++;
                     loaded_in_dest = 1;
                 }
@@ -457,13 +472,13 @@ uint32_t EMIT_move(struct TranslatorContext *ctx)
             is_load_immediate = 1;
             switch (size) {
                 case 4:
-                    immediate_value = cache_read_32(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+                    immediate_value = M68K_ReadCode32((uintptr_t)ctx->tc_M68kCodePtr);
                     break;
                 case 2:
-                    immediate_value = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+                    immediate_value = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
                     break;
                 case 1:
-                    immediate_value = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr) & 0xff;
+                    immediate_value = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr) & 0xff;
                     break;
             }
         }
@@ -122,7 +122,7 @@ uint32_t EMIT_MULS_L(struct TranslatorContext *ctx, uint16_t opcode)
     uint8_t reg_dh = 0xff;
     uint8_t src = 0xff;
     uint8_t ext_words = 1;
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t signed_mul = (opcode2 & (1 << 11)) != 0;
     uint8_t result64 = (opcode2 & (1 << 10)) != 0;
 
@@ -446,7 +446,7 @@ uint32_t EMIT_DIVU_W(struct TranslatorContext *ctx, uint16_t opcode)
 uint32_t EMIT_DIVUS_L(struct TranslatorContext *ctx, uint16_t opcode)
 {
     uint8_t update_mask = M68K_GetSRMask(ctx->tc_M68kCodePtr - 1);
-    uint16_t opcode2 = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode2 = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t sig = (opcode2 & (1 << 11)) != 0;
     uint8_t div64 = (opcode2 & (1 << 10)) != 0;
     uint8_t reg_q = 0xff;
@@ -0,0 +1,258 @@
+/*
+    Copyright © 2025 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "support.h"
+#include "M68k.h"
+#include "A64.h"
+
+/*
+    Peephole pass over the body of a translation unit, i.e. the code between the prologue and the
+    epilogue, run once all m68k instructions are translated. The decoders emit every instruction in
+    isolation, so the body contains moves of a register onto itself, additions of zero, branches
+    to the very next instruction and pairs of loads or stores to neighbouring fields of M68KState.
+    The first ones are removed, the pairs are merged into single LDP/STP instructions.
+
+    Removing instructions shifts the code, therefore every PC relative instruction of the body is
+    adjusted afterwards. Branches to removed instructions continue at the next kept one. Code
+    behind the body moves down as a whole. Memory pairs are fused only if their base register is
+    the context pointer or SP. Accesses to m68k memory have to stay as they are, since merging
+    them would change width and order of the cycles seen on the m68k bus.
+*/
+
+#define PH_TARGET   0x80000000
+#define PH_DELETE   0x40000000
+#define PH_INDEX    0x3fffffff
+
+enum PCRelKind {
+    PR_NONE,
+    PR_B26,         /* B, BL */
+    PR_IMM19,       /* B.cond, CBZ, CBNZ, LDR literal */
+    PR_IMM14,       /* TBZ, TBNZ */
+    PR_ADR,
+    PR_ADRP
+};
+
+/* Classify PC relative instruction, offset is returned in bytes */
+static enum PCRelKind PCRel(uint32_t op, int32_t *offset)
+{
+    if ((op & 0x7c000000) == 0x14000000)
+    {
+        *offset = ((int32_t)(op << 6)) >> 4;
+        return PR_B26;
+    }
+    else if ((op & 0xff000010) == 0x54000000 || (op & 0x7e000000) == 0x34000000 || (op & 0x3b000000) == 0x18000000)
+    {
+        *offset = ((int32_t)(op << 8)) >> 11 & ~3;
+        return PR_IMM19;
+    }
+    else if ((op & 0x7e000000) == 0x36000000)
+    {
+        *offset = ((int32_t)(op << 13)) >> 16 & ~3;
+        return PR_IMM14;
+    }
+    else if ((op & 0x9f000000) == 0x10000000)
+    {
+        *offset = (((int32_t)(op << 8)) >> 11 & ~3) | ((op >> 29) & 3);
+        return PR_ADR;
+    }
+    else if ((op & 0x9f000000) == 0x90000000)
+    {
+        return PR_ADRP;
+    }
+
+    return PR_NONE;
+}
+
+static uint32_t SetPCRel(uint32_t op, enum PCRelKind kind, int32_t offset)
+{
+    switch (kind)
+    {
+        case PR_B26:
+            return (op & 0xfc000000) | ((offset >> 2) & 0x3ffffff);
+        case PR_IMM19:
+            return (op & ~(0x7ffff << 5)) | (((offset >> 2) & 0x7ffff) << 5);
+        case PR_IMM14:
+            return (op & ~(0x3fff << 5)) | (((offset >> 2) & 0x3fff) << 5);
+        case PR_ADR:
+            return (op & ~((3 << 29) | (0x7ffff << 5))) | ((offset & 3) << 29) | (((offset >> 2) & 0x7ffff) << 5);
+        default:
+            return op;
+    }
+}
+
+/* Instructions which do not change any state: mov xN, xN, add/sub xN, xN, #0 and b to next instruction */
+static int IsRedundant(uint32_t op)
+{
+    /* 32-bit variants clear upper half of the register and have to stay */
+    if ((op & 0xffe0ffe0) == 0xaa0003e0 && ((op >> 16) & 31) == (op & 31))
+        return 1;
+    if ((op & 0xbffffc00) == 0x91000000 && ((op >> 5) & 31) == (op & 31))
+        return 1;
+    if (op == 0x14000001)
+        return 1;
+
+    return 0;
+}
+
+/*
+    Try to merge two LDR or two STR (unsigned offset, 32 or 64 bit) into one LDP/STP. Returns the
+    pair instruction or 0 if the two cannot be merged.
+*/
+static uint32_t FusePair(uint32_t op1, uint32_t op2, uint8_t ctx_reg)
+{
+    uint32_t cls = op1 & 0xffc00000;
+
+    if (cls != (op2 & 0xffc00000))
+        return 0;
+    if (cls != 0xb9400000 && cls != 0xb9000000 && cls != 0xf9400000 && cls != 0xf9000000)
+        return 0;
+
+    uint8_t rn = (op1 >> 5) & 31;
+    if (rn != ((op2 >> 5) & 31))
+        return 0;
+    if (rn != 31 && rn != ctx_reg)
+        return 0;
+
+    int is64 = (cls & 0x40000000) != 0;
+    int is_load = (cls & 0x00400000) != 0;
+    uint32_t size = is64 ? 8 : 4;
+    uint32_t off1 = ((op1 >> 10) & 0xfff) * size;
+    uint32_t off2 = ((op2 >> 10) & 0xfff) * size;
+    uint8_t rt1 = op1 & 31;
+    uint8_t rt2 = op2 & 31;
+
+    /* First load must not change the base of the second, both loads need distinct targets */
+    if (is_load && (rt1 == rn || rt1 == rt2))
+        return 0;
+
+    if (off2 == off1 + size && off1 <= 63 * size)
+    {
+        if (is64)
+            return is_load ? ldp64(rn, rt1, rt2, off1) : stp64(rn, rt1, rt2, off1);
+        else
+            return is_load ? ldp(rn, rt1, rt2, off1) : stp(rn, rt1, rt2, off1);
+    }
+    else if (off1 == off2 + size && off2 <= 63 * size)
+    {
+        if (is64)
+            return is_load ? ldp64(rn, rt2, rt1, off2) : stp64(rn, rt2, rt1, off2);
+        else
+            return is_load ? ldp(rn, rt2, rt1, off2) : stp(rn, rt2, rt1, off2);
+    }
+
+    return 0;
+}
+
+/*
+    Optimize length instructions at code in place. The ctx_reg is the register holding the context
+    pointer, 0xff if there is none. On return map[i] holds new position of instruction i and
+    map[length] the new length of the code. Returns number of instructions removed.
+*/
+uint32_t M68K_Peephole(uint32_t *code, uint32_t length, uint8_t ctx_reg, uint32_t *map)
+{
+    uint32_t ctx_def = ctx_reg != 0xff ? mov_simd_to_reg(ctx_reg, CTX_POINTER) : 0;
+    uint8_t live_ctx = 0xff;
+    uint32_t pos = 0;
+
+    for (uint32_t i=0; i <= length; i++)
+        map[i] = i;
+
+    if (length == 0 || length > PH_INDEX)
+        return 0;
+
+    /* Find all branch targets within the code. ADRP or data addressed by ADR leave the code alone */
+    for (uint32_t i=0; i < length; i++)
+    {
+        int32_t offset;
+        enum PCRelKind kind = PCRel(I32(code[i]), &offset);
+
+        if (kind == PR_ADRP || (kind == PR_ADR && (offset & 3)))
+            return 0;
+
+        if (kind != PR_NONE)
+        {
+            int32_t target = (int32_t)i + offset / 4;
+
+            if (target >= 0 && target < (int32_t)length)
+                map[target] |= PH_TARGET;
+        }
+    }
+
+    /* Select instructions to remove and fuse pairs. Second half of a pair must not be a branch target */
+    for (uint32_t i=0; i < length; i++)
+    {
+        uint32_t op = I32(code[i]);
+
+        if (code[i] == ctx_def)
+            live_ctx = ctx_reg;
+
+        if (IsRedundant(op))
+        {
+            map[i] |= PH_DELETE;
+        }
+        else if (i + 1 < length && !(map[i + 1] & PH_TARGET))
+        {
+            uint32_t pair = FusePair(op, I32(code[i + 1]), live_ctx);
+
+            if (pair)
+            {
+                code[i] = pair;
+                map[i + 1] |= PH_DELETE;
+                i++;
+            }
+        }
+    }
+
+    /* Assign new positions, removed instructions take position of the next kept one */
+    for (uint32_t i=0; i < length; i++)
+    {
+        uint32_t flags = map[i] & PH_DELETE;
+        map[i] = pos | flags;
+        if (!flags)
+            pos++;
+    }
+    map[length] = pos;
+
+    if (pos == length)
+    {
+        for (uint32_t i=0; i < length; i++)
+            map[i] &= PH_INDEX;
+        return 0;
+    }
+
+    /* Move the code down and adjust PC relative instructions. Code behind the body moves with it */
+    for (uint32_t i=0; i < length; i++)
+    {
+        if (map[i] & PH_DELETE)
+            continue;
+
+        uint32_t op = I32(code[i]);
+        int32_t offset;
+        enum PCRelKind kind = PCRel(op, &offset);
+
+        if (kind != PR_NONE)
+        {
+            int32_t target = (int32_t)i + offset / 4;
+
+            if (target >= (int32_t)length)
+                target -= length - pos;
+            else if (target >= 0)
+                target = map[target] & PH_INDEX;
+
+            op = SetPCRel(op, kind, 4 * (target - (int32_t)(map[i] & PH_INDEX)));
+        }
+
+        code[map[i] & PH_INDEX] = I32(op);
+    }
+
+    for (uint32_t i=0; i < length; i++)
+        map[i] &= PH_INDEX;
+
+    return length - pos;
+}
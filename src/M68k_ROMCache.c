@@ -0,0 +1,460 @@
+/*
+    Copyright © 2025 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "support.h"
+#include "M68k.h"
+#include "A64.h"
+#include "lists.h"
+#include "tlsf.h"
+#include "mmu.h"
+#include "md5.h"
+#include "UnitTable.h"
+
+/*
+    Units translated from Kickstart ROM never change for given ROM image. They can be exported
+    to memory with the JITSNAP control register, stored by m68k software and appended to the ROM
+    image loaded through initramfs. On the next boot such units are put directly into JIT cache.
+
+    The image consists of a header followed by the units. Each unit is followed by its ARM code
+    and a list of relocations. Since the code refers to functions of Emu68 itself, the image is
+    valid only for the same build of Emu68, ROM image and JIT settings.
+*/
+
+#define ROMCACHE_MAGIC      0x4a383645  /* 'E68J' */
+#define ROMCACHE_VERSION    2
+
+#define ROM_START           0x00f80000
+#define ROM_END             0x01000000
+
+#define JIT_EXEC_ALIAS      0x0000001000000000ULL
+
+#define RELOC_UNIT_HI_LO    0x00000000  /* Two words, upper and lower half of unit address */
+#define RELOC_INLINE_CACHE  0x80000000  /* ic_Unit field of an inline cache */
+#define RELOC_OFFSET_MASK   0x7fffffff
+#define RELOC_NONE          0xffffffff
+
+struct ROMCacheHeader {
+    uint32_t    rc_Magic;
+    uint32_t    rc_Version;
+    uint32_t    rc_Size;
+    uint32_t    rc_UnitCount;
+    struct MD5  rc_ROMDigest;
+    uint32_t    rc_JIT_CONTROL;
+    uint32_t    rc_JIT_CONTROL2;
+    uint64_t    rc_BuildID;
+    uint32_t    rc_Checksum;        /* CRC32 of everything following the header */
+    uint32_t    rc_Pad;
+};
+
+struct ROMCacheUnit {
+    uint32_t    ru_M68kAddress;
+    uint32_t    ru_M68kLow;
+    uint32_t    ru_M68kHigh;
+    uint32_t    ru_CRC32;
+    uint32_t    ru_Fingerprint;
+    uint32_t    ru_PrologueSize;
+    uint32_t    ru_EpilogueSize;
+    uint32_t    ru_Conditionals;
+    uint32_t    ru_M68kInsnCnt;
+    uint32_t    ru_ARMInsnCnt;
+    uint32_t    ru_Tier;
+    uint32_t    ru_RelocCount;
+    uint32_t    ru_Data[];          /* ARM code including end marker, then relocations */
+};
+
+extern struct List LRU;
+extern struct UnitTable ICache;
+extern uint32_t EPOCH;
+extern struct M68KState *__m68k_state;
+
+/*
+    Code refers to Emu68 functions and variables by their absolute addresses, so the image can
+    be used by exactly the same build only.
+*/
+static uint64_t GetBuildID()
+{
+    extern const char _verstring_object[];
+    uint64_t id = 0xcbf29ce484222325ULL;
+
+    for (const char *c = _verstring_object; *c; c++)
+    {
+        id ^= (uint8_t)*c;
+        id *= 0x100000001b3ULL;
+    }
+
+    id ^= (uintptr_t)&M68K_GetTranslationUnit;
+    id *= 0x100000001b3ULL;
+    id ^= (uintptr_t)&__m68k_state;
+
+    return id;
+}
+
+static int IsROMUnit(struct M68KTranslationUnit *unit)
+{
+    return unit->mt_M68kLow >= ROM_START && unit->mt_M68kHigh < ROM_END &&
+        ((uintptr_t)unit->mt_ARMEntryPoint >> 56) != 0xaa &&
+        unit->mt_JIT_CONTROL == __m68k_state->JIT_CONTROL &&
+        unit->mt_JIT_CONTROL2 == __m68k_state->JIT_CONTROL2;
+}
+
+static inline void ResetInlineCache(struct M68KInlineCache *ic, struct M68KTranslationUnit *unit)
+{
+    for (int i=0; i < IC_WAYS; i++)
+    {
+        ic->ic_Way[i].ic_M68kPC = IC_INVALID_PC;
+        ic->ic_Way[i].ic_Pad = 0;
+        ic->ic_Way[i].ic_ARMEntry = NULL;
+    }
+    ic->ic_Unit = unit;
+    ic->ic_Victim = 0;
+}
+
+/* Check if the code refers to address addr at offset i, return the relocation type if it does */
+static inline uint32_t RelocationAt(const uint32_t *code, uint32_t i, uintptr_t addr)
+{
+    if (code[i] == (uint32_t)(addr >> 32) && code[i+1] == (uint32_t)addr)
+        return RELOC_UNIT_HI_LO;
+    else if ((i & 1) == 0 && *(const uint64_t *)&code[i] == addr)
+        return RELOC_INLINE_CACHE;
+
+    return RELOC_NONE;
+}
+
+/*
+    Find all places where the code refers to its own unit: literals of chainable exits and
+    inline caches. Returns number of relocations, stores them in relocs if not NULL.
+*/
+static uint32_t FindRelocations(struct M68KTranslationUnit *unit, uint32_t *relocs)
+{
+    uintptr_t addr = (uintptr_t)unit;
+    uint32_t *code = &unit->mt_ARMCode[0];
+    uint32_t count = 0;
+
+    for (uint32_t i=0; i + 1 < unit->mt_ARMInsnCnt; i++)
+    {
+        uint32_t type = RelocationAt(code, i, addr);
+
+        if (type != RELOC_NONE)
+        {
+            if (relocs)
+                relocs[count] = type | i;
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/*
+    Point code of a unit which was copied from old_address back to the unit itself. Links to
+    other units have to be broken before the copy is made. Returns number of relocations.
+*/
+uint32_t M68K_RelocateUnit(struct M68KTranslationUnit *unit, uintptr_t old_address)
+{
+    uint32_t *code = &unit->mt_ARMCode[0];
+    uint32_t count = 0;
+
+    for (uint32_t i=0; i + 1 < unit->mt_ARMInsnCnt; i++)
+    {
+        uint32_t type = RelocationAt(code, i, old_address);
+
+        if (type == RELOC_INLINE_CACHE)
+        {
+            ResetInlineCache((struct M68KInlineCache *)((uintptr_t)&code[i] - __builtin_offsetof(struct M68KInlineCache, ic_Unit)), unit);
+            count++;
+        }
+        else if (type == RELOC_UNIT_HI_LO)
+        {
+            code[i] = (uint32_t)((uintptr_t)unit >> 32);
+            code[i+1] = (uint32_t)(uintptr_t)unit;
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/*
+    Check that all relocations of a unit loaded from the image point inside its code, so that
+    applying them cannot write past the unit.
+*/
+static int ValidRelocations(const struct ROMCacheUnit *ru)
+{
+    const uint32_t *relocs = &ru->ru_Data[ru->ru_ARMInsnCnt + 1];
+    const uint64_t ic_offset = __builtin_offsetof(struct M68KInlineCache, ic_Unit);
+
+    for (uint32_t r=0; r < ru->ru_RelocCount; r++)
+    {
+        uint64_t offset = relocs[r] & RELOC_OFFSET_MASK;
+
+        if (relocs[r] & RELOC_INLINE_CACHE)
+        {
+            if (4 * offset < ic_offset || offset + sizeof(struct M68KInlineCache) / 4 >= ru->ru_ARMInsnCnt)
+                return 0;
+        }
+        else if (offset + 1 >= ru->ru_ARMInsnCnt)
+            return 0;
+    }
+
+    return 1;
+}
+
+static uint32_t ExportedSize(struct M68KTranslationUnit *unit)
+{
+    return sizeof(struct ROMCacheUnit) + 4 * (unit->mt_ARMInsnCnt + 1 + FindRelocations(unit, NULL));
+}
+
+/*
+    Export all ROM units to the buffer given in JIT_SNAPSHOT. First longword of the buffer holds
+    its capacity. Required size is left in JIT_SNAPSHOT_SIZE, if the buffer is too small nothing
+    is written. Called from JIT code through MOVEC.
+*/
+void M68K_SaveROMCache()
+{
+    uint32_t address = __m68k_state->JIT_SNAPSHOT;
+    uint32_t size = sizeof(struct ROMCacheHeader);
+    uint32_t count = 0;
+    struct Node *n;
+
+    ForeachNode(&LRU, n)
+    {
+        struct M68KTranslationUnit *unit = (void *)((char *)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+
+        if (IsROMUnit(unit))
+        {
+            size += ExportedSize(unit);
+            count++;
+        }
+    }
+
+    __m68k_state->JIT_SNAPSHOT_SIZE = size;
+
+    /* Buffer has to be in ARM memory, the bus is not going to handle that */
+    if (address == 0 || mmu_virt2phys(address) == (uintptr_t)-1 || mmu_virt2phys(address + size - 1) == (uintptr_t)-1)
+        return;
+
+    if (BE32(*(uint32_t *)(uintptr_t)address) < size)
+        return;
+
+    struct ROMCacheHeader *hdr = (struct ROMCacheHeader *)(uintptr_t)address;
+    uint8_t *out = (uint8_t *)&hdr[1];
+
+    hdr->rc_Magic = ROMCACHE_MAGIC;
+    hdr->rc_Version = ROMCACHE_VERSION;
+    hdr->rc_Size = size;
+    hdr->rc_UnitCount = count;
+    hdr->rc_ROMDigest = CalcMD5((void *)ROM_START, (void *)ROM_END);
+    hdr->rc_JIT_CONTROL = __m68k_state->JIT_CONTROL;
+    hdr->rc_JIT_CONTROL2 = __m68k_state->JIT_CONTROL2;
+    hdr->rc_BuildID = GetBuildID();
+
+    ForeachNode(&LRU, n)
+    {
+        struct M68KTranslationUnit *unit = (void *)((char *)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+        struct ROMCacheUnit *ru = (struct ROMCacheUnit *)out;
+
+        if (!IsROMUnit(unit))
+            continue;
+
+        ru->ru_M68kAddress = unit->mt_M68kAddress;
+        ru->ru_M68kLow = unit->mt_M68kLow;
+        ru->ru_M68kHigh = unit->mt_M68kHigh;
+        ru->ru_CRC32 = unit->mt_CRC32;
+        ru->ru_Fingerprint = unit->mt_Fingerprint;
+        ru->ru_PrologueSize = unit->mt_PrologueSize;
+        ru->ru_EpilogueSize = unit->mt_EpilogueSize;
+        ru->ru_Conditionals = unit->mt_Conditionals;
+        ru->ru_M68kInsnCnt = unit->mt_M68kInsnCnt;
+        ru->ru_ARMInsnCnt = unit->mt_ARMInsnCnt;
+        ru->ru_Tier = unit->mt_Tier;
+
+        uint32_t *code = &ru->ru_Data[0];
+        uint32_t *relocs = &ru->ru_Data[unit->mt_ARMInsnCnt + 1];
+
+        for (uint32_t i=0; i <= unit->mt_ARMInsnCnt; i++)
+            code[i] = unit->mt_ARMCode[i];
+
+        ru->ru_RelocCount = FindRelocations(unit, relocs);
+
+        /* Links to other units are not exported, put back the nop slots... */
+        struct Node *l;
+        ForeachNode(&unit->mt_ChainOut, l)
+        {
+            struct M68KChainLink *link = (void *)((char *)l - __builtin_offsetof(struct M68KChainLink, cl_OutNode));
+            uint32_t *slot = (uint32_t *)((uintptr_t)link->cl_Slot & ~JIT_EXEC_ALIAS);
+
+            if (link->cl_Type == CHAIN_BRANCH)
+                code[slot - &unit->mt_ARMCode[0]] = nop();
+        }
+
+        /* ...and empty inline caches */
+        for (uint32_t r=0; r < ru->ru_RelocCount; r++)
+        {
+            if (relocs[r] & RELOC_INLINE_CACHE)
+            {
+                uint32_t *ic_unit = &code[relocs[r] & RELOC_OFFSET_MASK];
+                ResetInlineCache((struct M68KInlineCache *)((uintptr_t)ic_unit - __builtin_offsetof(struct M68KInlineCache, ic_Unit)), NULL);
+            }
+        }
+
+        out += sizeof(struct ROMCacheUnit) + 4 * (unit->mt_ARMInsnCnt + 1 + ru->ru_RelocCount);
+    }
+
+    hdr->rc_Checksum = CalcCRC32(&hdr[1], (uint8_t *)hdr + size);
+
+    kprintf("[ICache] Exported %d ROM units (%d bytes) to %08x\n", count, size, address);
+}
+
+/* Check if the buffer starts with exported ROM cache */
+int M68K_IsROMCache(const void *buffer, uint32_t size)
+{
+    const struct ROMCacheHeader *hdr = buffer;
+
+    return size >= sizeof(struct ROMCacheHeader) && hdr->rc_Magic == ROMCACHE_MAGIC;
+}
+
+/*
+    Put units from exported ROM cache into JIT cache. The image is used only if it was created
+    by the same Emu68 build, for the same ROM and with the same JIT settings. Returns number of
+    units loaded.
+*/
+int M68K_LoadROMCache(const void *buffer, uint32_t size)
+{
+    const struct ROMCacheHeader *hdr = buffer;
+    const uint8_t *in = (const uint8_t *)&hdr[1];
+    const uint8_t *end = (const uint8_t *)buffer + size;
+    struct MD5 digest = CalcMD5((void *)ROM_START, (void *)ROM_END);
+    int loaded = 0;
+
+    if (!M68K_IsROMCache(buffer, size) || hdr->rc_Version != ROMCACHE_VERSION || hdr->rc_Size > size)
+    {
+        kprintf("[ICache] ROM cache image is invalid\n");
+        return 0;
+    }
+
+    if (hdr->rc_BuildID != GetBuildID())
+    {
+        kprintf("[ICache] ROM cache image was created by different Emu68 build, ignoring\n");
+        return 0;
+    }
+
+    if (hdr->rc_ROMDigest.a != digest.a || hdr->rc_ROMDigest.b != digest.b ||
+        hdr->rc_ROMDigest.c != digest.c || hdr->rc_ROMDigest.d != digest.d)
+    {
+        kprintf("[ICache] ROM cache image was created for different ROM, ignoring\n");
+        return 0;
+    }
+
+    if (hdr->rc_JIT_CONTROL != __m68k_state->JIT_CONTROL || hdr->rc_JIT_CONTROL2 != __m68k_state->JIT_CONTROL2)
+    {
+        kprintf("[ICache] ROM cache image was created with different JIT settings, ignoring\n");
+        return 0;
+    }
+
+    end = (const uint8_t *)buffer + hdr->rc_Size;
+
+    if (hdr->rc_Size < sizeof(struct ROMCacheHeader) || CalcCRC32((void *)in, (void *)end) != hdr->rc_Checksum)
+    {
+        kprintf("[ICache] ROM cache image is damaged, ignoring\n");
+        return 0;
+    }
+
+    for (uint32_t u=0; u < hdr->rc_UnitCount; u++)
+    {
+        const struct ROMCacheUnit *ru = (const struct ROMCacheUnit *)in;
+
+        if ((uint64_t)(end - in) < sizeof(struct ROMCacheUnit))
+            break;
+
+        uint64_t length = sizeof(struct ROMCacheUnit) + 4 * ((uint64_t)ru->ru_ARMInsnCnt + 1 + ru->ru_RelocCount);
+
+        if (length > (uint64_t)(end - in) || !ValidRelocations(ru))
+        {
+            kprintf("[ICache] ROM cache unit %d is damaged, stopping\n", u);
+            break;
+        }
+
+        in += length;
+
+        if (UnitTable_IsFull(&ICache) || UnitTable_FindAddress(&ICache, ru->ru_M68kAddress) != NULL)
+            continue;
+
+        uint32_t line_length = 4 * (ru->ru_ARMInsnCnt + 1);
+        uint64_t unit_length = ((uint64_t)line_length + 63 + sizeof(struct M68KTranslationUnit)) & ~63ULL;
+
+        if (unit_length > 0xffffffffULL)
+            break;
+
+        struct M68KTranslationUnit *unit = M68K_AllocUnit(unit_length);
+
+        if (unit == NULL)
+            break;
+
+        for (uint32_t i=0; i <= ru->ru_ARMInsnCnt; i++)
+            unit->mt_ARMCode[i] = ru->ru_Data[i];
+
+        /* Point the code back to its own unit */
+        const uint32_t *relocs = &ru->ru_Data[ru->ru_ARMInsnCnt + 1];
+        for (uint32_t r=0; r < ru->ru_RelocCount; r++)
+        {
+            uint32_t *ptr = &unit->mt_ARMCode[relocs[r] & RELOC_OFFSET_MASK];
+
+            if (relocs[r] & RELOC_INLINE_CACHE)
+            {
+                ResetInlineCache((struct M68KInlineCache *)((uintptr_t)ptr - __builtin_offsetof(struct M68KInlineCache, ic_Unit)), unit);
+            }
+            else
+            {
+                ptr[0] = (uint32_t)((uintptr_t)unit >> 32);
+                ptr[1] = (uint32_t)(uintptr_t)unit;
+            }
+        }
+
+        unit->mt_ARMEntryPoint = (void *)((uintptr_t)&unit->mt_ARMCode[0] | JIT_EXEC_ALIAS);
+
+        arm_flush_dcache_for_jit((uintptr_t)&unit->mt_ARMCode[0], line_length);
+        arm_flush_icache_for_jit((uintptr_t)unit->mt_ARMEntryPoint, line_length);
+
+        unit->mt_Epoch = EPOCH;
+        unit->mt_M68kAddress = ru->ru_M68kAddress;
+        unit->mt_M68kLow = ru->ru_M68kLow;
+        unit->mt_M68kHigh = ru->ru_M68kHigh;
+        unit->mt_CRC32 = ru->ru_CRC32;
+        unit->mt_Fingerprint = ru->ru_Fingerprint;
+        unit->mt_PrologueSize = ru->ru_PrologueSize;
+        unit->mt_EpilogueSize = ru->ru_EpilogueSize;
+        unit->mt_Conditionals = ru->ru_Conditionals;
+        unit->mt_M68kInsnCnt = ru->ru_M68kInsnCnt;
+        unit->mt_ARMInsnCnt = ru->ru_ARMInsnCnt;
+        unit->mt_Tier = ru->ru_Tier;
+        unit->mt_UseCount = 0;
+        unit->mt_FetchCount = 0;
+        unit->mt_LocalState = NULL;
+        unit->mt_JIT_CONTROL = hdr->rc_JIT_CONTROL;
+        unit->mt_JIT_CONTROL2 = hdr->rc_JIT_CONTROL2;
+
+        NEWLIST(&unit->mt_ChainIn);
+        NEWLIST(&unit->mt_ChainOut);
+        unit->mt_IndexNode.un_Prev = NULL;
+        unit->mt_ARMIndexNode.un_Prev = NULL;
+
+        ADDTAIL(&LRU, &unit->mt_LRUNode);
+        UnitTable_Insert(&ICache, unit->mt_Epoch, unit->mt_M68kAddress, unit);
+        M68K_IndexUnit(unit);
+
+        __m68k_state->JIT_UNIT_COUNT++;
+        loaded++;
+    }
+
+    __m68k_state->JIT_CACHE_FREE = M68K_CodeCacheFree();
+
+    kprintf("[ICache] Loaded %d of %d ROM units from ROM cache image\n", loaded, hdr->rc_UnitCount);
+
+    return loaded;
+}
@@ -28,7 +28,7 @@ uint8_t SR_GetEALength(uint16_t *insn_stream, uint8_t ea, uint8_t imm_size)
         else if (mode == 6 || (mode == 7 && reg == 3))
         {
             /* Reg- or PC-relative addressing mode */
-            uint16_t brief = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[0]);
+            uint16_t brief = M68K_ReadCode16((uint32_t)(uintptr_t)&insn_stream[0]);
 
             /* Brief word is here */
             word_count++;
@@ -96,7 +96,7 @@ uint8_t SR_GetEALength(uint16_t *insn_stream, uint8_t ea, uint8_t imm_size)
 /* Check if opcode is of branch kind or may result in a branch */
 int M68K_IsBranch(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[0]);
+    uint16_t opcode = M68K_ReadCode16((uint32_t)(uintptr_t)&insn_stream[0]);
 
     if (
         opcode == 0x007c            ||
@@ -128,7 +128,7 @@ int M68K_IsBranch(uint16_t *insn_stream)
 /* Try to follow a branch given by insn_stream pointer. If not possible, return NULL */
 uint16_t *M68K_TryFollowBranch(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)insn_stream++);
+    uint16_t opcode = M68K_ReadCode16((uint32_t)(uintptr_t)insn_stream++);
     
     /* Branch is BRA */
     if ((opcode & 0xff00) == 0x6000) {
@@ -136,12 +136,12 @@ uint16_t *M68K_TryFollowBranch(uint16_t *insn_stream)
         /* use 16-bit offset */
         if ((opcode & 0x00ff) == 0x00)
         {
-            bra_off = (int16_t)(cache_read_16(ICACHE, (uintptr_t)insn_stream));
+            bra_off = (int16_t)(M68K_ReadCode16((uintptr_t)insn_stream));
         }
         /* use 32-bit offset */
         else if ((opcode & 0x00ff) == 0xff)
         {
-            bra_off = (int32_t)(cache_read_32(ICACHE, (uintptr_t)insn_stream));
+            bra_off = (int32_t)(M68K_ReadCode32((uintptr_t)insn_stream));
         }
         else
         /* otherwise use 8-bit offset */
@@ -157,7 +157,7 @@ uint16_t *M68K_TryFollowBranch(uint16_t *insn_stream)
 
 int M68K_GetMoveLength(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[0]);
+    uint16_t opcode = M68K_ReadCode16((uint32_t)(uintptr_t)&insn_stream[0]);
     int size = 0;
     int length = 1;
     uint8_t ea = opcode & 0x3f;
@@ -181,8 +181,8 @@ int M68K_GetMoveLength(uint16_t *insn_stream)
 
 int M68K_GetLineFLength(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[0]);
-    uint16_t opcode2 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]);;
+    uint16_t opcode = M68K_ReadCode16((uint32_t)(uintptr_t)&insn_stream[0]);
+    uint16_t opcode2 = M68K_ReadCode16((uint32_t)(uintptr_t)&insn_stream[1]);;
     int length = 1;
     int need_ea = 0;
     int opsize = 0;
@@ -798,7 +798,7 @@ int M68K_GetLineFLength(uint16_t *insn_stream)
 /* Get number of 16-bit words this instruction occupies */
 int M68K_GetINSNLength(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[0]);
+    uint16_t opcode = M68K_ReadCode16((uint32_t)(uintptr_t)&insn_stream[0]);
     int length = 0;
 
     switch(opcode & 0xf000)
@@ -888,7 +888,7 @@ extern struct M68KState *__m68k_state;
 /* Get the mask of status flags changed by the instruction specified by the opcode */
 uint8_t M68K_GetSRMask(uint16_t *insn_stream)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)insn_stream);
+    uint16_t opcode = M68K_ReadCode16((uint32_t)(uintptr_t)insn_stream);
     uint32_t scan_depth = 0;
     uint32_t max_scan_depth = (__m68k_state->JIT_CONTROL2 >> JC2B_CCR_SCAN_DEPTH) & JC2_CCR_SCAN_MASK;
     uint8_t mask = 0;
@@ -939,11 +939,11 @@ uint8_t M68K_GetSRMask(uint16_t *insn_stream)
                 int32_t branch_offset = (int8_t)(opcode & 0xff);
 
                 if ((opcode & 0xff) == 0) {
-                    branch_offset = (int16_t)cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]);
+                    branch_offset = (int16_t)M68K_ReadCode16((uint32_t)(uintptr_t)&insn_stream[1]);
                 } else if ((opcode & 0xff) == 0xff) {
                     uint16_t lo16, hi16;
-                    hi16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]);
-                    lo16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[2]);
+                    hi16 = M68K_ReadCode16((uint32_t)(uintptr_t)&insn_stream[1]);
+                    lo16 = M68K_ReadCode16((uint32_t)(uintptr_t)&insn_stream[2]);
                     branch_offset = lo16 | (hi16 << 16);
                 }
 
@@ -956,11 +956,11 @@ uint8_t M68K_GetSRMask(uint16_t *insn_stream)
             {
                 if (opcode & 1) {
                     uint16_t lo16, hi16;
-                    hi16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]);
-                    lo16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[2]);
+                    hi16 = M68K_ReadCode16((uint32_t)(uintptr_t)&insn_stream[1]);
+                    lo16 = M68K_ReadCode16((uint32_t)(uintptr_t)&insn_stream[2]);
                     insn_stream = (uint16_t*)(uintptr_t)(lo16 | (hi16 << 16));
                 } else {
-                    insn_stream = (uint16_t*)(uintptr_t)((uint32_t)cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]));
+                    insn_stream = (uint16_t*)(uintptr_t)((uint32_t)M68K_ReadCode16((uint32_t)(uintptr_t)&insn_stream[1]));
                 }
 
                 D(kprintf("[JIT]   %02d: Absolute jump to %08x\n", scan_depth, insn_stream));
@@ -974,12 +974,12 @@ uint8_t M68K_GetSRMask(uint16_t *insn_stream)
                 needed |= mask & (SRCheck[opcode >> 12](opcode) >> 16);
 
                 if ((opcode & 0xff) == 0) {
-                    branch_offset = (int16_t)cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]);
+                    branch_offset = (int16_t)M68K_ReadCode16((uint32_t)(uintptr_t)&insn_stream[1]);
                     insn_stream_2++;
                 } else if ((opcode & 0xff) == 0xff) {
                     uint16_t lo16, hi16;
-                    hi16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[1]);
-                    lo16 = cache_read_16(ICACHE, (uint32_t)(uintptr_t)&insn_stream[2]);
+                    hi16 = M68K_ReadCode16((uint32_t)(uintptr_t)&insn_stream[1]);
+                    lo16 = M68K_ReadCode16((uint32_t)(uintptr_t)&insn_stream[2]);
                     branch_offset = lo16 | (hi16 << 16);
                     insn_stream_2+=2;
                 }
@@ -1003,7 +1003,7 @@ uint8_t M68K_GetSRMask(uint16_t *insn_stream)
                         break;
 
                     /* Get opcode */
-                    opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)insn_stream);
+                    opcode = M68K_ReadCode16((uint32_t)(uintptr_t)insn_stream);
 
                     D(kprintf("[JIT]   %02d.1: opcode=%04x @ %08x ", scan_depth, opcode, insn_stream));
 
@@ -1040,7 +1040,7 @@ uint8_t M68K_GetSRMask(uint16_t *insn_stream)
                         break;
 
                     /* Get opcode */
-                    opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)insn_stream_2);
+                    opcode = M68K_ReadCode16((uint32_t)(uintptr_t)insn_stream_2);
 
                     D(kprintf("[JIT]   %02d.2: opcode=%04x @ %08x ", scan_depth, opcode, insn_stream_2));
 
@@ -1095,7 +1095,7 @@ uint8_t M68K_GetSRMask(uint16_t *insn_stream)
                         break;
 
                     /* Get opcode */
-                    opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)insn_stream);
+                    opcode = M68K_ReadCode16((uint32_t)(uintptr_t)insn_stream);
 
                     uint32_t flags = SRCheck[opcode >> 12](opcode);
                     tmp_sets = flags & 0x1f;
@@ -1130,7 +1130,7 @@ uint8_t M68K_GetSRMask(uint16_t *insn_stream)
                         break;
 
                     /* Get opcode */
-                    opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)insn_stream_2);
+                    opcode = M68K_ReadCode16((uint32_t)(uintptr_t)insn_stream_2);
 
                     uint32_t flags = SRCheck[opcode >> 12](opcode);
                     tmp_sets = flags & 0x1f;
@@ -1169,7 +1169,7 @@ uint8_t M68K_GetSRMask(uint16_t *insn_stream)
         }
         
         /* Get opcode */
-        opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)insn_stream);
+        opcode = M68K_ReadCode16((uint32_t)(uintptr_t)insn_stream);
         D(kprintf("[JIT]   %02d: opcode=%04x @ %08x ", scan_depth, opcode, insn_stream));
 
         uint32_t flags = SRCheck[opcode >> 12](opcode);
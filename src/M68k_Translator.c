@@ -19,6 +19,11 @@
 #include "DuffCopy.h"
 #include "disasm.h"
 #include "cache.h"
+#include "spinlock.h"
+#include "mmu.h"
+#include "JITStats.h"
+#include "JITProfiler.h"
+#include "M68kIR.h"
 
 #if SET_FEATURES_AT_RUNTIME
 features_t Features;
@@ -43,7 +48,9 @@ static inline int globalDisasm() {
     return disasm;
 }
 
-struct List ICache[EMU68_HASHSIZE];
+struct UnitTable ICache;
+struct UnitIndex ICacheRanges;
+static struct UnitIndex ICacheARMRanges;
 struct List LRU;
 static struct M68KLocalState *local_state;
 
@@ -104,7 +111,7 @@ void EMIT_ResetOffsetPC(struct TranslatorContext *)
 
 uint32_t EMIT_lineA(struct TranslatorContext *ctx)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uintptr_t)ctx->tc_M68kCodePtr++);
+    uint16_t opcode = M68K_ReadCode16((uintptr_t)ctx->tc_M68kCodePtr++);
 
     EMIT_FlushPC(ctx);
     if (debug)
@@ -140,7 +147,7 @@ extern struct M68KState *__m68k_state;
 
 static inline uint32_t EmitINSN(struct TranslatorContext *ctx)
 {
-    uint16_t opcode = cache_read_16(ICACHE, (uint32_t)(uintptr_t)ctx->tc_M68kCodePtr);
+    uint16_t opcode = M68K_ReadCode16((uint32_t)(uintptr_t)ctx->tc_M68kCodePtr);
     uint8_t group = opcode >> 12;
 
     host_flags = 0;
@@ -228,12 +235,38 @@ void M68K_ResetReturnStack()
     ReturnStackDepth = 0;
 }
 
+/* Static exits of the unit being translated, handed over to the translation worker */
+static uint32_t Successors[EMU68_ASYNC_JIT_SUCC];
+static uint32_t SuccessorCount = 0;
+
+void M68K_AddSuccessor(uint16_t *m68k_ptr)
+{
+#if EMU68_ASYNC_JIT
+    uint32_t address = (uint32_t)(uintptr_t)m68k_ptr;
+
+    if (address & 1)
+        return;
+
+    for (unsigned i=0; i < SuccessorCount; i++)
+    {
+        if (Successors[i] == address)
+            return;
+    }
+
+    if (SuccessorCount < EMU68_ASYNC_JIT_SUCC)
+        Successors[SuccessorCount++] = address;
+#else
+    (void)m68k_ptr;
+#endif
+}
+
 uint16_t *m68k_high;
 uint16_t *m68k_low;
 uint32_t insn_count;
 uint32_t prologue_size = 0;
 uint32_t epilogue_size = 0;
 uint32_t conditionals_count = 0;
+static uint32_t translation_tier = 1;
 
 void M68K_PrintContext(void *);
 
@@ -247,7 +280,7 @@ uint8_t reg_Load96;
 uint8_t reg_Save96;
 uint32_t val_FPIAR;
 
-void EMIT_LocalExit(struct TranslatorContext *ctx, uint32_t insn_fixup)
+static void EMIT_ExitState(struct TranslatorContext *ctx, uint32_t insn_fixup)
 {
 #if EMU68_INSN_COUNTER
     EMIT(ctx, mov_simd_to_reg(0, CTX_INSN_COUNT));
@@ -277,13 +310,271 @@ void EMIT_LocalExit(struct TranslatorContext *ctx, uint32_t insn_fixup)
             mov_reg_to_simd(REG_FPIAR, 0)
         );
     }
+}
+
+/*
+    Emit return to the main loop which can be later patched to jump directly into the translation
+    unit of the next m68k address. The slot is a nop until M68K_LinkExit replaces it with a branch.
+    If an interrupt is pending, the slot is skipped entirely. Otherwise the address of the slot is
+    left in CTX_EXIT_SLOT for the main loop, followed by a literal with address of the unit owning
+    the slot. The literal is never executed.
+*/
+static void EMIT_ChainSlot(struct TranslatorContext *ctx)
+{
+#if EMU68_CHAIN_UNITS
+    uintptr_t unit = (uintptr_t)ctx->tc_CodeStart - __builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode);
+
+    EMIT(ctx,
+        mov_simd_to_reg(0, CTX_POINTER),
+        ldr64_offset(0, 0, __builtin_offsetof(struct M68KState, INT64)),
+        cbnz_64(0, 4),
+        nop(),
+        adr(0, -4),
+        mov_reg_to_simd(CTX_EXIT_SLOT, 0),
+        bx_lr(),
+        (uint32_t)(unit >> 32),
+        (uint32_t)unit
+    );
+#else
+    EMIT(ctx, bx_lr());
+#endif
+}
+
+#if EMU68_INLINE_CACHE
+/*
+    Put an empty inline cache at current position. The structure is read with 64-bit loads,
+    so it is aligned to 8 bytes.
+*/
+static struct M68KInlineCache *EMIT_InlineCacheData(struct TranslatorContext *ctx)
+{
+    struct M68KInlineCache *ic;
+
+    if ((uintptr_t)ctx->tc_CodePtr & 7)
+        EMIT(ctx, nop());
+
+    ic = (struct M68KInlineCache *)ctx->tc_CodePtr;
+    ctx->tc_CodePtr += sizeof(struct M68KInlineCache) / 4;
+
+    for (int i=0; i < IC_WAYS; i++)
+    {
+        ic->ic_Way[i].ic_M68kPC = IC_INVALID_PC;
+        ic->ic_Way[i].ic_Pad = 0;
+        ic->ic_Way[i].ic_ARMEntry = NULL;
+    }
+    ic->ic_Unit = (struct M68KTranslationUnit *)((uintptr_t)ctx->tc_CodeStart - __builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode));
+    ic->ic_Victim = 0;
+    ic->ic_Pad = 0;
+
+    return ic;
+}
+
+/*
+    Compare PC with both ways of inline cache pointed by x1 and jump to the remembered code on
+    a hit. On a miss leave x1 in CTX_IC_SITE for the main loop and return.
+*/
+static void EMIT_InlineCacheLookup(struct TranslatorContext *ctx)
+{
+    EMIT(ctx,
+        ldr_offset(1, 2, __builtin_offsetof(struct M68KInlineCache, ic_Way[0].ic_M68kPC)),
+        cmp_reg(2, REG_PC, LSL, 0),
+        b_cc(A64_CC_NE, 3),
+        ldr64_offset(1, 3, __builtin_offsetof(struct M68KInlineCache, ic_Way[0].ic_ARMEntry)),
+        br(3),
+        ldr_offset(1, 2, __builtin_offsetof(struct M68KInlineCache, ic_Way[1].ic_M68kPC)),
+        cmp_reg(2, REG_PC, LSL, 0),
+        b_cc(A64_CC_NE, 3),
+        ldr64_offset(1, 3, __builtin_offsetof(struct M68KInlineCache, ic_Way[1].ic_ARMEntry)),
+        br(3),
+        mov_reg_to_simd(CTX_IC_SITE, 1),
+        bx_lr()
+    );
+}
+#endif
+
+/*
+    Emit return from an indirect exit (JMP, JSR). The PC is compared against the targets
+    remembered in a small cache placed directly behind the code. On a hit the code jumps to the
+    remembered ARM entry point, otherwise the address of the cache is left in CTX_IC_SITE so that
+    the main loop can update it once the target unit is known.
+*/
+static void EMIT_InlineCache(struct TranslatorContext *ctx)
+{
+#if EMU68_INLINE_CACHE
+    uint32_t *int_check;
+    uint32_t *site_adr;
+    struct M68KInlineCache *ic;
+
+    EMIT(ctx,
+        mov_simd_to_reg(0, CTX_POINTER),
+        ldr64_offset(0, 0, __builtin_offsetof(struct M68KState, INT64))
+    );
+    int_check = ctx->tc_CodePtr++;
+    site_adr = ctx->tc_CodePtr++;
+
+    EMIT_InlineCacheLookup(ctx);
+
+    /* Pending interrupt goes straight to the final ret */
+    *int_check = cbnz_64(0, ctx->tc_CodePtr - 1 - int_check);
+
+    ic = EMIT_InlineCacheData(ctx);
+    *site_adr = adr(1, 4 * ((uint32_t *)ic - site_adr));
+#else
+    EMIT(ctx, bx_lr());
+#endif
+}
+
+/*
+    Emit return from RTS. If the PC matches the top of the shadow stack, the entry is popped and
+    the inline cache of the call site is used. Otherwise the inline cache of RTS itself is used.
+*/
+static void EMIT_ReturnExit(struct TranslatorContext *ctx)
+{
+#if EMU68_SHADOW_STACK && EMU68_INLINE_CACHE
+    uint32_t *int_check;
+    uint32_t *no_match;
+    uint32_t *site_adr;
+    struct M68KInlineCache *ic;
+    const uint8_t sp_bits = __builtin_ctz(EMU68_SHADOW_STACK_DEPTH * sizeof(struct M68KShadowEntry));
+
+    EMIT(ctx,
+        mov_simd_to_reg(0, CTX_POINTER),
+        ldr64_offset(0, 0, __builtin_offsetof(struct M68KState, INT64))
+    );
+    int_check = ctx->tc_CodePtr++;
+
+    EMIT(ctx,
+        mov_simd_to_reg(0, CTX_SHADOW_SP),
+        ldr_offset(0, 2, __builtin_offsetof(struct M68KShadowEntry, se_M68kPC)),
+        cmp_reg(2, REG_PC, LSL, 0)
+    );
+    no_match = ctx->tc_CodePtr++;
+
+    /* Match - pop the entry and take inline cache of the call site */
+    EMIT(ctx,
+        ldr64_offset(0, 1, __builtin_offsetof(struct M68KShadowEntry, se_Site)),
+        mov_immed_u16(2, IC_INVALID_PC, 0),
+        str_offset(0, 2, __builtin_offsetof(struct M68KShadowEntry, se_M68kPC)),
+        sub64_immed(3, 0, sizeof(struct M68KShadowEntry)),
+        bfi64(0, 3, 0, sp_bits),
+        mov_reg_to_simd(CTX_SHADOW_SP, 0),
+        b(2)
+    );
+
+    *no_match = b_cc(A64_CC_NE, ctx->tc_CodePtr - no_match);
+    site_adr = ctx->tc_CodePtr++;
+
+    EMIT_InlineCacheLookup(ctx);
+
+    *int_check = cbnz_64(0, ctx->tc_CodePtr - 1 - int_check);
+
+    ic = EMIT_InlineCacheData(ctx);
+    *site_adr = adr(1, 4 * ((uint32_t *)ic - site_adr));
+#else
+    EMIT_InlineCache(ctx);
+#endif
+}
 
+/*
+    Push return address of a call which ends the unit onto the shadow stack. Returns location
+    of the adr instruction which has to be pointed to the inline cache of the call site.
+*/
+static uint32_t *EMIT_ShadowPush(struct TranslatorContext *ctx, uint32_t ret_pc)
+{
+#if EMU68_SHADOW_STACK && EMU68_INLINE_CACHE
+    uint32_t *site_adr;
+    const uint8_t sp_bits = __builtin_ctz(EMU68_SHADOW_STACK_DEPTH * sizeof(struct M68KShadowEntry));
+
+    EMIT(ctx,
+        mov_simd_to_reg(0, CTX_SHADOW_SP),
+        add64_immed(1, 0, sizeof(struct M68KShadowEntry)),
+        bfi64(0, 1, 0, sp_bits)
+    );
+    EMIT_LoadImmediate(ctx, 2, ret_pc);
+    site_adr = ctx->tc_CodePtr++;
+    EMIT(ctx,
+        str_offset(0, 2, __builtin_offsetof(struct M68KShadowEntry, se_M68kPC)),
+        str64_offset(0, 1, __builtin_offsetof(struct M68KShadowEntry, se_Site)),
+        mov_reg_to_simd(CTX_SHADOW_SP, 0)
+    );
+
+    return site_adr;
+#else
+    (void)ctx;
+    (void)ret_pc;
+    return NULL;
+#endif
+}
+
+void EMIT_LocalExit(struct TranslatorContext *ctx, uint32_t insn_fixup)
+{
+    EMIT_ExitState(ctx, insn_fixup);
     EMIT(ctx, bx_lr());
 }
 
+/*
+    Local exit to a m68k address known at translation time. Such exit may be chained with the
+    target unit later on.
+*/
+void EMIT_ChainableExit(struct TranslatorContext *ctx, uint32_t insn_fixup)
+{
+    EMIT_ExitState(ctx, insn_fixup);
+    EMIT_ChainSlot(ctx);
+}
+
+struct M68KCodeStream M68K_CodeStream;
+static uint32_t code_stream_fetches;
+
+void M68K_OpenCodeStream()
+{
+    for (int i=0; i < M68K_CODE_BLOCK_COUNT; i++)
+        M68K_CodeStream.cs_Tag[i] = 0xffffffff;
+
+    code_stream_fetches = 0;
+    M68K_CodeStream.cs_Active = 1;
+}
+
+void M68K_CloseCodeStream()
+{
+    M68K_CodeStream.cs_Active = 0;
+}
+
+const uint8_t *M68K_FetchCodeBlock(uint32_t address)
+{
+    uint32_t base = address & ~(M68K_CODE_BLOCK_SIZE - 1);
+    uint32_t slot = (address / M68K_CODE_BLOCK_SIZE) & (M68K_CODE_BLOCK_COUNT - 1);
+    uint128_t *dst = (uint128_t *)(void *)M68K_CodeStream.cs_Data[slot];
+
+    /* Fill whole block with cache lines. The block is aligned to its size and thus never leaves the page */
+    for (int i=0; i < M68K_CODE_BLOCK_SIZE / 16; i++)
+        dst[i] = cache_read_128(ICACHE, base + 16 * i);
+
+    M68K_CodeStream.cs_Tag[slot] = base;
+    code_stream_fetches++;
+
+    return M68K_CodeStream.cs_Data[slot];
+}
+
+uint16_t M68K_ReadCodeSlow16(uint32_t address)
+{
+    return cache_read_16(ICACHE, address);
+}
+
+uint32_t M68K_ReadCodeSlow32(uint32_t address)
+{
+    /* Word pair crossing the block boundary is still taken from the stream */
+    if (M68K_CodeStream.cs_Active && (address & 1) == 0)
+        return ((uint32_t)M68K_ReadCode16(address) << 16) | M68K_ReadCode16(address + 2);
+
+    return cache_read_32(ICACHE, address);
+}
+
 uint16_t * m68k_entry_point;
 uint8_t host_flags;
 
+/* Data was put between the instructions of the unit (debug strings), the peephole pass must not touch it */
+static int code_has_data;
+static uint32_t peephole_removed;
+
 struct DisasmOut {
     uint16_t *do_M68kAddr;
     uint32_t *do_ArmAddr;
@@ -291,9 +582,77 @@ struct DisasmOut {
     uint32_t do_ArmCount;
 } disasm_items[512], *disasm_ptr;
 
+#if EMU68_PEEPHOLE
+static inline uint32_t *PeepholeRemap(uint32_t *ptr, uint32_t *body, uint32_t length, const uint32_t *map)
+{
+    if (ptr < body)
+        return ptr;
+    else if (ptr >= body + length)
+        return ptr - (length - map[length]);
+    else
+        return body + map[ptr - body];
+}
+
+/*
+    Run peephole pass over the body of the unit translated so far, between the prologue and the
+    current end of code. Everything pointing into the body is adjusted: the per instruction map,
+    locations of pending exit fixups and the disassembler output.
+*/
+static void M68K_PeepholeUnit(struct TranslatorContext *ctx, struct List *exitList)
+{
+    uint32_t *body = ctx->tc_CodeStart + prologue_size;
+    uint32_t length = ctx->tc_CodePtr - body;
+    uint32_t *map = tlsf_malloc(tlsf, sizeof(uint32_t) * (length + 1));
+
+    if (map == NULL)
+        return;
+
+    peephole_removed = M68K_Peephole(body, length, RA_TryCTX(ctx), map);
+
+    if (peephole_removed)
+    {
+        struct Node *n;
+
+        for (uint32_t i=0; i < insn_count; i++)
+        {
+            uint32_t off = local_state[i].mls_ARMOffset;
+            if (off >= prologue_size && off <= prologue_size + length)
+                local_state[i].mls_ARMOffset = prologue_size + map[off - prologue_size];
+        }
+
+        ForeachNode(exitList, n)
+        {
+            struct ExitBlock *eb = (struct ExitBlock *)n;
+
+            if (eb->eb_Type == MARKER_DOUBLE_EXIT)
+            {
+                struct DoubleExitBlock *deb = (struct DoubleExitBlock *)n;
+                deb->eb_Fixup1Location = PeepholeRemap(deb->eb_Fixup1Location, body, length, map);
+                deb->eb_Fixup2Location = PeepholeRemap(deb->eb_Fixup2Location, body, length, map);
+            }
+            else
+                eb->eb_FixupLocation = PeepholeRemap(eb->eb_FixupLocation, body, length, map);
+        }
+
+        for (struct DisasmOut *d = disasm_items; d < disasm_ptr; d++)
+        {
+            uint32_t *end = PeepholeRemap(d->do_ArmAddr + d->do_ArmCount, body, length, map);
+            d->do_ArmAddr = PeepholeRemap(d->do_ArmAddr, body, length, map);
+            d->do_ArmCount = end - d->do_ArmAddr;
+        }
+
+        ctx->tc_CodePtr -= peephole_removed;
+    }
+
+    tlsf_free(tlsf, map);
+}
+#endif
+
+/* Exit blocks of the unit being translated, kept here so that an aborted translation can release them */
+static struct List exitList;
+
 static inline uintptr_t M68K_Translate(uint16_t *M68kCodePtr, uint32_t *arm_start, uint32_t *arm_end)
 {
-    struct List exitList;
     m68k_entry_point = M68kCodePtr;
     uint16_t *orig_m68kcodeptr = M68kCodePtr;
     uintptr_t hash = (uintptr_t)M68kCodePtr;
@@ -311,6 +670,10 @@ static inline uintptr_t M68K_Translate(uint16_t *M68kCodePtr, uint32_t *arm_star
     ctx.tc_CodeEnd = arm_end;
     ctx.tc_M68kCodePtr = M68kCodePtr;
     ctx.tc_M68kCodeStart = M68kCodePtr;
+    ctx.tc_KnownMask = 0;
+    ctx.tc_KnownWrites = 0;
+
+    M68K_OpenCodeStream();
 
     uint16_t *last_rev_jump = (uint16_t *)0xffffffff;
 
@@ -319,6 +682,8 @@ static inline uintptr_t M68K_Translate(uint16_t *M68kCodePtr, uint32_t *arm_star
     disasm_ptr = disasm_items;
 
     host_flags = 0;
+    code_has_data = 0;
+    peephole_removed = 0;
     reg_Load96 = 0xff;
     reg_Save96 = 0xff;
     val_FPIAR = 0xffffffff;
@@ -344,7 +709,7 @@ static inline uintptr_t M68K_Translate(uint16_t *M68kCodePtr, uint32_t *arm_star
     M68K_ResetReturnStack();
 
     if (debug) {
-        uint32_t hash_calc = (hash >> EMU68_HASHSHIFT) & EMU68_HASHMASK;
+        uint32_t hash_calc = UnitTable_Hash(&ICache, (uint32_t)hash);
         kprintf("[ICache] Creating new translation unit with hash %04x (m68k code @ %p)\n", hash_calc, (void*)M68kCodePtr);
         if (debug > 1)
             M68K_PrintContext(__m68k_state);
@@ -357,6 +722,7 @@ static inline uintptr_t M68K_Translate(uint16_t *M68kCodePtr, uint32_t *arm_star
     conditionals_count = 0;
 
     insn_count = 0;
+    SuccessorCount = 0;
 
     (void)prologue_size;
     (void)lr_is_saved;
@@ -373,9 +739,48 @@ static inline uintptr_t M68K_Translate(uint16_t *M68kCodePtr, uint32_t *arm_star
         RA_FreeARMRegister(&ctx, reg);
     }
 
+#if EMU68_TIERED_JIT
+    /*
+        Tier 1 units count their entries in mt_UseCount. Once the count reaches the threshold, the
+        unit posts its m68k address to MainLoop which retranslates it with tier 2 settings.
+    */
+    uint32_t tier2_shift = (__m68k_state->JIT_CONTROL2 >> JC2B_TIER2_THRESHOLD) & JC2_TIER2_THRESHOLD_MASK;
+    if (translation_tier == 1 && tier2_shift != 0)
+    {
+        uint8_t base = RA_AllocARMRegister(&ctx);
+        uint8_t cnt = RA_AllocARMRegister(&ctx);
+        uint8_t tmp = RA_AllocARMRegister(&ctx);
+        int32_t unit_offset = -(int32_t)(__builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode) + 4 * (ctx.tc_CodePtr - ctx.tc_CodeStart));
+
+        EMIT(&ctx,
+            adr(base, unit_offset),
+            bic64_immed(base, base, 1, 28, 1),  /* Exec alias of JIT code is read-only, use the writable one */
+            ldr64_offset(base, cnt, __builtin_offsetof(struct M68KTranslationUnit, mt_UseCount)),
+            add64_immed(cnt, cnt, 1),
+            str64_offset(base, cnt, __builtin_offsetof(struct M68KTranslationUnit, mt_UseCount)),
+            mov_immed_u16(tmp, 1 << (tier2_shift & 15), tier2_shift >> 4),
+            cmp64_reg(cnt, tmp, LSL, 0),
+            b_cc(A64_CC_NE, 6),
+            ldr_offset(base, tmp, __builtin_offsetof(struct M68KTranslationUnit, mt_M68kAddress)),
+            mov_simd_to_reg(cnt, CTX_POINTER),
+            str_offset(cnt, tmp, __builtin_offsetof(struct M68KState, JIT_TIER2_PC)),
+            mov_immed_u16(tmp, 1, 0),
+            strb_offset(cnt, tmp, __builtin_offsetof(struct M68KState, INTF.JIT))
+        );
+
+        RA_FreeARMRegister(&ctx, tmp);
+        RA_FreeARMRegister(&ctx, cnt);
+        RA_FreeARMRegister(&ctx, base);
+    }
+#endif
+
     prologue_size = ctx.tc_CodePtr - ctx.tc_CodeStart;
 
     int break_loop = FALSE;
+    int static_exit = TRUE;
+    int indirect_exit = FALSE;
+    int return_exit = FALSE;
+    int call_exit = FALSE;
     int inner_loop = FALSE;
     int soft_break = FALSE;
     int max_rev_jumps = 0;
@@ -386,6 +791,12 @@ static inline uintptr_t M68K_Translate(uint16_t *M68kCodePtr, uint32_t *arm_star
     m68k_low = ctx.tc_M68kCodePtr;
     m68k_high = ctx.tc_M68kCodePtr + 2;
 
+#if EMU68_IR
+    /* IR merges instructions, keep it away from per instruction debugging and CHIP slowdown */
+    int use_ir = (__m68k_state->JIT_CONTROL2 & JC2F_IR) && !(__m68k_state->JIT_CONTROL2 & JC2F_CHIP_SLOWDOWN) &&
+                 debug < 2 && debug_cnt == 0;
+#endif
+
     while (break_loop == FALSE && soft_break == FALSE && insn_count < var_EMU68_M68K_INSN_DEPTH)
     {
         uint16_t insn_consumed;
@@ -418,7 +829,19 @@ static inline uintptr_t M68K_Translate(uint16_t *M68kCodePtr, uint32_t *arm_star
         local_state[insn_count].mls_M68kPtr = ctx.tc_M68kCodePtr;
         local_state[insn_count].mls_PCRel = _pc_rel;
 
-        insn_consumed = EmitINSN(&ctx);
+#if EMU68_IR
+        insn_consumed = use_ir ? M68K_TranslateIR(&ctx, var_EMU68_M68K_INSN_DEPTH - insn_count, orig_m68kcodeptr) : 0;
+        if (insn_consumed == 0)
+#endif
+        {
+#if EMU68_KNOWN_VALUES
+            M68K_PrepareKnownValues(&ctx, in_code);
+            insn_consumed = EmitINSN(&ctx);
+            M68K_UpdateKnownValues(&ctx, in_code, insn_consumed);
+#else
+            insn_consumed = EmitINSN(&ctx);
+#endif
+        }
 
         if (ctx.tc_M68kCodePtr < m68k_low)
             m68k_low = ctx.tc_M68kCodePtr;
@@ -435,6 +858,31 @@ static inline uintptr_t M68K_Translate(uint16_t *M68kCodePtr, uint32_t *arm_star
         {
             ctx.tc_CodePtr--;
             break_loop = TRUE;
+            static_exit = FALSE;
+        }
+        if (ctx.tc_CodePtr[-1] == INSN_TO_LE(MARKER_STOP_LINKABLE))
+        {
+            ctx.tc_CodePtr--;
+            break_loop = TRUE;
+        }
+        if (ctx.tc_CodePtr[-1] == INSN_TO_LE(MARKER_STOP_INDIRECT))
+        {
+            ctx.tc_CodePtr--;
+            break_loop = TRUE;
+            static_exit = FALSE;
+            indirect_exit = TRUE;
+        }
+        if (ctx.tc_CodePtr[-1] == INSN_TO_LE(MARKER_STOP_RETURN))
+        {
+            ctx.tc_CodePtr--;
+            break_loop = TRUE;
+            static_exit = FALSE;
+            return_exit = TRUE;
+        }
+        if (break_loop && ctx.tc_CodePtr[-1] == INSN_TO_LE(MARKER_CALL))
+        {
+            ctx.tc_CodePtr--;
+            call_exit = TRUE;
         }
         if (ctx.tc_CodePtr[-1] == INSN_TO_LE(MARKER_BREAK))
         {
@@ -573,6 +1021,15 @@ static inline uintptr_t M68K_Translate(uint16_t *M68kCodePtr, uint32_t *arm_star
 
     if (orig_m68kcodeptr != ctx.tc_M68kCodePtr) inner_loop = FALSE;
 
+    /* Unit falls through to the next instruction or returns there from a subroutine */
+    if (!inner_loop && ((static_exit && !break_loop) || call_exit))
+        M68K_AddSuccessor(ctx.tc_M68kCodePtr);
+
+#if EMU68_PEEPHOLE
+    if ((__m68k_state->JIT_CONTROL2 & JC2F_PEEPHOLE) && !code_has_data)
+        M68K_PeepholeUnit(&ctx, &exitList);
+#endif
+
     uint32_t *out_code = ctx.tc_CodePtr;
     uint32_t *tmpptr = ctx.tc_CodePtr;
 
@@ -613,7 +1070,31 @@ static inline uintptr_t M68K_Translate(uint16_t *M68kCodePtr, uint32_t *arm_star
         uint32_t *tmpptr = ctx.tc_CodePtr;
         EMIT(&ctx, cbz_64(tmp2, ctx.tc_CodeStart - tmpptr));
     }
-    EMIT(&ctx, bx_lr());
+
+    /* Unit ends with subroutine call, remember where it shall return to */
+    uint32_t *call_site_adr = NULL;
+    if (!inner_loop && call_exit)
+        call_site_adr = EMIT_ShadowPush(&ctx, (uint32_t)(uintptr_t)ctx.tc_M68kCodePtr);
+
+    /* PC after the unit is known at translation time, the exit can be chained */
+    if (!inner_loop && static_exit)
+        EMIT_ChainSlot(&ctx);
+    /* PC computed at runtime, try cached targets first */
+    else if (!inner_loop && indirect_exit)
+        EMIT_InlineCache(&ctx);
+    else if (!inner_loop && return_exit)
+        EMIT_ReturnExit(&ctx);
+    else
+        EMIT(&ctx, bx_lr());
+
+#if EMU68_SHADOW_STACK && EMU68_INLINE_CACHE
+    /* Inline cache of call site, filled with translation of the code at return address */
+    if (call_site_adr != NULL)
+    {
+        struct M68KInlineCache *ic = EMIT_InlineCacheData(&ctx);
+        *call_site_adr = adr(1, 4 * ((uint32_t *)ic - call_site_adr));
+    }
+#endif
     
     uint32_t *_tmpptr = ctx.tc_CodePtr;
     RA_FreeARMRegister(&ctx, tmp2);
@@ -772,7 +1253,16 @@ static inline uintptr_t M68K_Translate(uint16_t *M68kCodePtr, uint32_t *arm_star
         mean = mean / insn_count;
         uint32_t mean_n = mean / 100;
         uint32_t mean_f = mean % 100;
-        kprintf("[ICache]   Mean ARM instructions per m68k instruction: %d.%02d\n", mean_n, mean_f);
+        if (peephole_removed)
+        {
+            uint32_t mean_pre = 100 * (ctx.tc_CodePtr - ctx.tc_CodeStart + peephole_removed - (prologue_size + epilogue_size));
+            mean_pre = mean_pre / insn_count;
+            kprintf("[ICache]   Mean ARM instructions per m68k instruction: %d.%02d (%d.%02d before peephole, %d removed)\n",
+                mean_n, mean_f, mean_pre / 100, mean_pre % 100, peephole_removed);
+        }
+        else
+            kprintf("[ICache]   Mean ARM instructions per m68k instruction: %d.%02d\n", mean_n, mean_f);
+        kprintf("[ICache]   Opcode blocks fetched from ICACHE: %d\n", code_stream_fetches);
     }
 
     if (ctx.tc_CodePtr > ctx.tc_CodeEnd) {
@@ -780,64 +1270,750 @@ static inline uintptr_t M68K_Translate(uint16_t *M68kCodePtr, uint32_t *arm_star
         while(1) asm volatile("wfi");
     }
 
+    M68K_CloseCodeStream();
+
     return (uintptr_t)ctx.tc_CodePtr - (uintptr_t)ctx.tc_CodeStart;
 }
 
+#define JIT_EXEC_ALIAS 0x0000001000000000ULL
+
 /*
-    Verify if the translated code has changed since the unit was created. In order
-    to do this fingerprint and crc32 of the block is compared with the previousy calculated one.
+    Units are indexed twice: by the m68k address range they were translated from, for range
+    invalidations and write faults, and by the range of their AArch64 code, as offset from the
+    JIT base, to find the unit a host PC belongs to.
+*/
+static inline uint32_t M68K_ARMOffset(const void *ptr)
+{
+    extern void *m68k_jit_virt_base;
+    return ((uintptr_t)ptr & ~JIT_EXEC_ALIAS) - (uintptr_t)m68k_jit_virt_base;
+}
 
-    If th sums are not same, the block is removed form LRU cache and hashtable and memory
-    is released.
+void M68K_IndexUnit(struct M68KTranslationUnit *unit)
+{
+    uint32_t arm_low = M68K_ARMOffset(&unit->mt_ARMCode[0]);
 
-    The function returns poitner to verified unit or NULL if the unit changed
+    UnitIndex_Insert(&ICacheRanges, &unit->mt_IndexNode, unit->mt_M68kLow, unit->mt_M68kHigh);
+    UnitIndex_Insert(&ICacheARMRanges, &unit->mt_ARMIndexNode, arm_low, arm_low + 4 * unit->mt_ARMInsnCnt);
+}
+
+void M68K_UnindexUnit(struct M68KTranslationUnit *unit)
+{
+    UnitIndex_Remove(&ICacheRanges, &unit->mt_IndexNode);
+    UnitIndex_Remove(&ICacheARMRanges, &unit->mt_ARMIndexNode);
+}
+
+/*
+    Return the unit which AArch64 code contains given address, either through writable or
+    executable alias of JIT memory. Returns NULL if the address is not in any translated unit.
 */
-struct M68KTranslationUnit *M68K_VerifyUnit(struct M68KTranslationUnit *unit)
+struct M68KTranslationUnit *M68K_FindUnitByARMAddress(const void *arm_pc)
 {
-    if (unit)
-    {
-        uint32_t crc = 0;
+    uint32_t offset = M68K_ARMOffset(arm_pc);
+    struct UnitIndexNode *node;
 
-        /* If JIT settings from the moment of compilation are different than now, the unit is invalid */
-        if (unit->mt_JIT_CONTROL != __m68k_state->JIT_CONTROL ||
-            unit->mt_JIT_CONTROL2 != __m68k_state->JIT_CONTROL2)
-        {
-            REMOVE(&unit->mt_LRUNode);
-            REMOVE(&unit->mt_HashNode);
-            tlsf_free(jit_tlsf, unit);
+    if (offset >= __m68k_state->JIT_CACHE_TOTAL)
+        return NULL;
 
-            __m68k_state->JIT_UNIT_COUNT--;
-            __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+    node = UnitIndex_FindFirst(&ICacheARMRanges, offset, offset + 1);
+    if (node == NULL)
+        return NULL;
 
-            return NULL;
-        }
+    return (void *)((char *)node - __builtin_offsetof(struct M68KTranslationUnit, mt_ARMIndexNode));
+}
 
-        /* Quick path - ROM is always valid as long as we don't use any fancy remapping, at least on Amiga */
-        if (unit->mt_M68kAddress >= 0xf80000 && unit->mt_M68kAddress < 0x1000000) {
-            /* Update EPOCH of the unit */
-            extern uint32_t EPOCH;
-            unit->mt_Epoch = EPOCH;
+#if EMU68_SHADOW_STACK
+/* Ring buffer of return addresses. CTX_SHADOW_SP wraps around within it, hence the alignment */
+static struct M68KShadowEntry ShadowStack[EMU68_SHADOW_STACK_DEPTH]
+    __attribute__((aligned(EMU68_SHADOW_STACK_DEPTH * sizeof(struct M68KShadowEntry))));
+#endif
 
-            /* Move the unit to the beginning of LRU list */
-            REMOVE(&unit->mt_LRUNode);
-            ADDHEAD(&LRU, &unit->mt_LRUNode);
-            return unit;
-        }
+void M68K_ResetShadowStack()
+{
+#if EMU68_SHADOW_STACK
+    for (int i=0; i < EMU68_SHADOW_STACK_DEPTH; i++)
+    {
+        ShadowStack[i].se_M68kPC = IC_INVALID_PC;
+        ShadowStack[i].se_Site = NULL;
+    }
 
-        /* 
-            First check fingerprint - if this one changed then there is no need to calculate CRC32
-            of the whole block.
+    __asm__ volatile("mov "CTX_SHADOW_SP_ASM", %0"::"r"(&ShadowStack[0]));
+#endif
+}
 
-            HOWEVER - calculate fingerprint **only** if CRC32 block would take longer, i.e. block 
-            is larger than 8 bytes!
-        */
-        uint32_t fp = 0;
+static inline int M68K_UnitContains(struct M68KTranslationUnit *unit, uint32_t *ptr)
+{
+    uintptr_t start = (uintptr_t)&unit->mt_ARMCode[0] | JIT_EXEC_ALIAS;
+    uintptr_t end = start + 4 * unit->mt_ARMInsnCnt;
 
-        if (unit->mt_M68kHigh - unit->mt_M68kLow > 8) {
-            fp = cache_read_32(ICACHE, unit->mt_M68kAddress) ^ cache_read_32(ICACHE, unit->mt_M68kAddress + 4);
-        } else {
-            fp = unit->mt_Fingerprint;
-        }
+    return (uintptr_t)ptr >= start && (uintptr_t)ptr < end;
+}
+
+static void M68K_BreakLink(struct M68KChainLink *link)
+{
+    uint32_t *slot = (uint32_t *)((uintptr_t)link->cl_Slot & ~JIT_EXEC_ALIAS);
+
+    if (link->cl_Type == CHAIN_INLINE_CACHE)
+    {
+        /* Inline cache is data, no need to touch instruction cache */
+        slot[0] = IC_INVALID_PC;
+    }
+    else
+    {
+        *slot = nop();
+
+        arm_flush_dcache_for_jit((uintptr_t)slot, 4);
+        arm_flush_icache_for_jit((uintptr_t)link->cl_Slot, 4);
+    }
+
+    REMOVE(&link->cl_OutNode);
+    REMOVE(&link->cl_InNode);
+    tlsf_free(tlsf, link);
+}
+
+/*
+    Patch the exit slot left by previous unit in CTX_EXIT_SLOT with a direct branch to the entry
+    point of the unit which is about to be executed. The unit owning the slot is obtained from the
+    literal which follows the slot. Slots which are not inside of any live unit (e.g. copied epilogue
+    after cache flush), entry points marked for verification and targets out of branch range are
+    silently ignored.
+*/
+void M68K_LinkExit(uint32_t *slot, void *entry)
+{
+    struct M68KTranslationUnit *source;
+    struct M68KTranslationUnit *target;
+    struct M68KChainLink *link;
+    intptr_t distance;
+
+    /* Entry point with a mark in top byte requires verification on each entry - do not link */
+    if (((uintptr_t)entry >> 56) != 0xff)
+        return;
+
+    source = (struct M68KTranslationUnit *)(((uintptr_t)slot[4] << 32) | slot[5]);
+
+    if (!M68K_UnitContains(source, slot) || slot[0] != nop())
+        return;
+
+    distance = (intptr_t)entry - (intptr_t)slot;
+
+    if (distance >= (1LL << 27) || distance < -(1LL << 27))
+        return;
+
+    target = (struct M68KTranslationUnit *)(((uintptr_t)entry & ~JIT_EXEC_ALIAS) - __builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode));
+
+    link = tlsf_malloc(tlsf, sizeof(struct M68KChainLink));
+    if (link == NULL)
+        return;
+
+    link->cl_Slot = slot;
+    link->cl_Type = CHAIN_BRANCH;
+    ADDTAIL(&source->mt_ChainOut, &link->cl_OutNode);
+    ADDTAIL(&target->mt_ChainIn, &link->cl_InNode);
+
+    uint32_t *wslot = (uint32_t *)((uintptr_t)slot & ~JIT_EXEC_ALIAS);
+    *wslot = b(distance >> 2);
+
+    arm_flush_dcache_for_jit((uintptr_t)wslot, 4);
+    arm_flush_icache_for_jit((uintptr_t)slot, 4);
+}
+
+/*
+    Remember the target of an indirect exit which has missed its inline cache. The way to be
+    replaced is selected round-robin, link of the entry which was there before is removed.
+*/
+void M68K_UpdateInlineCache(struct M68KInlineCache *site, uint32_t pc, void *entry)
+{
+    struct M68KTranslationUnit *source = site->ic_Unit;
+    struct M68KTranslationUnit *target;
+    struct M68KInlineCache *wsite;
+    struct M68KChainLink *link;
+    struct Node *n;
+    uint32_t way;
+
+    if (((uintptr_t)entry >> 56) != 0xff)
+        return;
+
+    if (!M68K_UnitContains(source, (uint32_t *)site))
+        return;
+
+    wsite = (struct M68KInlineCache *)((uintptr_t)site & ~JIT_EXEC_ALIAS);
+    way = wsite->ic_Victim;
+    wsite->ic_Victim = (way + 1) % IC_WAYS;
+
+    if (wsite->ic_Way[way].ic_M68kPC != IC_INVALID_PC)
+    {
+        ForeachNode(&source->mt_ChainOut, n)
+        {
+            link = (struct M68KChainLink *)((char *)n - __builtin_offsetof(struct M68KChainLink, cl_OutNode));
+
+            if (link->cl_Slot == &site->ic_Way[way].ic_M68kPC)
+            {
+                M68K_BreakLink(link);
+                break;
+            }
+        }
+    }
+
+    link = tlsf_malloc(tlsf, sizeof(struct M68KChainLink));
+    if (link == NULL)
+        return;
+
+    target = (struct M68KTranslationUnit *)(((uintptr_t)entry & ~JIT_EXEC_ALIAS) - __builtin_offsetof(struct M68KTranslationUnit, mt_ARMCode));
+
+    link->cl_Slot = &site->ic_Way[way].ic_M68kPC;
+    link->cl_Type = CHAIN_INLINE_CACHE;
+    ADDTAIL(&source->mt_ChainOut, &link->cl_OutNode);
+    ADDTAIL(&target->mt_ChainIn, &link->cl_InNode);
+
+    /* Entry point first, the PC makes the way valid */
+    wsite->ic_Way[way].ic_ARMEntry = entry;
+    wsite->ic_Way[way].ic_M68kPC = pc;
+}
+
+/*
+    Remove all links into and out of given unit. Has to be called before the unit is released.
+*/
+void M68K_UnlinkUnit(struct M68KTranslationUnit *unit)
+{
+    struct Node *n;
+    uintptr_t pending;
+
+    while ((n = GETHEAD(&unit->mt_ChainIn)))
+    {
+        M68K_BreakLink((struct M68KChainLink *)((char *)n - __builtin_offsetof(struct M68KChainLink, cl_InNode)));
+    }
+
+    while ((n = GETHEAD(&unit->mt_ChainOut)))
+    {
+        M68K_BreakLink((struct M68KChainLink *)((char *)n - __builtin_offsetof(struct M68KChainLink, cl_OutNode)));
+    }
+
+    /* If the exit slot or inline cache waiting for update belongs to this unit, forget it */
+    __asm__ volatile("mov %0, "CTX_EXIT_SLOT_ASM:"=r"(pending));
+
+    if (M68K_UnitContains(unit, (uint32_t *)pending))
+        __asm__ volatile("mov "CTX_EXIT_SLOT_ASM", xzr");
+
+    __asm__ volatile("mov %0, "CTX_IC_SITE_ASM:"=r"(pending));
+
+    if (M68K_UnitContains(unit, (uint32_t *)pending))
+        __asm__ volatile("mov "CTX_IC_SITE_ASM", xzr");
+
+#if EMU68_SHADOW_STACK
+    /* Return addresses pushed by this unit must not be used anymore */
+    for (int i=0; i < EMU68_SHADOW_STACK_DEPTH; i++)
+    {
+        if (M68K_UnitContains(unit, (uint32_t *)ShadowStack[i].se_Site))
+            ShadowStack[i].se_M68kPC = IC_INVALID_PC;
+    }
+#endif
+}
+
+/*
+    Remove all links between translation units, e.g. when whole cache is flushed
+*/
+void M68K_UnlinkAll()
+{
+    struct Node *n;
+    struct Node *l;
+
+    ForeachNode(&LRU, n)
+    {
+        struct M68KTranslationUnit *u = (struct M68KTranslationUnit *)((char *)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+
+        while ((l = GETHEAD(&u->mt_ChainOut)))
+        {
+            M68K_BreakLink((struct M68KChainLink *)((char *)l - __builtin_offsetof(struct M68KChainLink, cl_OutNode)));
+        }
+    }
+
+    __asm__ volatile("mov "CTX_EXIT_SLOT_ASM", xzr");
+    __asm__ volatile("mov "CTX_IC_SITE_ASM", xzr");
+
+#if EMU68_SHADOW_STACK
+    for (int i=0; i < EMU68_SHADOW_STACK_DEPTH; i++)
+        ShadowStack[i].se_M68kPC = IC_INVALID_PC;
+#endif
+}
+
+#if EMU68_TIERED_JIT
+/*
+    Retranslate hot unit with tier 2 settings: deeper CCR scan, more loop unrolling and longer
+    units. The old unit is taken out of LRU and lookup table first, so that it cannot be evicted
+    while the new one is translated. Once the new unit is in place, all links to the old one are
+    broken and it is released.
+*/
+void M68K_PromoteUnit(uint32_t address)
+{
+    extern uint32_t EPOCH;
+    struct M68KTranslationUnit *unit = UnitTable_FindAddress(&ICache, address);
+
+    /* Unit is gone, already promoted or waiting for verification - nothing to do */
+    if (unit == NULL || unit->mt_Tier != 1 || unit->mt_Epoch != EPOCH ||
+        ((uintptr_t)unit->mt_ARMEntryPoint >> 56) == 0xaa)
+        return;
+
+    /* Translation worker must not see the tier 2 settings */
+    M68K_LockTranslator();
+
+    uint32_t jit_control = __m68k_state->JIT_CONTROL;
+    uint32_t jit_control2 = __m68k_state->JIT_CONTROL2;
+
+    uint32_t insn_depth = (jit_control >> JCCB_INSN_DEPTH) & JCCB_INSN_DEPTH_MASK;
+    if (insn_depth == 0)
+        insn_depth = JCCB_INSN_DEPTH_MASK + 1;
+    if (insn_depth < EMU68_TIER2_INSN_DEPTH)
+        insn_depth = EMU68_TIER2_INSN_DEPTH;
+
+    uint32_t loop_count = (jit_control >> JCCB_LOOP_COUNT) & JCCB_LOOP_COUNT_MASK;
+    if (loop_count == 0)
+        loop_count = JCCB_LOOP_COUNT_MASK + 1;
+    if (loop_count < EMU68_TIER2_LOOP_COUNT)
+        loop_count = EMU68_TIER2_LOOP_COUNT;
+
+    uint32_t ccr_depth = (jit_control2 >> JC2B_CCR_SCAN_DEPTH) & JC2_CCR_SCAN_MASK;
+    if (ccr_depth < EMU68_TIER2_CCR_SCAN_DEPTH)
+        ccr_depth = EMU68_TIER2_CCR_SCAN_DEPTH;
+
+    __m68k_state->JIT_CONTROL &= ~((JCCB_INSN_DEPTH_MASK << JCCB_INSN_DEPTH) | (JCCB_LOOP_COUNT_MASK << JCCB_LOOP_COUNT));
+    __m68k_state->JIT_CONTROL |= (insn_depth & JCCB_INSN_DEPTH_MASK) << JCCB_INSN_DEPTH;
+    __m68k_state->JIT_CONTROL |= (loop_count & JCCB_LOOP_COUNT_MASK) << JCCB_LOOP_COUNT;
+    __m68k_state->JIT_CONTROL2 &= ~(JC2_CCR_SCAN_MASK << JC2B_CCR_SCAN_DEPTH);
+    __m68k_state->JIT_CONTROL2 |= (ccr_depth & JC2_CCR_SCAN_MASK) << JC2B_CCR_SCAN_DEPTH;
+
+    REMOVE(&unit->mt_LRUNode);
+    UnitTable_Remove(&ICache, address);
+    M68K_UnindexUnit(unit);
+
+    translation_tier = 2;
+    struct M68KTranslationUnit *hot = M68K_GetTranslationUnit((uint16_t *)(uintptr_t)address);
+    translation_tier = 1;
+
+    __m68k_state->JIT_CONTROL = jit_control;
+    __m68k_state->JIT_CONTROL2 = jit_control2;
+
+    /* Tier 2 unit is valid as long as base JIT settings do not change */
+    hot->mt_JIT_CONTROL = jit_control;
+    hot->mt_JIT_CONTROL2 = jit_control2;
+    hot->mt_UseCount = unit->mt_UseCount;
+    hot->mt_FetchCount = unit->mt_FetchCount;
+
+    LRU_InvalidateByM68kAddress(address);
+    M68K_UnlinkUnit(unit);
+    M68K_FreeUnit(unit);
+
+    __m68k_state->JIT_UNIT_COUNT--;
+    __m68k_state->JIT_CACHE_FREE = M68K_CodeCacheFree();
+
+    M68K_UnlockTranslator();
+}
+#endif
+
+#if EMU68_BRANCH_PROFILE
+/*
+    Branch profile is a direct mapped table of counters, addressed through CTX_BRANCH_PROFILE
+    lane from the code. Addresses of the branches owning the entries are kept separately, since
+    the JIT code needs only the counters. Colliding branch takes the entry over.
+*/
+static struct M68KBranchProfile BranchProfile[EMU68_BRANCH_PROFILE_SIZE] __attribute__((aligned(64)));
+static uint32_t BranchProfileOwner[EMU68_BRANCH_PROFILE_SIZE];
+
+static inline uint32_t BranchProfileIndex(uint16_t *insn_ptr)
+{
+    return (((uint32_t)(uintptr_t)insn_ptr * 0x9e3779b1) >> 16) & (EMU68_BRANCH_PROFILE_SIZE - 1);
+}
+#endif
+
+void M68K_ResetBranchProfile()
+{
+#if EMU68_BRANCH_PROFILE
+    for (int i=0; i < EMU68_BRANCH_PROFILE_SIZE; i++)
+    {
+        BranchProfile[i].bp_Taken = 0;
+        BranchProfile[i].bp_NotTaken = 0;
+        BranchProfileOwner[i] = 0xffffffff;
+    }
+
+    __asm__ volatile("mov "CTX_BRANCH_PROFILE_ASM", %0"::"r"(&BranchProfile[0]));
+#endif
+}
+
+/*
+    Return direction in which conditional branch at insn_ptr shall be followed. Tier 2
+    translation uses the counters gathered by tier 1 code, if there are enough of them.
+    Otherwise the static guess passed in take_branch is returned.
+*/
+int M68K_PredictBranch(uint16_t *insn_ptr, int take_branch)
+{
+#if EMU68_BRANCH_PROFILE
+    uint32_t idx = BranchProfileIndex(insn_ptr);
+
+    if (translation_tier == 2 && BranchProfileOwner[idx] == (uint32_t)(uintptr_t)insn_ptr)
+    {
+        uint32_t taken = BranchProfile[idx].bp_Taken;
+        uint32_t not_taken = BranchProfile[idx].bp_NotTaken;
+
+        if (taken + not_taken >= EMU68_BRANCH_PROFILE_MIN)
+            return taken > not_taken;
+    }
+#else
+    (void)insn_ptr;
+#endif
+    return take_branch;
+}
+
+/*
+    Count execution of one direction of conditional branch. Emitted in tier 1 code only, tier 2
+    code does not need the counters anymore.
+*/
+void EMIT_BranchProfile(struct TranslatorContext *ctx, uint16_t *insn_ptr, int taken)
+{
+#if EMU68_BRANCH_PROFILE
+    if (translation_tier != 1 || ((__m68k_state->JIT_CONTROL2 >> JC2B_TIER2_THRESHOLD) & JC2_TIER2_THRESHOLD_MASK) == 0)
+        return;
+
+    uint32_t idx = BranchProfileIndex(insn_ptr);
+    uint32_t offset = idx * sizeof(struct M68KBranchProfile);
+
+    if (BranchProfileOwner[idx] != (uint32_t)(uintptr_t)insn_ptr)
+    {
+        BranchProfileOwner[idx] = (uint32_t)(uintptr_t)insn_ptr;
+        BranchProfile[idx].bp_Taken = 0;
+        BranchProfile[idx].bp_NotTaken = 0;
+    }
+
+    if (taken)
+        offset += __builtin_offsetof(struct M68KBranchProfile, bp_Taken);
+    else
+        offset += __builtin_offsetof(struct M68KBranchProfile, bp_NotTaken);
+
+    uint8_t base = RA_AllocARMRegister(ctx);
+    uint8_t cnt = RA_AllocARMRegister(ctx);
+
+    EMIT(ctx,
+        mov_simd_to_reg(base, CTX_BRANCH_PROFILE),
+        ldr_offset(base, cnt, offset),
+        add_immed(cnt, cnt, 1),
+        str_offset(base, cnt, offset)
+    );
+
+    RA_FreeARMRegister(ctx, cnt);
+    RA_FreeARMRegister(ctx, base);
+#else
+    (void)ctx;
+    (void)insn_ptr;
+    (void)taken;
+#endif
+}
+
+static inline int getCPUId()
+{
+    uint64_t cpu_id;
+    __asm__ volatile("mrs %0, MPIDR_EL1":"=r"(cpu_id));
+    return cpu_id & 3;
+}
+
+#if EMU68_WP_SMC
+/*
+    Pages of fast RAM holding m68k code of translated units are made read-only. As long as a page
+    stays protected, the code in it did not change and units translated from it need no CRC check
+    after cache flushes. A write to such page faults and makes the page writable again. Pages
+    written twice, most likely mixing code with data, are not protected anymore.
+*/
+int smc_write_protect = 1;
+
+static uint32_t wp_protected[(1 << 20) / 32];
+static uint32_t wp_written[(1 << 20) / 32];
+static uint32_t wp_excluded[(1 << 20) / 32];
+static struct List DiscardedUnits;
+
+/* Changed every time any page is protected or unprotected */
+static volatile uint32_t wp_generation = 0;
+static uint32_t wp_pages = 0;
+static uint32_t wp_faults = 0;
+static uint32_t wp_discarded = 0;
+static uint32_t wp_verified = 0;
+
+static inline int WP_Test(const uint32_t *map, uint32_t page)
+{
+    return (map[page >> 5] >> (page & 31)) & 1;
+}
+
+static inline void WP_Set(uint32_t *map, uint32_t page)
+{
+    map[page >> 5] |= 1 << (page & 31);
+}
+
+static inline void WP_Clear(uint32_t *map, uint32_t page)
+{
+    map[page >> 5] &= ~(1 << (page & 31));
+}
+
+/* Check if whole m68k code of the unit lies in write protected pages */
+static int M68K_IsUnitProtected(struct M68KTranslationUnit *unit)
+{
+    if (!smc_write_protect || unit->mt_M68kHigh <= unit->mt_M68kLow)
+        return 0;
+
+    for (uint32_t page = unit->mt_M68kLow >> 12; page <= (unit->mt_M68kHigh - 1) >> 12; page++)
+    {
+        if (!WP_Test(wp_protected, page))
+            return 0;
+    }
+
+    return 1;
+}
+
+/* Write protect pages with m68k code of the unit, where possible */
+static void M68K_ProtectUnit(struct M68KTranslationUnit *unit)
+{
+    if (!smc_write_protect || unit->mt_M68kHigh <= unit->mt_M68kLow)
+        return;
+
+    for (uint32_t page = unit->mt_M68kLow >> 12; page <= (unit->mt_M68kHigh - 1) >> 12; page++)
+    {
+        if (WP_Test(wp_protected, page) || WP_Test(wp_excluded, page))
+            continue;
+
+        /* Pages which are not regular RAM, e.g. CHIP memory or ROM, are never tried again */
+        if (mmu_write_protect(page << 12, 1))
+        {
+            WP_Set(wp_protected, page);
+            wp_pages++;
+            wp_generation++;
+        }
+        else
+        {
+            WP_Set(wp_excluded, page);
+        }
+    }
+}
+
+/* The unit may be the one doing the write, it is released later from the main loop */
+static void M68K_DiscardUnit(struct UnitIndexNode *node, void *data)
+{
+    struct M68KTranslationUnit *u = (void *)((char *)node - __builtin_offsetof(struct M68KTranslationUnit, mt_IndexNode));
+
+    (void)data;
+
+    M68K_UnlinkUnit(u);
+    REMOVE(&u->mt_LRUNode);
+    UnitTable_Remove(&ICache, u->mt_M68kAddress);
+    M68K_UnindexUnit(u);
+    LRU_InvalidateByM68kAddress(u->mt_M68kAddress);
+    ADDTAIL(&DiscardedUnits, &u->mt_LRUNode);
+
+    __m68k_state->JIT_UNIT_COUNT--;
+    wp_discarded++;
+}
+
+/*
+    Called from exception handler on write to a page protected by JIT. The page is made writable
+    again. If the write was done by translated code on CPU0, units overlapping the page are thrown
+    away at once. Otherwise the LRU list may be in use by interrupted code, so the page is only
+    excluded from protection and its units are left to CRC verification. Returns 0 if the page
+    was not protected by JIT.
+*/
+int M68K_WriteProtectFault(uint64_t far, uint64_t elr)
+{
+    uint32_t page = far >> 12;
+    int from_jit;
+
+    if ((far >> 32) != 0 || !WP_Test(wp_protected, page))
+        return 0;
+
+    from_jit = getCPUId() == 0 && (elr & JIT_EXEC_ALIAS) &&
+        M68K_ARMOffset((void *)elr) < __m68k_state->JIT_CACHE_TOTAL;
+
+    M68K_LockTranslator();
+
+    /* Other CPU might have been faster */
+    if (WP_Test(wp_protected, page))
+    {
+        mmu_write_protect(page << 12, 0);
+        WP_Clear(wp_protected, page);
+        wp_pages--;
+        wp_faults++;
+        wp_generation++;
+
+        if (!from_jit || WP_Test(wp_written, page))
+            WP_Set(wp_excluded, page);
+        else
+            WP_Set(wp_written, page);
+
+        if (from_jit)
+        {
+            UnitIndex_ForEachOverlap(&ICacheRanges, page << 12, (page + 1) << 12, M68K_DiscardUnit, NULL);
+
+            __asm__ volatile("mov "CTX_LAST_PC_ASM", %w0"::"r"(0xffffffff));
+        }
+    }
+
+    M68K_UnlockTranslator();
+
+    return 1;
+}
+
+/* Free units thrown away by write faults. Called from main loop when no unit is running */
+void M68K_ReleaseDiscardedUnits()
+{
+    struct Node *n;
+
+    if (GETHEAD(&DiscardedUnits) == NULL)
+        return;
+
+    M68K_LockTranslator();
+
+    while ((n = REMHEAD(&DiscardedUnits)))
+    {
+        M68K_FreeUnit((char *)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+    }
+
+    __m68k_state->JIT_CACHE_FREE = M68K_CodeCacheFree();
+
+    M68K_UnlockTranslator();
+}
+#else
+int M68K_WriteProtectFault(uint64_t far, uint64_t elr) { (void)far; (void)elr; return 0; }
+void M68K_ReleaseDiscardedUnits() { }
+#endif
+
+/* Number of M68K_InvalidateRange calls, units translated meanwhile by the worker are checked */
+static volatile uint32_t range_invalidations = 0;
+
+static void M68K_InvalidateUnit(struct UnitIndexNode *node, void *data)
+{
+    struct M68KTranslationUnit *unit = (void *)((char *)node - __builtin_offsetof(struct M68KTranslationUnit, mt_IndexNode));
+
+    (void)data;
+
+#if EMU68_WP_SMC
+    /* Code in write protected page did not change */
+    if (M68K_IsUnitProtected(unit))
+        return;
+#endif
+
+    M68K_UnlinkUnit(unit);
+    LRU_InvalidateByM68kAddress(unit->mt_M68kAddress);
+
+    if (__m68k_state->JIT_CONTROL & JCCF_SOFT)
+    {
+        // Weak cflush. Generate invalid entry address instead of flushing. Fault handler will
+        // verify block checksum and eventually discard it
+        uintptr_t e = (uintptr_t)unit->mt_ARMEntryPoint;
+        e &= 0x00ffffffffffffffULL;
+        e |= 0xaa00000000000000ULL;
+        unit->mt_ARMEntryPoint = (void*)e;
+    }
+    else
+    {
+        REMOVE(&unit->mt_LRUNode);
+        UnitTable_Remove(&ICache, unit->mt_M68kAddress);
+        M68K_UnindexUnit(unit);
+        M68K_FreeUnit(unit);
+
+        __m68k_state->JIT_UNIT_COUNT--;
+    }
+}
+
+/*
+    Throw away units translated from m68k code in range [low, high), e.g. on CINV or CPUSH with
+    line or page scope. Other units stay valid, EPOCH is not changed.
+*/
+void M68K_InvalidateRange(uint32_t low, uint32_t high)
+{
+    M68K_LockTranslator();
+
+    range_invalidations++;
+
+    UnitIndex_ForEachOverlap(&ICacheRanges, low, high, M68K_InvalidateUnit, NULL);
+
+    __m68k_state->JIT_CACHE_FREE = M68K_CodeCacheFree();
+
+    M68K_UnlockTranslator();
+    __asm__ volatile("mov "CTX_LAST_PC_ASM", %w0"::"r"(0xffffffff));
+}
+
+/*
+    Verify if the translated code has changed since the unit was created. In order
+    to do this fingerprint and crc32 of the block is compared with the previousy calculated one.
+
+    If th sums are not same, the block is removed form LRU cache and hashtable and memory
+    is released.
+
+    The function returns poitner to verified unit or NULL if the unit changed
+*/
+struct M68KTranslationUnit *M68K_VerifyUnit(struct M68KTranslationUnit *unit)
+{
+    if (unit)
+    {
+        uint32_t crc = 0;
+
+        /* Unit table, LRU and JIT heap are shared with the translation worker */
+        M68K_LockTranslator();
+
+        /* If JIT settings from the moment of compilation are different than now, the unit is invalid */
+        if (unit->mt_JIT_CONTROL != __m68k_state->JIT_CONTROL ||
+            unit->mt_JIT_CONTROL2 != __m68k_state->JIT_CONTROL2)
+        {
+            M68K_UnlinkUnit(unit);
+            REMOVE(&unit->mt_LRUNode);
+            UnitTable_Remove(&ICache, unit->mt_M68kAddress);
+            M68K_UnindexUnit(unit);
+            M68K_FreeUnit(unit);
+
+            __m68k_state->JIT_UNIT_COUNT--;
+            __m68k_state->JIT_CACHE_FREE = M68K_CodeCacheFree();
+
+            M68K_UnlockTranslator();
+
+            return NULL;
+        }
+
+        /* Quick path - ROM is always valid as long as we don't use any fancy remapping, at least on Amiga */
+        if (unit->mt_M68kAddress >= 0xf80000 && unit->mt_M68kAddress < 0x1000000) {
+            /* Update EPOCH of the unit */
+            extern uint32_t EPOCH;
+            unit->mt_Epoch = EPOCH;
+            UnitTable_SetEpoch(&ICache, unit->mt_M68kAddress, EPOCH);
+
+            /* Move the unit to the beginning of LRU list */
+            REMOVE(&unit->mt_LRUNode);
+            ADDHEAD(&LRU, &unit->mt_LRUNode);
+
+            M68K_UnlockTranslator();
+            return unit;
+        }
+
+#if EMU68_WP_SMC
+        /* Same for code in write protected pages, any write would have thrown the unit away */
+        if (M68K_IsUnitProtected(unit)) {
+            extern uint32_t EPOCH;
+            unit->mt_Epoch = EPOCH;
+            UnitTable_SetEpoch(&ICache, unit->mt_M68kAddress, EPOCH);
+            wp_verified++;
+
+            REMOVE(&unit->mt_LRUNode);
+            ADDHEAD(&LRU, &unit->mt_LRUNode);
+
+            M68K_UnlockTranslator();
+            return unit;
+        }
+#endif
+
+        /* 
+            First check fingerprint - if this one changed then there is no need to calculate CRC32
+            of the whole block.
+
+            HOWEVER - calculate fingerprint **only** if CRC32 block would take longer, i.e. block 
+            is larger than 8 bytes!
+        */
+        uint32_t fp = 0;
+
+        if (unit->mt_M68kHigh - unit->mt_M68kLow > 8) {
+            fp = cache_read_32(ICACHE, unit->mt_M68kAddress) ^ cache_read_32(ICACHE, unit->mt_M68kAddress + 4);
+        } else {
+            fp = unit->mt_Fingerprint;
+        }
 
         /* If FP matches, calculate CRC32 */
         if (fp == unit->mt_Fingerprint)
@@ -848,12 +2024,14 @@ struct M68KTranslationUnit *M68K_VerifyUnit(struct M68KTranslationUnit *unit)
         /* In case of FP or CRC mismatch, remove the unit and reclaim memory */
         if (fp != unit->mt_Fingerprint || crc != unit->mt_CRC32)
         {
+            M68K_UnlinkUnit(unit);
             REMOVE(&unit->mt_LRUNode);
-            REMOVE(&unit->mt_HashNode);
-            tlsf_free(jit_tlsf, unit);
+            UnitTable_Remove(&ICache, unit->mt_M68kAddress);
+            M68K_UnindexUnit(unit);
+            M68K_FreeUnit(unit);
 
             __m68k_state->JIT_UNIT_COUNT--;
-            __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+            __m68k_state->JIT_CACHE_FREE = M68K_CodeCacheFree();
 
             unit = NULL;
         }
@@ -862,16 +2040,19 @@ struct M68KTranslationUnit *M68K_VerifyUnit(struct M68KTranslationUnit *unit)
             /* Update EPOCH of the unit */
             extern uint32_t EPOCH;
             unit->mt_Epoch = EPOCH;
+            UnitTable_SetEpoch(&ICache, unit->mt_M68kAddress, EPOCH);
 
             /* Move the unit to the beginning of LRU list */
             REMOVE(&unit->mt_LRUNode);
             ADDHEAD(&LRU, &unit->mt_LRUNode);
 
-            /* Move the unit to the beginning of bucket - need to check if really important */
-            uint32_t hash = (unit->mt_M68kAddress >> EMU68_HASHSHIFT) & EMU68_HASHMASK;
-            REMOVE(&unit->mt_HashNode);
-            ADDHEAD(&ICache[hash], &unit->mt_HashNode);
+#if EMU68_WP_SMC
+            /* Code is still the same, protect it again if a write made it writable */
+            M68K_ProtectUnit(unit);
+#endif
         }
+
+        M68K_UnlockTranslator();
     }
 
     return unit;
@@ -890,17 +2071,31 @@ struct M68KTranslationUnit *M68K_VerifyUnitCRC32(struct M68KTranslationUnit *uni
 {
     if (unit)
     {
+#if EMU68_WP_SMC
+        if (M68K_IsUnitProtected(unit))
+        {
+            wp_verified++;
+            return unit;
+        }
+#endif
+
         uint32_t crc = CalcCRC32((void *)(uintptr_t)unit->mt_M68kLow, (void*)(uintptr_t)unit->mt_M68kHigh);
 
         /* In case of FP or CRC mismatch, remove the unit and reclaim memory */
         if (crc != unit->mt_CRC32)
         {
+            M68K_LockTranslator();
+
+            M68K_UnlinkUnit(unit);
             REMOVE(&unit->mt_LRUNode);
-            REMOVE(&unit->mt_HashNode);
-            tlsf_free(jit_tlsf, unit);
+            UnitTable_Remove(&ICache, unit->mt_M68kAddress);
+            M68K_UnindexUnit(unit);
+            M68K_FreeUnit(unit);
 
             __m68k_state->JIT_UNIT_COUNT--;
-            __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+            __m68k_state->JIT_CACHE_FREE = M68K_CodeCacheFree();
+
+            M68K_UnlockTranslator();
 
             unit = NULL;
         }
@@ -910,77 +2105,149 @@ struct M68KTranslationUnit *M68K_VerifyUnitCRC32(struct M68KTranslationUnit *uni
 }
 
 /*
-    Get M68K code unit from the instruction cache. Return NULL if code was not found and needs to be
-    translated first.
-
-    If the code was found, update its position in the LRU cache.
+    Throw away up to count least recently used units, e.g. when JIT cache or lookup table is full
 */
-struct M68KTranslationUnit *M68K_GetTranslationUnit(uint16_t *m68kcodeptr)
+static void M68K_EvictUnits(int count, int debug)
 {
-    const uint8_t icnt = ((__m68k_state->JIT_CONTROL >> JCCB_INSN_DEPTH) & JCCB_INSN_DEPTH_MASK) - 1;
-    const uint32_t initial_alloc = sizeof(struct M68KTranslationUnit) + ((uint32_t)icnt + 1) * 256;
-    struct M68KTranslationUnit *unit = NULL;
-    uintptr_t hash = (uintptr_t)m68kcodeptr;
-    uint16_t *orig_m68kcodeptr = m68kcodeptr;
+    uint64_t t0 = JITStat_Clock();
+    int evicted = 0;
 
-    int debug = 0;
+    for (int i=0; i < count; i++) {
+        struct Node *n = REMTAIL(&LRU);
 
-    if ((uint32_t)(uintptr_t)m68kcodeptr >= debug_range_min && (uint32_t)(uintptr_t)m68kcodeptr <= debug_range_max) {
-        debug = globalDebug();
+        if (n == NULL)
+            break;
+
+        struct M68KTranslationUnit *u = (struct M68KTranslationUnit *)((char *)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode));
+        UnitTable_Remove(&ICache, u->mt_M68kAddress);
+        M68K_UnindexUnit(u);
+
+        // Fush the unit from LRU cache in case it was there
+        LRU_InvalidateByM68kAddress(u->mt_M68kAddress);
+
+        if (debug > 0)
+        {    
+            kprintf("[ICache] Run out of cache. Removing least recently used cache line node @ %p\n", (void *)u);
+        }
+        M68K_UnlinkUnit(u);
+        M68K_FreeUnit(u);
+        __m68k_state->JIT_UNIT_COUNT--;
+        evicted++;
     }
+    __m68k_state->JIT_CACHE_FREE = M68K_CodeCacheFree();
 
-    /* Get 16-bit has from the pointer to m68k code */
-    hash = (hash >> EMU68_HASHSHIFT) & EMU68_HASHMASK;
+    if (evicted)
+        JITStat_Time(JS_EVICT, t0);
+}
 
-    if (debug > 2)
-        kprintf("[ICache] GetTranslationUnit(%08x)\n[ICache] Hash: 0x%04x\n", (void*)m68kcodeptr, (int)hash);
+#if EMU68_ASYNC_JIT
+/*
+    Translator keeps its state in globals, so only one CPU may translate at a time. The lock is
+    recursive for the CPU owning it, since M68K_PromoteUnit holds it around M68K_GetTranslationUnit.
+*/
+static spinlock_t translator_lock;
+static volatile int translator_owner = -1;
+static int translator_depth = 0;
+#endif
+
+void M68K_LockTranslator()
+{
+#if EMU68_ASYNC_JIT
+    int cpu = getCPUId();
 
-    /* Create translation unit of size which shall be sufficient */
-    do {
-        /* Allocate as much as you can */
-        unit = tlsf_malloc_aligned(jit_tlsf, initial_alloc, 64);
+    if (translator_owner == cpu)
+    {
+        translator_depth++;
+        return;
+    }
 
-        /* Update free coutner */
-        __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+    spinlock_acquire(&translator_lock);
+    translator_owner = cpu;
+    translator_depth = 1;
+#endif
+}
 
-        if (unit == NULL)
-        {
-            if (debug > 0)
-            {
-                kprintf("[ICache] Requested block was %d bytes long\n", initial_alloc);
-                kprintf("[ICache] JIT cache free: %d kB, total: %d kB\n", __m68k_state->JIT_CACHE_FREE, __m68k_state->JIT_CACHE_TOTAL);
-            }
+/*
+    Take the lock only if it is free. Used by the profiler from IRQ context, where waiting is not
+    possible. Fails also if the current CPU holds the lock, since the data might be half updated.
+*/
+int M68K_TryLockTranslator()
+{
+#if EMU68_ASYNC_JIT
+    if (!spinlock_try_acquire(&translator_lock))
+        return 0;
 
-            for (int i=0; i < 64; i++) {
-                struct Node *n = REMTAIL(&LRU);
+    translator_owner = getCPUId();
+    translator_depth = 1;
+#endif
+    return 1;
+}
 
-                if (n == NULL)
-                    break;
+void M68K_UnlockTranslator()
+{
+#if EMU68_ASYNC_JIT
+    if (--translator_depth == 0)
+    {
+        translator_owner = -1;
+        spinlock_release(&translator_lock);
+        __asm__ volatile("sev");
+    }
+#endif
+}
+
+/* Unit which is being built right now, released if speculative translation faults */
+static struct M68KTranslationUnit *building_unit = NULL;
 
-                void *ptr = (char *)n - __builtin_offsetof(struct M68KTranslationUnit, mt_LRUNode);
-                REMOVE((struct Node *)ptr);
+/*
+    Allocate and translate new unit. The unit is not put in LRU nor in the lookup table. Returns
+    NULL if JIT cache has no space left. Caller has to hold the translator lock.
+*/
+static struct M68KTranslationUnit *M68K_BuildUnit(uint16_t *m68kcodeptr, int debug)
+{
+    extern uint32_t EPOCH;
+    const uint32_t jit_control = __m68k_state->JIT_CONTROL;
+    const uint32_t jit_control2 = __m68k_state->JIT_CONTROL2;
+    const uint32_t epoch = EPOCH;
+    const uint8_t icnt = ((jit_control >> JCCB_INSN_DEPTH) & JCCB_INSN_DEPTH_MASK) - 1;
+    uint32_t initial_alloc = sizeof(struct M68KTranslationUnit) + ((uint32_t)icnt + 1) * 256;
+    struct M68KTranslationUnit *unit;
+
+#if EMU68_PROFILER
+    /* Profiler maps ARM code back to m68k instructions, keep local state after the code */
+    const uint32_t keep_state = prof_rate != 0;
+    if (keep_state)
+        initial_alloc += ((uint32_t)icnt + 1) * 2 * sizeof(struct M68KLocalState);
+#else
+    const uint32_t keep_state = 0;
+#endif
 
-                // Fush the unit from LRU cache in case it was there
-                struct M68KTranslationUnit *u = ptr;
-                LRU_InvalidateByM68kAddress(u->mt_M68kAddress);
+    /* Allocate as much as you can */
+    unit = M68K_AllocUnit(initial_alloc);
 
-                if (debug > 0)
-                {    
-                    kprintf("[ICache] Run out of cache. Removing least recently used cache line node @ %p\n", ptr);
-                }
-                tlsf_free(jit_tlsf, ptr);
-                __m68k_state->JIT_UNIT_COUNT--;
-            }
-            __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
-            
-            __asm__ volatile("mov "CTX_LAST_PC_ASM", %w0"::"r"(0xffffffff));
+    if (unit == NULL)
+    {
+        if (debug > 0)
+        {
+            kprintf("[ICache] Requested block was %d bytes long\n", initial_alloc);
+            kprintf("[ICache] JIT cache free: %d kB, total: %d kB\n", M68K_CodeCacheFree(), __m68k_state->JIT_CACHE_TOTAL);
         }
-    } while(unit == NULL);
+        return NULL;
+    }
+
+    building_unit = unit;
 
+    uint64_t t0 = JITStat_Clock();
+    uint8_t activity = Profiler_Enter(PROF_TRANSLATE);
     uintptr_t line_length = M68K_Translate(m68kcodeptr, &unit->mt_ARMCode[0], &unit->mt_ARMCode[((uint32_t)icnt + 1) * 64]);
+    Profiler_Leave(activity);
+    JITStat_Time(JS_TRANSLATE, t0);
     uintptr_t arm_insn_count = line_length/4 - 1;
 
     uintptr_t unit_length = (line_length + 63 + sizeof(struct M68KTranslationUnit)) & ~63;
+    uintptr_t state_offset = unit_length;
+
+    if (keep_state)
+        unit_length += insn_count * sizeof(struct M68KLocalState);
 
     //kprintf("unit length: %ld, initial alloc: %ld\n", unit_length, initial_alloc);
     if (initial_alloc < unit_length) {
@@ -989,7 +2256,15 @@ struct M68KTranslationUnit *M68K_GetTranslationUnit(uint16_t *m68kcodeptr)
     }
 
     /* Trim the unit to calculated unit length */
-    unit = tlsf_realloc(jit_tlsf, unit, unit_length);
+    unit = M68K_TrimUnit(unit, unit_length);
+    building_unit = unit;
+
+    unit->mt_LocalState = NULL;
+    if (keep_state)
+    {
+        unit->mt_LocalState = (struct M68KLocalState *)((uintptr_t)unit + state_offset);
+        memcpy(unit->mt_LocalState, local_state, insn_count * sizeof(struct M68KLocalState));
+    }
 
     /* Set-up entry point */
     unit->mt_ARMEntryPoint = &unit->mt_ARMCode[0];
@@ -1011,13 +2286,13 @@ struct M68KTranslationUnit *M68K_GetTranslationUnit(uint16_t *m68kcodeptr)
     //m68k_low = (uint16_t *)(((uintptr_t)m68k_low) & ~7);
     //m68k_high = (uint16_t *)(((uintptr_t)m68k_high + 7) & ~7);
 
-    extern uint32_t EPOCH;
-    unit->mt_Epoch = EPOCH;
+    unit->mt_Epoch = epoch;
     unit->mt_M68kInsnCnt = insn_count;
     unit->mt_ARMInsnCnt = arm_insn_count;
+    unit->mt_Tier = translation_tier;
     unit->mt_UseCount = 0;
     unit->mt_FetchCount = 0;
-    unit->mt_M68kAddress = (uint32_t)(uintptr_t)orig_m68kcodeptr;
+    unit->mt_M68kAddress = (uint32_t)(uintptr_t)m68kcodeptr;
     unit->mt_M68kLow = (uint32_t)(uintptr_t)m68k_low;
     unit->mt_M68kHigh = (uint32_t)(uintptr_t)m68k_high;
     unit->mt_Fingerprint = cache_read_32(ICACHE, unit->mt_M68kAddress) ^ cache_read_32(ICACHE, unit->mt_M68kAddress + 4);
@@ -1027,15 +2302,355 @@ struct M68KTranslationUnit *M68K_GetTranslationUnit(uint16_t *m68kcodeptr)
     unit->mt_Conditionals = conditionals_count;
 
     /* Remember settings of JIT for this compiled fragment */
-    unit->mt_JIT_CONTROL = __m68k_state->JIT_CONTROL;
-    unit->mt_JIT_CONTROL2 = __m68k_state->JIT_CONTROL2;
+    unit->mt_JIT_CONTROL = jit_control;
+    unit->mt_JIT_CONTROL2 = jit_control2;
+
+    NEWLIST(&unit->mt_ChainIn);
+    NEWLIST(&unit->mt_ChainOut);
+    unit->mt_IndexNode.un_Prev = NULL;
+    unit->mt_ARMIndexNode.un_Prev = NULL;
+
+    building_unit = NULL;
+
+    return unit;
+}
+
+#if EMU68_ASYNC_JIT
+/*
+    Single producer, single consumer rings between CPU0 and the translation worker. Producer
+    advances aq_Head, consumer advances aq_Tail, both only ever grow.
+*/
+struct AsyncRequest {
+    uint32_t ar_M68kAddress;
+    uint32_t ar_Depth;
+};
+
+struct AsyncResult {
+    struct M68KTranslationUnit *ar_Unit;
+    uint32_t ar_Depth;
+    uint32_t ar_SuccessorCount;
+    uint32_t ar_WPGeneration;
+    uint32_t ar_Invalidations;
+    uint32_t ar_Successors[EMU68_ASYNC_JIT_SUCC];
+};
+
+static struct {
+    volatile uint32_t aq_Head __attribute__((aligned(64)));
+    volatile uint32_t aq_Tail __attribute__((aligned(64)));
+    struct AsyncRequest aq_Slot[EMU68_ASYNC_JIT_QUEUE];
+} RequestQueue;
+
+static struct {
+    volatile uint32_t aq_Head __attribute__((aligned(64)));
+    volatile uint32_t aq_Tail __attribute__((aligned(64)));
+    struct AsyncResult aq_Slot[EMU68_ASYNC_JIT_QUEUE];
+} ResultQueue;
+
+/* Addresses requested recently, so that the same successor is not queued over and over again */
+static struct {
+    uint32_t rr_M68kAddress;
+    uint32_t rr_Epoch;
+} RecentRequests[64];
+
+static volatile int worker_running = 0;
+static volatile int worker_speculating = 0;
+static void *worker_jmpbuf[5];
+
+static uint32_t async_requested = 0;
+static uint32_t async_adopted = 0;
+static uint32_t async_dropped = 0;
+static uint32_t async_faults = 0;
+
+/* Ask the worker to translate successors of a unit. Called on CPU0 only */
+static void M68K_QueueSuccessors(const uint32_t *successors, uint32_t count, uint32_t depth)
+{
+    extern uint32_t EPOCH;
+    uint32_t head = RequestQueue.aq_Head;
+    int queued = 0;
+
+    if (!worker_running)
+        return;
+
+    for (uint32_t i=0; i < count; i++)
+    {
+        uint32_t address = successors[i];
+        uint32_t idx = ((address * 0x9e3779b1) >> 16) & 63;
+
+        if (RecentRequests[idx].rr_M68kAddress == address && RecentRequests[idx].rr_Epoch == EPOCH)
+            continue;
+
+        if (UnitTable_FindAddress(&ICache, address) != NULL)
+            continue;
+
+        /* Queue is full, worker is busy enough */
+        if (head - __atomic_load_n(&RequestQueue.aq_Tail, __ATOMIC_ACQUIRE) >= EMU68_ASYNC_JIT_QUEUE)
+            break;
+
+        RecentRequests[idx].rr_M68kAddress = address;
+        RecentRequests[idx].rr_Epoch = EPOCH;
+
+        RequestQueue.aq_Slot[head % EMU68_ASYNC_JIT_QUEUE].ar_M68kAddress = address;
+        RequestQueue.aq_Slot[head % EMU68_ASYNC_JIT_QUEUE].ar_Depth = depth;
+        head++;
+        queued = 1;
+        async_requested++;
+    }
+
+    if (queued)
+    {
+        __atomic_store_n(&RequestQueue.aq_Head, head, __ATOMIC_RELEASE);
+        __asm__ volatile("sev");
+    }
+}
+
+/*
+    Code might have been changed and flushed while the worker was translating it. Unless no range
+    was invalidated and all of its pages stayed write protected since then, compare the CRC.
+*/
+static inline int M68K_PrefetchedCodeChanged(struct M68KTranslationUnit *unit, struct AsyncResult *r)
+{
+    int trusted = r->ar_Invalidations == range_invalidations;
+
+#if EMU68_WP_SMC
+    if (smc_write_protect)
+        trusted = trusted && r->ar_WPGeneration == wp_generation && M68K_IsUnitProtected(unit);
+#endif
+
+    if (trusted)
+        return 0;
+
+    return CalcCRC32((void *)(uintptr_t)unit->mt_M68kLow, (void *)(uintptr_t)unit->mt_M68kHigh) != unit->mt_CRC32;
+}
+
+/*
+    Put units translated by the worker into LRU and lookup table. Units translated for another
+    epoch or JIT settings, or for addresses which were translated synchronously in the meantime,
+    are thrown away. Called on CPU0 only.
+*/
+void M68K_AdoptPrefetchedUnits()
+{
+    extern uint32_t EPOCH;
+    uint32_t tail = ResultQueue.aq_Tail;
+    uint32_t head = __atomic_load_n(&ResultQueue.aq_Head, __ATOMIC_ACQUIRE);
+
+    if (tail == head)
+        return;
+
+    M68K_LockTranslator();
+
+    while (tail != head)
+    {
+        struct AsyncResult *r = &ResultQueue.aq_Slot[tail % EMU68_ASYNC_JIT_QUEUE];
+        struct M68KTranslationUnit *unit = r->ar_Unit;
+
+        if (unit->mt_Epoch != EPOCH ||
+            unit->mt_JIT_CONTROL != __m68k_state->JIT_CONTROL ||
+            unit->mt_JIT_CONTROL2 != __m68k_state->JIT_CONTROL2 ||
+            UnitTable_IsFull(&ICache) ||
+            UnitTable_FindAddress(&ICache, unit->mt_M68kAddress) != NULL ||
+            M68K_PrefetchedCodeChanged(unit, r))
+        {
+            M68K_FreeUnit(unit);
+            async_dropped++;
+        }
+        else
+        {
+            ADDHEAD(&LRU, &unit->mt_LRUNode);
+            UnitTable_Insert(&ICache, unit->mt_Epoch, unit->mt_M68kAddress, unit);
+            M68K_IndexUnit(unit);
+            __m68k_state->JIT_UNIT_COUNT++;
+            async_adopted++;
+#if EMU68_WP_SMC
+            M68K_ProtectUnit(unit);
+#endif
+
+            if (r->ar_Depth < EMU68_ASYNC_JIT_DEPTH)
+                M68K_QueueSuccessors(r->ar_Successors, r->ar_SuccessorCount, r->ar_Depth + 1);
+        }
+
+        tail++;
+    }
+
+    __atomic_store_n(&ResultQueue.aq_Tail, tail, __ATOMIC_RELEASE);
+    __m68k_state->JIT_CACHE_FREE = M68K_CodeCacheFree();
+
+    M68K_UnlockTranslator();
+
+    /* Code written by the other CPU is about to be executed here */
+    __asm__ volatile("isb");
+}
+
+/*
+    Called from the exception handler. If the worker faulted during speculative translation, e.g.
+    because the code wandered into memory which is accessed through the bus, the translation is
+    abandoned and the worker continues at the point where it has started.
+*/
+static void __attribute__((noreturn, used)) M68K_WorkerRecover()
+{
+    __builtin_longjmp(worker_jmpbuf, 1);
+}
+
+int M68K_TranslationWorkerFault()
+{
+    if (!worker_speculating || getCPUId() != EMU68_ASYNC_JIT_CPU)
+        return 0;
+
+    __asm__ volatile("msr ELR_EL1, %0"::"r"((uintptr_t)M68K_WorkerRecover));
+
+    return 1;
+}
+
+static struct M68KTranslationUnit *M68K_SpeculateUnit(uint32_t address, struct AsyncResult *r)
+{
+    struct M68KTranslationUnit *unit = NULL;
+
+    M68K_LockTranslator();
+
+    r->ar_Invalidations = range_invalidations;
+#if EMU68_WP_SMC
+    r->ar_WPGeneration = wp_generation;
+#endif
+
+    if (__builtin_setjmp(worker_jmpbuf) == 0)
+    {
+        worker_speculating = 1;
+        unit = M68K_BuildUnit((uint16_t *)(uintptr_t)address, 0);
+        worker_speculating = 0;
+
+        r->ar_SuccessorCount = SuccessorCount;
+        for (uint32_t i=0; i < SuccessorCount; i++)
+            r->ar_Successors[i] = Successors[i];
+    }
+    else
+    {
+        worker_speculating = 0;
+        M68K_CloseCodeStream();
+
+        /* Translation stopped half way, bring allocator back to its initial state and release
+           exit blocks collected by the translator so far */
+        RA_Reset();
+
+        struct Node *n;
+        while ((n = REMHEAD(&exitList)))
+            tlsf_free(tlsf, n);
+
+        if (building_unit != NULL)
+        {
+            M68K_FreeUnit(building_unit);
+            building_unit = NULL;
+        }
+        unit = NULL;
+        async_faults++;
+    }
+
+    M68K_UnlockTranslator();
+
+    return unit;
+}
+
+/*
+    Translation worker. Runs on otherwise idle CPU and translates static successors of units
+    created on CPU0 before they are needed. Ready units are returned through ResultQueue.
+*/
+void M68K_TranslationWorker()
+{
+    uint32_t tail = RequestQueue.aq_Tail;
+
+    kprintf("[JIT] Translation worker running on CPU%d\n", getCPUId());
+
+    __atomic_store_n(&worker_running, 1, __ATOMIC_RELEASE);
+
+    while(1)
+    {
+        __asm__ volatile("sevl");
+        while (tail == __atomic_load_n(&RequestQueue.aq_Head, __ATOMIC_ACQUIRE))
+            __asm__ volatile("wfe");
+
+        struct AsyncRequest req = RequestQueue.aq_Slot[tail % EMU68_ASYNC_JIT_QUEUE];
+        __atomic_store_n(&RequestQueue.aq_Tail, ++tail, __ATOMIC_RELEASE);
+
+        /* No space for results, CPU0 did not need the previous ones yet */
+        uint32_t head = ResultQueue.aq_Head;
+        if (head - __atomic_load_n(&ResultQueue.aq_Tail, __ATOMIC_ACQUIRE) >= EMU68_ASYNC_JIT_QUEUE)
+            continue;
+
+        /* Code which is not in ARM memory goes through the bus, leave it to CPU0 */
+        if (mmu_virt2phys(req.ar_M68kAddress) == (uintptr_t)-1)
+            continue;
+
+        struct AsyncResult *r = &ResultQueue.aq_Slot[head % EMU68_ASYNC_JIT_QUEUE];
+        struct M68KTranslationUnit *unit = M68K_SpeculateUnit(req.ar_M68kAddress, r);
+
+        if (unit != NULL)
+        {
+            r->ar_Unit = unit;
+            r->ar_Depth = req.ar_Depth;
+            __atomic_store_n(&ResultQueue.aq_Head, head + 1, __ATOMIC_RELEASE);
+        }
+    }
+}
+#else
+void M68K_AdoptPrefetchedUnits() { }
+int M68K_TranslationWorkerFault() { return 0; }
+#endif
+
+/*
+    Get M68K code unit from the instruction cache. Return NULL if code was not found and needs to be
+    translated first.
+
+    If the code was found, update its position in the LRU cache.
+*/
+struct M68KTranslationUnit *M68K_GetTranslationUnit(uint16_t *m68kcodeptr)
+{
+    struct M68KTranslationUnit *unit = NULL;
+    uint32_t hash = UnitTable_Hash(&ICache, (uint32_t)(uintptr_t)m68kcodeptr);
+
+    int debug = 0;
+
+    if ((uint32_t)(uintptr_t)m68kcodeptr >= debug_range_min && (uint32_t)(uintptr_t)m68kcodeptr <= debug_range_max) {
+        debug = globalDebug();
+    }
+
+    if (debug > 2)
+        kprintf("[ICache] GetTranslationUnit(%08x)\n[ICache] Hash: 0x%04x\n", (void*)m68kcodeptr, (int)hash);
+
+    M68K_LockTranslator();
+
+    /* Make sure there is a free slot in lookup table for the new unit */
+    while (UnitTable_IsFull(&ICache))
+    {
+        M68K_EvictUnits(64, debug);
+        __asm__ volatile("mov "CTX_LAST_PC_ASM", %w0"::"r"(0xffffffff));
+    }
+
+    /* Create translation unit, throw older ones away if there is no space left */
+    while ((unit = M68K_BuildUnit(m68kcodeptr, debug)) == NULL)
+    {
+        if (!M68K_RecycleCodeCache(debug))
+            M68K_EvictUnits(64, debug);
+        __asm__ volatile("mov "CTX_LAST_PC_ASM", %w0"::"r"(0xffffffff));
+    }
+
+    /* Update free coutner */
+    __m68k_state->JIT_CACHE_FREE = M68K_CodeCacheFree();
 
     ADDHEAD(&LRU, &unit->mt_LRUNode);
-    ADDHEAD(&ICache[hash], &unit->mt_HashNode);
+    UnitTable_Insert(&ICache, unit->mt_Epoch, unit->mt_M68kAddress, unit);
+    M68K_IndexUnit(unit);
 
     __m68k_state->JIT_UNIT_COUNT++;
     __m68k_state->JIT_CACHE_MISS++;
 
+#if EMU68_WP_SMC
+    M68K_ProtectUnit(unit);
+#endif
+
+#if EMU68_ASYNC_JIT
+    /* Code following this unit is most likely needed soon, let the worker translate it */
+    if (translation_tier == 1)
+        M68K_QueueSuccessors(Successors, SuccessorCount, 1);
+#endif
+
     if (debug) {
         kprintf("[ICache]   Block checksum: %08x, Fingerprint: %08x\n", unit->mt_CRC32, unit->mt_Fingerprint);
         kprintf("[ICache]   ARM code at %p\n", unit->mt_ARMEntryPoint);
@@ -1072,6 +2687,8 @@ struct M68KTranslationUnit *M68K_GetTranslationUnit(uint16_t *m68kcodeptr)
         }
     }
 
+    M68K_UnlockTranslator();
+
     return unit;
 }
 
@@ -1081,17 +2698,21 @@ void M68K_InitializeCache()
 
     kprintf("[ICache] Setting up LRU\n");
     NEWLIST(&LRU);
+#if EMU68_WP_SMC
+    NEWLIST(&DiscardedUnits);
+#endif
 
     kprintf("[ICache] Setting up ICache\n");
 
 //    temporary_arm_code = tlsf_malloc(jit_tlsf, (JCCB_INSN_DEPTH_MASK + 1) * 16 * 64);
-    __m68k_state->JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+    __m68k_state->JIT_CACHE_FREE = M68K_CodeCacheFree();
 //    kprintf("[ICache] Temporary code at %p\n", temporary_arm_code);
+    M68K_InitCodeCache();
     local_state = tlsf_malloc(tlsf, sizeof(struct M68KLocalState)*(JCCB_INSN_DEPTH_MASK + 1)*2);
-    kprintf("[ICache] ICache array at %p\n", ICache);
-
-    for (int i=0; i < 65536; i++)
-        NEWLIST(&ICache[i]);
+    UnitTable_Init(&ICache, EMU68_HASHSIZE);
+    UnitIndex_Init(&ICacheRanges, EMU68_HASHSIZE / 16);
+    UnitIndex_Init(&ICacheARMRanges, EMU68_HASHSIZE / 16);
+    kprintf("[ICache] ICache table at %p, %d slots\n", ICache.ut_Slots, ICache.ut_Mask + 1);
 }
 
 void M68K_DumpStats()
@@ -1135,6 +2756,39 @@ void M68K_DumpStats()
     mean_n = mean / 100;
     mean_f = mean % 100;
     kprintf("[ICache] Mean total ARM instructions per m68k instruction: %d.%02d\n", mean_n, mean_f);
+
+    if (ICache.ut_Lookups)
+    {
+        mean = (100 * ICache.ut_Probes) / ICache.ut_Lookups;
+        kprintf("[ICache] Lookup table: %d of %d slots used, %lld lookups, mean probe length %d.%02d, max %d\n",
+            ICache.ut_Count, ICache.ut_Mask + 1, ICache.ut_Lookups, mean / 100, mean % 100, ICache.ut_MaxProbe);
+    }
+
+    if (range_invalidations)
+    {
+        kprintf("[ICache] Line and page invalidations: %d, %d units indexed by address range\n",
+            range_invalidations, ICacheRanges.ui_Count);
+    }
+
+    M68K_DumpCodeCacheStats();
+    JITStat_Print();
+    Profiler_Print();
+
+#if EMU68_WP_SMC
+    if (smc_write_protect)
+    {
+        kprintf("[ICache] Write protection: %d pages protected, %d write faults, %d units discarded, %d verified without CRC\n",
+            wp_pages, wp_faults, wp_discarded, wp_verified);
+    }
+#endif
+
+#if EMU68_ASYNC_JIT
+    if (worker_running)
+    {
+        kprintf("[ICache] Translation worker: %d requested, %d adopted, %d dropped, %d faulted\n",
+            async_requested, async_adopted, async_dropped, async_faults);
+    }
+#endif
 }
 
 void EMIT_InjectPrintContext(struct TranslatorContext *ctx)
@@ -1200,6 +2854,7 @@ void EMIT_InjectDebugStringV(struct TranslatorContext *ctx, const char * restric
     EMIT(ctx, str64_offset(31, 30, 240));
 
     tmpptr = ctx->tc_CodePtr;
+    code_has_data = 1;
     
     EMIT(ctx, 
         adr(0, 48),
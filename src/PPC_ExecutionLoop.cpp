@@ -38,7 +38,7 @@ __attribute__((aligned(4096))) uint8_t ppc_tmp_stack[65536];
 __attribute__((aligned(4096))) 
 #include "ppc_rom.h"
 
-Emu68::List<PPCTranslationUnit> ICache[EMU68_HASHSIZE] __attribute__((aligned(256)));
+UnitTable ICache;
 Emu68::List<TranslationUnitLRU> LRU;
 extern TLSF jit_ppc;
 extern PPCTranslatorContext local_translator;
@@ -164,37 +164,17 @@ static inline uint32_t * FindUnitQuick()
         return code;
 #endif
 
-    union {
-        struct {
-            uint32_t    ptu_Epoch;          /* 16: 2 x 4 bytes - first 32-bit epoch incremented after every cache flush */
-            uint32_t    ptu_PPCAddress;     /*                   followed by 32-bit PPC entry address */
-        };
-        uint64_t        ptu_Key;            /*     1 x 8 bytes - match key, the two above combined */
-    } u;
+    auto node = static_cast<PPCTranslationUnit *>(UnitTable_Find(&ICache, GET_EPOCH(), PC));
 
-    u.ptu_Epoch = GET_EPOCH();
-    u.ptu_PPCAddress = PC;
-
-    uint64_t key = u.ptu_Key;
-
-    /* Perform search */
-    uint32_t hash = (PC >> EMU68_HASHSHIFT) & EMU68_HASHMASK;
-    Emu68::List<PPCTranslationUnit> &bucket = ICache[hash];
-
-    /* Go through the list of translated units */
-    for(auto node: bucket)
+    if (likely(node != nullptr))
     {
-        /* Check if unit is found */
-        if (node->ptu_Key == key)
-        {
-            /* Tell CPU we are going to execute the code soon, give it time to prefetch eventually */
-            asm volatile ("prfm plil1keep, [%0]"::"r"(node->ptu_ARMEntryPoint));
+        /* Tell CPU we are going to execute the code soon, give it time to prefetch eventually */
+        asm volatile ("prfm plil1keep, [%0]"::"r"(node->ptu_ARMEntryPoint));
 
 #if EMU68_USE_LRU
-            cache.insertBlock(node->ptu_PPCAddress, (uint32_t*)node->ptu_ARMEntryPoint);
+        cache.insertBlock(node->ptu_PPCAddress, (uint32_t*)node->ptu_ARMEntryPoint);
 #endif
-            return (uint32_t *)(node->ptu_ARMEntryPoint);
-        }
+        return (uint32_t *)(node->ptu_ARMEntryPoint);
     }
 
     return nullptr;
@@ -327,20 +307,12 @@ void PPCMainLoop()
             uint32_t copyPC = getCTX()->PC;
 
             /* Perform search without testing Epoch */
-            PPCTranslationUnit *node = nullptr;
-            uint32_t hash = (copyPC >> EMU68_HASHSHIFT) & EMU68_HASHMASK;
-            auto bucket = &ICache[hash];
+            auto node = static_cast<PPCTranslationUnit *>(UnitTable_FindAddress(&ICache, copyPC));
 
-            /* Go through the list of translated units */
-            for(auto n: *bucket)
+            if (node != nullptr)
             {
-                /* Check if unit is found */
-                if (n->ptu_PPCAddress == copyPC)
-                {
-                    /* Node found, most likely Epoch broken */
-                    node = ppcVerifyUnit(n);
-                    break;
-                }
+                /* Node found, most likely Epoch broken */
+                node = ppcVerifyUnit(node);
             }
 
             if (node == NULL) {
@@ -382,7 +354,8 @@ extern "C" void InitPPC()
     Emu68::PPC::local_translator.tc_CodeStart = (uint32_t *)Emu68::PPC::jit_ppc.malloc((JCCB_INSN_DEPTH_MASK + 1) * 16 * 64);
     kprintf("[PPC] Temporary code at %p\n", Emu68::PPC::local_translator.tc_CodeStart);
     Emu68::PPC::local_state = (struct Emu68::PPC::PPCLocalState *)tlsf_malloc(tlsf, sizeof(Emu68::PPC::PPCLocalState)*(JCCB_INSN_DEPTH_MASK + 1)*2);
-    kprintf("[PPC] ICache array at %p\n", Emu68::PPC::ICache);
+    UnitTable_Init(&Emu68::PPC::ICache, EMU68_HASHSIZE);
+    kprintf("[PPC] ICache table at %p, %d slots\n", Emu68::PPC::ICache.ut_Slots, Emu68::PPC::ICache.ut_Mask + 1);
 
     kprintf("[PPC] Mapping PPC ROM at 0x%08x - 0x%08x\n", 0xfff00000, 0xfff00000 + Emu68::PPC::ppc_rom_img_len - 1);
     kprintf("[PPC] Mapping PPC boot stack at 0x%08x - 0x%08x\n", 0xfff00000 - sizeof(Emu68::PPC::ppc_tmp_stack), 0xfff00000 - 1);
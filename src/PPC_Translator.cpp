@@ -46,7 +46,7 @@ TLSF jit_ppc(ppc_jit_virt_base, dt_get_property_value_u32(dt_find_node("/emu68")
 PPCTranslatorContext local_translator;
 ReturnStack return_stack;
 
-extern List<PPCTranslationUnit> ICache[EMU68_HASHSIZE];
+extern UnitTable ICache;
 extern List<TranslationUnitLRU> LRU;
 
 PPCLocalState *local_state;
@@ -1495,7 +1495,7 @@ static inline uintptr_t PPC_Translate(uint32_t *PPCCodePtr, uint32_t *InsnCount)
     return_stack.reset();
 
     if (debug) {
-        uint32_t hash_calc = (hash >> EMU68_HASHSHIFT) & EMU68_HASHMASK;
+        uint32_t hash_calc = UnitTable_Hash(&ICache, (uint32_t)hash);
         kprintf("[PPC] Creating new translation unit with hash %04x (PPC code @ %p)\n", hash_calc, (void*)PPCCodePtr);
     }
 
@@ -1825,6 +1825,31 @@ static inline uintptr_t PPC_Translate(uint32_t *PPCCodePtr, uint32_t *InsnCount)
     return (uintptr_t)local_translator.tc_CodePtr - (uintptr_t)local_translator.tc_CodeStart;
 }
 
+/*
+    Throw away up to count least recently used units, e.g. when JIT cache or lookup table is full
+*/
+static void ppcEvictUnits(int count, int debug)
+{
+    struct PPCState *ctx = GET_HOST_CTX();
+
+    for (int i=0; i < count; i++) {
+        auto n = LRU.remTail()->unit;
+
+        if (n == nullptr)
+            break;
+
+        UnitTable_Remove(&ICache, n->ptu_PPCAddress);
+        if (debug > 0)
+        {    
+            kprintf("[PPC] Run out of cache. Removing least recently used cache line node @ %p\n", n);
+        }
+
+        jit_ppc.free(n);
+        ctx->JIT_UNIT_COUNT--;
+    }
+    ctx->JIT_CACHE_FREE = jit_ppc.free_size();
+}
+
 /*
     Get PPC code unit from the instruction cache. Return NULL if code was not found and needs to be
     translated first.
@@ -1835,7 +1860,7 @@ PPCTranslationUnit *PPC_GetTranslationUnit(uint32_t *ppccodeptr)
 {
     struct PPCState *ctx = GET_HOST_CTX();
     PPCTranslationUnit *unit = nullptr;
-    uintptr_t hash = (uintptr_t)ppccodeptr;
+    uint32_t hash = UnitTable_Hash(&ICache, (uint32_t)(uintptr_t)ppccodeptr);
     uint32_t *orig_ppccodeptr = ppccodeptr;
     uint64_t time_start, time_end;
 
@@ -1845,12 +1870,16 @@ PPCTranslationUnit *PPC_GetTranslationUnit(uint32_t *ppccodeptr)
         debug = globalDebug();
     }
 
-    /* Get 16-bit has from the pointer to PPC code */
-    hash = (hash >> EMU68_HASHSHIFT) & EMU68_HASHMASK;
-
     if (debug > 2)
         kprintf("[PPC] GetTranslationUnit(%08x)\n[PPC] Hash: 0x%04x\n", (void*)ppccodeptr, (int)hash);
 
+    /* Make sure there is a free slot in lookup table for the new unit */
+    while (UnitTable_IsFull(&ICache))
+    {
+        ppcEvictUnits(8, debug);
+        __asm__ volatile("mov " CTX_LAST_PC_ASM ", %w0"::"r"(0xffffffff));
+    }
+
     asm volatile("mrs %0, CNTPCT_EL0":"=r"(time_start));
     uint32_t insn_count = 0;
     uintptr_t line_length = PPC_Translate(ppccodeptr, &insn_count);
@@ -1869,22 +1898,7 @@ PPCTranslationUnit *PPC_GetTranslationUnit(uint32_t *ppccodeptr)
                 kprintf("[PPC] Requested block was %d bytes long\n", sizeof(PPCTranslationUnit));
             }
 
-            for (int i=0; i < 8; i++) {
-                auto n = LRU.remTail()->unit;
-
-                if (n == nullptr)
-                    break;
-
-                n->remove();
-                if (debug > 0)
-                {    
-                    kprintf("[PPC] Run out of cache. Removing least recently used cache line node @ %p\n", n);
-                }
-
-                jit_ppc.free(n);
-                ctx->JIT_UNIT_COUNT--;
-            }
-            ctx->JIT_CACHE_FREE = jit_ppc.free_size();
+            ppcEvictUnits(8, debug);
             
             __asm__ volatile("mov " CTX_LAST_PC_ASM ", %w0"::"r"(0xffffffff));
         }
@@ -1933,7 +1947,7 @@ PPCTranslationUnit *PPC_GetTranslationUnit(uint32_t *ppccodeptr)
 
     unit->ptu_LRU.unit = unit;
     LRU.addHead(&unit->ptu_LRU);
-    ICache[hash].addHead(unit);
+    UnitTable_Insert(&ICache, unit->ptu_Epoch, unit->ptu_PPCAddress, unit);
 
     ctx->JIT_UNIT_COUNT++;
     ctx->JIT_CACHE_MISS++;
@@ -2000,6 +2014,7 @@ PPCTranslationUnit *ppcVerifyUnit(PPCTranslationUnit *unit)
         if (unit->ptu_PPCAddress >= 0xfff00000 && unit->ptu_PPCAddress < 0xffff0000) {
             /* Update EPOCH of the unit */
             unit->ptu_Epoch = GET_EPOCH();
+            UnitTable_SetEpoch(&ICache, unit->ptu_PPCAddress, unit->ptu_Epoch);
 
             /* Move the unit to the beginning of LRU list */
             unit->ptu_LRU.remove();
@@ -2024,7 +2039,7 @@ PPCTranslationUnit *ppcVerifyUnit(PPCTranslationUnit *unit)
         if (fp != unit->ptu_Fingerprint || crc != unit->ptu_CRC32)
         {
             auto ctx = GET_HOST_CTX();
-            unit->remove();
+            UnitTable_Remove(&ICache, unit->ptu_PPCAddress);
             unit->ptu_LRU.remove();
             jit_ppc.free(unit);
 
@@ -2037,6 +2052,7 @@ PPCTranslationUnit *ppcVerifyUnit(PPCTranslationUnit *unit)
         {
             /* Update EPOCH of the unit */
             unit->ptu_Epoch = GET_EPOCH();
+            UnitTable_SetEpoch(&ICache, unit->ptu_PPCAddress, unit->ptu_Epoch);
 
             /* Move the unit to the beginning of LRU list */
             unit->ptu_LRU.remove();
@@ -0,0 +1,139 @@
+/*
+    Copyright © 2019-2025 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "support.h"
+#include "tlsf.h"
+#include "UnitIndex.h"
+
+void UnitIndex_Init(struct UnitIndex *idx, uint32_t size)
+{
+    extern void *tlsf;
+
+    /* Size has to be a power of two */
+    if (size & (size - 1))
+        size = 1 << (32 - __builtin_clz(size));
+
+    idx->ui_Buckets = tlsf_malloc_aligned(tlsf, size * sizeof(struct UnitIndexNode *), 64);
+    idx->ui_Mask = size - 1;
+    idx->ui_Shift = __builtin_clz(size) + 1;
+
+    UnitIndex_Clear(idx);
+}
+
+/* Forget all nodes. The nodes themselves are not touched */
+void UnitIndex_Clear(struct UnitIndex *idx)
+{
+    for (uint32_t i=0; i <= idx->ui_Mask; i++)
+        idx->ui_Buckets[i] = NULL;
+
+    idx->ui_Count = 0;
+    idx->ui_MaxSpan = 0;
+}
+
+void UnitIndex_Insert(struct UnitIndex *idx, struct UnitIndexNode *node, uint32_t low, uint32_t high)
+{
+    uint32_t page = low >> UNITINDEX_PAGE_SHIFT;
+    uint32_t span = 0;
+    struct UnitIndexNode **head = &idx->ui_Buckets[UnitIndex_Hash(idx, page)];
+
+    if (high > low)
+        span = ((high - 1) >> UNITINDEX_PAGE_SHIFT) - page;
+
+    if (span > idx->ui_MaxSpan)
+        idx->ui_MaxSpan = span;
+
+    node->un_Low = low;
+    node->un_High = high;
+    node->un_Next = *head;
+    node->un_Prev = head;
+
+    if (*head)
+        (*head)->un_Prev = &node->un_Next;
+    *head = node;
+
+    idx->ui_Count++;
+}
+
+void UnitIndex_Remove(struct UnitIndex *idx, struct UnitIndexNode *node)
+{
+    if (node->un_Prev == NULL)
+        return;
+
+    *node->un_Prev = node->un_Next;
+    if (node->un_Next)
+        node->un_Next->un_Prev = node->un_Prev;
+
+    node->un_Next = NULL;
+    node->un_Prev = NULL;
+
+    idx->ui_Count--;
+}
+
+/*
+    Call func for every node overlapping [low, high). The function may remove the node it was
+    called for from the index. Returns number of overlapping nodes.
+*/
+uint32_t UnitIndex_ForEachOverlap(struct UnitIndex *idx, uint32_t low, uint32_t high, UnitIndexFunc func, void *data)
+{
+    uint32_t count = 0;
+    uint32_t first, last;
+
+    if (high <= low)
+        return 0;
+
+    last = (high - 1) >> UNITINDEX_PAGE_SHIFT;
+    first = low >> UNITINDEX_PAGE_SHIFT;
+    first = first > idx->ui_MaxSpan ? first - idx->ui_MaxSpan : 0;
+
+    for (uint32_t page = first; page <= last; page++)
+    {
+        struct UnitIndexNode *node = idx->ui_Buckets[UnitIndex_Hash(idx, page)];
+
+        while (node)
+        {
+            struct UnitIndexNode *next = node->un_Next;
+
+            if ((node->un_Low >> UNITINDEX_PAGE_SHIFT) == page && node->un_Low < high && node->un_High > low)
+            {
+                count++;
+                if (func)
+                    func(node, data);
+            }
+
+            node = next;
+        }
+    }
+
+    return count;
+}
+
+/* Return first node found overlapping [low, high), NULL if there is none */
+struct UnitIndexNode *UnitIndex_FindFirst(struct UnitIndex *idx, uint32_t low, uint32_t high)
+{
+    uint32_t first, last;
+
+    if (high <= low)
+        return NULL;
+
+    last = (high - 1) >> UNITINDEX_PAGE_SHIFT;
+    first = low >> UNITINDEX_PAGE_SHIFT;
+    first = first > idx->ui_MaxSpan ? first - idx->ui_MaxSpan : 0;
+
+    /* Search from the last page down, nodes starting closer to the range are more likely to overlap */
+    for (uint32_t page = last + 1; page-- > first; )
+    {
+        for (struct UnitIndexNode *node = idx->ui_Buckets[UnitIndex_Hash(idx, page)]; node; node = node->un_Next)
+        {
+            if ((node->un_Low >> UNITINDEX_PAGE_SHIFT) == page && node->un_Low < high && node->un_High > low)
+                return node;
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,135 @@
+/*
+    Copyright © 2019-2025 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include "support.h"
+#include "tlsf.h"
+#include "UnitTable.h"
+
+void UnitTable_Init(struct UnitTable *t, uint32_t size)
+{
+    extern void *tlsf;
+
+    /* Size has to be a power of two */
+    if (size & (size - 1))
+        size = 1 << (32 - __builtin_clz(size));
+
+    t->ut_Slots = tlsf_malloc_aligned(tlsf, size * sizeof(struct UnitTableSlot), 64);
+    t->ut_Mask = size - 1;
+    t->ut_Shift = __builtin_clz(size) + 1;
+    t->ut_Count = 0;
+
+    /* Keep load factor below 7/8, the probe sequences grow quickly above that */
+    t->ut_Limit = size - size / 8;
+
+    for (uint32_t i=0; i < size; i++)
+    {
+        t->ut_Slots[i].us_Key = 0;
+        t->ut_Slots[i].us_Unit = NULL;
+    }
+
+    UnitTable_ResetStats(t);
+}
+
+void UnitTable_ResetStats(struct UnitTable *t)
+{
+    t->ut_Lookups = 0;
+    t->ut_Probes = 0;
+    t->ut_MaxProbe = 0;
+}
+
+/*
+    Insert unit into the table. Returns 0 if the table is full, in that case some units
+    have to be removed first.
+*/
+int UnitTable_Insert(struct UnitTable *t, uint32_t epoch, uint32_t address, void *unit)
+{
+    uint32_t idx = UnitTable_Hash(t, address);
+
+    while (t->ut_Slots[idx].us_Unit != NULL)
+    {
+        /* Address already known - replace the entry */
+        if (t->ut_Slots[idx].us_Address == address)
+        {
+            t->ut_Slots[idx].us_Epoch = epoch;
+            t->ut_Slots[idx].us_Unit = unit;
+            return 1;
+        }
+
+        idx = (idx + 1) & t->ut_Mask;
+    }
+
+    if (UnitTable_IsFull(t))
+        return 0;
+
+    t->ut_Slots[idx].us_Epoch = epoch;
+    t->ut_Slots[idx].us_Address = address;
+    t->ut_Slots[idx].us_Unit = unit;
+    t->ut_Count++;
+
+    return 1;
+}
+
+/*
+    Remove unit with given address. Entries following the removed one are shifted back if
+    this brings them closer to their home slot, so that no lookup stops too early.
+*/
+void UnitTable_Remove(struct UnitTable *t, uint32_t address)
+{
+    uint32_t idx = UnitTable_Hash(t, address);
+
+    while (t->ut_Slots[idx].us_Address != address)
+    {
+        if (t->ut_Slots[idx].us_Unit == NULL)
+            return;
+
+        idx = (idx + 1) & t->ut_Mask;
+    }
+
+    if (t->ut_Slots[idx].us_Unit == NULL)
+        return;
+
+    uint32_t hole = idx;
+
+    while (1)
+    {
+        idx = (idx + 1) & t->ut_Mask;
+
+        if (t->ut_Slots[idx].us_Unit == NULL)
+            break;
+
+        uint32_t home = UnitTable_Hash(t, t->ut_Slots[idx].us_Address);
+
+        /* Move the entry if its home slot is not within (hole, idx] */
+        if (((idx - home) & t->ut_Mask) >= ((idx - hole) & t->ut_Mask))
+        {
+            t->ut_Slots[hole] = t->ut_Slots[idx];
+            hole = idx;
+        }
+    }
+
+    t->ut_Slots[hole].us_Key = 0;
+    t->ut_Slots[hole].us_Unit = NULL;
+    t->ut_Count--;
+}
+
+void UnitTable_SetEpoch(struct UnitTable *t, uint32_t address, uint32_t epoch)
+{
+    uint32_t idx = UnitTable_Hash(t, address);
+
+    while (t->ut_Slots[idx].us_Unit != NULL)
+    {
+        if (t->ut_Slots[idx].us_Address == address)
+        {
+            t->ut_Slots[idx].us_Epoch = epoch;
+            return;
+        }
+
+        idx = (idx + 1) & t->ut_Mask;
+    }
+}
@@ -385,6 +385,20 @@ uint16_t RA_GetTempAllocMask()
     return register_pool;
 }
 
+/* Forget all allocations, used when translation was abandoned half way */
+void RA_Reset()
+{
+    register_pool = 0;
+    fpu_allocstate = 0;
+    reg_CC = 0xff;
+    mod_CC = 0;
+    reg_CTX = 0xff;
+    reg_FPCR = 0xff;
+    mod_FPCR = 0;
+    reg_FPSR = 0xff;
+    mod_FPSR = 0;
+}
+
 void EMIT_SaveRegFrame(struct TranslatorContext *ctx, uint32_t mask)
 {
     uint8_t cnt = __builtin_popcount(mask);
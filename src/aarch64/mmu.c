@@ -607,6 +607,95 @@ void mmu_map(uintptr_t phys, uintptr_t virt, uintptr_t length, uint32_t attr_low
 "       isb                         \n");
 }
 
+/* Check if at least count pages are left in the pool, without taking them */
+static int mmu_free_pages_left(int count)
+{
+    struct mmu_page *p = mmu_free_pages;
+
+    while (p && count > 0)
+    {
+        p = p->mp_next;
+        count--;
+    }
+
+    return count == 0;
+}
+
+/*
+    Make single 4K page of regular, 1:1 mapped RAM read-only or writable again. Pages of any other
+    kind are not changed. Large pages are split if needed, but only if the pool of 4K pages does
+    not run low. Returns 1 if the page has requested access mode on return.
+*/
+int mmu_write_protect(uintptr_t virt, int protect)
+{
+    const uint32_t ram_attr = MMU_ACCESS | MMU_ISHARE | MMU_ATTR_CACHED;
+    uint64_t *tbl;
+    uint64_t desc;
+    int split = 0;
+
+    virt &= ~4095ULL;
+
+    if (virt & 0xffff000000000000)
+        return 0;
+
+    __asm__ volatile("mrs %0, TTBR0_EL1":"=r"(tbl));
+    tbl = (uint64_t *)((uintptr_t)tbl + PHYS_VIRT_OFFSET);
+
+    desc = tbl[(virt >> 30) & 0x1ff];
+    if ((desc & 3) == 1)
+        split = 2;
+    else if ((desc & 3) == 3)
+    {
+        tbl = (uint64_t *)((desc & 0x0000fffffffff000) + PHYS_VIRT_OFFSET);
+        desc = tbl[(virt >> 21) & 0x1ff];
+        
+        if ((desc & 3) == 1)
+            split = 1;
+        else if ((desc & 3) == 3)
+        {
+            tbl = (uint64_t *)((desc & 0x0000fffffffff000) + PHYS_VIRT_OFFSET);
+            desc = tbl[(virt >> 12) & 0x1ff];
+
+            if ((desc & 3) != 3)
+                return 0;
+        }
+        else return 0;
+    }
+    else return 0;
+
+    /* Only RAM mapped 1:1, accessible from EL1 only, without any upper attributes */
+    if (mmu_virt2phys(virt) != virt || (desc >> 52) != 0 || (desc & 0xffc & ~MMU_READ_ONLY) != ram_attr)
+        return 0;
+
+    if (!!(desc & MMU_READ_ONLY) == !!protect)
+        return 1;
+
+    /* Splitting the large page costs one 4K page per level, keep some of them for other purposes */
+    if (split && !mmu_free_pages_left(split + 16))
+        return 0;
+
+    put_4k_page(virt, virt, ram_attr | (protect ? MMU_READ_ONLY : 0), 0);
+
+    if (split)
+    {
+        __asm__ volatile(
+"       dsb     ish                 \n"
+"       tlbi    VMALLE1IS           \n"
+"       dsb     sy                  \n"
+"       isb                         \n");
+    }
+    else
+    {
+        __asm__ volatile(
+"       dsb     ishst               \n"
+"       tlbi    vaae1is, %0         \n"
+"       dsb     ish                 \n"
+"       isb                         \n"::"r"(virt >> 12));
+    }
+
+    return 1;
+}
+
 void mmu_unmap(uintptr_t virt, uintptr_t length)
 {
     (void)virt;
@@ -30,6 +30,7 @@
 #include "sponsoring.h"
 #include "spinlock.h"
 #include "intc.h"
+#include "JITProfiler.h"
 #ifdef PISTORM_ANY_MODEL
 #include "ps_protocol.h"
 #endif
@@ -309,10 +310,13 @@ void* m68k_jit_virt_base = NULL;
 void* ppc_jit_virt_base = NULL;
 
 void M68K_StartEmu(void *addr, void *fdt);
+void *rom_cache_loc = NULL;
+uint32_t rom_cache_size = 0;
 void __vectors_start(void);
 extern int debug_cnt;
 int enable_cache = 0;
 int limit_2g = 0;
+int dispatch_bench = 0;
 int zorro_disable = 0;
 int ppc_enable = 0;
 int chip_slowdown;
@@ -321,6 +325,14 @@ int debug_not_implemented = 0;
 int emu68_icnt = EMU68_M68K_INSN_DEPTH;
 int emu68_ccrd = EMU68_CCR_SCAN_DEPTH;
 int emu68_irng = EMU68_BRANCH_INLINE_DISTANCE;
+static int peephole = EMU68_PEEPHOLE;
+static int jit_ir = 0;
+#ifdef PISTORM_ANY_MODEL
+static int direct_bus = 0;
+#endif
+#ifdef PISTORM
+static int posted_writes = 0;
+#endif
 int dcache_mask_bits;
 int disable_scsi = 0;
 int beamcon0_pal_clear = 0;
@@ -330,6 +342,9 @@ int beamcon0_pal_set = 0;
 #include "ps_protocol.h"
 static int blitwait;
 static int membench = 0;
+#ifdef PISTORM
+static int busbench = 0;
+#endif
 #endif
 
 extern const char _verstring_object[];
@@ -485,6 +500,14 @@ void secondary_boot(void)
     (void)async_log;
 #endif
 
+#if EMU68_ASYNC_JIT
+    /* CPU is otherwise idle, translate m68k code ahead of time */
+    if (cpu_id == EMU68_ASYNC_JIT_CPU && !async_log)
+    {
+        M68K_TranslationWorker();
+    }
+#endif
+
     while(1) { __asm__ volatile("wfe"); }
 }
 uintptr_t vid_base;
@@ -566,6 +589,7 @@ void parse_cmdline(const char *cmdline)
     ppc_enable = !!find_token(cmdline, "ppc_enable");
     enable_cache = !!find_token(cmdline, "enable_cache");
     limit_2g = !!find_token(cmdline, "limit_2g");
+    dispatch_bench = !!find_token(cmdline, "dispatch_bench");
 
 #ifdef PISTORM_ANY_MODEL
     int force_ps16 = !!find_token(cmdline, "ps16");
@@ -663,6 +687,54 @@ void parse_cmdline(const char *cmdline)
         cs_dist = cs;
     }
 
+    peephole = EMU68_PEEPHOLE && !find_token(cmdline, "no_peephole");
+
+    jit_ir = EMU68_IR && find_token(cmdline, "jit_ir");
+
+#if EMU68_WP_SMC
+    extern int smc_write_protect;
+    smc_write_protect = !find_token(cmdline, "no_smc_wp");
+#endif
+
+#if EMU68_JIT_SEGMENTED
+    extern int jit_segmented;
+    jit_segmented = !!find_token(cmdline, "jit_fifo");
+#endif
+
+#if EMU68_JIT_STATS
+    if ((tok = find_token(cmdline, "jit_stats=")))
+    {
+        extern uint32_t jit_stats_period;
+        uint32_t period = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            if (tok[10 + i] < '0' || tok[10 + i] > '9')
+                break;
+
+            period = period * 10 + tok[10 + i] - '0';
+        }
+
+        jit_stats_period = period;
+    }
+#endif
+
+#if EMU68_PROFILER
+    if ((tok = find_token(cmdline, "profile=")))
+    {
+        extern uint32_t prof_rate;
+        uint32_t rate = 0;
+        for (int i = 0; i < 5; i++)
+        {
+            if (tok[8 + i] < '0' || tok[8 + i] > '9')
+                break;
+
+            rate = rate * 10 + tok[8 + i] - '0';
+        }
+
+        prof_rate = rate;
+    }
+#endif
+
 #ifdef PISTORM_ANY_MODEL
 
 #if !defined(PISTORM_CLASSIC)
@@ -690,6 +762,12 @@ void parse_cmdline(const char *cmdline)
 
     blitwait = find_token(cmdline, "blitwait") || find_token(cmdline, "BW");
 
+    direct_bus = EMU68_DIRECT_BUS && !find_token(cmdline, "no_direct_bus");
+
+#ifdef PISTORM
+    posted_writes = PISTORM_WRITE_QUEUE && !find_token(cmdline, "no_posted_writes");
+#endif
+
     if ((tok = find_token(cmdline, "membench=")))
     {
         uint32_t bench = 0;
@@ -708,6 +786,26 @@ void parse_cmdline(const char *cmdline)
 
         membench = bench;
     }
+#ifdef PISTORM
+    if ((tok = find_token(cmdline, "busbench=")))
+    {
+        uint32_t bench = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            if (tok[9 + i] < '0' || tok[9 + i] > '9')
+                break;
+
+            bench = bench * 10 + tok[9 + i] - '0';
+        }
+
+        if (bench > 1024)
+        {
+            bench = 1024;
+        }
+
+        busbench = bench;
+    }
+#endif
     if ((tok = find_token(cmdline, "buptest=")))
     {
         uint32_t bup = 0;
@@ -1120,6 +1218,40 @@ void boot(void *dtree)
             *(uint32_t *)p->op_value = 0;
         }
     }
+
+#ifdef PISTORM
+    if (busbench)
+    {
+        of_node_t *bus = dt_find_node("/emu68/diag/busbench");
+        if (bus == NULL)
+        {
+            bus = dt_make_node("busbench");
+            dt_add_node(diag, bus);
+        }
+
+        if ((p = dt_find_property(bus, "status")) == NULL)
+        {
+            dt_add_property(bus, "status", "okay", 5);
+        }
+        else
+        {
+            tlsf_free(tlsf, p->op_value);
+            p->op_value = tlsf_malloc(tlsf, 5);
+            p->op_length = 5;
+            memcpy(p->op_value, "okay", 5);
+        }
+
+        if ((p = dt_find_property(bus, "size")) == NULL)
+        {
+            uint32_t sz = busbench * 1024;
+            dt_add_property(bus, "size", &sz, 4);
+        }
+        else
+        {
+            *(uint32_t *)p->op_value = busbench * 1024;
+        }
+    }
+#endif
 #endif
 
     /*
@@ -1398,6 +1530,8 @@ void boot(void *dtree)
         mmu_map((uintptr_t)m68k_jit_phys_base, (uintptr_t)m68k_jit_virt_base | 0x0000001000000000ULL, m68k_jit_size, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
 
         jit_tlsf = tlsf_init_with_memory((void*)m68k_jit_virt_base, m68k_jit_size);
+        /* Units are allocated by the translation worker and released on CPU0 */
+        tlsf_set_flags(jit_tlsf, TLSF_MULTITHREADING);
 
         /* If PPC was enabled, create proper MMU map here */
         if (dt_find_property(dt_find_node("/emu68"), "ppc-enable"))
@@ -1754,10 +1888,27 @@ void boot(void *dtree)
     {
         extern uint32_t rom_mapped;
 
-        kprintf("[BOOT] Loading ROM from %p, size %d\n", initramfs_loc, initramfs_size);
+        uintptr_t rom_size = initramfs_size;
+
+        /* ROM image may be followed by translated ROM code exported in previous session */
+        for (uintptr_t size = 262144; size <= 2097152; size <<= 1)
+        {
+            if (initramfs_size > size && M68K_IsROMCache((void *)((uintptr_t)initramfs_loc + size), initramfs_size - size))
+            {
+                rom_size = size;
+                rom_cache_size = initramfs_size - size;
+                rom_cache_loc = tlsf_malloc(tlsf, rom_cache_size);
+                if (rom_cache_loc)
+                    memcpy(rom_cache_loc, (void *)((uintptr_t)initramfs_loc + size), rom_cache_size);
+                kprintf("[BOOT] Translated ROM code found after ROM image, size %d\n", rom_cache_size);
+                break;
+            }
+        }
+
+        kprintf("[BOOT] Loading ROM from %p, size %d\n", initramfs_loc, rom_size);
         mmu_map(0xf80000, 0xf80000, 524288, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
             
-        if (initramfs_size == 262144)
+        if (rom_size == 262144)
         {
             /* Make a shadow of 0xf80000 at 0xe00000 */
             mmu_map(0xe00000, 0xe00000, 524288, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
@@ -1765,14 +1916,14 @@ void boot(void *dtree)
             DuffCopy((void*)0xffffff9000fc0000, initramfs_loc, 262144 / 4);
             DuffCopy((void*)0xffffff9000e00000, (void*)0xffffff9000f80000, 524288 / 4);
         }
-        else if (initramfs_size == 524288)
+        else if (rom_size == 524288)
         {
             /* Make a shadow of 0xf80000 at 0xe00000 */
             mmu_map(0xe00000, 0xe00000, 524288, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
             DuffCopy((void*)0xffffff9000e00000, initramfs_loc, 524288 / 4);
             DuffCopy((void*)0xffffff9000f80000, initramfs_loc, 524288 / 4);
         }
-        else if (initramfs_size == 1048576)
+        else if (rom_size == 1048576)
         {
             mmu_map(0xe00000, 0xe00000, 524288, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
             mmu_map(0xf00000, 0xf00000, 524288, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
@@ -1780,7 +1931,7 @@ void boot(void *dtree)
             DuffCopy((void*)0xffffff9000f00000, initramfs_loc, 524288 / 4);
             DuffCopy((void*)0xffffff9000f80000, (void*)((uintptr_t)initramfs_loc + 524288), 524288 / 4);
         }
-        else if (initramfs_size == 2097152) {
+        else if (rom_size == 2097152) {
             mmu_map(0xa80000, 0xa80000, 524288, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
             mmu_map(0xb00000, 0xb00000, 524288, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
             mmu_map(0xe00000, 0xe00000, 524288, MMU_ACCESS | MMU_ISHARE | MMU_ALLOW_EL0 | MMU_READ_ONLY | MMU_ATTR_CACHED, 0);
@@ -1800,7 +1951,7 @@ void boot(void *dtree)
                     rom_start[i] = rom_start[i + 1];
                     rom_start[i+1] = tmp;
                 }
-                if (initramfs_size == 0x100000 || initramfs_size == 0x200000) {
+                if (rom_size == 0x100000 || rom_size == 0x200000) {
                     rom_start = (uint8_t *)0xffffff9000e00000;
 
                     for (int i=0; i < 524288; i+=2) {
@@ -1809,7 +1960,7 @@ void boot(void *dtree)
                         rom_start[i+1] = tmp;
                     }
 
-                    if (initramfs_size == 0x200000) {
+                    if (rom_size == 0x200000) {
                         rom_start = (uint8_t *)0xffffff9000a80000;
 
                         for (int i=0; i < 2*524288; i+=2) {
@@ -1868,6 +2019,15 @@ void boot(void *dtree)
         dt_dump_tree();
     }
 
+#if EMU68_ASM_DISPATCH
+    if (dispatch_bench) {
+        void M68K_DispatchBenchmark();
+
+        kprintf("[BOOT] Running dispatcher benchmark\n");
+        M68K_DispatchBenchmark();
+    }
+#endif
+
 #ifdef PISTORM_ANY_MODEL
     if (recalc_checksum) {
         amiga_checksum((void*)0xffffff9000f80000, 524288, 524288-24, 1);
@@ -1900,6 +2060,20 @@ void boot(void *dtree)
 
     }
 
+#ifdef PISTORM
+    n = dt_find_node("/emu68/diag/busbench");
+    if (n != NULL)
+    {
+        of_property_t * prop = dt_find_property(n, "status");
+        if (prop && strcmp(prop->op_value, "okay") == 0)
+        {
+            uint32_t size = dt_get_property_value_u32(n, "size", 256 * 1024, 0);
+            kprintf("[BOOT] Calling busbench with size %d\n", size);
+            ps_busbench(size);
+        }
+    }
+#endif
+
     /* If fast_page_zero is enabled, map first 4K to ROM directly (Overlay active) */
     if (dt_find_property(dt_find_node("/emu68/defaults"), "fast-page-zero"))
     {
@@ -2096,38 +2270,6 @@ extern uint32_t fb_height;
 
 void ExecutionLoop(struct M68KState *ctx);
 
-void  __attribute__((used)) stub_FindUnit()
-{
-    __asm__ volatile(
-"       .align  8                           \n"
-"FindUnit:                                  \n"
-"       adrp    x4, ICache                  \n"
-"       add     x4, x4, :lo12:ICache        \n"
-"       and     x0, x%[reg_pc], 0x1fffe0    \n" // Hash is (address >> 5) & 0xffff !!!!
-"       ldr     x0, [x4, x0]                \n"
-"       b       1f                          \n"
-"3:                                         \n" // 2 -> 5
-"       cmp     w5, w%[reg_pc]              \n"
-"       b.eq    2f                          \n"
-"       mov     x0, x4                      \n"
-"1:     ldr     x4, [x0]                    \n"
-"       ldr     x5, [x0, #32]               \n"
-"       cbnz    x4, 3b                      \n"
-"       mov     x0, #0                      \n"
-"4:     ret                                 \n"
-"2:     ldp     x6, x4, [x0, #16]           \n"
-"       ldr     x5, [x4, #8]                \n"
-"       cbz     x5, 4b                      \n"
-"       stp     x4, x5, [x0, #16]           \n"
-"       add     x7, x0, #0x10               \n" // 4 -> 7
-"       str     x7, [x5]                    \n"
-"       stp     x6, x7, [x4]                \n"
-"       str     x4, [x6, #8]                \n"
-"       ret                                 \n"
-
-::[reg_pc]"i"(REG_PC));
-}
-
 #ifdef PISTORM_ANY_MODEL
 extern volatile unsigned char bus_lock;
 #endif
@@ -2173,7 +2315,7 @@ void M68K_StartEmu(void *addr, void *fdt)
     __m68k.SR = BE16(SR_S | SR_IPL);
     __m68k.FPCR = 0;
     __m68k.JIT_CACHE_TOTAL = tlsf_get_total_size(jit_tlsf);
-    __m68k.JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+    __m68k.JIT_CACHE_FREE = M68K_CodeCacheFree();
     __m68k.JIT_UNIT_COUNT = 0;
     __m68k.JIT_SOFTFLUSH_THRESH = EMU68_WEAK_CFLUSH_LIMIT;
     __m68k.JIT_CONTROL = EMU68_WEAK_CFLUSH ? JCCF_SOFT : 0;
@@ -2185,6 +2327,13 @@ void M68K_StartEmu(void *addr, void *fdt)
     __m68k.JIT_CONTROL2 |= (emu68_ccrd  << JC2B_CCR_SCAN_DEPTH); 
     __m68k.JIT_CONTROL2 |= ((cs_dist - 1) << JC2B_CHIP_SLOWDOWN_RATIO);
     __m68k.JIT_CONTROL2 |= blitwait ? JC2F_BLITWAIT : 0;
+    __m68k.JIT_CONTROL2 |= EMU68_TIERED_JIT ? (EMU68_TIER2_THRESHOLD << JC2B_TIER2_THRESHOLD) : 0;
+    __m68k.JIT_CONTROL2 |= peephole ? JC2F_PEEPHOLE : 0;
+    __m68k.JIT_CONTROL2 |= jit_ir ? JC2F_IR : 0;
+    __m68k.JIT_CONTROL2 |= direct_bus ? JC2F_DIRECT_BUS : 0;
+#ifdef PISTORM
+    __m68k.JIT_CONTROL2 |= posted_writes ? JC2F_POSTED_WRITES : 0;
+#endif
 #else
     __m68k.D[0].u32 = BE32((uint32_t)pitch);
     __m68k.D[1].u32 = BE32((uint32_t)fb_width);
@@ -2198,7 +2347,7 @@ void M68K_StartEmu(void *addr, void *fdt)
     __m68k.SR = BE16(SR_S | SR_IPL);
     __m68k.FPCR = 0;
     __m68k.JIT_CACHE_TOTAL = tlsf_get_total_size(jit_tlsf);
-    __m68k.JIT_CACHE_FREE = tlsf_get_free_size(jit_tlsf);
+    __m68k.JIT_CACHE_FREE = M68K_CodeCacheFree();
     __m68k.JIT_UNIT_COUNT = 0;
     __m68k.JIT_SOFTFLUSH_THRESH = EMU68_WEAK_CFLUSH_LIMIT;
     __m68k.JIT_CONTROL = EMU68_WEAK_CFLUSH ? JCCF_SOFT : 0;
@@ -2206,6 +2355,9 @@ void M68K_StartEmu(void *addr, void *fdt)
     __m68k.JIT_CONTROL |= (emu68_irng & JCCB_INLINE_RANGE_MASK) << JCCB_INLINE_RANGE;
     __m68k.JIT_CONTROL |= (EMU68_MAX_LOOP_COUNT & JCCB_LOOP_COUNT_MASK) << JCCB_LOOP_COUNT;
     __m68k.JIT_CONTROL2 = (emu68_ccrd << JC2B_CCR_SCAN_DEPTH);
+    __m68k.JIT_CONTROL2 |= EMU68_TIERED_JIT ? (EMU68_TIER2_THRESHOLD << JC2B_TIER2_THRESHOLD) : 0;
+    __m68k.JIT_CONTROL2 |= peephole ? JC2F_PEEPHOLE : 0;
+    __m68k.JIT_CONTROL2 |= jit_ir ? JC2F_IR : 0;
     *(uint32_t *)(intptr_t)(BE32(__m68k.ISP.u32)) = 0;
 #endif
     of_node_t *node = dt_find_node("/chosen");
@@ -2241,6 +2393,13 @@ void M68K_StartEmu(void *addr, void *fdt)
         }       
     }
 
+    if (rom_cache_loc != NULL)
+    {
+        M68K_LoadROMCache(rom_cache_loc, rom_cache_size);
+        tlsf_free(tlsf, rom_cache_loc);
+        rom_cache_loc = NULL;
+    }
+
     kprintf("[JIT]\n");
     M68K_PrintContext(&__m68k);
 
@@ -2272,6 +2431,9 @@ __asm__ volatile(
     /* Save the context to CTX_POINTER_ASM, it will be fetched in main loop */
     __asm__ volatile("mov "CTX_POINTER_ASM", %0"::"r"(&__m68k));
 
+    /* Sampling profiler interrupts CPU0, start it as late as possible */
+    Profiler_Start();
+
     /* Fire PPC */
     extern spinlock_t PPCStart;
     spinlock_release(&PPCStart);
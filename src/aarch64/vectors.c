@@ -16,6 +16,8 @@
 #include "M68k.h"
 #include "cache.h"
 #include "intc.h"
+#include "JITStats.h"
+#include "JITProfiler.h"
 
 #define FULL_CONTEXT 0
 
@@ -95,6 +97,24 @@ static const int REGMAP[32] = {
 #define LOAD_CONTEXT    LOAD_SHORT_CONTEXT
 #endif
 
+#if EMU68_PROFILER
+#define PROFILER_IRQ_CHECK \
+    "       mrs x0, CNTV_CTL_EL0            \n" /* Virtual timer enabled, unmasked and expired? */ \
+    "       cmp x0, #5                      \n" \
+    "       b.eq ProfilerIRQ                \n" /* Then it is the profiler */
+
+#define PROFILER_IRQ \
+    "ProfilerIRQ:                           \n" \
+    "       ldp x0, x1, [sp], #16           \n" /* Restore scratch registers */ \
+    SAVE_CONTEXT \
+    "       mrs x0, ELR_EL1                 \n" /* Interrupted PC */ \
+    "       bl Profiler_Sample              \n" \
+    "       b ExceptionExit                 \n"
+#else
+#define PROFILER_IRQ_CHECK
+#define PROFILER_IRQ
+#endif
+
 struct INT_shadow {
     uint16_t INTENA;
     uint16_t INTREQ;
@@ -150,6 +170,7 @@ void  __attribute__((used)) __stub_vectors()
 "       mrs x0, MPIDR_EL1               \n" // Check CPU core id
 "       tst x0, #3                      \n" // if Core ID != 0
 "       b.ne 2f                         \n" // Go to SysHandler
+        PROFILER_IRQ_CHECK
 "       mrs x0, SPSR_EL1                \n" // Get SPSR
 "       orr x0, x0, #0x080              \n" // Disable IRQ interrupt so that we are not disturbed on return
 "       msr SPSR_EL1, x0                \n"
@@ -268,6 +289,7 @@ void  __attribute__((used)) __stub_vectors()
 "       bl SYSHandler                   \n"
 "       b ExceptionExit                 \n"
 "                                       \n"
+        PROFILER_IRQ
 "IRQonOtherCores:                       \n"
         SAVE_CONTEXT                        // exception from a lower EL(AArch32).
 "       mov x0, #0xffff                 \n"
@@ -716,11 +738,107 @@ int SYSReadValFromAddr(uint64_t *value, uint64_t *value2, int size, uint64_t far
         else if (beamcon0_pal_clear) {
             *value |= 0x1000;
         }
-    } 
+    }
 
     return 1;
 }
 
+#if EMU68_DIRECT_BUS
+
+/*
+    Bus accesses called directly from translated code, when the address is known at translation
+    time to be in CHIP memory or chipset registers. Translated code puts the address in w0 and
+    value to write in w1, then calls the SYSBusRead/SYSBusWrite stub of given size. The stubs
+    preserve x2-x18, x30, flags and interrupt mask, result of the read is returned in x0. Like the
+    page fault handlers they run with interrupts masked, so the access is never split.
+*/
+uint64_t SYSBusRead(uint32_t address, int size, uint64_t ret)
+{
+    uint64_t value = 0;
+    uint64_t t0 = JITStat_Clock();
+
+    SYSReadValFromAddr(&value, NULL, size, address);
+
+    JITStat_Time(JS_BUSCALL, t0);
+    Profiler_PollFault(ret - 4);
+
+    return value;
+}
+
+void SYSBusWrite(uint32_t address, uint64_t value, int size, uint64_t ret)
+{
+    uint64_t t0 = JITStat_Clock();
+
+    SYSWriteValToAddr(value, 0, size, address);
+
+    JITStat_Time(JS_BUSCALL, t0);
+    Profiler_PollFault(ret - 4);
+}
+
+#define BUS_STUB_ENTRY(name, size, common) \
+    "       .globl " name "                 \n" \
+    "       .type " name ", %function       \n" \
+    "       .balign 8                       \n" \
+    name ":                                 \n" \
+    "       stp x2, x3, [sp, -10*16]!       \n" \
+    "       mov w2, #" #size "              \n" \
+    "       b " common "                    \n"
+
+#define BUS_STUB_SAVE \
+    "       stp x4, x5, [sp, #1*16]         \n" \
+    "       stp x6, x7, [sp, #2*16]         \n" \
+    "       stp x8, x9, [sp, #3*16]         \n" \
+    "       stp x10, x11, [sp, #4*16]       \n" \
+    "       stp x12, x13, [sp, #5*16]       \n" \
+    "       stp x14, x15, [sp, #6*16]       \n" \
+    "       stp x16, x17, [sp, #7*16]       \n" \
+    "       stp x18, x30, [sp, #8*16]       \n" \
+    "       mrs x4, NZCV                    \n" \
+    "       mrs x5, DAIF                    \n" \
+    "       stp x4, x5, [sp, #9*16]         \n" \
+    "       msr DAIFSet, #3                 \n"
+
+#define BUS_STUB_RESTORE \
+    "       ldp x4, x5, [sp, #9*16]         \n" \
+    "       msr NZCV, x4                    \n" \
+    "       msr DAIF, x5                    \n" \
+    "       ldp x4, x5, [sp, #1*16]         \n" \
+    "       ldp x6, x7, [sp, #2*16]         \n" \
+    "       ldp x8, x9, [sp, #3*16]         \n" \
+    "       ldp x10, x11, [sp, #4*16]       \n" \
+    "       ldp x12, x13, [sp, #5*16]       \n" \
+    "       ldp x14, x15, [sp, #6*16]       \n" \
+    "       ldp x16, x17, [sp, #7*16]       \n" \
+    "       ldp x18, x30, [sp, #8*16]       \n" \
+    "       ldp x2, x3, [sp], #10*16        \n" \
+    "       ret                             \n"
+
+void  __attribute__((used)) __stub_buscall()
+{ __asm__ volatile(
+"       .pushsection .text              \n"
+        BUS_STUB_ENTRY("SYSBusRead8", 1, "SYSBusReadCommon")
+        BUS_STUB_ENTRY("SYSBusRead16", 2, "SYSBusReadCommon")
+        BUS_STUB_ENTRY("SYSBusRead32", 4, "SYSBusReadCommon")
+"SYSBusReadCommon:                      \n"
+        BUS_STUB_SAVE
+"       mov w1, w2                      \n" // Size
+"       mov x2, x30                     \n" // Return address into translated code
+"       bl SYSBusRead                   \n"
+        BUS_STUB_RESTORE
+"                                       \n"
+        BUS_STUB_ENTRY("SYSBusWrite8", 1, "SYSBusWriteCommon")
+        BUS_STUB_ENTRY("SYSBusWrite16", 2, "SYSBusWriteCommon")
+        BUS_STUB_ENTRY("SYSBusWrite32", 4, "SYSBusWriteCommon")
+"SYSBusWriteCommon:                     \n"
+        BUS_STUB_SAVE
+"       mov x3, x30                     \n" // Return address into translated code
+"       bl SYSBusWrite                  \n"
+        BUS_STUB_RESTORE
+"       .popsection                     \n"
+);}
+
+#endif /* EMU68_DIRECT_BUS */
+
 #else
 
 int SYSWriteValToAddr(uint64_t value, uint64_t value2, int size, uint64_t far)
@@ -1226,6 +1344,364 @@ static inline uint64_t SYSGetValueFromReg(uint8_t regNr, uint64_t *ctx)
     return value;
 }
 
+#if EMU68_FAULT_CACHE
+
+/*
+    Decoded integer loads and stores (single register, any addressing mode but literal) which
+    faulted, indexed by their address. The same few instructions of translated code fault over
+    and over again, once the access is found here the handler does not decode the opcode anymore.
+    Entries are valid for one epoch only, the epoch advances whenever translated code is freed.
+    Opcode is compared too, so that code patched in place is never mistaken for the old one.
+*/
+#define FAF_STORE       0x01
+#define FAF_SEXT        0x02    /* Sign extend loaded value to 32 bits */
+#define FAF_SEXT64      0x04    /* Sign extend loaded value to 64 bits */
+#define FAF_WRITEBACK   0x08    /* Base register updated with base + offset */
+#define FAF_POSTINDEX   0x10    /* Access at base, offset applied afterwards */
+#define FAF_INDEX       0x20    /* Address is base + extended and shifted index register */
+
+struct FaultAccess {
+    uint64_t    fa_ELR;
+    uint32_t    fa_Opcode;
+    uint32_t    fa_Epoch;
+    int32_t     fa_Offset;
+    uint8_t     fa_Flags;
+    uint8_t     fa_Size;
+    uint8_t     fa_Rt;
+    uint8_t     fa_Rn;
+    uint8_t     fa_Rm;
+    uint8_t     fa_Extend;
+    uint8_t     fa_Shift;
+};
+
+static struct FaultAccess fault_cache[EMU68_FAULT_CACHE];
+static uint32_t fault_cache_epoch = 1;
+
+/* Called whenever translated code is freed */
+void SYSFaultCacheFlush()
+{
+    __atomic_add_fetch(&fault_cache_epoch, 1, __ATOMIC_RELAXED);
+}
+
+/* Decode integer load or store into fa. Returns 0 if the opcode is of any other kind */
+static int SYSFaultDecode(struct FaultAccess *fa, uint32_t opcode)
+{
+    fa->fa_Size = getOPsize(opcode);
+    fa->fa_Rt = opcode & 31;
+    fa->fa_Rn = (opcode >> 5) & 31;
+    fa->fa_Rm = 0;
+    fa->fa_Extend = 0;
+    fa->fa_Shift = 0;
+    fa->fa_Offset = 0;
+    fa->fa_Flags = 0;
+
+    /* Unsigned offset */
+    if ((opcode & 0x3f000000) == 0x39000000)
+    {
+        fa->fa_Offset = ((opcode >> 10) & 0xfff) * fa->fa_Size;
+    }
+    /* Unscaled offset, post- and pre-index */
+    else if ((opcode & 0x3f200000) == 0x38000000)
+    {
+        fa->fa_Offset = ((int16_t)(opcode >> 5)) >> 7;
+
+        switch ((opcode >> 10) & 3)
+        {
+            case 0:
+                break;
+            case 1:
+                fa->fa_Flags = FAF_WRITEBACK | FAF_POSTINDEX;
+                break;
+            case 3:
+                fa->fa_Flags = FAF_WRITEBACK;
+                break;
+            default:
+                return 0;
+        }
+    }
+    /* Register offset */
+    else if ((opcode & 0x3f200c00) == 0x38200800)
+    {
+        fa->fa_Flags = FAF_INDEX;
+        fa->fa_Rm = (opcode >> 16) & 31;
+        fa->fa_Extend = (opcode >> 13) & 7;
+        if (opcode & 0x1000)
+            fa->fa_Shift = __builtin_ctz(fa->fa_Size);
+    }
+    else
+        return 0;
+
+    switch ((opcode >> 22) & 3)
+    {
+        case 0:
+            fa->fa_Flags |= FAF_STORE;
+            break;
+        case 1:
+            break;
+        case 2:
+            /* PRFM */
+            if (fa->fa_Size == 8)
+                return 0;
+            fa->fa_Flags |= FAF_SEXT | FAF_SEXT64;
+            break;
+        case 3:
+            if (fa->fa_Size >= 4)
+                return 0;
+            fa->fa_Flags |= FAF_SEXT;
+            break;
+    }
+
+    return 1;
+}
+
+static int SYSFaultExecute(const struct FaultAccess *fa, uint64_t *ctx)
+{
+    uint64_t ptr = SYSGetValueFromReg(fa->fa_Rn, ctx);
+    uint64_t addr = ptr;
+    uint64_t value = 0;
+    int handled;
+
+    if (fa->fa_Flags & FAF_INDEX)
+    {
+        uint64_t rm = SYSGetValueFromReg(fa->fa_Rm, ctx);
+
+        switch (fa->fa_Extend)
+        {
+            case 0b010: // UXTW
+                rm &= 0xffffffffULL;
+                break;
+            case 0b110: // SXTW
+                rm = (int64_t)(int32_t)rm;
+                break;
+        }
+
+        addr += rm << fa->fa_Shift;
+    }
+    else if (!(fa->fa_Flags & FAF_POSTINDEX))
+    {
+        addr += fa->fa_Offset;
+    }
+
+    if (fa->fa_Flags & FAF_STORE)
+    {
+        if (fa->fa_Rt != 31)
+            value = SYSGetValueFromReg(fa->fa_Rt, ctx);
+
+        handled = SYSWriteValToAddr(value, 0, fa->fa_Size, addr);
+
+        if (fa->fa_Flags & FAF_WRITEBACK)
+            SYSPutValueToReg(ptr + fa->fa_Offset, fa->fa_Rn, ctx);
+    }
+    else
+    {
+        handled = SYSReadValFromAddr(&value, NULL, fa->fa_Size, addr);
+
+        if (handled)
+        {
+            if (fa->fa_Flags & FAF_SEXT)
+            {
+                int sext = 0;
+                switch (fa->fa_Size)
+                {
+                    case 1:
+                        sext = value & 0x80;
+                        if (sext) value |= 0xffffff00;
+                        break;
+                    case 2:
+                        sext = value & 0x8000;
+                        if (sext) value |= 0xffff0000;
+                        break;
+                    case 4:
+                        sext = value & 0x80000000;
+                        break;
+                }
+
+                if (sext && (fa->fa_Flags & FAF_SEXT64))
+                    value |= 0xffffffff00000000ULL;
+            }
+
+            SYSPutValueToReg(value, fa->fa_Rt, ctx);
+
+            if (fa->fa_Flags & FAF_WRITEBACK)
+                SYSPutValueToReg(ptr + fa->fa_Offset, fa->fa_Rn, ctx);
+        }
+    }
+
+    return handled;
+}
+
+/*
+    Emulate the access through the cache. Returns 0 if the opcode is not one the cache handles,
+    otherwise result of the access is stored in handled.
+*/
+static int SYSFaultCached(uint64_t elr, uint32_t opcode, uint64_t *ctx, int *handled)
+{
+    struct FaultAccess *fa = &fault_cache[(elr >> 2) & (EMU68_FAULT_CACHE - 1)];
+    uint32_t epoch = __atomic_load_n(&fault_cache_epoch, __ATOMIC_RELAXED);
+
+    if (fa->fa_ELR == elr && fa->fa_Opcode == opcode && fa->fa_Epoch == epoch)
+    {
+        JITStat_Inc(JS_FAULT_CACHE_HIT);
+    }
+    else
+    {
+        struct FaultAccess decoded;
+
+        JITStat_Inc(JS_FAULT_CACHE_MISS);
+
+        if (!SYSFaultDecode(&decoded, opcode))
+            return 0;
+
+        decoded.fa_ELR = elr;
+        decoded.fa_Opcode = opcode;
+        decoded.fa_Epoch = epoch;
+        *fa = decoded;
+    }
+
+    *handled = SYSFaultExecute(fa, ctx);
+
+    return 1;
+}
+
+#else
+
+void SYSFaultCacheFlush() {}
+
+#endif
+
+#if PISTORM_BLOCK_FAULTS
+
+/*
+    MOVEM stores or loads a list of registers to consecutive longwords with a run of 32-bit STP/STR
+    (LDP/LDR) instructions sharing one base register. When the first of them faults on CHIP memory,
+    the whole run is performed with one block transfer on the bus and the exception is taken only
+    once instead of once per instruction. Only the first instruction of a run may use pre-index
+    addressing, which is how MOVEM with pre-decrement mode starts. Returns the number of instructions
+    handled, or 0 if the fault is not the start of a run.
+*/
+
+#define FAULT_BLOCK_MAX     32
+
+static int SYSFaultBlock(uint64_t elr, uint64_t *ctx, int store)
+{
+    const uint32_t *code = (const uint32_t *)elr;
+    uint32_t buf[FAULT_BLOCK_MAX];
+    uint8_t regs[FAULT_BLOCK_MAX];
+    uint32_t cls_single = store ? 0xb9000000 : 0xb9400000;
+    uint32_t cls_pair = store ? 0x29000000 : 0x29400000;
+    uint32_t cls_pre = store ? 0x29800000 : 0x29c00000;
+    uint8_t base = 0xff;
+    uint64_t bval = 0;
+    int32_t start = 0;
+    int32_t expect = 0;
+    int writeback = 0;
+    int count = 0;
+    int insns;
+
+    for (insns = 0; insns < FAULT_BLOCK_MAX; insns++)
+    {
+        uint32_t opcode = LE32(code[insns]);
+        uint32_t cls = opcode & 0xffc00000;
+        uint8_t rn = (opcode >> 5) & 31;
+        uint8_t rt = opcode & 31;
+        uint8_t rt2 = (opcode >> 10) & 31;
+        int32_t offset;
+        int n;
+
+        if (cls == cls_single) {
+            offset = 4 * ((opcode >> 10) & 0xfff);
+            n = 1;
+        }
+        else if (cls == cls_pair || (insns == 0 && cls == cls_pre)) {
+            offset = 4 * (((int32_t)(opcode << 10)) >> 25);
+            n = 2;
+        }
+        else
+            break;
+
+        if (insns == 0)
+        {
+            if (rn == 31)
+                return 0;
+
+            base = rn;
+            bval = SYSGetValueFromReg(rn, ctx);
+
+            /* Following instructions see the updated base */
+            if (cls == cls_pre) {
+                bval += offset;
+                offset = 0;
+                writeback = 1;
+            }
+
+            start = expect = offset;
+        }
+
+        if (rn != base || offset != expect || count + n > FAULT_BLOCK_MAX)
+            break;
+        if (!store && n == 2 && rt == rt2)
+            break;
+
+        regs[count++] = rt;
+        if (n == 2)
+            regs[count++] = rt2;
+        expect += 4 * n;
+
+        /* Load overwriting the base ends the run */
+        if (!store && (rt == base || (n == 2 && rt2 == base)))
+        {
+            insns++;
+            break;
+        }
+    }
+
+    if (insns < 2)
+        return 0;
+
+    uint64_t address = bval + start;
+
+    if ((address >> 32) != 0 || address + 4 * count > 0x00200000)
+        return 0;
+
+    if (move_slow_to_chip && address < 0x00100000 && address + 4 * count > 0x00080000)
+        return 0;
+
+    if (store)
+    {
+        for (int i=0; i < count; i++)
+        {
+            if (regs[i] == 31)
+                buf[i] = 0;
+            else if (regs[i] == base && writeback)
+                buf[i] = bval;
+            else
+                buf[i] = SYSGetValueFromReg(regs[i], ctx);
+        }
+
+        ps_write_block(address, buf, count);
+
+        if (writeback)
+            SYSPutValueToReg(bval, base, ctx);
+    }
+    else
+    {
+        ps_read_block(address, buf, count);
+
+        if (writeback)
+            SYSPutValueToReg(bval, base, ctx);
+
+        for (int i=0; i < count; i++)
+        {
+            if (regs[i] != 31)
+                SYSPutValueToReg(buf[i], regs[i], ctx);
+        }
+    }
+
+    return insns;
+}
+
+#endif
+
 int SYSPageFaultWriteHandler(uint32_t vector, uint64_t *ctx, uint64_t elr, uint64_t spsr, uint64_t esr, uint64_t far)
 {
     int handled = 0;
@@ -1244,6 +1720,21 @@ int SYSPageFaultWriteHandler(uint32_t vector, uint64_t *ctx, uint64_t elr, uint6
 
     D(kprintf("[JIT:SYS] Fage fault: opcode %08x, %s %p size %d\n", opcode, "write to", far, size));
 
+#if PISTORM_BLOCK_FAULTS
+    int insns = SYSFaultBlock(elr, ctx, 1);
+    if (insns != 0)
+    {
+        handled = 1;
+        elr += 4 * (insns - 1);
+        goto done;
+    }
+#endif
+
+#if EMU68_FAULT_CACHE
+    if (SYSFaultCached(elr, opcode, ctx, &handled))
+        goto done;
+#endif
+
     /**** MISC ****/
     if ((opcode & 0xffffffe0) == 0xd50b7e20)
     {
@@ -1600,6 +2091,9 @@ int SYSPageFaultWriteHandler(uint32_t vector, uint64_t *ctx, uint64_t elr, uint6
         SYSPutValueToReg(ptr, (opcode >> 5) & 31, ctx);
     }
 
+#if EMU68_FAULT_CACHE || PISTORM_BLOCK_FAULTS
+done:
+#endif
     if (!handled)
     {    
         kprintf("[JIT:SYS] Unhandled page fault: opcode %08x, write to %p\n", opcode, far);
@@ -1630,6 +2124,21 @@ int SYSPageFaultReadHandler(uint32_t vector, uint64_t *ctx, uint64_t elr, uint64
 
     D(kprintf("[JIT:SYS] Fage fault: opcode %08x, %s %p size %d\n", opcode, "read from", far, size));
 
+#if PISTORM_BLOCK_FAULTS
+    int insns = SYSFaultBlock(elr, ctx, 0);
+    if (insns != 0)
+    {
+        handled = 1;
+        elr += 4 * (insns - 1);
+        goto done;
+    }
+#endif
+
+#if EMU68_FAULT_CACHE
+    if (SYSFaultCached(elr, opcode, ctx, &handled))
+        goto done;
+#endif
+
     /**** Floating point loads ****/
     /* FLDS */
     if ((opcode & 0xfee00c00) == 0xbc400000)
@@ -2216,6 +2725,9 @@ int SYSPageFaultReadHandler(uint32_t vector, uint64_t *ctx, uint64_t elr, uint64
         }
     }
 
+#if EMU68_FAULT_CACHE || PISTORM_BLOCK_FAULTS
+done:
+#endif
     if (!handled)
     {    
         kprintf("[JIT:SYS] Unhandled page fault: opcode %08x, read from %p\n", opcode, far);
@@ -2243,11 +2755,33 @@ void SYSHandler(uint32_t vector, uint64_t *ctx)
    
     cpu_id &= 3;
 
+#if EMU68_ASYNC_JIT
+    /* Speculative translation touched memory it should not, abandon it */
+    if (cpu_id == EMU68_ASYNC_JIT_CPU && (vector & 0x1ff) == 0x00 && (esr & 0xf8000000) == 0x90000000)
+    {
+        if (M68K_TranslationWorkerFault())
+            return;
+    }
+#endif
+
+#if EMU68_WP_SMC
+    /* Write to a page holding translated code. Page is writable now, repeat the store */
+    if ((vector & 0x1ff) == 0x00 && (esr & 0xf8000000) == 0x90000000 && (esr & (1 << 6)))
+    {
+        if (M68K_WriteProtectFault(far, elr))
+            return;
+    }
+#endif
+
     if ((vector & 0x1ff) == 0x00 && (esr & 0xf8000000) == 0x90000000)
     {
         int writeFault = (esr & (1 << 6)) != 0;
+        uint64_t t0 = JITStat_Clock();
 
         handled = writeFault ? SYSPageFaultWriteHandler(vector, ctx, elr, spsr, esr, far) : SYSPageFaultReadHandler(vector, ctx, elr, spsr, esr, far);
+
+        JITStat_Time(JS_FAULT, t0);
+        Profiler_PollFault(elr);
     }
     else if ((vector & 0x1ff) == 0x00 && (esr & 0xf8000000) == 0x80000000)
     {
@@ -2398,6 +2932,14 @@ void SYSHandler(uint32_t vector, uint64_t *ctx)
         kprintf("[JIT:SYS] Exception with vector %04x on CPU%d. ELR=%p, SPSR=%08x, ESR=%p, FAR=%p\n", vector, cpu_id, elr, spsr, esr, far);
         kprintf("[JIT:SYS] Failed instruction: %08x\n", LE32(*(uint32_t*)elr));
         uint32_t *ptr = (uint32_t *)elr;
+        struct M68KTranslationUnit *unit = M68K_FindUnitByARMAddress(ptr);
+
+        if (unit)
+        {
+            uint32_t offset = (elr & ~0x0000001000000000ULL) - (uintptr_t)&unit->mt_ARMCode[0];
+            kprintf("[JIT:SYS] In unit %p translated from m68k %08x (range %08x-%08x), ARM offset %d\n",
+                unit, unit->mt_M68kAddress, unit->mt_M68kLow, unit->mt_M68kHigh, offset / 4);
+        }
         
         disasm_open();
 
@@ -12,9 +12,13 @@
 #include "support.h"
 #include "cache.h"
 //#include "ps_protocol.h"
-#include "M68k.h"
 #include <stdint.h>
 
+#if defined(__aarch64__) && CACHE_WAY_COUNT == 8
+#include <arm_neon.h>
+#define CACHE_NEON_LOOKUP 1
+#endif
+
 union CacheLine
 {
     uint128_t cl_128;
@@ -24,13 +28,17 @@ union CacheLine
     uint8_t  cl_8[16];
 };
 
+
 #define D(x) /* x */
 
-#define F_VALID         0x80
 #define F_DIRTY0        0x01
 #define F_DIRTY1        0x02
 #define F_DIRTY2        0x04
 #define F_DIRTY3        0x08
+#define F_DIRTY         (F_DIRTY0 | F_DIRTY1 | F_DIRTY2 | F_DIRTY3)
+
+/* Tags are aligned to the size of one way, bit 0 is free to mark the line as valid */
+#define TAG_VALID       0x00000001
 
 #if CACHE_WAY_COUNT > 32
 #error CACHE_WAY_COUNT shall be less or equal 32
@@ -39,12 +47,21 @@ union CacheLine
 #define GET_SET(x)  (((x) >> 4) & (CACHE_SET_COUNT - 1))
 #define GET_TAG(x)  ((x) & ~(CACHE_SET_COUNT * 16 - 1))
 
+/*
+    Tags of all ways in a set are kept together with the valid bit folded in, so that a lookup
+    is one compare of the whole set. With 8 ways that are two NEON registers.
+*/
+struct CacheSet
+{
+    uint32_t            cs_Tags[CACHE_WAY_COUNT];
+    uint8_t             cs_Flags[CACHE_WAY_COUNT];
+    uint32_t            cs_WaySelect;
+} __attribute__((aligned(16)));
+
 struct Cache
 {
     union CacheLine     c_Lines[CACHE_SET_COUNT][CACHE_WAY_COUNT];
-    uint32_t            c_Tags[CACHE_SET_COUNT][CACHE_WAY_COUNT];
-    uint8_t             c_Flags[CACHE_SET_COUNT][CACHE_WAY_COUNT];
-    uint32_t            c_WaySelect[CACHE_SET_COUNT];
+    struct CacheSet     c_Sets[CACHE_SET_COUNT];
 };
 
 struct Cache *IC;
@@ -53,18 +70,126 @@ struct Cache *DC;
 void cache_mark_hit(struct Cache *cache, int set, int way)
 {
     /* Mark the way as accessed */
-    cache->c_WaySelect[set] |= 1 << way;
+    cache->c_Sets[set].cs_WaySelect |= 1 << way;
 
     /* If all ways are marked as accessed, clear them all and set the current one again */
-    if (cache->c_WaySelect[set] == (0xffffffff >> (32 - CACHE_WAY_COUNT)))
+    if (cache->c_Sets[set].cs_WaySelect == (0xffffffff >> (32 - CACHE_WAY_COUNT)))
     {
-        cache->c_WaySelect[set] = 1 << way;
+        cache->c_Sets[set].cs_WaySelect = 1 << way;
     }
 }
 
 int cache_get_way(struct Cache *cache, int set)
 {
-    return __builtin_ffs(~cache->c_WaySelect[set]) - 1;
+    return __builtin_ffs(~cache->c_Sets[set].cs_WaySelect) - 1;
+}
+
+/* Return the way holding valid line with given tag, -1 if there is none */
+static inline int cache_find_way(struct Cache *cache, uint32_t set, uint32_t tag)
+{
+    const uint32_t *tags = cache->c_Sets[set].cs_Tags;
+
+#if CACHE_NEON_LOOKUP
+    /* Compare all 8 tags, narrow the result to bytes and fold it into a bitmask of matching ways.
+       Lanes are weighted through memory, so that the result does not depend on endianness */
+    static const uint8_t weights[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint32x4_t key = vdupq_n_u32(tag | TAG_VALID);
+    uint16x4_t lo = vmovn_u32(vceqq_u32(vld1q_u32(&tags[0]), key));
+    uint16x4_t hi = vmovn_u32(vceqq_u32(vld1q_u32(&tags[4]), key));
+    uint8x8_t hits = vand_u8(vmovn_u16(vcombine_u16(lo, hi)), vld1_u8(weights));
+    uint32_t mask = vaddv_u8(hits);
+
+    if (mask == 0)
+        return -1;
+
+    return __builtin_ctz(mask);
+#else
+    for (int i=0; i < CACHE_WAY_COUNT; i++)
+    {
+        if (tags[i] == (tag | TAG_VALID))
+            return i;
+    }
+
+    return -1;
+#endif
+}
+
+static inline void cache_write_back(struct Cache *cache, uint32_t set, int way)
+{
+    uint8_t flags = cache->c_Sets[set].cs_Flags[way];
+    uint32_t line_address = (cache->c_Sets[set].cs_Tags[way] & ~TAG_VALID) + (set << 4);
+
+    D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
+        cache->c_Sets[set].cs_Tags[way], line_address));
+
+    /* Write cache back if the lines are dirty */
+    if (flags & F_DIRTY0)
+        *(uint32_t *)(uintptr_t)(line_address) = cache->c_Lines[set][way].cl_32[0];
+    if (flags & F_DIRTY1)
+        *(uint32_t *)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
+    if (flags & F_DIRTY2)
+        *(uint32_t *)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
+    if (flags & F_DIRTY3)
+        *(uint32_t *)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
+}
+
+static inline void cache_drop_way(struct Cache *cache, uint32_t set, int way)
+{
+    cache->c_Sets[set].cs_Tags[way] = 0;
+    cache->c_Sets[set].cs_Flags[way] = 0;
+    cache->c_Sets[set].cs_WaySelect &= ~(1 << way);
+}
+
+/*
+    Common hit/miss path of all reads and writes. Returns the way holding the line of given
+    address. On a miss the line is allocated if allocate is set, dirty victim is written back
+    and the line is loaded from memory if load is set. Returns -1 on a miss without allocation.
+*/
+static inline int cache_lookup(struct Cache *cache, uint32_t address, int allocate, int load)
+{
+    const uint32_t tag = GET_TAG(address);
+    const uint32_t set = GET_SET(address);
+    int way = cache_find_way(cache, set, tag);
+
+    D(kprintf("[CACHE]   set = %u, tag = %08x, way = %d\n", set, tag, way));
+
+    /* There was no valid cache line matching the tag, get one */
+    if (way == -1)
+    {
+        if (!allocate)
+            return -1;
+
+        way = cache_get_way(cache, set);
+        D(kprintf("[CACHE]   allocated way = %d\n", way));
+
+        if (cache->c_Sets[set].cs_Flags[way] & F_DIRTY)
+            cache_write_back(cache, set, way);
+
+        /* Load the cache line */
+        if (load)
+        {
+            D(kprintf("[CACHE]   loading line from address %08x\n", address & 0xfffffff0));
+            cache->c_Lines[set][way].cl_128 = *(uint128_t *)(uintptr_t)(address & 0xfffffff0);
+        }
+
+        /* Update tag, mark line as valid */
+        cache->c_Sets[set].cs_Flags[way] = 0;
+        cache->c_Sets[set].cs_Tags[way] = tag | TAG_VALID;
+    }
+
+    /* Mark LRU */
+    cache_mark_hit(cache, set, way);
+
+    return way;
+}
+
+/* Mark longwords of the line covered by access of given size as dirty */
+static inline void cache_mark_dirty(struct Cache *cache, uint32_t address, int way, uint32_t size)
+{
+    const uint32_t first = (address & 15) >> 2;
+    const uint32_t last = ((address & 15) + size - 1) >> 2;
+
+    cache->c_Sets[GET_SET(address)].cs_Flags[way] |= ((2 << last) - 1) & ~((1 << first) - 1);
 }
 
 void cache_setup()
@@ -81,19 +206,11 @@ void cache_setup()
     (kprintf("[CACHE] Cache setup. Cache sizeof=%lu\n", sizeof(struct Cache)));
     (kprintf("[CACHE] Way count: %d, Set count: %d\n", CACHE_WAY_COUNT, CACHE_SET_COUNT));
 
-    IC = (struct Cache *)tlsf_malloc(tlsf, sizeof(struct Cache));
-    DC = (struct Cache *)tlsf_malloc(tlsf, sizeof(struct Cache));
+    IC = (struct Cache *)tlsf_malloc_aligned(tlsf, sizeof(struct Cache), 64);
+    DC = (struct Cache *)tlsf_malloc_aligned(tlsf, sizeof(struct Cache), 64);
 
-    for(int i=0; i < CACHE_SET_COUNT; i++)
-    {
-        IC->c_WaySelect[i] = 0;
-        DC->c_WaySelect[i] = 0;
-        for (int j=0; j < CACHE_WAY_COUNT; j++)
-        {
-            IC->c_Flags[i][j] = 0;
-            IC->c_Tags[i][j] = 0;
-        }
-    }
+    cache_invalidate_all(ICACHE);
+    cache_invalidate_all(DCACHE);
 
     (kprintf("[CACHE] ICache @ %p, DCache @ %p\n", IC, DC));
 }
@@ -106,10 +223,11 @@ void cache_invalidate_all(enum CacheType type)
 
     for (int i=0; i < CACHE_SET_COUNT; i++)
     {
-        cache->c_WaySelect[i] = 0;
+        cache->c_Sets[i].cs_WaySelect = 0;
         for (int j=0; j < CACHE_WAY_COUNT; j++)
         {
-            cache->c_Flags[i][j] = 0;
+            cache->c_Sets[i].cs_Tags[j] = 0;
+            cache->c_Sets[i].cs_Flags[j] = 0;
         }        
     }
 }
@@ -125,58 +243,60 @@ void cache_flush_all(enum CacheType type)
 
     for (int set=0; set < CACHE_SET_COUNT; set++)
     {
-        cache->c_WaySelect[set] = 0;
         for (int way=0; way < CACHE_WAY_COUNT; way++)
         {
-            if ((cache->c_Flags[set][way] & F_VALID) && (cache->c_Flags[set][way] & (F_DIRTY0 | F_DIRTY1 | F_DIRTY2 | F_DIRTY3)) != 0)
-            {
-                uint32_t line_address = cache->c_Tags[set][way] + (set << 4);
-                D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
-                    cache->c_Tags[set][way], line_address));
-                
-                /* Write cache back if the lines are dirty */
-                if (cache->c_Flags[set][way] & F_DIRTY0)
-                    *(uint32_t *)(uintptr_t)(line_address) = cache->c_Lines[set][way].cl_32[0];
-                if (cache->c_Flags[set][way] & F_DIRTY1)
-                    *(uint32_t *)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
-                if (cache->c_Flags[set][way] & F_DIRTY2)
-                    *(uint32_t *)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
-                if (cache->c_Flags[set][way] & F_DIRTY3)
-                    *(uint32_t *)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
-            }
-            cache->c_Flags[set][way] = 0;
-        }        
+            if ((cache->c_Sets[set].cs_Tags[way] & TAG_VALID) && (cache->c_Sets[set].cs_Flags[way] & F_DIRTY))
+                cache_write_back(cache, set, way);
+
+            cache_drop_way(cache, set, way);
+        }
+        cache->c_Sets[set].cs_WaySelect = 0;
     }
 }
 
 void cache_invalidate_line(enum CacheType type, uint32_t address)
 {
     struct Cache *cache = (type == ICACHE) ? IC : DC;
+    const uint32_t set = GET_SET(address);
+    int way = cache_find_way(cache, set, GET_TAG(address));
 
     D(kprintf("[CACHE] %cCache invalidate line (%08lx)\n", type == ICACHE ? 'I':'D', address));
 
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
-
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
-    {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            cache->c_Flags[set][i] = 0;
-            cache->c_WaySelect[set] &= ~(1 << i);
-        }
-    }
+    if (way != -1)
+        cache_drop_way(cache, set, way);
 }
 
 void cache_invalidate_range(enum CacheType type, uint32_t address, uint32_t len)
 {
+    struct Cache *cache = (type == ICACHE) ? IC : DC;
     const uint64_t start = address & 0xfffffff0;
-    const uint64_t end = (address + len - 1) & 0xfffffff0;
+    const uint64_t end = ((uint64_t)address + len + 15) & ~15ULL;
+
+    if (len == 0)
+        return;
+
+    D(kprintf("[CACHE] %cCache invalidate range (%08lx, %d)\n", type == ICACHE ? 'I':'D', address, len));
+
+    /* Short range - look up every line of it */
+    if (end - start <= CACHE_SET_COUNT * 16)
+    {
+        for (uint64_t addr = start; addr < end; addr += 16)
+        {
+            cache_invalidate_line(type, addr);
+        }
+        return;
+    }
 
-    for (uint64_t addr = start; addr <= end; addr += 16)
+    /* Range covers every set of the cache, check all valid lines if they are within the range */
+    for (int set=0; set < CACHE_SET_COUNT; set++)
     {
-        cache_invalidate_line(type, addr);
+        for (int way=0; way < CACHE_WAY_COUNT; way++)
+        {
+            uint64_t line_address = (cache->c_Sets[set].cs_Tags[way] & ~TAG_VALID) + (set << 4);
+
+            if ((cache->c_Sets[set].cs_Tags[way] & TAG_VALID) && line_address >= start && line_address < end)
+                cache_drop_way(cache, set, way);
+        }
     }
 }
 
@@ -186,50 +306,29 @@ void cache_flush_line(enum CacheType type, uint32_t address)
         cache_invalidate_line(type, address);
 
     struct Cache *cache = (type == ICACHE) ? IC : DC;
-
-    D(kprintf("[CACHE] %cCache invalidate line (%08lx)\n", type == ICACHE ? 'I':'D', address));
-
-    const uint32_t tag = GET_TAG(address);
     const uint32_t set = GET_SET(address);
+    int way = cache_find_way(cache, set, GET_TAG(address));
 
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
+    D(kprintf("[CACHE] %cCache flush line (%08lx)\n", type == ICACHE ? 'I':'D', address));
+
+    if (way != -1)
     {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            uint32_t line_address = cache->c_Tags[set][i] + (set << 4);
-
-            /* Write cache back if the lines are dirty */
-            if (cache->c_Flags[set][i] & F_DIRTY0)
-                *(uint32_t *)(uintptr_t)(line_address) = cache->c_Lines[set][i].cl_32[0];
-            if (cache->c_Flags[set][i] & F_DIRTY1)
-                *(uint32_t *)(uintptr_t)(line_address + 4) = cache->c_Lines[set][i].cl_32[1];
-            if (cache->c_Flags[set][i] & F_DIRTY2)
-                *(uint32_t *)(uintptr_t)(line_address + 8) = cache->c_Lines[set][i].cl_32[2];
-            if (cache->c_Flags[set][i] & F_DIRTY3)
-                *(uint32_t *)(uintptr_t)(line_address + 12) = cache->c_Lines[set][i].cl_32[3];
-
-            cache->c_Flags[set][i] = 0;
-            cache->c_WaySelect[set] &= ~(1 << i);
-        }
+        if (cache->c_Sets[set].cs_Flags[way] & F_DIRTY)
+            cache_write_back(cache, set, way);
+
+        cache_drop_way(cache, set, way);
     }
 }
 
 uint128_t cache_read_128(enum CacheType type, uint32_t address)
 {
     struct Cache *cache = (type == ICACHE) ? IC : DC;
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
-    int way = -1;
 
     if (address >= 0x01000000)
         return *(uint128_t *)(uintptr_t)address;
 
     D(kprintf("[CACHE] %cCache read_128(%08lx)\n", type == ICACHE ? 'I':'D', address));
 
-    D(kprintf("[CACHE]   set = %u, ", set));
-    D(kprintf("tag = %08x, ", tag));
-
     if ((address & 15) != 0)
     {
         uint128_t data;
@@ -238,54 +337,8 @@ uint128_t cache_read_128(enum CacheType type, uint32_t address)
         return data;
     }
 
-        /* Check the given set and find the cache way with mathing tag and falid flag set */
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
-    {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            way = i;
-            break;
-        }
-    }
-
-    D(kprintf("way = %d\n", way));
-
-    /* There was no valid cache line matching the tag, get one */
-    if (way == -1)
-    {
-        way = cache_get_way(cache, set);
-        D(kprintf("[CACHE]   allocated way = %d\n", way));
-        if (cache->c_Flags[set][way] & F_VALID)
-        {
-            uint32_t line_address = cache->c_Tags[set][way] + (set << 4);
-            D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
-        	    cache->c_Tags[set][way], line_address));
-            
-            /* Write cache back if the lines are dirty */
-            if (cache->c_Flags[set][way] & F_DIRTY0)
-                *(uint32_t*)(uintptr_t)line_address = cache->c_Lines[set][way].cl_32[0];
-            if (cache->c_Flags[set][way] & F_DIRTY1)
-                *(uint32_t*)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
-            if (cache->c_Flags[set][way] & F_DIRTY2)
-                *(uint32_t*)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
-            if (cache->c_Flags[set][way] & F_DIRTY3)
-                *(uint32_t*)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
-        }
-
-        /* Load the cache line */
-        D(kprintf("[CACHE]   loading line from address %08x\n", address & 0xfffffff0));
-        cache->c_Lines[set][way].cl_128 = *(uint128_t *)(uintptr_t)(address & 0xfffffff0);
-
-        /* Update tag, mark page as valid */
-        cache->c_Flags[set][way] = F_VALID;
-        cache->c_Tags[set][way] = tag;
-    }
-
-    /* Mark LRUm */
-    cache_mark_hit(cache, set, way);
-
-    uint128_t data = cache->c_Lines[set][way].cl_128;
+    int way = cache_lookup(cache, address, 1, 1);
+    uint128_t data = cache->c_Lines[GET_SET(address)][way].cl_128;
 
     D(kprintf("[CACHE]   => %016lx%016lx\n", data.hi, data.lo));
 
@@ -295,18 +348,12 @@ uint128_t cache_read_128(enum CacheType type, uint32_t address)
 uint64_t cache_read_64(enum CacheType type, uint32_t address)
 {
     struct Cache *cache = (type == ICACHE) ? IC : DC;
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
-    int way = -1;
 
     if (address >= 0x01000000)
         return *(uint64_t *)(uintptr_t)address;
 
     D(kprintf("[CACHE] %cCache read_64(%08lx)\n", type == ICACHE ? 'I':'D', address));
 
-    D(kprintf("[CACHE]   set = %u, ", set));
-    D(kprintf("tag = %08x, ", tag));
-
     if ((address & 15) > 8)
     {
         uint64_t data = 0;
@@ -353,54 +400,8 @@ uint64_t cache_read_64(enum CacheType type, uint32_t address)
         return data;
     }
 
-    /* Check the given set and find the cache way with mathing tag and falid flag set */
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
-    {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            way = i;
-            break;
-        }
-    }
-
-    D(kprintf("way = %d\n", way));
-
-    /* There was no valid cache line matching the tag, get one */
-    if (way == -1)
-    {
-        way = cache_get_way(cache, set);
-        D(kprintf("[CACHE]   allocated way = %d\n", way));
-        if (cache->c_Flags[set][way] & F_VALID)
-        {
-            uint32_t line_address = cache->c_Tags[set][way] + (set << 4);
-            D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
-        	    cache->c_Tags[set * CACHE_WAY_COUNT + way], line_address));
-            
-            /* Write cache back if the lines are dirty */
-            if (cache->c_Flags[set][way] & F_DIRTY0)
-                *(uint32_t*)(uintptr_t)line_address = cache->c_Lines[set][way].cl_32[0];
-            if (cache->c_Flags[set][way] & F_DIRTY1)
-                *(uint32_t*)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
-            if (cache->c_Flags[set][way] & F_DIRTY2)
-                *(uint32_t*)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
-            if (cache->c_Flags[set][way] & F_DIRTY3)
-                *(uint32_t*)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
-        }
-
-        /* Load the cache line */
-        D(kprintf("[CACHE]   loading line from address %08x\n", address & 0xfffffff0));
-        cache->c_Lines[set][way].cl_128 = *(uint128_t *)(uintptr_t)(address & 0xfffffff0);
-
-        /* Update tag, mark page as valid */
-        cache->c_Flags[set][way] = F_VALID;
-        cache->c_Tags[set][way] = tag;
-    }
-
-    /* Mark LRUm */
-    cache_mark_hit(cache, set, way);
-
-    uint64_t data = *(uint64_t *)&cache->c_Lines[set][way].cl_8[address & 15];
+    int way = cache_lookup(cache, address, 1, 1);
+    uint64_t data = *(uint64_t *)&cache->c_Lines[GET_SET(address)][way].cl_8[address & 15];
 
     D(kprintf("[CACHE]   => %016lx\n", data));
 
@@ -410,18 +411,12 @@ uint64_t cache_read_64(enum CacheType type, uint32_t address)
 uint32_t cache_read_32(enum CacheType type, uint32_t address)
 {
     struct Cache *cache = (type == ICACHE) ? IC : DC;
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
-    int way = -1;
 
     if (address >= 0x01000000)
         return *(uint32_t *)(uintptr_t)address;
 
     D(kprintf("[CACHE] %cCache read_32(%08lx)\n", type == ICACHE ? 'I':'D', address));
 
-    D(kprintf("[CACHE]   set = %u, ", set));
-    D(kprintf("tag = %08x, ", tag));
-
     if ((address & 15) > 12)
     {
         uint32_t data;
@@ -446,54 +441,9 @@ uint32_t cache_read_32(enum CacheType type, uint32_t address)
         return data;
     }
 
-    /* Check the given set and find the cache way with mathing tag and falid flag set */
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
-    {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            way = i;
-            break;
-        }
-    }
-
-    D(kprintf("way = %d\n", way));
-
-    /* There was no valid cache line matching the tag, get one */
-    if (way == -1)
-    {
-        way = cache_get_way(cache, set);
-        D(kprintf("[CACHE]   allocated way = %d\n", way));
-        if (cache->c_Flags[set][way] & F_VALID)
-        {
-            uint32_t line_address = cache->c_Tags[set][way] + (set << 4);
-            D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
-        	    cache->c_Tags[set][way], line_address));
-            
-            /* Write cache back if the lines are dirty */
-            if (cache->c_Flags[set][way] & F_DIRTY0)
-                *(uint32_t*)(uintptr_t)line_address = cache->c_Lines[set][way].cl_32[0];
-            if (cache->c_Flags[set][way] & F_DIRTY1)
-                *(uint32_t*)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
-            if (cache->c_Flags[set][way] & F_DIRTY2)
-                *(uint32_t*)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
-            if (cache->c_Flags[set][way] & F_DIRTY3)
-                *(uint32_t*)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
-        }
-
-        /* Load the cache line */
-        D(kprintf("[CACHE]   loading line from address %08x\n", address & 0xfffffff0));
-        cache->c_Lines[set][way].cl_128 = *(uint128_t *)(uintptr_t)(address & 0xfffffff0);
-
-        /* Update tag, mark page as valid */
-        cache->c_Flags[set][way] = F_VALID;
-        cache->c_Tags[set][way] = tag;
-    }
-
-    /* Mark LRUm */
-    cache_mark_hit(cache, set, way);
+    int way = cache_lookup(cache, address, 1, 1);
+    uint32_t data = *(uint32_t *)&cache->c_Lines[GET_SET(address)][way].cl_8[address & 15];
 
-    uint32_t data = *(uint32_t *)&cache->c_Lines[set][way].cl_8[address & 15];
     D(kprintf("[CACHE]   => %08x\n", data));
 
     return data;
@@ -502,18 +452,12 @@ uint32_t cache_read_32(enum CacheType type, uint32_t address)
 uint16_t cache_read_16(enum CacheType type, uint32_t address)
 {
     struct Cache *cache = (type == ICACHE) ? IC : DC;
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
-    int way = -1;
 
     if (address >= 0x01000000)
         return *(uint16_t *)(uintptr_t)address;
 
     D(kprintf("[CACHE] %cCache read_16(%08lx)\n", type == ICACHE ? 'I':'D', address));
 
-    D(kprintf("[CACHE]   set = %u, ", set));
-    D(kprintf("tag = %08x, ", tag));
-
     if ((address & 15) > 14)
     {
         uint16_t data = cache_read_8(type, address) << 8;
@@ -522,54 +466,9 @@ uint16_t cache_read_16(enum CacheType type, uint32_t address)
         return data;
     }
 
-    /* Check the given set and find the cache way with mathing tag and falid flag set */
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
-    {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            way = i;
-            break;
-        }
-    }
-
-    D(kprintf("way = %d\n", way));
-
-    /* There was no valid cache line matching the tag, get one */
-    if (way == -1)
-    {
-        way = cache_get_way(cache, set);
-        D(kprintf("[CACHE]   allocated way = %d\n", way));
-        if (cache->c_Flags[set][way] & F_VALID)
-        {
-            uint32_t line_address = cache->c_Tags[set][way] + (set << 4);
-            D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
-        	    cache->c_Tags[set][way], line_address));
-            
-            /* Write cache back if the lines are dirty */
-            if (cache->c_Flags[set][way] & F_DIRTY0)
-                *(uint32_t*)(uintptr_t)line_address = cache->c_Lines[set][way].cl_32[0];
-            if (cache->c_Flags[set][way] & F_DIRTY1)
-                *(uint32_t*)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
-            if (cache->c_Flags[set][way] & F_DIRTY2)
-                *(uint32_t*)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
-            if (cache->c_Flags[set][way] & F_DIRTY3)
-                *(uint32_t*)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
-        }
-
-        /* Load the cache line */
-        //kprintf("[CACHE]   loading line from address %08x\n", address & 0xfffffff0);
-        cache->c_Lines[set][way].cl_128 = *(uint128_t *)(uintptr_t)(address & 0xfffffff0);
-
-        /* Update tag, mark page as valid */
-        cache->c_Flags[set][way] = F_VALID;
-        cache->c_Tags[set][way] = tag;
-    }
-
-    /* Mark LRUm */
-    cache_mark_hit(cache, set, way);
+    int way = cache_lookup(cache, address, 1, 1);
+    uint16_t data = *(uint16_t *)(void *)&cache->c_Lines[GET_SET(address)][way].cl_8[address & 15];
 
-    uint16_t data = *(uint16_t *)(void *)&cache->c_Lines[set][way].cl_8[address & 15];
     D(kprintf("[CACHE]   => %04x\n", data));
 
     return data;
@@ -578,146 +477,48 @@ uint16_t cache_read_16(enum CacheType type, uint32_t address)
 uint8_t cache_read_8(enum CacheType type, uint32_t address)
 {
     struct Cache *cache = (type == ICACHE) ? IC : DC;
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
-    int way = -1;
 
     if (address >= 0x01000000)
         return *(uint8_t *)(uintptr_t)address;
 
     D(kprintf("[CACHE] %cCache read_8(%08lx)\n", type == ICACHE ? 'I':'D', address));
 
-    D(kprintf("[CACHE]   set = %u, ", set));
-    D(kprintf("tag = %08x, ", tag));
-
-    /* Check the given set and find the cache way with mathing tag and falid flag set */
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
-    {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            way = i;
-            break;
-        }
-    }
-
-    D(kprintf("way = %d\n", way));
-
-    /* There was no valid cache line matching the tag, get one */
-    if (way == -1)
-    {
-        way = cache_get_way(cache, set);
-        D(kprintf("[CACHE]   allocated way = %d\n", way));
-        if (cache->c_Flags[set][way] & F_VALID)
-        {
-            uint32_t line_address = cache->c_Tags[set][way] + (set << 4);
-            D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
-        	    cache->c_Tags[set][way], line_address));
-            
-            /* Write cache back if the lines are dirty */
-            if (cache->c_Flags[set][way] & F_DIRTY0)
-                *(uint32_t*)(uintptr_t)line_address = cache->c_Lines[set][way].cl_32[0];
-            if (cache->c_Flags[set][way] & F_DIRTY1)
-                *(uint32_t*)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
-            if (cache->c_Flags[set][way] & F_DIRTY2)
-                *(uint32_t*)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
-            if (cache->c_Flags[set][way] & F_DIRTY3)
-                *(uint32_t*)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
-        }
-
-        /* Load the cache line */
-        D(kprintf("[CACHE]   loading line from address %08x\n", address & 0xfffffff0));
-        cache->c_Lines[set][way].cl_128 = *(uint128_t *)(uintptr_t)(address & 0xfffffff0);
-
-        /* Update tag, mark page as valid */
-        cache->c_Flags[set][way] = F_VALID;
-        cache->c_Tags[set][way] = tag;
-    }
-
-    /* Mark LRUm */
-    cache_mark_hit(cache, set, way);
-
-    uint8_t data = cache->c_Lines[set][way].cl_8[address & 15];
+    int way = cache_lookup(cache, address, 1, 1);
+    uint8_t data = cache->c_Lines[GET_SET(address)][way].cl_8[address & 15];
 
     D(kprintf("[CACHE]   => %02x\n", data));
 
     return data;
 }
 
+/*
+    Writes spanning over two cache lines are not handled and return 0. On a miss write-through
+    cache does not allocate the line and returns 0, the caller performs direct write then.
+*/
+
 int cache_write_128(enum CacheType type, uint32_t address, uint128_t data, uint8_t write_back)
 {
     struct Cache *cache = (type == ICACHE) ? IC : DC;
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
-    int way = -1;
 
     D(kprintf("[CACHE] %cCache write_128(%08lx, %016lx%016lx, %x)\n", type == ICACHE ? 'I':'D', address, data.hi, data.lo, write_back));
 
-    D(kprintf("[CACHE]   set = %u, ", set));
-    D(kprintf("tag = %08x, ", tag));
-
     if ((address & 15) != 0)
     {
         D(kprintf("[CACHE] Accessed data spans over two cache lines, aborting\n"));
         return 0;
     }
 
-    /* Check the given set and find the cache way with mathing tag and falid flag set */
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
-    {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            way = i;
-            break;
-        }
-    }
-
-    D(kprintf("way = %d\n", way));
-
-    /* There was no valid cache line matching the tag */
+    /* No need to load cache line here, it gets overwritten and marked dirty immediately */
+    int way = cache_lookup(cache, address, write_back, 0);
     if (way == -1)
-    {
-        /* Write-through cache does not load cache line, performs direct write instead */
-        if (write_back == 0)
-            return 0;
-
-        /* Write-back cache loads whole cache line and updates the value */
-        way = cache_get_way(cache, set);
-        D(kprintf("[CACHE]   allocated way = %d\n", way));
-        if (cache->c_Flags[set][way] & F_VALID)
-        {
-            uint32_t line_address = cache->c_Tags[set][way] + (set << 4);
-            D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
-        	    cache->c_Tags[set][way], line_address));
-            
-            /* Write cache back if the lines are dirty */
-            if (cache->c_Flags[set][way] & F_DIRTY0)
-                *(uint32_t*)(uintptr_t)line_address = cache->c_Lines[set][way].cl_32[0];
-            if (cache->c_Flags[set][way] & F_DIRTY1)
-                *(uint32_t*)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
-            if (cache->c_Flags[set][way] & F_DIRTY2)
-                *(uint32_t*)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
-            if (cache->c_Flags[set][way] & F_DIRTY3)
-                *(uint32_t*)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
-        }
-
-        /* No need to load cache line here, it gets overwritten and marked dirty immediately */
-
-        /* Update tag, mark page as valid */
-        cache->c_Flags[set][way] = F_VALID;
-        cache->c_Tags[set][way] = tag;
-    }
-
-    /* Mark LRUm */
-    cache_mark_hit(cache, set, way);
+        return 0;
 
-    cache->c_Lines[set][way].cl_128 = data;
+    cache->c_Lines[GET_SET(address)][way].cl_128 = data;
 
     if (write_back)
     {
         /* Write-back cache marks the portion of cache line as dirty */
-        cache->c_Flags[set][way] |= F_DIRTY0 | F_DIRTY1 | F_DIRTY2 | F_DIRTY3;
+        cache_mark_dirty(cache, address, way, 16);
     }
     else
     {
@@ -731,94 +532,25 @@ int cache_write_128(enum CacheType type, uint32_t address, uint128_t data, uint8
 int cache_write_64(enum CacheType type, uint32_t address, uint64_t data, uint8_t write_back)
 {
     struct Cache *cache = (type == ICACHE) ? IC : DC;
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
-    int way = -1;
 
     D(kprintf("[CACHE] %cCache write_64(%08lx, %016lx, %x)\n", type == ICACHE ? 'I':'D', address, data, write_back));
 
-    D(kprintf("[CACHE]   set = %u, ", set));
-    D(kprintf("tag = %08x, ", tag));
-
     if ((address & 15) > 8)
     {
         D(kprintf("[CACHE] Accessed data spans over two cache lines, aborting\n"));
         return 0;
     }
 
-    /* Check the given set and find the cache way with mathing tag and falid flag set */
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
-    {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            way = i;
-            break;
-        }
-    }
-
-    D(kprintf("way = %d\n", way));
-
-    /* There was no valid cache line matching the tag */
+    int way = cache_lookup(cache, address, write_back, 1);
     if (way == -1)
-    {
-        /* Write-through cache does not load cache line, performs direct write instead */
-        if (write_back == 0)
-            return 0;
-
-        /* Write-back cache loads whole cache line and updates the value */
-        way = cache_get_way(cache, set);
-        D(kprintf("[CACHE]   allocated way = %d\n", way));
-        if (cache->c_Flags[set][way] & F_VALID)
-        {
-            uint32_t line_address = cache->c_Tags[set][way] + (set << 4);
-            D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
-        	    cache->c_Tags[set][way], line_address));
-            
-            /* Write cache back if the lines are dirty */
-            if (cache->c_Flags[set][way] & F_DIRTY0)
-                *(uint32_t*)(uintptr_t)line_address = cache->c_Lines[set][way].cl_32[0];
-            if (cache->c_Flags[set][way] & F_DIRTY1)
-                *(uint32_t*)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
-            if (cache->c_Flags[set][way] & F_DIRTY2)
-                *(uint32_t*)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
-            if (cache->c_Flags[set][way] & F_DIRTY3)
-                *(uint32_t*)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
-        }
-
-        /* Load the cache line */
-        D(kprintf("[CACHE]   loading line from address %08x\n", address & 0xfffffff0));
-        cache->c_Lines[set][way].cl_128 = *(uint128_t *)(uintptr_t)(address & 0xfffffff0);
-
-        /* Update tag, mark page as valid */
-        cache->c_Flags[set][way] = F_VALID;
-        cache->c_Tags[set][way] = tag;
-    }
-
-    /* Mark LRUm */
-    cache_mark_hit(cache, set, way);
+        return 0;
 
-    (*(uint64_t *)(void*)&cache->c_Lines[set][way].cl_8[address & 15]) = data;
+    (*(uint64_t *)(void*)&cache->c_Lines[GET_SET(address)][way].cl_8[address & 15]) = data;
 
     if (write_back)
     {
         /* Write-back cache marks the portion of cache line as dirty */
-        switch((address >> 2) & 3)
-        {
-            case 0:
-                cache->c_Flags[set][way] |= F_DIRTY0 | F_DIRTY1;
-                if ((((address + 7) >> 2) & 3) == 2)
-                    cache->c_Flags[set][way] |= F_DIRTY2;
-                break;
-            case 1:
-                cache->c_Flags[set][way] |= F_DIRTY1 | F_DIRTY2;
-                if ((((address + 7) >> 2) & 3) == 3)
-                    cache->c_Flags[set][way] |= F_DIRTY3;
-                break;
-            case 2:
-                cache->c_Flags[set][way] |= F_DIRTY2 | F_DIRTY3;
-                break;
-        }
+        cache_mark_dirty(cache, address, way, 8);
     }
     else
     {
@@ -832,99 +564,25 @@ int cache_write_64(enum CacheType type, uint32_t address, uint64_t data, uint8_t
 int cache_write_32(enum CacheType type, uint32_t address, uint32_t data, uint8_t write_back)
 {
     struct Cache *cache = (type == ICACHE) ? IC : DC;
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
-    int way = -1;
 
     D(kprintf("[CACHE] %cCache write_32(%08lx, %08x, %x)\n", type == ICACHE ? 'I':'D', address, data, write_back));
 
-    D(kprintf("[CACHE]   set = %u, ", set));
-    D(kprintf("tag = %08x, ", tag));
-
     if ((address & 15) > 12)
     {
         D(kprintf("[CACHE] Accessed data spans over two cache lines, aborting\n"));
         return 0;
     }
 
-    /* Check the given set and find the cache way with mathing tag and falid flag set */
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
-    {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            way = i;
-            break;
-        }
-    }
-
-    D(kprintf("way = %d\n", way));
-
-    /* There was no valid cache line matching the tag */
+    int way = cache_lookup(cache, address, write_back, 1);
     if (way == -1)
-    {
-        /* Write-through cache does not load cache line, performs direct write instead */
-        if (write_back == 0)
-            return 0;
-
-        /* Write-back cache loads whole cache line and updates the value */
-        way = cache_get_way(cache, set);
-        D(kprintf("[CACHE]   allocated way = %d\n", way));
-        if (cache->c_Flags[set][way] & F_VALID)
-        {
-            uint32_t line_address = cache->c_Tags[set][way] + (set << 4);
-            D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
-        	    cache->c_Tags[set][way], line_address));
-            
-            /* Write cache back if the lines are dirty */
-            if (cache->c_Flags[set][way] & F_DIRTY0)
-                *(uint32_t*)(uintptr_t)line_address = cache->c_Lines[set][way].cl_32[0];
-            if (cache->c_Flags[set][way] & F_DIRTY1)
-                *(uint32_t*)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
-            if (cache->c_Flags[set][way] & F_DIRTY2)
-                *(uint32_t*)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
-            if (cache->c_Flags[set][way] & F_DIRTY3)
-                *(uint32_t*)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
-        }
-
-        /* Load the cache line */
-        D(kprintf("[CACHE]   loading line from address %08x\n", address & 0xfffffff0));
-        cache->c_Lines[set][way].cl_128 = *(uint128_t *)(uintptr_t)(address & 0xfffffff0);
-
-        /* Update tag, mark page as valid */
-        cache->c_Flags[set][way] = F_VALID;
-        cache->c_Tags[set][way] = tag;
-    }
-
-    /* Mark LRUm */
-    cache_mark_hit(cache, set, way);
+        return 0;
 
-    (*(uint32_t *)(void*)&cache->c_Lines[set][way].cl_8[address & 15]) = data;
+    (*(uint32_t *)(void*)&cache->c_Lines[GET_SET(address)][way].cl_8[address & 15]) = data;
 
     if (write_back)
     {
         /* Write-back cache marks the portion of cache line as dirty */
-        switch((address >> 2) & 3)
-        {
-            case 0:
-                cache->c_Flags[set][way] |= F_DIRTY0;
-                if ((((address + 3) >> 2) & 3) == 1)
-                    cache->c_Flags[set][way] |= F_DIRTY1;
-                break;
-            case 1:
-                cache->c_Flags[set][way] |= F_DIRTY1;
-                if ((((address + 3) >> 2) & 3) == 2)
-                    cache->c_Flags[set][way] |= F_DIRTY2;
-                break;
-            case 2:
-                cache->c_Flags[set][way] |= F_DIRTY2;
-                if ((((address + 3) >> 2) & 3) == 3)
-                    cache->c_Flags[set][way] |= F_DIRTY3;
-                break;
-            case 3:
-                cache->c_Flags[set][way] |= F_DIRTY3;
-                break;
-        }
+        cache_mark_dirty(cache, address, way, 4);
     }
     else
     {
@@ -935,103 +593,28 @@ int cache_write_32(enum CacheType type, uint32_t address, uint32_t data, uint8_t
     return 1;
 }
 
-
 int cache_write_16(enum CacheType type, uint32_t address, uint16_t data, uint8_t write_back)
 {
     struct Cache *cache = (type == ICACHE) ? IC : DC;
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
-    int way = -1;
 
     D(kprintf("[CACHE] %cCache write_16(%08lx, %04x, %x)\n", type == ICACHE ? 'I':'D', address, data, write_back));
 
-    D(kprintf("[CACHE]   set = %u, ", set));
-    D(kprintf("tag = %08x, ", tag));
-
     if ((address & 15) > 14)
     {
         D(kprintf("[CACHE] Accessed data spans over two cache lines, aborting\n"));
         return 0;
     }
 
-    /* Check the given set and find the cache way with mathing tag and falid flag set */
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
-    {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            way = i;
-            break;
-        }
-    }
-
-    D(kprintf("way = %d\n", way));
-
-    /* There was no valid cache line matching the tag */
+    int way = cache_lookup(cache, address, write_back, 1);
     if (way == -1)
-    {
-        /* Write-through cache does not load cache line, performs direct write instead */
-        if (write_back == 0)
-            return 0;
-
-        /* Write-back cache loads whole cache line and updates the value */
-        way = cache_get_way(cache, set);
-        D(kprintf("[CACHE]   allocated way = %d\n", way));
-        if (cache->c_Flags[set][way] & F_VALID)
-        {
-            uint32_t line_address = cache->c_Tags[set][way] + (set << 4);
-            D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
-        	    cache->c_Tags[set][way], line_address));
-            
-            /* Write cache back if the lines are dirty */
-            if (cache->c_Flags[set][way] & F_DIRTY0)
-                *(uint32_t*)(uintptr_t)line_address = cache->c_Lines[set][way].cl_32[0];
-            if (cache->c_Flags[set][way] & F_DIRTY1)
-                *(uint32_t*)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
-            if (cache->c_Flags[set][way] & F_DIRTY2)
-                *(uint32_t*)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
-            if (cache->c_Flags[set][way] & F_DIRTY3)
-                *(uint32_t*)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
-        }
-
-        /* Load the cache line */
-        D(kprintf("[CACHE]   loading line from address %08x\n", address & 0xfffffff0));
-        cache->c_Lines[set][way].cl_128 = *(uint128_t *)(uintptr_t)(address & 0xfffffff0);
-
-        /* Update tag, mark page as valid */
-        cache->c_Flags[set][way] = F_VALID;
-        cache->c_Tags[set][way] = tag;
-    }
-
-    /* Mark LRUm */
-    cache_mark_hit(cache, set, way);
+        return 0;
 
-    (*(uint16_t *)(void*)&cache->c_Lines[set][way].cl_8[address & 15]) = data;
+    (*(uint16_t *)(void*)&cache->c_Lines[GET_SET(address)][way].cl_8[address & 15]) = data;
 
     if (write_back)
     {
         /* Write-back cache marks the portion of cache line as dirty */
-        switch((address >> 2) & 3)
-        {
-            case 0:
-                cache->c_Flags[set][way] |= F_DIRTY0;
-                if ((((address + 1) >> 2) & 3) == 1)
-                    cache->c_Flags[set][way] |= F_DIRTY1;
-                break;
-            case 1:
-                cache->c_Flags[set][way] |= F_DIRTY1;
-                if ((((address + 1) >> 2) & 3) == 2)
-                    cache->c_Flags[set][way] |= F_DIRTY2;
-                break;
-            case 2:
-                cache->c_Flags[set][way] |= F_DIRTY2;
-                if ((((address + 1) >> 2) & 3) == 3)
-                    cache->c_Flags[set][way] |= F_DIRTY3;
-                break;
-            case 3:
-                cache->c_Flags[set][way] |= F_DIRTY3;
-                break;
-        }
+        cache_mark_dirty(cache, address, way, 2);
     }
     else
     {
@@ -1045,87 +628,19 @@ int cache_write_16(enum CacheType type, uint32_t address, uint16_t data, uint8_t
 int cache_write_8(enum CacheType type, uint32_t address, uint8_t data, uint8_t write_back)
 {
     struct Cache *cache = (type == ICACHE) ? IC : DC;
-    const uint32_t tag = GET_TAG(address);
-    const uint32_t set = GET_SET(address);
-    int way = -1;
 
     D(kprintf("[CACHE] %cCache write_8(%08lx, %02x, %x)\n", type == ICACHE ? 'I':'D', address, data, write_back));
 
-    D(kprintf("[CACHE]   set = %u, ", set));
-    D(kprintf("tag = %08x, ", tag));
-
-    /* Check the given set and find the cache way with mathing tag and falid flag set */
-    for (unsigned i=0; i < CACHE_WAY_COUNT; i++)
-    {
-        if ((cache->c_Tags[set][i] == tag) &&
-            (cache->c_Flags[set][i] & F_VALID))
-        {
-            way = i;
-            break;
-        }
-    }
-
-    D(kprintf("way = %d\n", way));
-
-    /* There was no valid cache line matching the tag */
+    int way = cache_lookup(cache, address, write_back, 1);
     if (way == -1)
-    {
-        /* Write-through cache does not load cache line, performs direct write instead */
-        if (write_back == 0)
-            return 0;
-
-        /* Write-back cache loads whole cache line and updates the value */
-        way = cache_get_way(cache, set);
-        D(kprintf("[CACHE]   allocated way = %d\n", way));
-        if (cache->c_Flags[set][way] & F_VALID)
-        {
-            uint32_t line_address = cache->c_Tags[set][way] + (set << 4);
-            D(kprintf("[CACHE]   cache line was previously used, tag=%08x, address=%08x, flushing\n",
-        	    cache->c_Tags[set][way], line_address));
-            
-            /* Write cache back if the lines are dirty */
-            if (cache->c_Flags[set][way] & F_DIRTY0)
-                *(uint32_t*)(uintptr_t)line_address = cache->c_Lines[set][way].cl_32[0];
-            if (cache->c_Flags[set][way] & F_DIRTY1)
-                *(uint32_t*)(uintptr_t)(line_address + 4) = cache->c_Lines[set][way].cl_32[1];
-            if (cache->c_Flags[set][way] & F_DIRTY2)
-                *(uint32_t*)(uintptr_t)(line_address + 8) = cache->c_Lines[set][way].cl_32[2];
-            if (cache->c_Flags[set][way] & F_DIRTY3)
-                *(uint32_t*)(uintptr_t)(line_address + 12) = cache->c_Lines[set][way].cl_32[3];
-        }
-
-        /* Load the cache line */
-        D(kprintf("[CACHE]   loading line from address %08x\n", address & 0xfffffff0));
-        cache->c_Lines[set][way].cl_128 = *(uint128_t *)(uintptr_t)(address & 0xfffffff0);
-
-        /* Update tag, mark page as valid */
-        cache->c_Flags[set][way] = F_VALID;
-        cache->c_Tags[set][way] = tag;
-    }
-
-    /* Mark LRUm */
-    cache_mark_hit(cache, set, way);
+        return 0;
 
-    cache->c_Lines[set][way].cl_8[address & 15] = data;
+    cache->c_Lines[GET_SET(address)][way].cl_8[address & 15] = data;
 
     if (write_back)
     {
         /* Write-back cache marks the portion of cache line as dirty */
-        switch((address >> 2) & 3)
-        {
-            case 0:
-                cache->c_Flags[set][way] |= F_DIRTY0;
-                break;
-            case 1:
-                cache->c_Flags[set][way] |= F_DIRTY1;
-                break;
-            case 2:
-                cache->c_Flags[set][way] |= F_DIRTY2;
-                break;
-            case 3:
-                cache->c_Flags[set][way] |= F_DIRTY3;
-                break;
-        }
+        cache_mark_dirty(cache, address, way, 1);
     }
     else
     {
@@ -1135,4 +650,3 @@ int cache_write_8(enum CacheType type, uint32_t address, uint8_t data, uint8_t w
 
     return 1;
 }
-
@@ -17,6 +17,7 @@
 #include "M68k.h"
 #include "cache.h"
 #include "intc.h"
+#include "JITStats.h"
 
 volatile unsigned int *gpio;
 volatile unsigned int *gpclk;
@@ -883,6 +884,8 @@ void ps_housekeeper()
             if (__m68k_state->INTF.IPL)
                 asm volatile("sev":::"memory");
 
+            JITStat_Periodic();
+
             if ((pin & (1 << PIN_RESET)) == 0 && ignore_reset == 0) {
                 kprintf("[HKEEP] Houskeeper will reset RasPi now...\n");
 
@@ -1223,6 +1226,18 @@ uint128_t ps_read_128(unsigned int address)
     return res;
 }
 
+void ps_read_block(unsigned int address, uint32_t *data, unsigned int count)
+{
+    for (unsigned int i=0; i < count; i++)
+        data[i] = ps_read_32(address + 4 * i);
+}
+
+void ps_write_block(unsigned int address, const uint32_t *data, unsigned int count)
+{
+    for (unsigned int i=0; i < count; i++)
+        ps_write_32(address + 4 * i, data[i]);
+}
+
 void put_char(uint8_t c);
 void putByte(void *io_base, char chr);
 
@@ -17,9 +17,11 @@
 #include "M68k.h"
 #include "cache.h"
 #include "intc.h"
+#include "JITStats.h"
 
 extern struct M68KState *__m68k_state;
 
+#if !PISTORM_SIM
 static inline uint64_t get_microseconds()
 {
     volatile struct
@@ -100,6 +102,7 @@ static inline void ticksleep_wfe(uint64_t ticks)
         asm volatile("wfe");
     } while (t1 < t0);
 }
+#endif
 
 // REG_STATUS
 #define STATUS_IS_BM (1 << 0)
@@ -253,6 +256,26 @@ static int slot_active[2] = {0, 0};
 #define REG_SLOT 5
 #define CONTROL_INC_EXEC_SLOT (1 << 5)
 
+#if PISTORM_SIM
+
+/*
+    Simulated PiStorm (ps_sim.c), used to run the bus protocol on a host or in the virt target.
+    Register accesses and the TXN pin go to the simulation, everything above is unchanged.
+*/
+#include "ps_sim.h"
+
+static inline void set_input() { ps_sim_set_input(); }
+static inline void set_output() { ps_sim_set_output(); }
+static inline uint32_t wait_txn() { return ps_sim_wait_txn(); }
+static inline uint32_t read_ps_reg_ps16(uint32_t address) { return ps_sim_read_reg(address); }
+static inline uint32_t read_ps_reg_ps32(uint32_t address) { return ps_sim_read_reg(address); }
+static inline uint32_t read_ps_reg_with_wait_ps16(uint32_t address) { return ps_sim_read_reg_with_wait(address); }
+static inline uint32_t read_ps_reg_with_wait_ps32(uint32_t address) { return ps_sim_read_reg_with_wait(address); }
+static inline void write_ps_reg_ps16(uint32_t address, uint16_t data) { ps_sim_write_reg(address, data); }
+static inline void write_ps_reg_ps32(uint32_t address, uint16_t data) { ps_sim_write_reg(address, data); }
+
+#else
+
 static inline void set_input()
 {
     GPIO->GPFSEL0 = INPUT[0];
@@ -393,6 +416,8 @@ static inline void write_ps_reg_ps32(uint32_t address, uint16_t data)
     GPIO->GPCLR0 = CLEAR_BITS;
 }
 
+#endif
+
 // Pointers to functions talking with PiStorm - selected depending on detected
 // PiStorm model
 
@@ -400,8 +425,72 @@ void (*write_ps_reg)(uint32_t address, uint16_t data);
 uint32_t (*read_ps_reg)(uint32_t address);
 uint32_t (*read_ps_reg_with_wait)(uint32_t address);
 
+#if PISTORM_WRITE_QUEUE
+
+/*
+    Posted writes on PiStorm32. Stores to CHIP memory are not performed by CPU0, they are put into
+    the queue and written to the bus by the housekeeper on CPU2 instead, so that CPU0 can continue
+    executing m68k code without waiting for the bus cycle. The queue is a single producer, single
+    consumer ring. CPU0 advances wq_head only, CPU2 advances wq_tail only after the write is done.
+
+    There is only one bus and it belongs to CPU2 as long as the queue is not empty. Every other access
+    from CPU0 (all reads, writes to CIA, chipset and any other area, PiStorm registers) waits until the
+    queue is drained first. In consequence all bus cycles are performed in the order issued by m68k
+    code, a read always sees data of pending writes and writes to INTENA/INTREQ or the blitter keep
+    their strict semantics.
+*/
+
+struct WriteRequest {
+    uint32_t  wr_addr;
+    uint32_t  wr_value;
+    uint8_t   wr_size;
+};
+
+static struct WriteRequest wq_buffer[PISTORM_WRITE_QUEUE];
+static volatile uint32_t wq_head;
+static volatile uint32_t wq_tail;
+extern volatile int housekeeper_enabled;
+
+/* Wait until CPU2 has written all posted data and gave the bus back */
+static inline void wq_drain()
+{
+    while (__atomic_load_n(&wq_tail, __ATOMIC_ACQUIRE) != wq_head)
+        asm volatile("yield");
+}
+
+static inline int wq_can_post(unsigned int address, unsigned int size)
+{
+    if (__m68k_state == NULL || !(__m68k_state->JIT_CONTROL2 & JC2F_POSTED_WRITES) || !housekeeper_enabled)
+        return 0;
+
+    return (address & 0xffffff) + size <= 0x00200000;
+}
+
+static inline void wq_push(unsigned int address, unsigned int value, unsigned int size)
+{
+    uint32_t head = wq_head;
+
+    while (head - __atomic_load_n(&wq_tail, __ATOMIC_ACQUIRE) >= PISTORM_WRITE_QUEUE)
+        asm volatile("yield");
+
+    wq_buffer[head & (PISTORM_WRITE_QUEUE - 1)].wr_addr = address;
+    wq_buffer[head & (PISTORM_WRITE_QUEUE - 1)].wr_value = value;
+    wq_buffer[head & (PISTORM_WRITE_QUEUE - 1)].wr_size = size;
+
+    __atomic_store_n(&wq_head, head + 1, __ATOMIC_RELEASE);
+
+    asm volatile("sev");
+}
+
+#else
+
+static inline void wq_drain() {}
+
+#endif
+
 void ps_set_control(uint32_t value)
 {
+    wq_drain();
     set_output();
     write_ps_reg(REG_CONTROL, 0x8000 | (value & 0x7fff));
     set_input();
@@ -409,11 +498,13 @@ void ps_set_control(uint32_t value)
 
 void ps_clr_control(uint32_t value)
 {
+    wq_drain();
     set_output();
     write_ps_reg(REG_CONTROL, value & 0x7fff);
     set_input();
 }
 
+#if !PISTORM_SIM
 void ps_efinix_setup(uint8_t pistorm_model)
 {
     // set programming pins to output
@@ -841,6 +932,7 @@ void fastSerial_init()
 
     fastSerial_reset();
 }
+#endif
 
 static int write_pending = 0;
 static uint8_t g_fc = 0;
@@ -1205,6 +1297,91 @@ static inline uint128_t ps32_do_read_access_128_2s(unsigned int address)
     return data;
 }
 
+/*
+    Block transfers of count longwords. Writes are issued to both slots alternately, so that the
+    next longword is already set up while the previous one is still on the bus. Reads keep two
+    transactions in flight, once the data of one slot is fetched the next read is started in the
+    same slot immediately. Intended for memory only, callers take care of register areas.
+*/
+static void ps32_do_write_block_2s(unsigned int address, const uint32_t *data, unsigned int count)
+{
+    set_output();
+
+    for (unsigned int i=0; i < count; i++, address += 4)
+    {
+        write_ps_reg_ps32(REG_SLOT, next_slot);
+        if (slot_active[next_slot])
+        {
+            wait_txn();
+        }
+
+        write_ps_reg_ps32(REG_DATA_LO, data[i] & 0xffff);
+        write_ps_reg_ps32(REG_DATA_HI, (data[i] >> 16) & 0xffff);
+
+        write_ps_reg_ps32(REG_ADDR_LO, address & 0xffff);
+        write_ps_reg_ps32(REG_ADDR_HI, TXN_WRITE | (g_fc << TXN_FC_SHIFT) | (SIZE_LONG << TXN_SIZE_SHIFT) | ((address >> 16) & 0xff));
+
+        slot_active[next_slot] = 1;
+        next_slot = (next_slot + 1) & 1;
+    }
+
+    set_input();
+}
+
+static void ps32_do_read_block_2s(unsigned int address, uint32_t *data, unsigned int count)
+{
+    int first_slot = next_slot;
+    unsigned int issued = 0;
+
+    set_output();
+
+    /* Start first two reads */
+    while (issued < count && issued < 2)
+    {
+        write_ps_reg_ps32(REG_SLOT, next_slot);
+        if (slot_active[next_slot])
+        {
+            wait_txn();
+        }
+
+        write_ps_reg_ps32(REG_ADDR_LO, (address + 4 * issued) & 0xffff);
+        write_ps_reg_ps32(REG_ADDR_HI, TXN_READ | (g_fc << TXN_FC_SHIFT) | (SIZE_LONG << TXN_SIZE_SHIFT) | (((address + 4 * issued) >> 16) & 0xff));
+
+        slot_active[next_slot] = 1;
+        next_slot = (next_slot + 1) & 1;
+        issued++;
+    }
+
+    /* Fetch results in order of issue, restart the slot with next read as soon as it is free */
+    for (unsigned int i=0; i < count; i++)
+    {
+        int slot = (first_slot + i) & 1;
+
+        set_output();
+        write_ps_reg_ps32(REG_SLOT, slot);
+        set_input();
+
+        wait_txn();
+
+        data[i] = read_ps_reg_ps32(REG_DATA_LO);
+        data[i] |= read_ps_reg_ps32(REG_DATA_HI) << 16;
+        slot_active[slot] = 0;
+
+        if (issued < count)
+        {
+            set_output();
+
+            write_ps_reg_ps32(REG_ADDR_LO, (address + 4 * issued) & 0xffff);
+            write_ps_reg_ps32(REG_ADDR_HI, TXN_READ | (g_fc << TXN_FC_SHIFT) | (SIZE_LONG << TXN_SIZE_SHIFT) | (((address + 4 * issued) >> 16) & 0xff));
+
+            slot_active[slot] = 1;
+            issued++;
+        }
+    }
+
+    next_slot = (first_slot + count) & 1;
+}
+
 static inline void ps32_do_write_access(unsigned int address, unsigned int data, unsigned int size)
 {
     set_output();
@@ -1473,10 +1650,19 @@ void (*ps32_write_access_64)(unsigned int address, uint64_t data);
 void (*ps32_write_access_128)(unsigned int address, uint128_t data);
 
 void ps32_write_8_int(unsigned int address, unsigned int data) {
+    wq_drain();
     ps32_write_access(address, data, SIZE_BYTE);
 }
 
 void ps32_write_8(unsigned int address, unsigned int data) {
+#if PISTORM_WRITE_QUEUE
+    if (wq_can_post(address, 1))
+    {
+        wq_push(address, data, SIZE_BYTE);
+        cache_invalidate_range(ICACHE, address, 1);
+        return;
+    }
+#endif
     ps32_write_8_int(address, data);
     if (SLOW_IO(address))
     {
@@ -1486,10 +1672,19 @@ void ps32_write_8(unsigned int address, unsigned int data) {
 }
 
 void ps32_write_16_int(unsigned int address, unsigned int data) {
+    wq_drain();
     ps32_write_access(address, data, SIZE_WORD);
 }
 
 void ps32_write_16(unsigned int address, unsigned int data) {
+#if PISTORM_WRITE_QUEUE
+    if (wq_can_post(address, 2))
+    {
+        wq_push(address, data, SIZE_WORD);
+        cache_invalidate_range(ICACHE, address, 2);
+        return;
+    }
+#endif
     check_blit_active(address, 2);
     ps32_write_16_int(address, data);
     if (SLOW_IO(address))
@@ -1500,10 +1695,19 @@ void ps32_write_16(unsigned int address, unsigned int data) {
 }
 
 void ps32_write_32_int(unsigned int address, unsigned int data) {
+    wq_drain();
     ps32_write_access(address, data, SIZE_LONG);
 }
 
 void ps32_write_32(unsigned int address, unsigned int data) {
+#if PISTORM_WRITE_QUEUE
+    if (wq_can_post(address, 4))
+    {
+        wq_push(address, data, SIZE_LONG);
+        cache_invalidate_range(ICACHE, address, 4);
+        return;
+    }
+#endif
     check_blit_active(address, 4);
     ps32_write_32_int(address, data);
     if (SLOW_IO(address))
@@ -1514,6 +1718,7 @@ void ps32_write_32(unsigned int address, unsigned int data) {
 }
 
 void ps32_write_64_int(unsigned int address, uint64_t data) {
+    wq_drain();
     ps32_write_access_64(address, data);
 }
 
@@ -1528,6 +1733,7 @@ void ps32_write_64(unsigned int address, uint64_t data) {
 }
 
 void ps32_write_128_int(unsigned int address, uint128_t data) {
+    wq_drain();
     ps32_write_access_128(address, data);
 }
 
@@ -1541,23 +1747,79 @@ void ps32_write_128(unsigned int address, uint128_t data) {
     cache_invalidate_range(ICACHE, address, 16);
 }
 
+/* Block transfers of longwords. Chipset and CIA registers are accessed one by one as before */
+static inline int ps32_block_allowed(unsigned int address, unsigned int count)
+{
+    return use_2slot && (address + 4 * count <= 0x00bf0000 || address > 0x00dfffff);
+}
+
+void ps32_read_block(unsigned int address, uint32_t *data, unsigned int count)
+{
+    wq_drain();
+
+    if (ps32_block_allowed(address, count))
+    {
+        ps32_do_read_block_2s(address, data, count);
+    }
+    else
+    {
+        for (unsigned int i=0; i < count; i++)
+            data[i] = ps32_read_access(address + 4 * i, SIZE_LONG);
+    }
+}
+
+void ps32_write_block(unsigned int address, const uint32_t *data, unsigned int count)
+{
+    if (ps32_block_allowed(address, count))
+    {
+        wq_drain();
+        ps32_do_write_block_2s(address, data, count);
+        cache_invalidate_range(ICACHE, address, 4 * count);
+    }
+    else
+    {
+        for (unsigned int i=0; i < count; i++)
+            ps32_write_32(address + 4 * i, data[i]);
+    }
+}
+
 unsigned int ps32_read_8(unsigned int address) {
+    wq_drain();
     return ps32_read_access(address, SIZE_BYTE);
 }
 
 unsigned int ps32_read_16(unsigned int address) {
+    wq_drain();
     return ps32_read_access(address, SIZE_WORD);
 }
 
 unsigned int ps32_read_32(unsigned int address) {
+    wq_drain();
     return ps32_read_access(address, SIZE_LONG);
 }
 
 uint64_t ps32_read_64(unsigned int address) {
+    wq_drain();
     return ps32_read_access_64(address);
 }
 
 uint128_t ps32_read_128(unsigned int address) {
+    wq_drain();
+
+    /* MOVE16 and 128-bit loads keep both slots busy */
+    if (ps32_block_allowed(address, 4))
+    {
+        uint32_t buf[4];
+        uint128_t data;
+
+        ps32_do_read_block_2s(address, buf, 4);
+
+        data.hi = ((uint64_t)buf[0] << 32) | buf[1];
+        data.lo = ((uint64_t)buf[2] << 32) | buf[3];
+
+        return data;
+    }
+
     return ps32_read_access_128(address);
 }
 
@@ -1856,6 +2118,18 @@ void ps16_write_128(unsigned int address, uint128_t data)
     cache_invalidate_range(ICACHE, address, 16);
 }
 
+void ps16_read_block(unsigned int address, uint32_t *data, unsigned int count)
+{
+    for (unsigned int i=0; i < count; i++)
+        data[i] = ps16_read_32(address + 4 * i);
+}
+
+void ps16_write_block(unsigned int address, const uint32_t *data, unsigned int count)
+{
+    for (unsigned int i=0; i < count; i++)
+        ps16_write_32(address + 4 * i, data[i]);
+}
+
 static uint8_t pistorm_model;
 
 unsigned int (*ps_read_8)(unsigned int address);
@@ -1870,6 +2144,9 @@ void (*ps_write_32)(unsigned int address, unsigned int data);
 void (*ps_write_64)(unsigned int address, uint64_t data);
 void (*ps_write_128)(unsigned int address, uint128_t data);
 
+void (*ps_read_block)(unsigned int address, uint32_t *data, unsigned int count);
+void (*ps_write_block)(unsigned int address, const uint32_t *data, unsigned int count);
+
 unsigned int (*ps_read_8_int)(unsigned int address);
 unsigned int (*ps_read_16_int)(unsigned int address);
 unsigned int (*ps_read_32_int)(unsigned int address);
@@ -1882,6 +2159,9 @@ void (*ps_write_64_int)(unsigned int address, uint64_t data);
 
 void ps_setup_protocol()
 {
+#if PISTORM_SIM
+    pistorm_model = PISTORM_MODEL_32;
+#else
     pistorm_setup_io();
     pistorm_setup_serial();
 
@@ -1890,6 +2170,7 @@ void ps_setup_protocol()
     set_input();
 
     pistorm_model = pistorm_get_model();
+#endif
 
     switch (pistorm_model)
     {
@@ -1939,6 +2220,9 @@ void ps_setup_protocol()
             ps_write_64 = ps32_write_64;
             ps_write_128 = ps32_write_128;
 
+            ps_read_block = ps32_read_block;
+            ps_write_block = ps32_write_block;
+
             break;
 
         case PISTORM_MODEL_16:
@@ -1968,6 +2252,9 @@ void ps_setup_protocol()
             ps_write_64 = ps16_write_64;
             ps_write_128 = ps16_write_128;
 
+            ps_read_block = ps16_read_block;
+            ps_write_block = ps16_write_block;
+
             break;
     }
 }
@@ -1984,6 +2271,8 @@ void ps_reset_state_machine()
 {
 }
 
+#if !PISTORM_SIM
+
 #include <boards.h>
 extern struct ExpansionBoard **board;
 extern struct ExpansionBoard *__boards_start;
@@ -2151,6 +2440,25 @@ void ps_pulse_reset()
     ignore_reset = 0;
 }
 
+#if PISTORM_WRITE_QUEUE
+/*
+    Perform at most max posted writes, called by the housekeeper. The limit keeps latency of IPL
+    polling low when CPU0 pushes writes faster than the bus can take them.
+*/
+static void wq_process(int max)
+{
+    uint32_t tail = wq_tail;
+
+    while (max-- > 0 && tail != __atomic_load_n(&wq_head, __ATOMIC_ACQUIRE))
+    {
+        struct WriteRequest *req = &wq_buffer[tail & (PISTORM_WRITE_QUEUE - 1)];
+
+        ps32_write_access(req->wr_addr, req->wr_value, req->wr_size);
+
+        __atomic_store_n(&wq_tail, ++tail, __ATOMIC_RELEASE);
+    }
+}
+#endif
 
 void ps_housekeeper()
 {
@@ -2185,65 +2493,25 @@ void ps_housekeeper()
     {
         /*
               Wait for event. It can happen that the CPU is flooded with them for some reason, but
-              nevertheless, thanks for the event stream set up above, they will appear at 1.2MHz in worst case
+              nevertheless, thanks for the event stream set up above, they will appear at 1.2MHz in worst case.
+              Posted writes are pushed with sev, as long as some are left in the queue there is no waiting.
         */
+#if PISTORM_WRITE_QUEUE
+        if (wq_tail == wq_head)
+#endif
         asm volatile("wfe");
 
         if (housekeeper_enabled)
         {
-            uint32_t pin = LE32(GPIO->GPLEV0);
-#if 0
-            static uint64_t last_stats_shown = 0;
-            uint64_t now;
-
-            asm volatile("mrs %0, CNTPCT_EL0" : "=r"(now));
-            if (now - last_stats_shown >= (freq)) {
-                last_stats_shown = now;
-                double used = 100.0 * (1.0 - (double)tlsf_get_free_size(jit_tlsf) / (double)tlsf_get_total_size(jit_tlsf));
-                uint64_t percent = 100 * used;
-                kprintf("[JIT] JIT cache free %dkB, %d.%02d%% used, unit count %d\n", tlsf_get_free_size(jit_tlsf) / 1024, percent / 100, percent % 100, __m68k_state->JIT_UNIT_COUNT);
-#if 0
-                int max_idx = 0;
-                static struct {
-                    uint32_t item_count;
-                    uint32_t list_count;
-                } stats[EMU68_HASHSIZE]; 
-
-                for (int i=0; i < EMU68_HASHSIZE; i++) {
-                    stats[i].item_count = 0;
-                    stats[i].list_count = 0;
-                }
+            uint32_t pin;
 
-                for (int i=0; i < EMU68_HASHSIZE; i++) {
-                    extern struct List ICache[EMU68_HASHSIZE];
-                    unsigned cnt = 0;
-                    struct List *l = &ICache[i];
-                    struct Node *n;
-                    ForeachNode(l, n) {
-                        cnt++;
-                    }
-                    if (cnt == 0) continue;
-
-                    int stats_idx = -1;
-                    for (int j=0; j < max_idx; j++) {
-                        if (stats[j].item_count == cnt) {
-                            stats_idx = j;
-                            break;
-                        }
-                    }
-                    if (stats_idx == -1) {
-                        stats_idx = max_idx++;
-                    }
-                    stats[stats_idx].item_count = cnt;
-                    stats[stats_idx].list_count++;
-                }
-                kprintf("[JIT] JIT usage stats:\n");
-                for (int i=0; i < max_idx; i++) {
-                    kprintf("[JIT]   %10d lists have %10d items in bucket\n", stats[i].list_count, stats[i].item_count);
-                }
-#endif
-            }
+#if PISTORM_WRITE_QUEUE
+            wq_process(16);
 #endif
+            pin = LE32(GPIO->GPLEV0);
+
+            JITStat_Periodic();
+
             // Reall 680x0 CPU filters IPL lines in order to avoid false interrupts if
             // there is a clock skew between three IPL bits. We need to do the same.
             // Update IPL if and only if two subsequent IPL reads are the same.
@@ -2458,6 +2726,77 @@ void ps_memtest(unsigned int test_size)
     kprintf_pc(__putc, NULL, "  WRITE LONG: %5ld KB/s   %5ld ns\n", (unsigned int)result / 1024, ns);
 }
 
+/* One pass of the bus benchmark over test_size bytes of CHIP memory, using access of given size */
+static void ps_busbench_pass(int write, unsigned int size, unsigned int test_size)
+{
+    static uint32_t block[64];
+    uint128_t val = { 0, 0 };
+
+    for (unsigned int addr = 0x1000; addr < test_size + 0x1000; addr += size)
+    {
+        switch (size)
+        {
+            case 1:
+                if (write) ps_write_8(addr, 0); else (void)ps_read_8(addr);
+                break;
+            case 2:
+                if (write) ps_write_16(addr, 0); else (void)ps_read_16(addr);
+                break;
+            case 4:
+                if (write) ps_write_32(addr, 0); else (void)ps_read_32(addr);
+                break;
+            case 8:
+                if (write) ps_write_64(addr, 0); else (void)ps_read_64(addr);
+                break;
+            case 16:
+                if (write) ps_write_128(addr, val); else val = ps_read_128(addr);
+                break;
+            default:
+                if (write) ps_write_block(addr, block, size / 4); else ps_read_block(addr, block, size / 4);
+                break;
+        }
+    }
+}
+
+void ps_busbench(unsigned int test_size)
+{
+    static const unsigned int sizes[] = { 1, 2, 4, 8, 16, 256 };
+    static const char * const names[] = { "BYTE: ", "WORD: ", "LONG: ", "QUAD: ", "OCTA: ", "BLOCK:" };
+    uint64_t clkspeed;
+    uint64_t t0, t1;
+
+    asm volatile("mrs %0, CNTFRQ_EL0":"=r"(clkspeed));
+
+    if (test_size > 1024 * 1024)
+        test_size = 1024 * 1024;
+
+    kprintf_pc(__putc, NULL, "BusBench with size %dK requested through commandline\n", test_size / 1024);
+
+    for (int write = 0; write < 2; write++)
+    {
+        for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        {
+            int num_iter = 1;
+
+            do {
+                asm volatile("mrs %0, CNTPCT_EL0":"=r"(t0));
+
+                for (int iter = 0; iter < num_iter; iter++)
+                    ps_busbench_pass(write, sizes[i], test_size);
+
+                asm volatile("mrs %0, CNTPCT_EL0":"=r"(t1));
+                num_iter <<= 1;
+            } while((t1 - t0) < clkspeed);
+
+            /* Throughput in KB/s, printed as MB/s with two decimal places */
+            uint32_t kbs = (uint64_t)test_size * (num_iter >> 1) * clkspeed / (t1 - t0) / 1024;
+
+            kprintf_pc(__putc, NULL, "  %s %s %4d.%02d MB/s\n", write ? "WRITE" : "READ ", names[i],
+                kbs / 1024, (kbs % 1024) * 100 / 1024);
+        }
+    }
+}
+
 void ps_buptest(unsigned int test_size, unsigned int maxiter)
 {
     // Initialize RNG
@@ -2633,3 +2972,5 @@ void ps_buptest(unsigned int test_size, unsigned int maxiter)
 
     tlsf_free(tlsf, garbage);
 }
+
+#endif /* !PISTORM_SIM */
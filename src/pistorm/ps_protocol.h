@@ -102,6 +102,9 @@ extern void ps_write_32(unsigned int address, unsigned int data);
 extern void ps_write_64(unsigned int address, uint64_t data);
 extern void ps_write_128(unsigned int address, uint128_t data);
 
+extern void ps_read_block(unsigned int address, uint32_t *data, unsigned int count);
+extern void ps_write_block(unsigned int address, const uint32_t *data, unsigned int count);
+
 extern unsigned int ps_read_8_int(unsigned int address);
 extern unsigned int ps_read_16_int(unsigned int address);
 extern unsigned int ps_read_32_int(unsigned int address);
@@ -124,6 +127,9 @@ extern void (*ps_write_32)(unsigned int address, unsigned int data);
 extern void (*ps_write_64)(unsigned int address, uint64_t data);
 extern void (*ps_write_128)(unsigned int address, uint128_t data);
 
+extern void (*ps_read_block)(unsigned int address, uint32_t *data, unsigned int count);
+extern void (*ps_write_block)(unsigned int address, const uint32_t *data, unsigned int count);
+
 extern unsigned int (*ps_read_8_int)(unsigned int address);
 extern unsigned int (*ps_read_16_int)(unsigned int address);
 extern unsigned int (*ps_read_32_int)(unsigned int address);
@@ -136,6 +142,7 @@ extern void (*ps_write_32_int)(unsigned int address, unsigned int data);
 
 void ps_memtest(unsigned int test_size);
 void ps_buptest(unsigned int test_size, unsigned int maxiter);
+void ps_busbench(unsigned int test_size);
 
 unsigned int ps_read_status_reg();
 void ps_write_status_reg(unsigned int value);
@@ -0,0 +1,231 @@
+/*
+    Copyright © 2025 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#include <stdint.h>
+#include "ps_sim.h"
+
+/* Register layout of the PiStorm32 firmware, the same as used by ps_protocol.c */
+#define SIM_REG_DATA_LO     0
+#define SIM_REG_DATA_HI     1
+#define SIM_REG_ADDR_LO     2
+#define SIM_REG_ADDR_HI     3
+#define SIM_REG_SLOT        5
+
+#define SIM_TXN_READ        (1 << 10)
+#define SIM_SIZE_BYTE       0
+#define SIM_SIZE_WORD       1
+#define SIM_SIZE_LONG       3
+
+#define SIM_ADDR_MASK       0x00ffffff
+
+struct SimSlot {
+    uint16_t    sl_DataLo;
+    uint16_t    sl_DataHi;
+    uint16_t    sl_AddrLo;
+    uint64_t    sl_Done;        /* Simulated time at which the transaction of the slot completes */
+};
+
+static struct {
+    uint8_t *           s_Memory;
+    struct PSSimTiming  s_Timing;
+    struct PSSimStats   s_Stats;
+    struct SimSlot      s_Slot[2];
+    int                 s_Selected;
+    uint64_t            s_Now;
+    uint64_t            s_BusFree;  /* Time at which the m68k bus is done with all started transactions */
+} sim;
+
+void ps_sim_init(uint8_t *memory, const struct PSSimTiming *timing)
+{
+    sim.s_Memory = memory;
+    sim.s_Timing = *timing;
+    sim.s_Selected = 0;
+    sim.s_Now = 0;
+    sim.s_BusFree = 0;
+
+    for (int i=0; i < 2; i++)
+    {
+        sim.s_Slot[i].sl_DataLo = 0;
+        sim.s_Slot[i].sl_DataHi = 0;
+        sim.s_Slot[i].sl_AddrLo = 0;
+        sim.s_Slot[i].sl_Done = 0;
+    }
+
+    ps_sim_reset_stats();
+}
+
+uint64_t ps_sim_time(void)
+{
+    return sim.s_Now;
+}
+
+void ps_sim_get_stats(struct PSSimStats *stats)
+{
+    *stats = sim.s_Stats;
+}
+
+void ps_sim_reset_stats(void)
+{
+    sim.s_Stats.ss_RegReads = 0;
+    sim.s_Stats.ss_RegWrites = 0;
+    sim.s_Stats.ss_Transactions = 0;
+    sim.s_Stats.ss_Bytes = 0;
+    sim.s_Stats.ss_WaitTime = 0;
+    sim.s_Stats.ss_Violations = 0;
+}
+
+static inline int slot_busy(struct SimSlot *slot)
+{
+    return sim.s_Now < slot->sl_Done;
+}
+
+/*
+    Start transaction in selected slot. Data and address are latched here, so the Pi may set up the
+    registers for the next access while the bus is busy. Memory is accessed at once, only the time
+    is deferred.
+*/
+static void start_txn(uint16_t addr_hi)
+{
+    struct SimSlot *slot = &sim.s_Slot[sim.s_Selected];
+    uint32_t address = (((uint32_t)addr_hi & 0xff) << 16) | slot->sl_AddrLo;
+    uint32_t size = (addr_hi >> 8) & 3;
+    uint8_t *mem = sim.s_Memory;
+    uint32_t cycles = size == SIM_SIZE_LONG ? 2 : 1;
+    uint32_t cycle = (address >= 0xbf0000 && address <= 0xbfffff) ? sim.s_Timing.st_CIACycle : sim.s_Timing.st_BusCycle;
+    uint64_t start = sim.s_Now > sim.s_BusFree ? sim.s_Now : sim.s_BusFree;
+
+    if (slot_busy(slot))
+        sim.s_Stats.ss_Violations++;
+
+    slot->sl_Done = sim.s_BusFree = start + cycles * cycle;
+
+    sim.s_Stats.ss_Transactions++;
+    sim.s_Stats.ss_Bytes += size == SIM_SIZE_LONG ? 4 : size + 1;
+
+    if (addr_hi & SIM_TXN_READ)
+    {
+        switch (size)
+        {
+            case SIM_SIZE_BYTE:
+                slot->sl_DataLo = mem[address];
+                break;
+            case SIM_SIZE_WORD:
+                slot->sl_DataLo = (mem[address] << 8) | mem[(address + 1) & SIM_ADDR_MASK];
+                break;
+            default:
+                slot->sl_DataHi = (mem[address] << 8) | mem[(address + 1) & SIM_ADDR_MASK];
+                slot->sl_DataLo = (mem[(address + 2) & SIM_ADDR_MASK] << 8) | mem[(address + 3) & SIM_ADDR_MASK];
+                break;
+        }
+    }
+    else
+    {
+        switch (size)
+        {
+            case SIM_SIZE_BYTE:
+                mem[address] = slot->sl_DataLo;
+                break;
+            case SIM_SIZE_WORD:
+                mem[address] = slot->sl_DataLo >> 8;
+                mem[(address + 1) & SIM_ADDR_MASK] = slot->sl_DataLo;
+                break;
+            default:
+                mem[address] = slot->sl_DataHi >> 8;
+                mem[(address + 1) & SIM_ADDR_MASK] = slot->sl_DataHi;
+                mem[(address + 2) & SIM_ADDR_MASK] = slot->sl_DataLo >> 8;
+                mem[(address + 3) & SIM_ADDR_MASK] = slot->sl_DataLo;
+                break;
+        }
+    }
+}
+
+void ps_sim_set_input(void)
+{
+    sim.s_Now += sim.s_Timing.st_Direction;
+}
+
+void ps_sim_set_output(void)
+{
+    sim.s_Now += sim.s_Timing.st_Direction;
+}
+
+/* TXN pin reflects the transaction of currently selected slot */
+uint32_t ps_sim_wait_txn(void)
+{
+    struct SimSlot *slot = &sim.s_Slot[sim.s_Selected];
+
+    if (slot_busy(slot))
+    {
+        sim.s_Stats.ss_WaitTime += slot->sl_Done - sim.s_Now;
+        sim.s_Now = slot->sl_Done;
+    }
+
+    sim.s_Now += sim.s_Timing.st_RegRead;
+
+    return 0;
+}
+
+uint32_t ps_sim_read_reg(uint32_t address)
+{
+    struct SimSlot *slot = &sim.s_Slot[sim.s_Selected];
+
+    sim.s_Now += sim.s_Timing.st_RegRead;
+    sim.s_Stats.ss_RegReads++;
+
+    switch (address)
+    {
+        case SIM_REG_DATA_LO:
+            if (slot_busy(slot))
+                sim.s_Stats.ss_Violations++;
+            return slot->sl_DataLo;
+        case SIM_REG_DATA_HI:
+            if (slot_busy(slot))
+                sim.s_Stats.ss_Violations++;
+            return slot->sl_DataHi;
+        default:
+            return 0;
+    }
+}
+
+uint32_t ps_sim_read_reg_with_wait(uint32_t address)
+{
+    ps_sim_wait_txn();
+
+    return ps_sim_read_reg(address);
+}
+
+void ps_sim_write_reg(uint32_t address, uint16_t data)
+{
+    struct SimSlot *slot = &sim.s_Slot[sim.s_Selected];
+
+    sim.s_Now += sim.s_Timing.st_RegWrite;
+    sim.s_Stats.ss_RegWrites++;
+
+    switch (address)
+    {
+        case SIM_REG_DATA_LO:
+            slot->sl_DataLo = data;
+            break;
+        case SIM_REG_DATA_HI:
+            slot->sl_DataHi = data;
+            break;
+        case SIM_REG_ADDR_LO:
+            slot->sl_AddrLo = data;
+            break;
+        case SIM_REG_ADDR_HI:
+            start_txn(data);
+            break;
+        case SIM_REG_SLOT:
+            sim.s_Selected = data & 1;
+            break;
+        default:
+            /* REG_CONTROL and others have no effect on the simulated bus */
+            break;
+    }
+}
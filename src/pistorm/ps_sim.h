@@ -0,0 +1,55 @@
+/*
+    Copyright © 2025 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+#ifndef _PS_SIM_H
+#define _PS_SIM_H
+
+#include <stdint.h>
+
+/*
+    Simulated PiStorm32 firmware. When ps_protocol.c is built with PISTORM_SIM, register reads
+    and writes and the TXN status pin are handled here instead of through GPIO. The simulation
+    keeps two transaction slots and executes their bus cycles in order against 16 MB of memory
+    standing for the Amiga address space.
+
+    Time is simulated. Every register access moves the clock forward by a fixed cost, and a bus
+    transaction takes a number of m68k bus cycles. Throughput of a protocol variant is the amount
+    of data divided by the simulated time, independent of the speed of the host.
+*/
+
+struct PSSimTiming {
+    uint32_t    st_RegWrite;    /* ns per register write from the Pi side */
+    uint32_t    st_RegRead;     /* ns per register read */
+    uint32_t    st_Direction;   /* ns to switch data pins between input and output */
+    uint32_t    st_BusCycle;    /* ns per 16-bit m68k bus cycle */
+    uint32_t    st_CIACycle;    /* ns per access synchronized to the E clock ($BF0000 - $BFFFFF) */
+};
+
+struct PSSimStats {
+    uint64_t    ss_RegReads;
+    uint64_t    ss_RegWrites;
+    uint64_t    ss_Transactions;
+    uint64_t    ss_Bytes;           /* Data moved by bus transactions */
+    uint64_t    ss_WaitTime;        /* ns spent waiting for the TXN pin */
+    uint64_t    ss_Violations;      /* Transaction started or data read while the slot was still busy */
+};
+
+void ps_sim_init(uint8_t *memory, const struct PSSimTiming *timing);
+uint64_t ps_sim_time(void);
+void ps_sim_get_stats(struct PSSimStats *stats);
+void ps_sim_reset_stats(void);
+
+void ps_sim_set_input(void);
+void ps_sim_set_output(void);
+uint32_t ps_sim_wait_txn(void);
+uint32_t ps_sim_read_reg(uint32_t address);
+uint32_t ps_sim_read_reg_with_wait(uint32_t address);
+void ps_sim_write_reg(uint32_t address, uint16_t data);
+
+#endif /* _PS_SIM_H */
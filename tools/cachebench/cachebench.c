@@ -0,0 +1,190 @@
+/*
+    Copyright © 2025 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/*
+    Host side microbenchmark of the emulated m68k cache model in src/cache.c. Builds on a Linux
+    host together with the cache model itself, e.g. on the Raspberry Pi to measure the NEON tag
+    lookup, or anywhere else for the scalar one:
+
+        cc -O2 -D_REGLOCK_H -Iinclude -o cachebench tools/cachebench/cachebench.c src/cache.c
+
+    _REGLOCK_H keeps the global register variables of Emu68 out of the host build.
+
+    The 16 MB m68k address space is backed by anonymous memory mapped at its real addresses.
+    Access patterns resemble what the translator does: opcode fetches running through short
+    blocks of ROM code, CRC32 of a block done byte by byte, and a mix of hits and misses of
+    data reads and writes.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "cache.h"
+
+#define M68K_MEM_BASE   0x00010000
+#define M68K_MEM_END    0x01000000
+#define ROM_START       0x00f80000
+#define ROM_SIZE        0x00080000
+
+/* Symbols of Emu68 used by cache.c */
+void *tlsf = NULL;
+
+void *tlsf_malloc_aligned(void *handle, uintptr_t size, uintptr_t align)
+{
+    (void)handle;
+    return aligned_alloc(align, (size + align - 1) & ~(align - 1));
+}
+
+void kprintf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t rng()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static volatile uint32_t sink;
+
+/* Translator fetching opcodes: blocks of 8-40 words starting at random places of the ROM */
+static uint64_t bench_fetch(uint64_t count)
+{
+    uint32_t sum = 0;
+    uint64_t done = 0;
+
+    while (done < count)
+    {
+        uint32_t pc = ROM_START + (rng() % ROM_SIZE & ~1);
+        uint32_t len = 8 + rng() % 32;
+
+        for (uint32_t i=0; i < len && pc < ROM_START + ROM_SIZE; i++, pc += 2)
+            sum += cache_read_16(ICACHE, pc);
+
+        done += len;
+    }
+
+    sink = sum;
+    return done;
+}
+
+/* Hot loop translated over and over again, stays in the cache */
+static uint64_t bench_hot(uint64_t count)
+{
+    uint32_t sum = 0;
+
+    for (uint64_t i=0; i < count; i++)
+        sum += cache_read_16(ICACHE, ROM_START + 0x1000 + ((i % 64) << 1));
+
+    sink = sum;
+    return count;
+}
+
+/* CRC of a translated block, byte by byte */
+static uint64_t bench_crc(uint64_t count)
+{
+    uint32_t sum = 0;
+    uint64_t done = 0;
+
+    while (done < count)
+    {
+        uint32_t start = 0x00200000 + (rng() % 0x00400000);
+        uint32_t len = 32 + rng() % 224;
+
+        for (uint32_t i=0; i < len; i++)
+            sum = (sum << 1) ^ cache_read_8(DCACHE, start + i);
+
+        done += len;
+    }
+
+    sink = sum;
+    return done;
+}
+
+/* Data accesses: 3 of 4 to a small working set, rest all over the memory, every fourth one writes */
+static uint64_t bench_data(uint64_t count)
+{
+    uint32_t sum = 0;
+
+    for (uint64_t i=0; i < count; i++)
+    {
+        uint32_t r = rng();
+        uint32_t addr = (r & 3) ? 0x00300000 + (r >> 8) % 0x4000 : 0x00100000 + (r >> 8) % 0x00e00000;
+
+        addr &= ~3;
+
+        if ((i & 3) == 3)
+            cache_write_32(DCACHE, addr, r, 1);
+        else
+            sum += cache_read_32(DCACHE, addr);
+    }
+
+    sink = sum;
+    return count;
+}
+
+static void run(const char *name, uint64_t (*func)(uint64_t), uint64_t count)
+{
+    cache_invalidate_all(ICACHE);
+    cache_invalidate_all(DCACHE);
+
+    /* Warm up */
+    func(count / 10);
+
+    uint64_t t0 = now_ns();
+    uint64_t done = func(count);
+    uint64_t t1 = now_ns();
+
+    double secs = (double)(t1 - t0) / 1e9;
+    printf("%-16s %10.2f M lookups/s  %6.2f ns/lookup\n", name, done / secs / 1e6, (t1 - t0) / (double)done);
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t count = argc > 1 ? strtoull(argv[1], NULL, 0) : 20000000;
+
+    void *mem = mmap((void *)M68K_MEM_BASE, M68K_MEM_END - M68K_MEM_BASE, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+    if (mem != (void *)M68K_MEM_BASE)
+    {
+        perror("cannot map m68k address space");
+        return 1;
+    }
+
+    for (uint32_t *p = (uint32_t *)(uintptr_t)ROM_START; p < (uint32_t *)(uintptr_t)(ROM_START + ROM_SIZE); p++)
+        *p = rng();
+
+    cache_setup();
+
+    run("opcode fetch", bench_fetch, count);
+    run("hot loop", bench_hot, count);
+    run("crc bytes", bench_crc, count);
+    run("data r/w", bench_data, count);
+
+    return 0;
+}
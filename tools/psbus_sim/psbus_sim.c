@@ -0,0 +1,378 @@
+/*
+    Copyright © 2025 Michal Schulz <michal.schulz@gmx.de>
+    https://github.com/michalsc
+
+    This Source Code Form is subject to the terms of the
+    Mozilla Public License, v. 2.0. If a copy of the MPL was not distributed
+    with this file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/*
+    Host side test and benchmark of the PiStorm32 bus protocol. The real ps_protocol.c is built
+    with PISTORM_SIM, so all register accesses go to the simulated firmware in ps_sim.c instead
+    of the GPIO pins:
+
+        cc -O2 -D_REGLOCK_H -DPISTORM -DPISTORM_SIM=1 -Iinclude -Isrc/pistorm -o psbus_sim \
+            tools/psbus_sim/psbus_sim.c src/pistorm/ps_protocol.c src/pistorm/ps_sim.c
+
+    _REGLOCK_H keeps the global register variables of Emu68 out of the host build.
+
+    First a random mix of reads and writes of all sizes, including block transfers, is run with
+    and without two slot pipelining and compared against a reference copy of the memory. Any
+    difference, or an access done by the protocol while the slot was still busy, is an error.
+    Then every access size is timed in simulated time. The reported throughput depends only on
+    the latencies given on the command line, not on the speed of the host.
+
+    Options:
+        -n <ops>        number of random accesses in the test (default 200000)
+        -s <seed>       seed of the random generator
+        -c <ns>         length of m68k bus cycle (default 564, i.e. 7.09 MHz, 4 clocks)
+        -r <ns>         register read from the Pi side (default 25)
+        -w <ns>         register write from the Pi side (default 12)
+        -d <ns>         switching data pins direction (default 10)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include "support.h"
+#include "cache.h"
+#include "ps_protocol.h"
+#include "ps_sim.h"
+
+#define AMIGA_MEM_SIZE  0x01000000
+#define BLOCK_MAX       32
+
+/* Symbols of Emu68 used by ps_protocol.c */
+struct M68KState *__m68k_state = NULL;
+extern uint32_t use_2slot;
+
+void cache_invalidate_range(enum CacheType type, uint32_t address, uint32_t len)
+{
+    (void)type; (void)address; (void)len;
+}
+
+static uint8_t *memory;
+static uint8_t *reference;
+
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t rng()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint32_t ref_get(uint32_t address, int size)
+{
+    uint32_t v = 0;
+
+    for (int i=0; i < size; i++)
+        v = (v << 8) | reference[(address + i) & (AMIGA_MEM_SIZE - 1)];
+
+    return v;
+}
+
+static void ref_put(uint32_t address, int size, uint32_t v)
+{
+    for (int i=size - 1; i >= 0; i--)
+    {
+        reference[(address + i) & (AMIGA_MEM_SIZE - 1)] = v;
+        v >>= 8;
+    }
+}
+
+/*
+    Random address for an access of given size. Mostly CHIP RAM, where block transfers are done,
+    some of the accesses go to slow and fast RAM and to the range excluded from the block path.
+*/
+static uint32_t random_address(uint32_t size)
+{
+    uint32_t address;
+
+    switch (rng() & 7)
+    {
+        case 0:
+            address = 0x00200000 + (rng() & 0x7fffff);
+            break;
+        case 1:
+            address = 0x00c00000 + (rng() & 0x1fffff);
+            break;
+        default:
+            address = rng() & 0x1fffff;
+            break;
+    }
+
+    /* m68k accesses larger than a byte are word aligned */
+    if (size > 1)
+        address &= ~1;
+
+    if (address + size > AMIGA_MEM_SIZE)
+        address = AMIGA_MEM_SIZE - size;
+
+    return address;
+}
+
+static int errors;
+
+static void mismatch(const char *what, uint32_t address, uint64_t got, uint64_t expected)
+{
+    if (errors++ < 10)
+        printf("  %s at %08x: got %llx, expected %llx\n", what, address, (unsigned long long)got, (unsigned long long)expected);
+}
+
+static void test(uint64_t ops)
+{
+    uint32_t buf[BLOCK_MAX];
+
+    for (uint64_t n=0; n < ops; n++)
+    {
+        int write = rng() & 1;
+        int kind = rng() % 7;
+        uint32_t v = rng();
+        uint32_t address;
+
+        switch (kind)
+        {
+            case 0:
+                address = random_address(1);
+                if (write) { ps_write_8(address, v & 0xff); ref_put(address, 1, v); }
+                else if (ps_read_8(address) != ref_get(address, 1)) mismatch("read 8", address, ps_read_8(address), ref_get(address, 1));
+                break;
+
+            case 1:
+                address = random_address(2);
+                if (write) { ps_write_16(address, v & 0xffff); ref_put(address, 2, v); }
+                else if (ps_read_16(address) != ref_get(address, 2)) mismatch("read 16", address, ps_read_16(address), ref_get(address, 2));
+                break;
+
+            case 2:
+                address = random_address(4);
+                if (write) { ps_write_32(address, v); ref_put(address, 4, v); }
+                else if (ps_read_32(address) != ref_get(address, 4)) mismatch("read 32", address, ps_read_32(address), ref_get(address, 4));
+                break;
+
+            case 3:
+                address = random_address(8);
+                if (write)
+                {
+                    uint64_t d = ((uint64_t)v << 32) | rng();
+                    ps_write_64(address, d);
+                    ref_put(address, 4, d >> 32);
+                    ref_put(address + 4, 4, d);
+                }
+                else
+                {
+                    uint64_t d = ps_read_64(address);
+                    uint64_t e = ((uint64_t)ref_get(address, 4) << 32) | ref_get(address + 4, 4);
+                    if (d != e) mismatch("read 64", address, d, e);
+                }
+                break;
+
+            case 4:
+                address = random_address(16);
+                if (write)
+                {
+                    uint128_t d;
+                    d.hi = ((uint64_t)v << 32) | rng();
+                    d.lo = ((uint64_t)rng() << 32) | rng();
+                    ps_write_128(address, d);
+                    ref_put(address, 4, d.hi >> 32);
+                    ref_put(address + 4, 4, d.hi);
+                    ref_put(address + 8, 4, d.lo >> 32);
+                    ref_put(address + 12, 4, d.lo);
+                }
+                else
+                {
+                    uint128_t d = ps_read_128(address);
+                    uint64_t hi = ((uint64_t)ref_get(address, 4) << 32) | ref_get(address + 4, 4);
+                    uint64_t lo = ((uint64_t)ref_get(address + 8, 4) << 32) | ref_get(address + 12, 4);
+                    if (d.hi != hi) mismatch("read 128 (hi)", address, d.hi, hi);
+                    if (d.lo != lo) mismatch("read 128 (lo)", address + 8, d.lo, lo);
+                }
+                break;
+
+            default:
+            {
+                uint32_t count = 1 + v % BLOCK_MAX;
+                address = random_address(4 * count);
+                if (write)
+                {
+                    for (uint32_t i=0; i < count; i++)
+                    {
+                        buf[i] = rng();
+                        ref_put(address + 4 * i, 4, buf[i]);
+                    }
+                    ps_write_block(address, buf, count);
+                }
+                else
+                {
+                    ps_read_block(address, buf, count);
+                    for (uint32_t i=0; i < count; i++)
+                    {
+                        if (buf[i] != ref_get(address + 4 * i, 4))
+                            mismatch("read block", address + 4 * i, buf[i], ref_get(address + 4 * i, 4));
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    if (memcmp(memory, reference, AMIGA_MEM_SIZE) != 0)
+    {
+        for (uint32_t i=0; i < AMIGA_MEM_SIZE; i++)
+        {
+            if (memory[i] != reference[i])
+            {
+                mismatch("memory", i, memory[i], reference[i]);
+                break;
+            }
+        }
+    }
+}
+
+#define BENCH_SIZE  0x10000
+
+enum BenchKind { B_8, B_16, B_32, B_64, B_128, B_BLOCK, B_COUNT };
+
+static const char * const bench_name[B_COUNT] = {
+    "BYTE: ", "WORD: ", "LONG: ", "QUAD: ", "128:  ", "BLOCK:"
+};
+
+/* Moves BENCH_SIZE bytes of CHIP RAM with given access size, returns throughput in kB/s */
+static uint64_t bench(enum BenchKind kind, int write)
+{
+    uint32_t buf[BLOCK_MAX] = { 0 };
+    uint128_t zero = { 0, 0 };
+    uint64_t start = ps_sim_time();
+    uint64_t t;
+
+    for (uint32_t a=0; a < BENCH_SIZE; )
+    {
+        switch (kind)
+        {
+            case B_8:
+                if (write) ps_write_8(a, 0); else ps_read_8(a);
+                a += 1;
+                break;
+            case B_16:
+                if (write) ps_write_16(a, 0); else ps_read_16(a);
+                a += 2;
+                break;
+            case B_32:
+                if (write) ps_write_32(a, 0); else ps_read_32(a);
+                a += 4;
+                break;
+            case B_64:
+                if (write) ps_write_64(a, 0); else ps_read_64(a);
+                a += 8;
+                break;
+            case B_128:
+                if (write) ps_write_128(a, zero); else ps_read_128(a);
+                a += 16;
+                break;
+            default:
+                if (write) ps_write_block(a, buf, BLOCK_MAX); else ps_read_block(a, buf, BLOCK_MAX);
+                a += 4 * BLOCK_MAX;
+                break;
+        }
+    }
+
+    /* A posted write is not done until the bus has completed it */
+    ps_read_8(0);
+
+    t = ps_sim_time() - start;
+
+    return t ? (uint64_t)BENCH_SIZE * 1000000ULL / t : 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct PSSimTiming timing = {
+        .st_RegWrite = 12,
+        .st_RegRead = 25,
+        .st_Direction = 10,
+        .st_BusCycle = 564,
+        .st_CIACycle = 1400,
+    };
+    struct PSSimStats stats;
+    uint64_t ops = 200000;
+
+    for (int i=1; i < argc; i++)
+    {
+        uint32_t *field = NULL;
+
+        if (i + 1 >= argc || argv[i][0] != '-' || argv[i][1] == 0 || argv[i][2] != 0)
+            field = NULL;
+        else if (argv[i][1] == 'n') { ops = strtoull(argv[++i], NULL, 0); continue; }
+        else if (argv[i][1] == 's') { rng_state = strtoul(argv[++i], NULL, 0) | 1; continue; }
+        else if (argv[i][1] == 'c') field = &timing.st_BusCycle;
+        else if (argv[i][1] == 'r') field = &timing.st_RegRead;
+        else if (argv[i][1] == 'w') field = &timing.st_RegWrite;
+        else if (argv[i][1] == 'd') field = &timing.st_Direction;
+
+        if (field == NULL)
+        {
+            fprintf(stderr, "usage: %s [-n ops] [-s seed] [-c bus_ns] [-r reg_read_ns] [-w reg_write_ns] [-d dir_ns]\n", argv[0]);
+            return 2;
+        }
+
+        *field = strtoul(argv[++i], NULL, 0);
+    }
+
+    memory = calloc(1, AMIGA_MEM_SIZE);
+    reference = calloc(1, AMIGA_MEM_SIZE);
+
+    if (memory == NULL || reference == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    for (int slots=2; slots >= 1; slots--)
+    {
+        use_2slot = slots == 2;
+
+        ps_sim_init(memory, &timing);
+        ps_setup_protocol();
+
+        printf("[PSSIM] %d slot protocol, %llu random accesses\n", slots, (unsigned long long)ops);
+
+        test(ops);
+
+        ps_sim_get_stats(&stats);
+        printf("  %llu transactions, %llu register reads, %llu register writes\n",
+            (unsigned long long)stats.ss_Transactions, (unsigned long long)stats.ss_RegReads,
+            (unsigned long long)stats.ss_RegWrites);
+
+        if (stats.ss_Violations)
+        {
+            printf("  %llu accesses to a busy slot\n", (unsigned long long)stats.ss_Violations);
+            errors++;
+        }
+
+        for (int write=0; write < 2; write++)
+        {
+            for (int k=0; k < B_COUNT; k++)
+            {
+                uint64_t kbps = bench(k, write);
+                printf("  %s %s %4llu.%02llu MB/s\n", write ? "WRITE" : "READ ", bench_name[k],
+                    (unsigned long long)(kbps / 1000), (unsigned long long)(kbps % 1000) / 10);
+            }
+        }
+
+        /* Benchmark wrote zeros to CHIP RAM, keep reference in sync for the next pass */
+        memcpy(reference, memory, AMIGA_MEM_SIZE);
+    }
+
+    printf("[PSSIM] %s\n", errors ? "FAILED" : "OK");
+
+    free(memory);
+    free(reference);
+
+    return errors ? 1 : 0;
+}